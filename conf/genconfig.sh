@@ -116,7 +116,8 @@ echo Successfully generated build_system.conf
 rm -f config.h platform.conf
 
 TESTFILES="simple.c stdlib.c has_intptr_t.c has_uintptr_t.c int_size_4.c
-	   long_size_4.c is64.c has_llong.c long_size_8.c llong_size_8.c"
+	   long_size_4.c is64.c has_llong.c long_size_8.c llong_size_8.c
+	   has_epoll.c has_atomics.c"
 
 cleanup() {
 	ECODE=$1
@@ -208,6 +209,22 @@ UIPT
 	fi
 
 
+cat > has_epoll.c <<HASEPOLL
+#include <sys/epoll.h>
+int main() { struct epoll_event ev; return epoll_wait(epoll_create(1), &ev, 1, 0); }
+HASEPOLL
+	if $CC -o /dev/null has_epoll.c $CCXFLAGS > /dev/null 2>&1 
+	then
+		echo "#ifndef CAT_HAS_EPOLL" >> config.h
+		echo "#define CAT_HAS_EPOLL 1" >> config.h
+		echo "#endif /* CAT_HAS_EPOLL */" >> config.h
+	else
+		echo "#ifndef CAT_HAS_EPOLL" >> config.h
+		echo "#define CAT_HAS_EPOLL 0" >> config.h
+		echo "#endif /* CAT_HAS_EPOLL */" >> config.h
+	fi
+
+
 else
 	echo "TARGETS=../lib/libcat_nolibc.a" >> platform.conf
 
@@ -276,6 +293,23 @@ else
 	HAS_LONG_LONG=0
 fi
 
+# Test for GCC style atomic builtins
+cat > has_atomics.c <<HASATOMICS
+long x;
+int main() { __atomic_store_n(&x, 1, __ATOMIC_RELEASE);
+	     return __atomic_exchange_n(&x, 0, __ATOMIC_ACQUIRE) != 1; }
+HASATOMICS
+if $CC -o /dev/null has_atomics.c $NOSTD $CCXFLAGS > /dev/null 2>&1 
+then
+	echo "#ifndef CAT_HAS_ATOMICS" >> config.h
+	echo "#define CAT_HAS_ATOMICS 1" >> config.h
+	echo "#endif /* CAT_HAS_ATOMICS */" >> config.h
+else
+	echo "#ifndef CAT_HAS_ATOMICS" >> config.h
+	echo "#define CAT_HAS_ATOMICS 0" >> config.h
+	echo "#endif /* CAT_HAS_ATOMICS */" >> config.h
+fi
+
 # Test for 64-bit architecture
 cat > is64.c <<IS64
 enum { FOO = 1 / (sizeof(long) >= 8 || sizeof(void*) >= 8) };
@@ -0,0 +1,65 @@
+/*
+ * cat/atomic.h -- Minimal atomic operations and spin locks
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2003-2017 -- See accompanying license
+ *
+ */
+#ifndef __cat_atomic_h
+#define __cat_atomic_h
+
+#include <cat/cat.h>
+
+#ifndef CAT_HAS_ATOMICS
+#define CAT_HAS_ATOMICS 0
+#endif /* CAT_HAS_ATOMICS */
+
+/*
+ * Loads and stores of pointer or integer sized objects with acquire,
+ * release, sequentially consistent or relaxed ordering.  Without
+ * CAT_HAS_ATOMICS these are plain memory accesses and the code that
+ * uses them is only safe in a single thread.
+ */
+#if CAT_HAS_ATOMICS
+
+#define cat_ld_acq(_p)		__atomic_load_n((_p), __ATOMIC_ACQUIRE)
+#define cat_st_rel(_p, _v)	__atomic_store_n((_p), (_v), __ATOMIC_RELEASE)
+#define cat_ld_sc(_p)		__atomic_load_n((_p), __ATOMIC_SEQ_CST)
+#define cat_st_sc(_p, _v)	__atomic_store_n((_p), (_v), __ATOMIC_SEQ_CST)
+#define cat_ld_rlx(_p)		__atomic_load_n((_p), __ATOMIC_RELAXED)
+#define cat_add_rlx(_p, _v)	__atomic_add_fetch((_p), (_v), __ATOMIC_RELAXED)
+
+typedef int cat_lock_t;
+
+#define cat_lock_init(_l)	(*(_l) = 0)
+#define cat_lock(_l)							\
+	do {								\
+		while ( __atomic_exchange_n((_l), 1, __ATOMIC_ACQUIRE) )\
+			while ( cat_ld_rlx(_l) )			\
+				;					\
+	} while (0)
+#define cat_trylock(_l)							\
+	(cat_ld_rlx(_l) == 0 &&						\
+	 __atomic_exchange_n((_l), 1, __ATOMIC_ACQUIRE) == 0)
+#define cat_unlock(_l)		cat_st_rel((_l), 0)
+
+#else /* CAT_HAS_ATOMICS */
+
+#define cat_ld_acq(_p)		(*(_p))
+#define cat_st_rel(_p, _v)	(*(_p) = (_v))
+#define cat_ld_sc(_p)		(*(_p))
+#define cat_st_sc(_p, _v)	(*(_p) = (_v))
+#define cat_ld_rlx(_p)		(*(_p))
+#define cat_add_rlx(_p, _v)	(*(_p) += (_v))
+
+typedef int cat_lock_t;
+
+#define cat_lock_init(_l)	(*(_l) = 0)
+#define cat_lock(_l)		(*(_l) = 1)
+#define cat_trylock(_l)		(*(_l) == 0 ? (*(_l) = 1) : 0)
+#define cat_unlock(_l)		(*(_l) = 0)
+
+#endif /* CAT_HAS_ATOMICS */
+
+#endif /* __cat_atomic_h */
@@ -228,6 +228,15 @@ typedef CAT_ALIGN	cat_align_t;
 	((type *)((char*)(ptr)-offsetof(type,field)))
 #define array_length(arr) (sizeof(arr) / sizeof(arr[0]))
 
+/* Hint that the memory at 'p' will be read soon */
+#ifndef CAT_PREFETCH
+#if defined(__GNUC__) && !CAT_ANSI89
+#define CAT_PREFETCH(p)	__builtin_prefetch(p)
+#else /* __GNUC__ && !CAT_ANSI89 */
+#define CAT_PREFETCH(p)	((void)(p))
+#endif /* __GNUC__ && !CAT_ANSI89 */
+#endif /* CAT_PREFETCH */
+
 #define ptr2int(p)	((intptr_t)(void *)(p))
 #define ptr2uint(p)	((uintptr_t)(void *)(p))
 #define int2ptr(i)	((void *)(uintptr_t)(i))
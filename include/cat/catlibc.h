@@ -28,6 +28,23 @@ struct catlibc_cfg {
 void catlibc_reset(struct catlibc_cfg *cprm);
 
 
+/*
+ * Word-at-a-time versions of the core memory and string functions.
+ * catlibc's memcpy(), memset() and so on use these when the library is
+ * built without the standard C library.  They are in every build so that
+ * they can be compared against the platform libc.  With GCC-compatible
+ * compilers, large blocks use CAT_LIBC_VEC byte vectors.  The default is
+ * 32 with __AVX2__, 16 with __SSE2__ and 0 (off) otherwise, and any of
+ * these can be forced with -DCAT_LIBC_VEC=n.
+ */
+void *	cat_memcpy(void *dst, const void *src, size_t len);
+void *	cat_memmove(void *dst, const void *src, size_t len);
+void *	cat_memset(void *dst, int c, size_t len);
+int	cat_memcmp(const void *b1, const void *b2, size_t len);
+size_t	cat_strlen(const char *s);
+char *	cat_strchr(const char *s, int ch);
+
+
 
 
 #endif /* __cat_catlibc_h */
@@ -0,0 +1,136 @@
+/*
+ * cat/cmap.h -- Concurrent hash table with lock-free readers
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2003-2017 -- See accompanying license
+ *
+ */
+
+#ifndef __cat_cmap_h
+#define __cat_cmap_h
+
+#include <cat/cat.h>
+#include <cat/aux.h>
+#include <cat/hash.h>
+#include <cat/atomic.h>
+
+/*
+ * A chained hash table with intrusive nodes that many threads can use at
+ * once.  Lookups take no locks and never retry:  they only have to run
+ * between cm_rd_enter() and cm_rd_leave() for a registered reader.
+ * Inserts and removals lock only the stripe of buckets that they touch.
+ * Removed nodes are not released until every reader that might still see
+ * them has left its read section (epoch based reclamation).  The map
+ * calls the 'release' function from cm_init() when a node is safe to
+ * free or reuse.
+ *
+ * Without CAT_HAS_ATOMICS the map still works, but is only safe to use
+ * from one thread.
+ */
+
+struct cmnode {
+	struct cmnode *	next;    /* next entry in the bucket */
+	struct cmnode *	rnext;   /* next entry on the retired list */
+	void *		key;     /* pointer to the key of the node */
+	uint		hash;    /* hash of the key */
+	ulong		epoch;   /* epoch the node was retired in */
+};
+
+
+struct cmreader {
+	struct cmreader *next;   /* next registered reader */
+	ulong		state;   /* 0 if idle, else (epoch << 1) | 1 */
+};
+
+
+typedef void (*cm_release_f)(struct cmnode *node, void *ctx);
+
+struct cmap {
+	struct cmnode **bkts;    /* array of node buckets */
+	uint		bmask;   /* number of buckets - 1 */
+	int *		locks;   /* array of stripe locks */
+	uint		lmask;   /* number of stripe locks - 1 */
+	cmp_f		cmp;     /* key comparison function */
+	hash_f		hash;    /* hash function */
+	void *		hctx;    /* context for the hash function */
+	cm_release_f	release; /* releases retired nodes */
+	void *		rctx;    /* context for the release function */
+	ulong		epoch;   /* global epoch */
+	int		glock;   /* protects the reader list and retired list */
+	struct cmreader *readers;/* registered readers */
+	struct cmnode *	retired; /* removed nodes waiting for release */
+	uint		nretired;/* length of the retired list */
+};
+
+/* try to reclaim retired nodes after this many removals */
+#define CM_RECLAIM_BATCH	64
+
+
+/*
+ * Initialize 'm' with 'bkts' pointing to an array of 'nbkts' buckets and
+ * 'locks' pointing to an array of 'nlocks' stripe locks.  Both counts
+ * must be powers of 2 and 'nlocks' can be at most 'nbkts'.  'cmp', 'hashf'
+ * and 'hctx' are as in ht_init().  'release' gets called with 'rctx' on
+ * every removed node once no reader can reach it.  It may be NULL.
+ */
+void cm_init(struct cmap *m, struct cmnode **bkts, uint nbkts, int *locks,
+	     uint nlocks, cmp_f cmp, hash_f hashf, void *hctx,
+	     cm_release_f release, void *rctx);
+
+/*
+ * Release all nodes still in 'm' and all retired nodes.  There must not
+ * be any other threads using the map.
+ */
+void cm_fini(struct cmap *m);
+
+/* Initialize a map node 'node' with 'key' as its key */
+void cm_ninit(struct cmnode *node, void *key);
+
+/* Return the hash value for 'key' using the hash function and context in 'm' */
+uint cm_hash(struct cmap *m, const void *key);
+
+/* Register or unregister reader 'r' with 'm':  one reader per thread */
+void cm_rd_reg(struct cmap *m, struct cmreader *r);
+void cm_rd_unreg(struct cmap *m, struct cmreader *r);
+
+/*
+ * Bracket lookups and any use of the nodes they return.  Keep read
+ * sections short:  a thread stuck in one keeps any removed node from
+ * being released.  Read sections do not nest.
+ */
+void cm_rd_enter(struct cmap *m, struct cmreader *r);
+void cm_rd_leave(struct cmap *m, struct cmreader *r);
+
+/*
+ * Find the node in the map 'm' with key 'key' or return NULL.  If 'hash'
+ * is non-NULL store the hash of 'key' in it for cm_ins().  Must be called
+ * in a read section.
+ */
+struct cmnode *cm_lkup(struct cmap *m, const void *key, uint *hash);
+
+/*
+ * Insert 'node' into 'm' with hash 'hash' unless some node with the same
+ * key is already there.  Returns NULL on success or the existing node.
+ * The existing node is only safe to use in a read section.
+ */
+struct cmnode *cm_ins(struct cmap *m, struct cmnode *node, uint hash);
+
+/*
+ * Remove 'node' from 'm' and retire it.  Returns 0 on success or -1 if
+ * the node was not in the map (e.g. another thread removed it first).
+ * The node gets released later from whatever thread calls cm_rem() or
+ * cm_reclaim().
+ */
+int cm_rem(struct cmap *m, struct cmnode *node);
+
+/*
+ * Find and remove the node with key 'key' from 'm' and return it or NULL.
+ * Like cm_ins(), the returned node is only safe to use in a read section.
+ */
+struct cmnode *cm_rem_key(struct cmap *m, const void *key);
+
+/* Try to advance the epoch and release retired nodes */
+void cm_reclaim(struct cmap *m);
+
+#endif /* __cat_cmap_h */
@@ -3,35 +3,142 @@
 
 #include <cat/peg.h>
 
+/* 'i' is the offset from the start of input, not an index into 'buf' */
 struct cpg_cursor {
-	uint i;
+	ulong i;
 	uint line;
 };
 
 
+/*
+ * Packrat memoization:  the result of a rule at a position along with the
+ * actions that fired while matching it.  A hit replays the actions in
+ * order so callbacks see exactly what they would without the memo.
+ */
+struct cpg_memo_ent {
+	int def;			/* definition node or -1 if unused */
+	ulong pos;
+	uint gen;			/* memo generation it was made in */
+	int rv;
+	struct cpg_cursor end;
+	ulong act;			/* first record in the action log */
+	uint nact;
+};
+
+
+/*
+ * An action that fired on 'len' bytes at input offset 'off' or, if 'pri'
+ * is negative, a memo hit that replayed the 'len' records at log position
+ * 'off'.
+ */
+struct cpg_act_rec {
+	int pri;
+	ulong off;
+	uint len;
+};
+
+
 struct cpg_state {
 	int debug;
 	int depth;
 	void *in;
 	struct cpg_cursor cur;
-	uchar *buf;
+	uchar *buf;			/* input from offset 'base' onward */
 	uint buflen;
-	uint readidx;
-	uint eof;
+	ulong base;
+	ulong readidx;
+	ulong eof;
+	ulong cut;			/* no backtracking before this */
+	ulong pin;			/* start of outermost open action */
 	int (*getc)(void *in);
+	int (*read)(void *in, void *buf, uint len);
 	struct peg_grammar *peg;
+
+	struct cpg_memo_ent *memo;
+	uint memo_mask;
+	uchar *memo_rules;
+	struct cpg_act_rec *acts;	/* action log from 'act_base' on */
+	ulong act_base;
+	ulong nacts;			/* log position of next record */
+	uint acts_len;
+	uint max_acts;
+	ulong *memo_open;		/* log positions of open rules */
+	uint memo_nopen;
+	uint memo_open_len;
+	uint memo_gen;
+	ulong memo_hits;
+	ulong memo_misses;
 };
 
 
 int cpg_init(struct cpg_state *state, struct peg_grammar *peg,
 	     int (*getc)(void *in));
 
+/*
+ * Like cpg_init() but reads input in blocks.  'read' stores up to 'len'
+ * bytes in 'buf' and returns how many it stored, 0 at the end of input
+ * or < 0 on error.
+ */
+int cpg_init_read(struct cpg_state *state, struct peg_grammar *peg,
+		  int (*read)(void *in, void *buf, uint len));
+
 void cpg_set_debug_level(struct cpg_state *state, int level);
 
+/*
+ * Return the next input character and advance the cursor, reading more
+ * input as needed.  Returns EOF at the end of input or < -1 on error.
+ * For parsers that pegcc generates.
+ */
+int cpg_getc(struct cpg_state *state);
+
 int cpg_parse(struct cpg_state *state, void *in, void *aux);
 
+/*
+ * Parse 'len' bytes at 'data' in place instead of reading input.  This
+ * resets 'state' first.  Actions get text that points into 'data'.
+ * Afterward the cursor shows how far the parse got and a later
+ * cpg_parse() without a reset reads on from there as if after a cut.
+ */
+int cpg_parse_mem(struct cpg_state *state, const void *data, size_t len,
+		  void *aux);
+
+#if CAT_HAS_POSIX
+/* Parse a whole file by mapping it into memory.  -1 if it can't be mapped */
+int cpg_parse_file(struct cpg_state *state, const char *path, void *aux);
+#endif /* CAT_HAS_POSIX */
+
 void cpg_reset(struct cpg_state *state);
 
+/*
+ * Commit the parse to everything matched up to the cursor.  This is what
+ * the '^' operator in a grammar does.  After a cut the parser may discard
+ * input before it so a grammar that cuts after every record parses a
+ * stream of any length in a buffer the size of the largest record.  Any
+ * later attempt to backtrack to before the cut (e.g. when the sequence
+ * holding the '^' fails) makes the parse fail with an error instead.
+ * Input under an action that is still matching is kept until the action
+ * runs.
+ */
+void cpg_cut(struct cpg_state *state);
+
+/*
+ * Enable packrat memoization of every rule within about 'budget' bytes.
+ * Half of the budget is a direct mapped table of (rule, position)
+ * results that newer results overwrite.  The rest holds the log of
+ * actions to replay on a hit.  When the log fills, records that no entry
+ * can replay any more are reclaimed and if that isn't enough the memo
+ * starts over empty.  A 'budget' of 0 turns memoization off.  Returns 0
+ * on success or -1 if out of memory.
+ */
+int cpg_memo_init(struct cpg_state *state, size_t budget);
+
+/*
+ * Turn memoization of the rule named 'rule' on or off.  Rules that are
+ * only ever tried once at a position are cheaper unmemoized.  Returns the
+ * number of rules changed (0 or 1).
+ */
+int cpg_memo_rule(struct cpg_state *state, const char *rule, int enable);
+
 void cpg_fini(struct cpg_state *state);
 
 #endif /* __cpg_h */
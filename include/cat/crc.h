@@ -12,10 +12,23 @@
 
 #include <cat/cat.h>
 
+/*
+ * resid[0] is the classic byte-at-a-time table.  resid[1..7] extend it
+ * to process 8 bytes per step ("slice-by-8").  'hwaccel' holds the
+ * CRC32T_HW_* paths that crc32t_le() may take on this CPU:  the init
+ * functions set it and callers may clear bits to force the portable
+ * code.  'fold' holds the PCLMULQDQ folding constants.
+ */
 struct crc32tab {
-	ulong resid[256];
+	uint32_t	resid[8][256];
+	ulong		poly;
+	int		hwaccel;
+	ulong		fold[4];
 };
 
+#define CRC32T_HW_CRC32C	0x1	/* SSE4.2 crc32 instruction */
+#define CRC32T_HW_CLMUL		0x2	/* PCLMULQDQ folding */
+
 
 #define CAT_CRC32_POLY		0x04C11DB7
 #define CAT_CRC32_POLY_REV	0xEDB88320
@@ -66,6 +79,19 @@ void crc32t_le_init(struct crc32tab *t, ulong poly);
 ulong crc32t_le(const struct crc32tab *t, const void *p, size_t size,
 	        ulong crc);
 
+/*
+ * Given 'crc1', the residue after processing a first block of bytes, and
+ * 'crc2', the residue of a following block of 'len2' bytes computed with
+ * an initial residue of 0, return the residue of both blocks together.
+ * This lets separate threads checksum chunks of a buffer in parallel.
+ */
+ulong crc32t_be_combine(const struct crc32tab *t, ulong crc1, ulong crc2,
+			size_t len2);
+
+/* Same as crc32t_be_combine() but for residues from crc32t_le() */
+ulong crc32t_le_combine(const struct crc32tab *t, ulong crc1, ulong crc2,
+			size_t len2);
+
 /*
  * Initialize global state for standard CRC-32 checksum calculations.
  * Used for for embedded environments where C global data structure
@@ -99,6 +125,13 @@ ulong crc32_step(const void *p, size_t size, ulong crc);
  */
 ulong crc32_finish(ulong crc);
 
+/*
+ * Given the standard CRC-32 checksums 'crc1' of a block of bytes and
+ * 'crc2' of a following block of 'len2' bytes, return the standard CRC-32
+ * checksum of the two blocks concatenated.
+ */
+ulong crc32_combine(ulong crc1, ulong crc2, size_t len2);
+
 /* Convenience wrapper for a one-shot standard CRC-32 checksum calculation */
 #define crc32(p, size) \
 	crc32_finish(crc32_step((p), (size), crc32_start()))
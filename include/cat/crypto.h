@@ -28,8 +28,8 @@ void arc4_encrypt(struct arc4ctx *arc4, const void *in, void *out, ulong len);
 struct sha256ctx {
 	ulong		llo;		/* length_lo: in bytes until fini */
 	ulong		lhi;		/* length_hi: in bytes until fini */
-	ulong		w[64];		/* 512-bits message + derived */
-	ulong		h[8];		/* current hash */
+	byte_t		block[64];	/* partial message block */
+	uint32_t	h[8];		/* current hash */
 };
 
 
@@ -39,6 +39,24 @@ void sha256_add(struct sha256ctx *s, void *p, ulong len);
 void sha256_fini(struct sha256ctx *s, byte_t hash[32]);
 void sha256(void *in, ulong len, byte_t hash[32]);
 
+/*
+ * Hash 'n' independent messages:  in[i] of len[i] bytes hashes to
+ * hash[i].  Without the SHA extensions but with AVX2 this runs 8
+ * messages at a time in parallel lanes, which works best when the
+ * messages are of similar length.  Otherwise it hashes them in turn.
+ */
+void sha256_multi(const void *in[], const ulong len[], byte_t hash[][32],
+		  uint n);
+
+/*
+ * Accelerated paths the SHA-256 functions may use.  This starts at -1
+ * and gets set from cpuid on first use.  Clear bits to force the portable
+ * code.
+ */
+#define SHA256_HW_SHANI		0x1	/* SHA extensions */
+#define SHA256_HW_AVX2		0x2	/* 8-lane sha256_multi() */
+extern int sha256_hwaccel;
+
 
 /* SipHash hash function */
 
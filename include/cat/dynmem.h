@@ -10,6 +10,8 @@
 #define __cat_dynmem_h
 #include <cat/cat.h>
 #include <cat/list.h>
+#include <cat/mem.h>
+#include <cat/atomic.h>
 
 /* core alignment type */
 union align_u {
@@ -164,4 +166,49 @@ void *tlsf_realloc(struct tlsf *tlsf, void *omem, size_t newamt);
 void tlsf_each_pool(struct tlsf *tlsf, apply_f f, void *ctx);
 void tlsf_each_block(struct tlsfpool *pool, apply_f f, void *ctx);
 
+/* Return the number of usable bytes in the block 'mem' that tlsf allocated */
+size_t tlsf_blklen(void *mem);
+
+
+/*
+ * Thread caching front end for a TLSF heap.  A 'struct tlsfmt' wraps a
+ * TLSF heap with a lock so that many threads can share it.  Each thread
+ * allocates through its own 'struct tlsfcache' which keeps a magazine
+ * (a free list) of blocks for each small size class.  Small requests
+ * only take the heap lock when a magazine runs dry or overflows and then
+ * move TLSFC_BATCH blocks at once.  Larger requests go straight to the
+ * locked heap.  Any thread may free a block that any other thread's
+ * cache allocated.  The cache must not be shared between threads and
+ * should be flushed with tlsfc_flush() before it goes away.
+ */
+
+#define TLSFC_QUANTUM	(UNITSIZE * 2)	/* spacing between size classes */
+#define TLSFC_NCLASS	32		/* number of small size classes */
+#define TLSFC_MAXSMALL	(TLSFC_QUANTUM * TLSFC_NCLASS)
+#define TLSFC_MAGSIZE	64		/* most blocks cached per class */
+#define TLSFC_BATCH	32		/* blocks moved per refill or flush */
+
+struct tlsfmt {
+	struct tlsf		tm_tlsf;
+	cat_lock_t		tm_lock;
+};
+
+struct tlsfcache {
+	struct memmgr		tc_mm;
+	struct tlsfmt *		tc_heap;
+	void *			tc_mags[TLSFC_NCLASS];
+	uint			tc_nmag[TLSFC_NCLASS];
+};
+
+void tlsfmt_init(struct tlsfmt *tm);
+void tlsfmt_add_pool(struct tlsfmt *tm, void *mem, size_t len);
+
+/* tc->tc_mm is a memory manager that allocates through the cache */
+void tlsfc_init(struct tlsfcache *tc, struct tlsfmt *tm);
+void *tlsfc_malloc(struct tlsfcache *tc, size_t amt);
+void tlsfc_free(struct tlsfcache *tc, void *mem);
+void *tlsfc_realloc(struct tlsfcache *tc, void *omem, size_t newamt);
+/* return all cached blocks to the shared heap */
+void tlsfc_flush(struct tlsfcache *tc);
+
 #endif /* __cat_dynmem_h */
@@ -0,0 +1,70 @@
+/*
+ * cat/fhash.h -- Fast non-cryptographic hash functions
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2003-2017 -- See accompanying license
+ *
+ */
+
+#ifndef __cat_fhash_h
+#define __cat_fhash_h
+
+#include <cat/cat.h>
+
+#if CAT_64BIT
+
+/*
+ * wyhash (final version 4) of 'len' bytes at 'p' with 'seed'.  Very fast
+ * for both short and long keys with good distribution, but not meant to
+ * resist hash flooding by someone who can choose the keys.  Multi-byte
+ * loads are native-endian, so values differ across byte orders.
+ */
+uint64_t wyhash(const void *p, size_t len, uint64_t seed);
+
+/* Mix a 64-bit integer with 'seed' the way wyhash mixes its blocks */
+uint64_t wyhash64(uint64_t x, uint64_t seed);
+
+/*
+ * SipHash-1-3 of 'len' bytes at 'p' with the 128-bit 'key'.  Has the
+ * same structure as SipHash-2-4 (see crypto.h) with fewer rounds:  still
+ * keyed and hard to flood, but about twice as fast.  Returns the 64-bit
+ * hash as a native integer.  The byte order of that integer stored
+ * little-endian is the standard SipHash output.
+ */
+uint64_t siphash13(const byte_t key[16], const void *p, size_t len);
+
+
+/*
+ * Ready-made hash_f functions for hash tables.  'ctx' points to a
+ * struct fhash_key or is NULL to use an all-zero key.  Each returns the
+ * low and high halves of the 64-bit hash XORed together.
+ */
+struct fhash_key {
+	uint64_t	seed;		/* wyhash seed */
+	byte_t		sipkey[16];	/* SipHash-1-3 key */
+};
+
+/* Fold 'len' bytes of 'seed' into the seed and SipHash key of 'k' */
+void fhash_key_init(struct fhash_key *k, const void *seed, size_t len);
+
+/* wyhash of a NULL terminated string */
+uint ht_wy_shash(const void *str, void *k);
+
+/* wyhash of the data of a 'struct raw';  ie. key points to a struct raw */
+uint ht_wy_rhash(const void *raw, void *k);
+
+/* wyhash64() of the uint32_t or uint64_t that 'key' points to */
+uint ht_wy_u32hash(const void *key, void *k);
+uint ht_wy_u64hash(const void *key, void *k);
+
+/* wyhash64() of the value of 'key' treated as an integer like ht_ihash() */
+uint ht_wy_ihash(const void *key, void *k);
+
+/* SipHash-1-3 of a NULL terminated string or of a struct raw's data */
+uint ht_sh13_shash(const void *str, void *k);
+uint ht_sh13_rhash(const void *raw, void *k);
+
+#endif /* CAT_64BIT */
+
+#endif /* __cat_fhash_h */
@@ -12,6 +12,7 @@
 
 #include <cat/cat.h>
 #include <cat/aux.h>
+#include <cat/mem.h>
 
 /* pointer to a hash function: takes a 'key' and context */
 typedef uint (*hash_f)(const void *key, void *ctx);
@@ -68,6 +69,19 @@ DECL uint ht_hash(struct htab *t, const void *key);
  */
 DECL struct hnode * ht_lkup(struct htab *t, const void *key, uint *hash);
 
+/*
+ * Look up 'nkeys' keys from 'keys' at once storing the matching node or
+ * NULL in the corresponding entry of 'out'.  If 'hashes' is non-NULL,
+ * store the hash of each key there as ht_lkup() does.  Returns the number
+ * of keys found.  This hashes a batch of keys first and prefetches their
+ * buckets and then the first node in each chain before walking the chains.
+ * So the cache misses for the batch overlap rather than coming one after
+ * another.  Batches of HT_BURST_MAX keys or fewer work best.
+ */
+#define HT_BURST_MAX	64
+DECL uint ht_lkup_burst(struct htab *t, const void **keys, uint nkeys,
+			struct hnode **out, uint *hashes);
+
 /* 
  * Insert 'node' into 't' with hash 'hash'.  Assumes 'hash' was calculated
  * by ht_hash() or returned through the third parameter of ht_lkup();
@@ -100,6 +114,55 @@ PTRDECL uint ht_rhash(const void *key, void *unused);
 PTRDECL uint ht_ihash(const void *key, void *unused);
 
 
+/*
+ * A hash table that resizes itself.  When the load gets too high or too
+ * low, it allocates a new bucket array and moves RHT_STEP buckets from
+ * the old array to the new one on every subsequent operation.  Lookups
+ * check both arrays while the move is in progress.  So there is never a
+ * pause to rehash the whole table.  The bucket count is always a power of
+ * 2.  Nodes are regular hash nodes, but they must be removed with
+ * rht_rem() rather than ht_rem() so the table can track its fill.
+ */
+#define RHT_STEP	4
+#define RHT_MAXLOAD	2	/* grow when fill > RHT_MAXLOAD * nbkts */
+#define RHT_MINLOAD	8	/* shrink when fill * RHT_MINLOAD < nbkts */
+
+struct rhtab {
+	struct htab	tab;     /* table for new entries */
+	struct htab	old;     /* table being moved from: bkts == NULL if none */
+	uint		mvidx;   /* next bucket in 'old' to move */
+	uint		minbkts; /* never shrink below this */
+	ulong		fill;    /* number of nodes in the table */
+	struct memmgr *	mm;      /* allocates the bucket arrays */
+};
+
+/*
+ * Initialize 't' with an initial bucket count of 'nbkts' (rounded up to
+ * a power of 2), allocating bucket arrays from 'mm'.  Returns 0 on
+ * success or -1 if it can't allocate the initial bucket array.
+ */
+int  rht_init(struct rhtab *t, struct memmgr *mm, uint nbkts, cmp_f cmpf,
+	      hash_f hashf, void *hctx);
+
+/* Release the bucket arrays of 't'.  Does not touch the nodes. */
+void rht_fini(struct rhtab *t);
+
+/* As ht_lkup() */
+struct hnode *rht_lkup(struct rhtab *t, const void *key, uint *hash);
+
+/* As ht_ins():  if growing the table fails it keeps the current size */
+void rht_ins(struct rhtab *t, struct hnode *node, uint hash);
+
+/* Remove 'node' from 't' */
+void rht_rem(struct rhtab *t, struct hnode *node);
+
+/* Apply 'func' to every node in 't':  'func' may ht_rem() (not rht_rem()) */
+void rht_apply(struct rhtab *t, apply_f func, void *ctx);
+
+#define rht_fill(t)	((t)->fill)
+#define rht_inmove(t)	((t)->old.bkts != NULL)
+
+
 /* ----- Implementation ----- */
 #if defined(CAT_HASH_DO_DECL) && CAT_HASH_DO_DECL
 
@@ -202,6 +265,62 @@ DECL struct hnode * ht_lkup(struct htab *t, const void *key, uint *hp)
 }
 
 
+DECL uint ht_lkup_burst(struct htab *t, const void **keys, uint nkeys,
+			struct hnode **out, uint *hashes)
+{
+	struct hnode **bkts[HT_BURST_MAX];
+	struct hnode *node;
+	uint h[HT_BURST_MAX];
+	uint i, n, base, nfound = 0;
+
+	abort_unless(t != NULL);
+	abort_unless(keys != NULL || nkeys == 0);
+	abort_unless(out != NULL || nkeys == 0);
+
+	for ( base = 0 ; base < nkeys ; base += n ) {
+		n = nkeys - base;
+		if ( n > HT_BURST_MAX )
+			n = HT_BURST_MAX;
+
+		for ( i = 0 ; i < n ; ++i ) {
+			abort_unless(keys[base + i] != NULL);
+			h[i] = (*t->hash)(keys[base + i], t->hctx);
+			if ( t->po2mask ) {
+				bkts[i] = t->bkts + (h[i] & t->po2mask);
+			} else {
+#if CAT_HAS_DIV
+				bkts[i] = t->bkts + (h[i] % t->nbkts);
+#else /* CAT_HAS_DIV */
+				bkts[i] = t->bkts + _modulo(h[i], t->nbkts);
+#endif /* CAT_HAS_DIV */
+			}
+			CAT_PREFETCH(bkts[i]);
+		}
+
+		for ( i = 0 ; i < n ; ++i ) {
+			out[base + i] = *bkts[i];
+			if ( out[base + i] != NULL )
+				CAT_PREFETCH(out[base + i]);
+		}
+
+		for ( i = 0 ; i < n ; ++i ) {
+			node = out[base + i];
+			while ( node != NULL ) {
+				if ( !(*t->cmp)(node->key, keys[base + i]) )
+					break;
+				node = node->next;
+			}
+			out[base + i] = node;
+			nfound += (node != NULL);
+			if ( hashes != NULL )
+				hashes[base + i] = h[i];
+		}
+	}
+
+	return nfound;
+}
+
+
 DECL void ht_ins(struct htab *t, struct hnode *node, uint hash)
 {
 	struct hnode **trav;
@@ -19,11 +19,20 @@ struct lexer_entry {
 };
 
 
+/*
+ * All the entries' patterns get combined into 'rset' so that each token
+ * is found in a single pass over the input.  If that is not possible
+ * (see rex_set_add()) 'use_rset' is 0 and the lexer tries each entry's
+ * pattern in turn.  Either way the longest match wins and among matches
+ * of the same length the entry added first wins.
+ */
 struct lexer { 
 	struct list		entries;
 	struct raw		input;
 	const char *		next_char;
 	struct memmgr *		mm;
+	struct rex_set		rset;
+	int			use_rset;
 };
 
 
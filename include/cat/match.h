@@ -44,6 +44,27 @@ void bm_pinit_lite(struct bmpat *bmp, struct raw *pat);
 int bm_match(struct raw *str, struct bmpat *pat, ulong *loc);
 
 
+/* Vectorized substring search */
+
+/*
+ * Find the first occurrence of 'pat' in 'str' with no pattern setup.
+ * Returns 1 and sets '*loc' (if not NULL) to the offset of the match or
+ * returns 0 if 'pat' does not occur.  An empty pattern matches at 0.
+ * Where SIMD is available, this compares the first and last bytes of
+ * 'pat' against 16 or 32 positions of 'str' at a time and only checks
+ * the rest of the pattern at positions where both match.
+ */
+int mem_match(const struct raw *str, const struct raw *pat, size_t *loc);
+
+/*
+ * Vector instructions mem_match() may use.  This starts at -1 and gets
+ * set from cpuid on first use.  Clear bits to force the portable code.
+ */
+#define MEM_MATCH_HW_SSE2	0x1
+#define MEM_MATCH_HW_AVX2	0x2
+extern int mem_match_hwaccel;
+
+
 /* Suffix Tree string matching */
 
 #ifndef CAT_SFX_MAXLEN
@@ -89,6 +110,141 @@ void sfx_clear(struct sfxtree *sfx);
 struct sfxnode *sfx_next(struct sfxtree *t, struct sfxnode *cur, int ch);
 
 
+/* Suffix Array string matching */
+
+/*
+ * The start of every suffix of 'str' in lexicographic order:  4 bytes per
+ * character or 8 with the LCP array.  A shorter suffix sorts before any
+ * longer one that it is a prefix of.  'str' must outlive the array.
+ */
+struct sfxarr {
+	struct memmgr *		mm;
+	struct raw		str;
+	uint32_t *		sa;
+	uint32_t *		lcp;	/* NULL until sfa_lcp() */
+};
+
+#define SFA_MAXLEN		((uint32_t)0xFFFFFFFE)
+
+/*
+ * Build the suffix array of 'str' in linear time with SA-IS.  This needs
+ * about 6 bytes per character while building.  Returns 0 on success or -1
+ * if 'str' is longer than SFA_MAXLEN, too long for its suffix array to
+ * fit in a size_t or out of memory.
+ */
+int  sfa_init(struct sfxarr *sfa, struct raw *str, struct memmgr *mm);
+
+/*
+ * Build the LCP array in linear time (Kasai et al):  lcp[i] is the length
+ * of the longest common prefix of the suffixes at sa[i - 1] and sa[i] and
+ * lcp[0] is 0.  Needs 4 more bytes per character while it runs.  Returns
+ * 0 on success or -1 if out of memory.
+ */
+int  sfa_lcp(struct sfxarr *sfa);
+
+/*
+ * Binary search for the suffixes that start with 'pat'.  Returns how many
+ * there are and sets '*first' (if not NULL) to the index in 'sa' of the
+ * first of them.  They are consecutive in 'sa'.
+ */
+ulong sfa_range(struct sfxarr *sfa, struct raw *pat, ulong *first);
+
+/* Returns 1 and sets '*loc' (if not NULL) to some occurrence of 'pat' or 0 */
+int  sfa_match(struct sfxarr *sfa, struct raw *pat, ulong *loc);
+
+void sfa_clear(struct sfxarr *sfa);
+
+#if CAT_HAS_POSIX
+/*
+ * Write the suffix array and LCP array (if built) to 'fd' as a short
+ * header followed by the arrays in host byte order.  The string is not
+ * saved.  Returns 0 on success or -1 on a write error.
+ */
+int  sfa_save(struct sfxarr *sfa, int fd);
+
+/*
+ * Read an array that sfa_save() wrote for 'str' from 'fd'.  Returns 0 on
+ * success or -1 on a read error, if out of memory or if the file is not a
+ * suffix array for a string of the length of 'str' from a machine with the
+ * same byte order.
+ */
+int  sfa_load(struct sfxarr *sfa, struct raw *str, int fd, struct memmgr *mm);
+#endif /* CAT_HAS_POSIX */
+
+
+/* Aho-Corasick multiple string matching */
+
+/*
+ * The goto edges of each state are compressed into a 256 bit bitmap:
+ * the children of a state are numbered consecutively in byte order so
+ * the child for byte 'c' is 'child' plus the number of edges below 'c'.
+ */
+struct acstate {
+	uint32_t		edges[8];	/* bytes that have goto edges */
+	uchar			rank[8];	/* # of edges in edges[0..i-1] */
+	uint			child;		/* state for the lowest edge */
+	uint			fail;		/* longest proper suffix state */
+	uint			dict;		/* nearest suffix state w/ pat */
+	uint			pat;		/* pattern ending here or AC_NONE */
+};
+
+#define AC_NONE			((uint)~0)
+
+struct acbnode;
+
+struct acpat {
+	struct memmgr *		mm;
+	struct acstate *	states;
+	uint			nstates;
+	uint *			plen;		/* length of each pattern */
+	uint *			pnext;		/* next pattern w/ same state */
+	uint			npat;
+	uint			palloc;
+	struct acbnode *	trie;
+	uint			ntrie;
+	uint			talloc;
+};
+
+/* scan position:  lets matches span the buffers passed to ac_scan() */
+struct acscan {
+	uint			state;
+	ulong			off;
+};
+
+/*
+ * Called for each match with the pattern number (in order of ac_add()
+ * calls starting at 0) and the offset of the start of the match from the
+ * start of the stream.  Returning non-zero stops the scan.
+ */
+typedef int (*ac_report_f)(uint pat, ulong off, void *ctx);
+
+void ac_init(struct acpat *ac, struct memmgr *mm);
+
+/* Add a non-empty pattern.  Returns the pattern number or -1 on error. */
+int  ac_add(struct acpat *ac, const struct raw *pat);
+
+/* Build the automaton after adding patterns.  Returns 0 or -1 on error. */
+int  ac_compile(struct acpat *ac);
+
+void ac_scan_init(struct acscan *scan);
+
+/*
+ * Feed 'buf' through the automaton from position 'scan' reporting every
+ * match (including overlapping ones) that ends in 'buf'.  Returns 0 at the
+ * end of 'buf' or the non-zero value that 'report' returned.  In the
+ * latter case 'scan' points just past the byte that ended the match and
+ * any further matches ending at that byte are skipped.
+ */
+int  ac_scan(struct acpat *ac, struct acscan *scan, const struct raw *buf,
+	     ac_report_f report, void *ctx);
+
+/* ac_scan() of a single buffer from the start */
+int  ac_match(struct acpat *ac, const struct raw *str, ac_report_f report,
+	      void *ctx);
+
+void ac_free(struct acpat *ac);
+
+
 /* Regular expression string matching */
 
 
@@ -131,11 +287,14 @@ struct rex_choice {
 	struct rex_node *	opt2;
 };
 
+struct rex_dfa;
+
 struct rex_pat {
 	struct memmgr *		mm;
 	int			start_anchor;
 	struct rex_group 	start;
 	struct rex_group 	end;
+	struct rex_dfa *	dfa;
 };
 
 struct rex_match_loc {
@@ -155,4 +314,51 @@ int rex_match(struct rex_pat *rxp, struct raw *str, struct rex_match_loc *m,
 	      uint nm);
 void rex_free(struct rex_pat *rxp);
 
+/*
+ * Compile an initialized pattern for linear time matching.  This builds a
+ * Thompson NFA of the reversed pattern and simulates it with a lazily
+ * built DFA:  each distinct set of NFA states becomes a DFA state the
+ * first time it is reached and its transitions get cached.  At most
+ * 'maxstates' DFA states (REX_DFA_DEFSTATES if 0) are kept at once;  the
+ * cache gets flushed and rebuilt when full.  Afterwards rex_match() scans
+ * the string once, backwards, to decide whether there is a match and
+ * where the leftmost one starts.  If 'nm' > 0 it then fills in 'm' by
+ * backtracking from that start only.  Returns 0 on success or -1 if the
+ * pattern expands to more than REX_NFA_MAX NFA states (e.g. large counted
+ * repetitions of groups) or memory runs out.  rex_match() keeps using
+ * the backtracking matcher in that case.
+ */
+#define REX_DFA_DEFSTATES	64
+#define REX_NFA_MAX		4096
+int rex_compile(struct rex_pat *rxp, uint maxstates);
+
+/*
+ * A set of patterns matched together against the start of a string in a
+ * single pass of one lazily built DFA (as with rex_compile()).  The
+ * longest match wins;  among matches of the same length the pattern
+ * added first wins.  The patterns must outlive the set.
+ */
+struct rex_set {
+	struct rex_dfa *	dfa;
+};
+
+/* Returns 0 on success and -1 if out of memory */
+int rex_set_init(struct rex_set *rs, struct memmgr *mm, uint maxstates);
+
+/*
+ * Add 'rxp' to the set to report 'id' (>= 0) when it matches.  Returns 0
+ * on success or -1 if the combined NFA would exceed REX_NFA_MAX states or
+ * memory runs out.  The set stays as it was in that case.
+ */
+int rex_set_add(struct rex_set *rs, struct rex_pat *rxp, int id);
+
+/*
+ * Find the longest match of any pattern at the start of 'str'.  Returns
+ * REX_MATCH and sets '*id' and '*len' to the winning pattern's id and the
+ * match length, REX_NOMATCH, or REX_ERROR if out of memory.
+ */
+int rex_set_match(struct rex_set *rs, struct raw *str, int *id, size_t *len);
+
+void rex_set_free(struct rex_set *rs);
+
 #endif /* __match_h */
@@ -95,6 +95,66 @@ size_t amm_get_fill(struct arraymm *amm);
 size_t amm_get_avail(struct arraymm *amm);
 
 
+/*
+ * A growable region allocator.  An arena carves allocations out of chunks
+ * that it gets from a parent memory manager.  Freeing an individual block
+ * only reclaims it if it was the most recent allocation.  Instead, callers
+ * take a mark before building up some temporary structure and release the
+ * mark to discard everything allocated since in one step.  Marks nest like
+ * a stack:  releasing a mark also releases every later mark.  Releasing
+ * and arena_fini() cost O(chunks) rather than O(allocations).
+ */
+#ifndef ARENA_DEF_CHUNK
+#define ARENA_DEF_CHUNK		8192
+#endif /* ARENA_DEF_CHUNK */
+
+union arena_chunk_u;
+
+struct arena {
+	struct memmgr		mm;
+	struct memmgr *		pmm;
+	union arena_chunk_u *	chunks;		/* newest chunk first */
+	union arena_chunk_u *	spare;		/* one released chunk to reuse */
+	byte_t *		next;		/* next free byte in chunks */
+	byte_t *		end;		/* end of the newest chunk */
+	byte_t *		last;		/* most recent allocation */
+	size_t			chunksz;
+};
+
+union arena_chunk_u {
+	struct {
+		union arena_chunk_u *	prev;
+		size_t			len;
+	} 			c;
+	cat_align_t		align;
+};
+
+struct arena_mark {
+	union arena_chunk_u *	chunk;
+	byte_t *		next;
+};
+
+
+/*
+ * Initialize 'a' to allocate chunks of 'chunksz' bytes (or ARENA_DEF_CHUNK
+ * bytes if 'chunksz' is 0) from 'pmm'.  Larger requests get a chunk of
+ * their own.  'a->mm' is a memory manager that allocates from the arena.
+ */
+void arena_init(struct arena *a, struct memmgr *pmm, size_t chunksz);
+
+/* Allocate 'len' bytes from 'a' or return NULL if 'pmm' is out of memory. */
+void *arena_alloc(struct arena *a, size_t len);
+
+/* Record the current allocation point of 'a' in 'm'. */
+void arena_mark(struct arena *a, struct arena_mark *m);
+
+/* Free everything allocated from 'a' since arena_mark() filled in 'm'. */
+void arena_release(struct arena *a, struct arena_mark *m);
+
+/* Free all memory that 'a' holds.  The arena remains usable. */
+void arena_fini(struct arena *a);
+
+
 /* Declaration of default memmgr. */
 extern struct memmgr stdmm;
 
@@ -0,0 +1,100 @@
+/*
+ * cat/oahash.h -- Open addressing hash table implementation
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2003-2017 -- See accompanying license
+ *
+ */
+
+#ifndef __cat_oahash_h
+#define __cat_oahash_h
+
+#include <cat/cat.h>
+#include <cat/aux.h>
+#include <cat/hash.h>
+
+/*
+ * The table is split into groups of OHT_GSIZE slots.  Each slot has a
+ * control byte in a separate dense array:  either OHT_EMPTY, OHT_DELETED
+ * or the low 7 bits of the hash of the key in the slot.  A lookup scans
+ * a whole group of control bytes at once (with SSE2 when available) and
+ * only touches the slots whose fingerprint matches.  The slot itself
+ * stores the full hash so that the key comparison function only runs on
+ * a true hash match.  Probing proceeds group by group and stops at the
+ * first group with an empty slot.
+ */
+#define OHT_GSIZE	16
+#define OHT_EMPTY	0x80
+#define OHT_DELETED	0xFE
+
+struct ohslot {
+	void *		key;     /* key for the slot */
+	void *		data;    /* data associated with the key */
+	uint		hash;    /* full hash value of the key */
+};
+
+
+struct ohtab {
+	byte_t *	ctrl;    /* control bytes:  one per slot */
+	struct ohslot *	slots;   /* array of slots */
+	uint		nslots;  /* number of slots (power of 2 >= OHT_GSIZE) */
+	uint		gmask;   /* number of groups - 1 */
+	uint		fill;    /* number of occupied slots */
+	uint		ntomb;   /* number of OHT_DELETED slots */
+	uint		maxfill; /* maximum of fill + ntomb */
+	cmp_f		cmp;     /* key comparison function */
+	hash_f		hash;    /* hash function */
+	void *		hctx;    /* context for the hash function */
+};
+
+
+/*
+ * Initialize table 't' with 'ctrl' pointing to an array of 'nslots' bytes
+ * and 'slots' pointing to an array of 'nslots' slots.  'nslots' must be
+ * a power of 2 and at least OHT_GSIZE.  'cmp', 'hashf' and 'hctx' are as
+ * for ht_init().
+ */
+void oht_init(struct ohtab *t, byte_t *ctrl, struct ohslot *slots,
+	      uint nslots, cmp_f cmp, hash_f hashf, void *hctx);
+
+/* Return the hash value for 'key' using the hash function and context in 't' */
+uint oht_hash(struct ohtab *t, const void *key);
+
+/*
+ * Find the slot in the table 't' with key 'key'.  If found return it,
+ * otherwise return NULL.  Either way, if 'hash' is non-NULL, store the hash
+ * of 'key' in it to allow for fast insertion with oht_ins().
+ */
+struct ohslot *oht_lkup(struct ohtab *t, const void *key, uint *hash);
+
+/*
+ * Insert 'key' and 'data' into 't' with hash 'hash' and return the slot
+ * that holds them.  Does not check for duplicates.  Returns NULL if the
+ * table is too full (see oht_isfull()) to accept a new key.  Slots move
+ * when the table gets rebuilt so do not hold on to slot pointers across
+ * an oht_move().
+ */
+struct ohslot *oht_ins(struct ohtab *t, void *key, void *data, uint hash);
+
+/* Remove the slot 's' from table 't' */
+void oht_rem(struct ohtab *t, struct ohslot *s);
+
+/* Apply 'func' to every occupied slot in 't' passing 'ctx' as state */
+void oht_apply(struct ohtab *t, apply_f func, void *ctx);
+
+/*
+ * Move every entry from 'src' to 'dst' without rehashing the keys.
+ * 'dst' must be able to hold all of the entries in 'src' and is usually
+ * a larger table.  'src' is empty afterwards.  This also gets rid of
+ * the tombstones left by oht_rem().
+ */
+void oht_move(struct ohtab *dst, struct ohtab *src);
+
+/* True if an insert could fail without reusing a deleted slot */
+#define oht_isfull(t)	((t)->fill + (t)->ntomb >= (t)->maxfill)
+
+/* The number of entries in 't' */
+#define oht_fill(t)	((t)->fill)
+
+#endif /* __cat_oahash_h */
@@ -60,4 +60,30 @@ typedef union {
 	cat_align_t	        align;
 } cat_pcpad_t;
 
+/*
+ * A slab allocator that fronts one pcache per size class.  The classes
+ * run from 16 to SLAB_MAXSIZE bytes in steps of 1x and 1.5x each power
+ * of 2.  Larger requests go straight to the backing memory manager.
+ * Each cache releases a page back to the backing manager once it becomes
+ * completely free and the cache holds more than 'hiwat' pages (never if
+ * 'hiwat' is 0).  'mm' in a struct slab is a memory manager for the slab.
+ */
+#define SLAB_NCLASS	16
+#define SLAB_MAXSIZE	4096
+
+struct slab {
+	struct memmgr		mm;
+	struct memmgr *		bmm;
+	struct list		large;
+	struct pcache		caches[SLAB_NCLASS];
+};
+
+/* 'pgsiz' of 0 selects PC_DEF_SIZE pages */
+void  slab_init(struct slab *s, size_t pgsiz, uint hiwat, struct memmgr *mm);
+void *slab_alloc(struct slab *s, size_t len);
+void *slab_resize(struct slab *s, void *mem, size_t len);
+void  slab_free(struct slab *s, void *mem);
+/* release every page and large block:  all allocations become invalid */
+void  slab_freeall(struct slab *s);
+
 #endif /* __pcache_h */
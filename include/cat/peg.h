@@ -102,7 +102,8 @@ enum {
 	PEG_PRIMARY,
 	PEG_IDENTIFIER,
 	PEG_LITERAL,
-	PEG_CLASS
+	PEG_CLASS,
+	PEG_CUT
 };
 
 enum {
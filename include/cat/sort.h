@@ -11,6 +11,7 @@
 #define __cat_sort_h
 
 #include <cat/cat.h>
+#include <cat/mem.h>
 
 void isort_array(void *arr, const size_t nelem, const size_t esize, cmp_f cmp);
 
@@ -20,6 +21,35 @@ void hsort_array(void *arr, const size_t nelem, const size_t esize, cmp_f cmp);
 
 void qsort_array(void *arr, const size_t nelem, const size_t esize, cmp_f cmp);
 
+/*
+ * Sort using up to 'nthreads' threads:  each thread sorts a slice of the
+ * array with qsort_array() and then the slices are merged in parallel.
+ * Falls back to qsort_array() in the calling thread for small arrays,
+ * if a temporary copy of the array can't be allocated or if the
+ * library was built without POSIX threads.  Link with -lpthread.
+ */
+void psort_array(void *arr, const size_t nelem, const size_t esize, cmp_f cmp,
+		 uint nthreads);
+
+/*
+ * Stable radix sorts of 'nelem' elements of 'esize' bytes ordered by a
+ * key at byte offset 'koff' within each element.  The key is a native
+ * uint32_t, a native uint64_t or a struct raw compared as by raw_cmp().
+ * Keys need not be aligned.  The sorts allocate a temporary copy of the
+ * array from 'mm' and return -1 without touching the array if that
+ * fails or 0 on success.  Small arrays and buckets get insertion sorted.
+ */
+int rsort_u32(void *arr, size_t nelem, size_t esize, size_t koff,
+	      struct memmgr *mm);
+
+#if CAT_64BIT
+int rsort_u64(void *arr, size_t nelem, size_t esize, size_t koff,
+	      struct memmgr *mm);
+#endif /* CAT_64BIT */
+
+int rsort_raw(void *arr, size_t nelem, size_t esize, size_t koff,
+	      struct memmgr *mm);
+
 void array_to_voidp(void **varr, void *arr, size_t nelem, size_t esize);
 
 void permute_array(void *arr, void *tswap, void **varr, size_t nelem, size_t esize);
@@ -123,14 +123,16 @@ struct chtab_attr {
 	struct chnode *	(*node_alloc)(struct chtab *, void *k);
 	void		(*node_free)(struct chtab *, struct chnode *);
 	void *		ctx;
+	struct memmgr *	mm;	/* node memory:  NULL for stdmm */
 };
 
 struct chtab {
-	struct htab	table;
+	struct rhtab	table;
 	int		abort_on_fail;
 	struct chnode *	(*node_alloc)(struct chtab *t, void *k);
 	void		(*node_free)(struct chtab *t, struct chnode *n);
 	void *		ctx;
+	struct memmgr *	mm;
 };
 
 extern struct chtab_attr cht_std_attr_skey;	/* string key table */
@@ -138,6 +140,7 @@ extern struct chtab_attr cht_std_attr_rkey;	/* raw key table */
 extern struct chtab_attr cht_std_attr_pkey;	/* ptr key table */
 extern struct chtab_attr cht_std_attr_bkey;	/* binary key table */
 
+/* The table resizes itself as needed:  'nbkts' is only the initial size */
 struct chtab *	cht_new(size_t nbkts, struct chtab_attr *attr, void *hctx,
 			int abort_on_fail);
 void		cht_free(struct chtab *t);
@@ -147,6 +150,43 @@ void *		cht_del(struct chtab *t, void *key);
 void		cht_apply(struct chtab *t, apply_f f, void *ctx);
 
 
+/* Application layer open addressing hash table functions */
+#include <cat/oahash.h>
+
+struct cohtab;
+
+struct cohtab_attr {
+	cmp_f		kcmp;
+	hash_f		hash;
+	size_t		hctx_size;
+	void *		(*key_dup)(struct cohtab *, void *k);
+	void		(*key_free)(struct cohtab *, void *k);
+	void *		ctx;
+};
+
+struct cohtab {
+	struct ohtab	table;
+	int		abort_on_fail;
+	void *		(*key_dup)(struct cohtab *t, void *k);
+	void		(*key_free)(struct cohtab *t, void *k);
+	void *		ctx;
+};
+
+extern struct cohtab_attr coht_std_attr_skey;	/* string key table */
+extern struct cohtab_attr coht_std_attr_rkey;	/* raw key table */
+extern struct cohtab_attr coht_std_attr_pkey;	/* ptr key table */
+extern struct cohtab_attr coht_std_attr_bkey;	/* binary key table */
+
+/* The table grows as needed:  'nslots' is only the initial size */
+struct cohtab *	coht_new(size_t nslots, struct cohtab_attr *attr, void *hctx,
+			 int abort_on_fail);
+void		coht_free(struct cohtab *t);
+void *		coht_get(struct cohtab *t, void *key);
+int		coht_put(struct cohtab *t, void *key, void *data);
+void *		coht_del(struct cohtab *t, void *key);
+void		coht_apply(struct cohtab *t, apply_f f, void *ctx);
+
+
 #include <cat/avl.h>
 
 struct canode {
@@ -163,6 +203,7 @@ struct cavltree_attr {
 	struct canode *	(*node_alloc)(struct cavltree *t, void *k);
 	void		(*node_free)(struct cavltree *t, struct canode *n);
 	void *		ctx;
+	struct memmgr *	mm;	/* node memory:  NULL for stdmm */
 };
 
 struct cavltree {
@@ -171,6 +212,7 @@ struct cavltree {
 	struct canode *	(*node_alloc)(struct cavltree *t, void *k);
 	void		(*node_free)(struct cavltree *t, struct canode *n);
 	void *		ctx;
+	struct memmgr *	mm;
 };
 
 extern struct cavltree_attr cavl_std_attr_skey;	/* string key table */
@@ -203,6 +245,7 @@ struct crbtree_attr {
 	struct crbnode *(*node_alloc)(struct crbtree *t, void *k);
 	void		(*node_free)(struct crbtree *t, struct crbnode *n);
 	void *		ctx;
+	struct memmgr *	mm;	/* node memory:  NULL for stdmm */
 };
 
 struct crbtree {
@@ -211,6 +254,7 @@ struct crbtree {
 	struct crbnode *(*node_alloc)(struct crbtree *t, void *k);
 	void		(*node_free)(struct crbtree *t, struct crbnode *n);
 	void *		ctx;
+	struct memmgr *	mm;
 };
 
 extern struct crbtree_attr crb_std_attr_skey;	/* string key table */
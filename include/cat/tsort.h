@@ -0,0 +1,161 @@
+/*
+ * cat/tsort.h -- Type specialized array sorting
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2003-2017 -- See accompanying license
+ *
+ */
+
+#ifndef __cat_tsort_h
+#define __cat_tsort_h
+
+#include <cat/cat.h>
+
+/*
+ * CAT_SORT_DEFINE(name, type, lessthan) defines a function:
+ *
+ *   static void name(type *arr, size_t nelem);
+ *
+ * that sorts 'arr' with the same introsort strategy as qsort_array():
+ * median-of-3 (or ninther for large arrays) quicksort that falls back to
+ * heap sort past 2 * log2(nelem) levels and insertion sorts partitions
+ * of CAT_SORT_ISORT_THRESH elements or fewer.  'lessthan(a, b)' is a
+ * macro or function taking two lvalues of 'type' and returning nonzero
+ * if 'a' should come before 'b'.  Elements are moved by assignment and
+ * 'lessthan' gets expanded in place, so there are no indirect calls.
+ * The instance uses the helper functions name_isort(), name_sift(),
+ * name_hsort(), name_med3() and name_intro().  For example:
+ *
+ *   #define dbl_lt(a, b) ((a) < (b))
+ *   CAT_SORT_DEFINE(dsort, double, dbl_lt)
+ *   ...
+ *   dsort(darr, n);
+ */
+
+#define CAT_SORT_ISORT_THRESH	16
+
+#define CAT_SORT_DEFINE(_name, _type, _lt)				\
+									\
+static void _name##_isort(_type *arr, size_t nelem)			\
+{									\
+	size_t i, j;							\
+	_type t;							\
+	for ( i = 1 ; i < nelem ; ++i ) {				\
+		t = arr[i];						\
+		for ( j = i ; j > 0 && _lt(t, arr[j - 1]) ; --j )	\
+			arr[j] = arr[j - 1];				\
+		arr[j] = t;						\
+	}								\
+}									\
+									\
+									\
+static void _name##_sift(_type *arr, size_t i, size_t nelem)		\
+{									\
+	size_t c;							\
+	_type t = arr[i];						\
+	while ( (c = 2 * i + 1) < nelem ) {				\
+		if ( c + 1 < nelem && _lt(arr[c], arr[c + 1]) )		\
+			++c;						\
+		if ( !_lt(t, arr[c]) )					\
+			break;						\
+		arr[i] = arr[c];					\
+		i = c;							\
+	}								\
+	arr[i] = t;							\
+}									\
+									\
+									\
+static void _name##_hsort(_type *arr, size_t nelem)			\
+{									\
+	size_t i;							\
+	_type t;							\
+	for ( i = nelem / 2 ; i > 0 ; --i )				\
+		_name##_sift(arr, i - 1, nelem);			\
+	for ( i = nelem ; i > 1 ; --i ) {				\
+		t = arr[0];						\
+		arr[0] = arr[i - 1];					\
+		arr[i - 1] = t;						\
+		_name##_sift(arr, 0, i - 1);				\
+	}								\
+}									\
+									\
+									\
+static _type *_name##_med3(_type *a, _type *b, _type *c)		\
+{									\
+	if ( _lt(*a, *b) )						\
+		return _lt(*b, *c) ? b : (_lt(*a, *c) ? c : a);		\
+	else								\
+		return _lt(*a, *c) ? a : (_lt(*b, *c) ? c : b);		\
+}									\
+									\
+									\
+static void _name##_intro(_type *arr, size_t nelem, int depth)		\
+{									\
+	_type *lo, *hi, *m1, *m2, *m3, t;				\
+	size_t s, nlo, nhi;						\
+									\
+	while ( nelem > CAT_SORT_ISORT_THRESH ) {			\
+		if ( depth-- <= 0 ) {					\
+			_name##_hsort(arr, nelem);			\
+			return;						\
+		}							\
+									\
+		m1 = arr;						\
+		m2 = arr + nelem / 2;					\
+		m3 = arr + nelem - 1;					\
+		if ( nelem > 64 ) {					\
+			s = nelem / 8;					\
+			m1 = _name##_med3(m1, m1 + s, m1 + 2 * s);	\
+			m2 = _name##_med3(m2 - s, m2, m2 + s);		\
+			m3 = _name##_med3(m3 - 2 * s, m3 - s, m3);	\
+		}							\
+		m1 = _name##_med3(m1, m2, m3);				\
+		t = *m1;						\
+		*m1 = arr[0];						\
+		arr[0] = t;						\
+									\
+		/* stop on equal keys on both sides to split runs */	\
+		lo = arr + 1;						\
+		hi = arr + nelem - 1;					\
+		while ( 1 ) {						\
+			while ( lo <= hi && _lt(*lo, arr[0]) )		\
+				++lo;					\
+			while ( lo <= hi && _lt(arr[0], *hi) )		\
+				--hi;					\
+			if ( lo >= hi )					\
+				break;					\
+			t = *lo;					\
+			*lo++ = *hi;					\
+			*hi-- = t;					\
+		}							\
+		t = *hi;						\
+		*hi = arr[0];						\
+		arr[0] = t;						\
+									\
+		/* recurse on the smaller side, loop on the larger */	\
+		nlo = hi - arr;						\
+		nhi = nelem - nlo - 1;					\
+		if ( nlo < nhi ) {					\
+			_name##_intro(arr, nlo, depth);			\
+			arr = hi + 1;					\
+			nelem = nhi;					\
+		} else {						\
+			_name##_intro(hi + 1, nhi, depth);		\
+			nelem = nlo;					\
+		}							\
+	}								\
+	_name##_isort(arr, nelem);					\
+}									\
+									\
+									\
+static void _name(_type *arr, size_t nelem)				\
+{									\
+	size_t n = nelem;						\
+	int depth = 0;							\
+	while ( (n >>= 1) )						\
+		++depth;						\
+	_name##_intro(arr, nelem, depth * 2);				\
+}
+
+#endif /* __cat_tsort_h */
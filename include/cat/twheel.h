@@ -0,0 +1,69 @@
+/*
+ * twheel.h -- Hashed hierarchical timing wheel.
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2003-2012 -- See accompanying license
+ *
+ */
+#ifndef __cat_twheel_h
+#define __cat_twheel_h
+
+#include <cat/cat.h>
+#include <cat/list.h>
+
+/*
+ * Time is measured in abstract 'ticks'.  Each level of the wheel has
+ * TW_NSLOTS slots and each slot in level N covers TW_NSLOTS^N ticks.
+ * Timers further out than the top level can represent wait on an overflow
+ * list that is rescanned every time the top level wraps.  Insertion and
+ * removal are O(1).  Timers get moved down a level at most TW_NLEVELS - 1
+ * times before they expire.
+ */
+#define TW_BITS		6
+#define TW_NSLOTS	(1 << TW_BITS)
+#define TW_MASK		(TW_NSLOTS - 1)
+#define TW_NLEVELS	6
+#define TW_BMLEN	((TW_NSLOTS + 31) / 32)
+
+struct twtimer {
+	struct list		entry;
+	ulong			expire;
+};
+
+struct twheel {
+	ulong			now;
+	ulong			count;
+	struct list		slots[TW_NLEVELS][TW_NSLOTS];
+	uint32_t		bmap[TW_NLEVELS][TW_BMLEN];
+	struct list		overflow;
+};
+
+void tw_init(struct twheel *tw);
+void tw_tmr_init(struct twtimer *t);
+
+/* Expires once the wheel advances 'ticks' (at least 1) ticks */
+void tw_ins(struct twheel *tw, struct twtimer *t, ulong ticks);
+void tw_rem(struct twheel *tw, struct twtimer *t);
+
+/* 
+ * Advance the wheel and move all expired timers to the 'out' list.  Timers
+ * on 'out' are no longer in the wheel:  use l_rem() to take them off 'out'.
+ */
+void tw_adv(struct twheel *tw, ulong ticks, struct list *out);
+
+/*
+ * Returns 0 if the wheel is empty.  Otherwise returns 1 and sets *ticks to
+ * a lower bound on the ticks until the next expiration.  The wheel may need
+ * to be advanced more than once to fire timers more than TW_NSLOTS ticks out.
+ */
+int  tw_next(struct twheel *tw, ulong *ticks);
+
+/* Remove all timers from the wheel and move them to the 'out' list */
+void tw_flush(struct twheel *tw, struct list *out);
+
+#define tw_isempty(tw)	((tw)->count == 0)
+#define tw_isreg(t)	l_onlist(&(t)->entry)
+#define l_to_twt(le)	container(le, struct twtimer, entry)
+
+#endif /* __cat_twheel_h */
@@ -14,11 +14,16 @@
 #if CAT_HAS_POSIX
 #include <cat/mem.h>
 #include <cat/list.h>
-#include <cat/dlist.h>
+#include <cat/twheel.h>
+#include <cat/time.h>
 #include <cat/avl.h>
 #include <cat/cb.h>
 #include <sys/select.h>
 
+#ifndef CAT_HAS_EPOLL
+#define CAT_HAS_EPOLL		0
+#endif /* CAT_HAS_EPOLL */
+
 
 struct ue_ioevent {
 	struct callback		cb;
@@ -27,6 +32,7 @@ struct ue_ioevent {
 	int			type;
 	struct uemux *		mux;
 	struct memmgr *		mm;
+	ulong			gen;
 };
 
 #define UE_RD		1
@@ -34,11 +40,13 @@ struct ue_ioevent {
 #define UE_EX		3
 
 
+/* timers are kept in a timing wheel with one tick per millisecond */
 struct ue_timer {
-	struct dlist		entry;
+	struct twtimer		entry;
 	int 			flags;
 	ulong			orig;
 	struct callback		cb;
+	struct uemux *		mux;
 	struct memmgr *		mm;
 };
 
@@ -55,9 +63,27 @@ struct ue_sigevent {
 };
 
 
+/* 
+ * I/O backends:  the select() backend is the default and the most portable
+ * but can not monitor descriptors >= FD_SETSIZE and costs O(maxfd) per call.
+ * The epoll() backends cost O(ready descriptors) per call but can not
+ * monitor regular files (ue_io_reg() fails).  In edge triggered mode, an I/O
+ * event's callback only fires again once new data arrives or more space
+ * frees up so the callback must read or write until EAGAIN.
+ */
+#define UE_BE_BEST	-1	/* epoll if available, otherwise select */
+#define UE_BE_SELECT	0
+#define UE_BE_EPOLL	1	/* level triggered */
+#define UE_BE_EPOLL_ET	2	/* edge triggered */
+
+#define UE_EPOLL_NEVENTS	256
+
+struct ue_iobe;
+
 struct uemux {
 	struct memmgr *		mm;
-	struct dlist		timers;
+	struct twheel		timers;
+	cat_time_t		tmlast;
 	int 			maxfd;
 	struct cavltree *	fdtab;
 	struct list		iolist;
@@ -66,11 +92,26 @@ struct uemux {
 	fd_set			eset;
 	struct cavltree *	sigtab;
 	int			done;
+
+	/* I/O backend state */
+	const struct ue_iobe *	iobe;
+	int			betype;
+	int			befd;
+	void *			bevents;
+	int			nready;
+	fd_set			rrdy;
+	fd_set			wrdy;
+	fd_set			erdy;
+	ulong			gen;
+	int			indisp;
+	struct list		fdfree;
 };
 
 
 /* mux initialization, finalization and execution */
 void ue_init(struct uemux *mux, struct memmgr *mm);
+/* returns -1 if the backend is unavailable or can't be initialized */
+int  ue_init_be(struct uemux *mux, struct memmgr *mm, int betype);
 void ue_fini(struct uemux *mux);
 void ue_stop(struct uemux *mux);
 void ue_next(struct uemux *mux);
@@ -10,6 +10,328 @@
 #include <cat/cat.h>
 #include <cat/catlibc.h>
 
+
+/*
+ * Word-at-a-time memory and string functions.  These are compiled into
+ * every build.  Only the build without the standard library uses them
+ * as its memcpy(), memset() and so on.
+ */
+
+#define CL_WSIZE	sizeof(ulong)
+#define CL_WMASK	(CL_WSIZE - 1)
+#define CL_ONES		((ulong)~0 / 0xFF)
+#define CL_HIGHS	(CL_ONES << 7)
+/* nonzero iff some byte in 'w' is zero */
+#define CL_HASZERO(w)	(((w) - CL_ONES) & ~(w) & CL_HIGHS)
+
+#if defined(__GNUC__) && !CAT_ANSI89
+
+/* may_alias lets us move words through buffers of any type */
+typedef ulong cl_word __attribute__((may_alias));
+typedef ulong cl_uword __attribute__((may_alias, aligned(1)));
+#define CL_UNALIGNED	1
+
+#ifndef CAT_LIBC_VEC
+#if defined(__AVX2__)
+#define CAT_LIBC_VEC	32
+#elif defined(__SSE2__)
+#define CAT_LIBC_VEC	16
+#else
+#define CAT_LIBC_VEC	0
+#endif
+#endif /* CAT_LIBC_VEC */
+
+#if CAT_LIBC_VEC
+typedef ulong cl_vec __attribute__((vector_size(CAT_LIBC_VEC), may_alias));
+typedef ulong cl_uvec __attribute__((vector_size(CAT_LIBC_VEC), may_alias,
+				      aligned(1)));
+#define CL_VMASK	(CAT_LIBC_VEC - 1)
+#endif /* CAT_LIBC_VEC */
+
+#else /* __GNUC__ && !CAT_ANSI89 */
+
+/* without unaligned loads, only copy by words if the source is aligned */
+typedef ulong cl_word;
+typedef ulong cl_uword;
+#define CL_UNALIGNED	0
+#undef CAT_LIBC_VEC
+#define CAT_LIBC_VEC	0
+
+#endif /* __GNUC__ && !CAT_ANSI89 */
+
+
+/* safe for overlapping regions as long as d <= s */
+static void cl_copy_fwd(byte_t *d, const byte_t *s, size_t len)
+{
+	ulong w0, w1, w2, w3;
+
+	if ( len >= 2 * CL_WSIZE ) {
+		while ( ((ulong)d & CL_WMASK) != 0 ) {
+			*d++ = *s++;
+			--len;
+		}
+
+#if CAT_LIBC_VEC
+		if ( len >= 4 * CAT_LIBC_VEC ) {
+			cl_vec v0, v1, v2, v3;
+			while ( ((ulong)d & CL_VMASK) != 0 ) {
+				*(cl_word *)d = *(const cl_uword *)s;
+				d += CL_WSIZE;
+				s += CL_WSIZE;
+				len -= CL_WSIZE;
+			}
+			while ( len >= 4 * CAT_LIBC_VEC ) {
+				v0 = ((const cl_uvec *)s)[0];
+				v1 = ((const cl_uvec *)s)[1];
+				v2 = ((const cl_uvec *)s)[2];
+				v3 = ((const cl_uvec *)s)[3];
+				((cl_vec *)d)[0] = v0;
+				((cl_vec *)d)[1] = v1;
+				((cl_vec *)d)[2] = v2;
+				((cl_vec *)d)[3] = v3;
+				d += 4 * CAT_LIBC_VEC;
+				s += 4 * CAT_LIBC_VEC;
+				len -= 4 * CAT_LIBC_VEC;
+			}
+		}
+#endif /* CAT_LIBC_VEC */
+
+		if ( CL_UNALIGNED || ((ulong)s & CL_WMASK) == 0 ) {
+			while ( len >= 4 * CL_WSIZE ) {
+				w0 = ((const cl_uword *)s)[0];
+				w1 = ((const cl_uword *)s)[1];
+				w2 = ((const cl_uword *)s)[2];
+				w3 = ((const cl_uword *)s)[3];
+				((cl_word *)d)[0] = w0;
+				((cl_word *)d)[1] = w1;
+				((cl_word *)d)[2] = w2;
+				((cl_word *)d)[3] = w3;
+				d += 4 * CL_WSIZE;
+				s += 4 * CL_WSIZE;
+				len -= 4 * CL_WSIZE;
+			}
+			while ( len >= CL_WSIZE ) {
+				*(cl_word *)d = *(const cl_uword *)s;
+				d += CL_WSIZE;
+				s += CL_WSIZE;
+				len -= CL_WSIZE;
+			}
+		}
+	}
+
+	while ( len > 0 ) {
+		*d++ = *s++;
+		--len;
+	}
+}
+
+
+/* safe for overlapping regions as long as d >= s */
+static void cl_copy_bwd(byte_t *d, const byte_t *s, size_t len)
+{
+	ulong w0, w1, w2, w3;
+
+	d += len;
+	s += len;
+	if ( len >= 2 * CL_WSIZE ) {
+		while ( ((ulong)d & CL_WMASK) != 0 ) {
+			*--d = *--s;
+			--len;
+		}
+		if ( CL_UNALIGNED || ((ulong)s & CL_WMASK) == 0 ) {
+			while ( len >= 4 * CL_WSIZE ) {
+				d -= 4 * CL_WSIZE;
+				s -= 4 * CL_WSIZE;
+				w3 = ((const cl_uword *)s)[3];
+				w2 = ((const cl_uword *)s)[2];
+				w1 = ((const cl_uword *)s)[1];
+				w0 = ((const cl_uword *)s)[0];
+				((cl_word *)d)[3] = w3;
+				((cl_word *)d)[2] = w2;
+				((cl_word *)d)[1] = w1;
+				((cl_word *)d)[0] = w0;
+				len -= 4 * CL_WSIZE;
+			}
+			while ( len >= CL_WSIZE ) {
+				d -= CL_WSIZE;
+				s -= CL_WSIZE;
+				*(cl_word *)d = *(const cl_uword *)s;
+				len -= CL_WSIZE;
+			}
+		}
+	}
+
+	while ( len > 0 ) {
+		*--d = *--s;
+		--len;
+	}
+}
+
+
+void *cat_memcpy(void *dst, const void *src, size_t len)
+{
+	abort_unless(dst && src);
+	cl_copy_fwd(dst, src, len);
+	return dst;
+}
+
+
+void *cat_memmove(void *dst, const void *src, size_t len)
+{
+	byte_t *d = dst;
+	const byte_t *s = src;
+
+	abort_unless(dst && src);
+	if ( d <= s || s + len <= d )
+		cl_copy_fwd(d, s, len);
+	else
+		cl_copy_bwd(d, s, len);
+	return dst;
+}
+
+
+void *cat_memset(void *dst, int c, size_t len)
+{
+	byte_t *d = dst;
+	ulong w;
+
+	if ( len >= 2 * CL_WSIZE ) {
+		w = CL_ONES * (uchar)c;
+		while ( ((ulong)d & CL_WMASK) != 0 ) {
+			*d++ = c;
+			--len;
+		}
+
+#if CAT_LIBC_VEC
+		if ( len >= 4 * CAT_LIBC_VEC ) {
+			cl_vec v = { 0 };
+			v += w;
+			while ( ((ulong)d & CL_VMASK) != 0 ) {
+				*(cl_word *)d = w;
+				d += CL_WSIZE;
+				len -= CL_WSIZE;
+			}
+			while ( len >= 4 * CAT_LIBC_VEC ) {
+				((cl_vec *)d)[0] = v;
+				((cl_vec *)d)[1] = v;
+				((cl_vec *)d)[2] = v;
+				((cl_vec *)d)[3] = v;
+				d += 4 * CAT_LIBC_VEC;
+				len -= 4 * CAT_LIBC_VEC;
+			}
+		}
+#endif /* CAT_LIBC_VEC */
+
+		while ( len >= 4 * CL_WSIZE ) {
+			((cl_word *)d)[0] = w;
+			((cl_word *)d)[1] = w;
+			((cl_word *)d)[2] = w;
+			((cl_word *)d)[3] = w;
+			d += 4 * CL_WSIZE;
+			len -= 4 * CL_WSIZE;
+		}
+		while ( len >= CL_WSIZE ) {
+			*(cl_word *)d = w;
+			d += CL_WSIZE;
+			len -= CL_WSIZE;
+		}
+	}
+
+	while ( len > 0 ) {
+		*d++ = c;
+		--len;
+	}
+	return dst;
+}
+
+
+int cat_memcmp(const void *b1p, const void *b2p, size_t len)
+{
+	const uchar *b1 = b1p, *b2 = b2p;
+
+	abort_unless(b1 && b2);
+	if ( len >= 2 * CL_WSIZE ) {
+		while ( ((ulong)b1 & CL_WMASK) != 0 ) {
+			if ( *b1 != *b2 )
+				return (int)*b1 - (int)*b2;
+			b1++;
+			b2++;
+			len--;
+		}
+		/* find the first word that differs, then the byte within it */
+		if ( CL_UNALIGNED || ((ulong)b2 & CL_WMASK) == 0 ) {
+			while ( len >= CL_WSIZE &&
+				*(const cl_word *)b1 == *(const cl_uword *)b2 ) {
+				b1 += CL_WSIZE;
+				b2 += CL_WSIZE;
+				len -= CL_WSIZE;
+			}
+		}
+	}
+
+	while ( len > 0 && (*b1 == *b2) ) {
+		b1++;
+		b2++;
+		len--;
+	}
+	if ( len )
+		return (int)*b1 - (int)*b2;
+	else
+		return 0;
+}
+
+
+/*
+ * An aligned word never straddles a page boundary, so reading the whole
+ * word that holds the terminator can not fault.
+ */
+size_t cat_strlen(const char *s)
+{
+	const char *p = s;
+	const cl_word *wp;
+
+	abort_unless(s);
+	for ( ; ((ulong)p & CL_WMASK) != 0 ; ++p )
+		if ( *p == '\0' )
+			return p - s;
+	for ( wp = (const cl_word *)p ; !CL_HASZERO(*wp) ; ++wp )
+		;
+	for ( p = (const char *)wp ; *p != '\0' ; ++p )
+		;
+	return p - s;
+}
+
+
+char *cat_strchr(const char *s, int ch)
+{
+	const cl_word *wp;
+	uchar c = ch;
+	ulong m, w;
+
+	abort_unless(s);
+	for ( ; ((ulong)s & CL_WMASK) != 0 ; ++s ) {
+		if ( (uchar)*s == c )
+			return (char *)s;
+		if ( *s == '\0' )
+			return NULL;
+	}
+
+	m = CL_ONES * c;
+	for ( wp = (const cl_word *)s ; ; ++wp ) {
+		w = *wp;
+		if ( CL_HASZERO(w) || CL_HASZERO(w ^ m) )
+			break;
+	}
+
+	for ( s = (const char *)wp ; ; ++s ) {
+		if ( (uchar)*s == c )
+			return (char *)s;
+		if ( *s == '\0' )
+			return NULL;
+	}
+}
+
+
 /* We use several functions even if we don't use the standard library */
 #if !CAT_USE_STDLIB
 #include <stdarg.h>
@@ -30,60 +352,31 @@ STATIC_BUG_ON(strspn_bad_size_char, CHAR_BIT != 8);
 
 int memcmp(const void *b1p, const void *b2p, size_t len)
 {
-	const uchar *b1 = b1p, *b2 = b2p;
-	abort_unless(b1 && b2);
-	while ( len > 0 && (*b1 == *b2) ) {
-		b1++;
-		b2++;
-		len--;
-	}
-	if ( len )
-		return (int)*b1 - (int)*b2;
-	else
-		return 0;
+	return cat_memcmp(b1p, b2p, len);
 }
 
 
 void *memcpy(void *dst, const void *src, size_t len)
 {
-	return memmove(dst, src, len);
+	return cat_memcpy(dst, src, len);
 }
 
 
 void *memmove(void *dst, const void *src, size_t len)
 {
-	const uchar *s;
-	uchar *d;
-	abort_unless(dst && src);
-	if ( src < dst ) {
-		s = src;
-		d = dst;
-		while (len--)
-			*d++ = *s++;
-	} else if ( src > dst ) {
-		s = (const uchar *)src + len;
-		d = (uchar *)dst + len;
-		while (len--)
-			*--d = *--s;
-	}
-	return dst;
+	return cat_memmove(dst, src, len);
 }
 
 
 void *memset(void *dst, int c, size_t len)
 {
-	uchar *p = dst;
-	while ( len-- ) *p = c;
-	return dst;
+	return cat_memset(dst, c, len);
 }
 
 
 size_t strlen(const char *s)
 {
-	int n = 0;
-	abort_unless(s);
-	while (*s++) ++n;
-	return n;
+	return cat_strlen(s);
 }
 
 
@@ -126,22 +419,17 @@ int strncmp(const char *c1, const char *c2, size_t n)
 
 char *strchr(const char *s, int ch)
 {
-	while ( *s != '\0' ) {
-		if ( *s == ch )
-			return (char *)s;
-		++s;
-	}
-	return NULL;
+	return cat_strchr(s, ch);
 }
 
 
 char *strrchr(const char *s, int ch)
 {
 	const char *last = NULL;
-	while ( *s != '\0' )
-		if ( *s == ch )
+	for ( ; *s != '\0' ; ++s )
+		if ( *s == (char)ch )
 			last = s;
-	return (char *)last;
+	return (char *)(ch == '\0' ? s : last);
 }
 
 
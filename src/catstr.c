@@ -382,22 +382,15 @@ size_t cs_find_str(const struct catstr *findin, const char *s)
 
 size_t cs_find_raw(const struct catstr *findin, const struct raw *r)
 {
-	struct bmpat bmp;
-	ulong off;
-	int rv;
+	size_t off;
 	struct raw rstr;
 
 	CKCS(findin);
-
-	/* TODO: fix bm_* so it uses size_t */
-	abort_unless(r->len <= (ulong)~0);
-	bm_pinit_lite(&bmp, (struct raw *)r);
+	abort_unless(r);
 
 	rstr.len = findin->cs_dlen;
 	rstr.data = (char *)findin->cs_data;
-	rv = bm_match(&rstr, &bmp, &off);
-
-	if ( rv < 0 )
+	if ( !mem_match(&rstr, r, &off) )
 		return CS_NOTFOUND;
 	else
 		return off;
@@ -0,0 +1,336 @@
+/*
+ * cmap.c -- Concurrent hash table with lock-free readers
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2003-2017 -- See accompanying license
+ *
+ */
+#include <cat/cmap.h>
+
+#define LOAD(_p)	cat_ld_acq(_p)
+#define STORE(_p, _v)	cat_st_rel((_p), (_v))
+#define LOAD_SC(_p)	cat_ld_sc(_p)
+#define STORE_SC(_p, _v) cat_st_sc((_p), (_v))
+#define lock(_l)	cat_lock(_l)
+#define trylock(_l)	cat_trylock(_l)
+#define unlock(_l)	cat_unlock(_l)
+
+
+void cm_init(struct cmap *m, struct cmnode **bkts, uint nbkts, int *locks,
+	     uint nlocks, cmp_f cmp, hash_f hashf, void *hctx,
+	     cm_release_f release, void *rctx)
+{
+	uint i;
+
+	abort_unless(m != NULL);
+	abort_unless(bkts != NULL);
+	abort_unless(locks != NULL);
+	abort_unless(nbkts > 0 && (nbkts & (nbkts - 1)) == 0);
+	abort_unless(nlocks > 0 && (nlocks & (nlocks - 1)) == 0);
+	abort_unless(nlocks <= nbkts);
+	abort_unless(cmp != NULL);
+	abort_unless(hashf != NULL);
+
+	m->bkts = bkts;
+	m->bmask = nbkts - 1;
+	for ( i = 0 ; i < nbkts ; ++i )
+		bkts[i] = NULL;
+	m->locks = locks;
+	m->lmask = nlocks - 1;
+	for ( i = 0 ; i < nlocks ; ++i )
+		locks[i] = 0;
+	m->cmp = cmp;
+	m->hash = hashf;
+	m->hctx = hctx;
+	m->release = release;
+	m->rctx = rctx;
+	m->epoch = 1;
+	m->glock = 0;
+	m->readers = NULL;
+	m->retired = NULL;
+	m->nretired = 0;
+}
+
+
+static void release_list(struct cmap *m, struct cmnode *list)
+{
+	struct cmnode *node;
+
+	while ( list != NULL ) {
+		node = list;
+		list = node->rnext;
+		node->next = NULL;
+		node->rnext = NULL;
+		if ( m->release != NULL )
+			(*m->release)(node, m->rctx);
+	}
+}
+
+
+void cm_fini(struct cmap *m)
+{
+	uint i;
+	struct cmnode *node, *list = m->retired;
+
+	abort_unless(m != NULL);
+
+	for ( i = 0 ; i <= m->bmask ; ++i ) {
+		while ( (node = m->bkts[i]) != NULL ) {
+			m->bkts[i] = node->next;
+			node->rnext = list;
+			list = node;
+		}
+	}
+	m->retired = NULL;
+	m->nretired = 0;
+	release_list(m, list);
+}
+
+
+void cm_ninit(struct cmnode *node, void *key)
+{
+	abort_unless(node != NULL);
+	abort_unless(key != NULL);
+
+	node->next = NULL;
+	node->rnext = NULL;
+	node->key = key;
+	node->hash = 0;
+	node->epoch = 0;
+}
+
+
+uint cm_hash(struct cmap *m, const void *key)
+{
+	abort_unless(m != NULL);
+	return (*m->hash)(key, m->hctx);
+}
+
+
+void cm_rd_reg(struct cmap *m, struct cmreader *r)
+{
+	abort_unless(m != NULL);
+	abort_unless(r != NULL);
+
+	r->state = 0;
+	lock(&m->glock);
+	r->next = m->readers;
+	m->readers = r;
+	unlock(&m->glock);
+}
+
+
+void cm_rd_unreg(struct cmap *m, struct cmreader *r)
+{
+	struct cmreader **trav;
+
+	abort_unless(m != NULL);
+	abort_unless(r != NULL);
+	abort_unless(r->state == 0);
+
+	lock(&m->glock);
+	for ( trav = &m->readers ; *trav != NULL ; trav = &(*trav)->next ) {
+		if ( *trav == r ) {
+			*trav = r->next;
+			break;
+		}
+	}
+	unlock(&m->glock);
+	r->next = NULL;
+}
+
+
+void cm_rd_enter(struct cmap *m, struct cmreader *r)
+{
+	ulong e;
+
+	abort_unless(m != NULL);
+	abort_unless(r != NULL);
+	abort_unless(r->state == 0);
+
+	/*
+	 * Publish the epoch we entered in and make sure that it is still
+	 * current.  Otherwise the epoch could have advanced past us before
+	 * our state became visible.
+	 */
+	do {
+		e = LOAD_SC(&m->epoch);
+		STORE_SC(&r->state, (e << 1) | 1);
+	} while ( LOAD_SC(&m->epoch) != e );
+}
+
+
+void cm_rd_leave(struct cmap *m, struct cmreader *r)
+{
+	abort_unless(r != NULL);
+	STORE(&r->state, 0);
+}
+
+
+struct cmnode *cm_lkup(struct cmap *m, const void *key, uint *hp)
+{
+	struct cmnode *node;
+	uint h;
+
+	abort_unless(m != NULL);
+	abort_unless(key != NULL);
+
+	h = (*m->hash)(key, m->hctx);
+	if ( hp != NULL )
+		*hp = h;
+
+	/* the key and hash of a node never change while it is reachable */
+	for ( node = LOAD(&m->bkts[h & m->bmask]) ; node != NULL ;
+	      node = LOAD(&node->next) )
+		if ( node->hash == h && !(*m->cmp)(node->key, key) )
+			return node;
+
+	return NULL;
+}
+
+
+struct cmnode *cm_ins(struct cmap *m, struct cmnode *node, uint h)
+{
+	struct cmnode **bkt, *trav;
+	int *l;
+
+	abort_unless(m != NULL);
+	abort_unless(node != NULL);
+
+	bkt = &m->bkts[h & m->bmask];
+	l = &m->locks[h & m->lmask];
+
+	lock(l);
+	for ( trav = *bkt ; trav != NULL ; trav = trav->next ) {
+		if ( trav->hash == h && !(*m->cmp)(trav->key, node->key) ) {
+			unlock(l);
+			return trav;
+		}
+	}
+	node->hash = h;
+	node->next = *bkt;
+	node->rnext = NULL;
+	STORE(bkt, node);
+	unlock(l);
+
+	return NULL;
+}
+
+
+/* Must hold the glock:  returns a list of nodes that are safe to release */
+static struct cmnode *collect(struct cmap *m)
+{
+	struct cmreader *r;
+	struct cmnode **trav, *node, *out = NULL;
+	ulong e, s;
+
+	/* advance the epoch if every active reader has seen the current one */
+	e = m->epoch;
+	for ( r = m->readers ; r != NULL ; r = r->next ) {
+		s = LOAD_SC(&r->state);
+		if ( (s & 1) && (s >> 1) != e )
+			break;
+	}
+	if ( r == NULL )
+		STORE_SC(&m->epoch, ++e);
+
+	/* a node retired in epoch N is unreachable once the epoch is N + 2 */
+	trav = &m->retired;
+	while ( (node = *trav) != NULL ) {
+		if ( e - node->epoch >= 2 ) {
+			*trav = node->rnext;
+			node->rnext = out;
+			out = node;
+			--m->nretired;
+		} else {
+			trav = &node->rnext;
+		}
+	}
+
+	return out;
+}
+
+
+static void retire(struct cmap *m, struct cmnode *node)
+{
+	struct cmnode *list = NULL;
+
+	lock(&m->glock);
+	node->epoch = m->epoch;
+	node->rnext = m->retired;
+	m->retired = node;
+	if ( ++m->nretired >= CM_RECLAIM_BATCH )
+		list = collect(m);
+	unlock(&m->glock);
+
+	release_list(m, list);
+}
+
+
+int cm_rem(struct cmap *m, struct cmnode *node)
+{
+	struct cmnode **trav;
+	int *l;
+
+	abort_unless(m != NULL);
+	abort_unless(node != NULL);
+
+	l = &m->locks[node->hash & m->lmask];
+	lock(l);
+	for ( trav = &m->bkts[node->hash & m->bmask] ; *trav != NULL ;
+	      trav = &(*trav)->next ) {
+		if ( *trav == node ) {
+			/* leave node->next intact for readers still on it */
+			STORE(trav, node->next);
+			unlock(l);
+			retire(m, node);
+			return 0;
+		}
+	}
+	unlock(l);
+
+	return -1;
+}
+
+
+struct cmnode *cm_rem_key(struct cmap *m, const void *key)
+{
+	struct cmnode **trav, *node;
+	uint h;
+	int *l;
+
+	abort_unless(m != NULL);
+	abort_unless(key != NULL);
+
+	h = (*m->hash)(key, m->hctx);
+	l = &m->locks[h & m->lmask];
+	lock(l);
+	for ( trav = &m->bkts[h & m->bmask] ; (node = *trav) != NULL ;
+	      trav = &node->next ) {
+		if ( node->hash == h && !(*m->cmp)(node->key, key) ) {
+			STORE(trav, node->next);
+			unlock(l);
+			retire(m, node);
+			return node;
+		}
+	}
+	unlock(l);
+
+	return NULL;
+}
+
+
+void cm_reclaim(struct cmap *m)
+{
+	struct cmnode *list;
+
+	abort_unless(m != NULL);
+
+	if ( !trylock(&m->glock) )
+		return;
+	list = collect(m);
+	unlock(&m->glock);
+
+	release_list(m, list);
+}
@@ -5,69 +5,165 @@
 #include <string.h>
 #include <limits.h>
 
-#define STR(_state, _cursor) ((_state)->buf + (_cursor)->i)
-#define CHAR(_state, _cursor) ((_state)->buf[(_cursor)->i])
-#define CHARI(_state, _cursor, _off) ((_state)->buf[(_cursor)->i + _off])
+#if CAT_HAS_POSIX
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif /* CAT_HAS_POSIX */
+
+#define STR(_state, _cursor) \
+	((_state)->buf + ((_cursor)->i - (_state)->base))
+#define CHAR(_state, _cursor) (*STR(_state, _cursor))
+#define CHARI(_state, _cursor, _off) (STR(_state, _cursor)[_off])
 #define NODE(_peg, _idx) (&(_peg)->nodes[_idx])
 #define NODE_VALID_IDX(_peg, _idx) \
 	((_idx) >= 0 && (_idx) < (_peg)->max_nodes)
 #define NODE_VALID(_peg, _idx, _type) \
 	(NODE_VALID_IDX(_peg, _idx) && ((_peg)->nodes[_idx].pn_type == _type))
+#define MEMO_HASH(_def, _pos) \
+	((uint)(_pos) * 0x9E3779B1u + (uint)(_def) * 0x85EBCA77u)
+#define MEMO_MIN_ENTS	16
+#define ACT_INIT_LEN	256
+#define CPG_BUF_INIT	4096
+#define CPG_NOPIN	((ulong)-1)
+#define CPG_ACT_REF	-1
 
 
-int cpg_init(struct cpg_state *state, struct peg_grammar *peg,
-	     int (*getc)(void *in))
+static int cpg_init_common(struct cpg_state *state, struct peg_grammar *peg)
 {
 	abort_unless(state != NULL);
 
 	state->debug = 0;
 	state->depth = 0;
 	state->in = NULL;
-	state->buf = malloc(4096);
+	state->buf = malloc(CPG_BUF_INIT);
 	if ( state->buf == NULL )
 		return -1;
-	state->buflen = 4096;
-	state->getc = getc;
+	state->buflen = CPG_BUF_INIT;
+	state->getc = NULL;
+	state->read = NULL;
 	state->peg = peg;
+	state->memo = NULL;
+	state->memo_mask = 0;
+	state->memo_rules = NULL;
+	state->acts = NULL;
+	state->acts_len = 0;
+	state->max_acts = 0;
+	state->memo_open = NULL;
+	state->memo_open_len = 0;
 	cpg_reset(state);
 
 	return 0;
 }
 
 
-static int cpg_getc(struct cpg_state *state)
+int cpg_init(struct cpg_state *state, struct peg_grammar *peg,
+	     int (*getc)(void *in))
+{
+	if ( cpg_init_common(state, peg) < 0 )
+		return -1;
+	state->getc = getc;
+	return 0;
+}
+
+
+int cpg_init_read(struct cpg_state *state, struct peg_grammar *peg,
+		  int (*read)(void *in, void *buf, uint len))
+{
+	if ( cpg_init_common(state, peg) < 0 )
+		return -1;
+	state->read = read;
+	return 0;
+}
+
+
+/*
+ * Read more input at readidx.  When the buffer is full, first drop the
+ * input before the last cut that no open action covers.  The character
+ * before that stays for the line count.  Then double the buffer unless
+ * that freed at least half of it.  A getc function only gets asked for
+ * one character so interactive input doesn't block on characters the
+ * parse might never need.  Returns the number of characters added, 0 at
+ * the end of input or -2 on error.
+ */
+static int cpg_fill(struct cpg_state *state)
 {
 	void *newbuf;
+	ulong keep;
+	uint used;
+	uint nlen;
 	int c;
 
-	if ( state->cur.i >= state->eof ) {
-		abort_unless(state->cur.i == state->eof);
-		return EOF;
+	used = state->readidx - state->base;
+	if ( used >= state->buflen ) {
+		abort_unless(used == state->buflen);
+		keep = (state->cut < state->pin) ? state->cut : state->pin;
+		if ( keep > state->base + 1 ) {
+			keep -= 1;
+			used = state->readidx - keep;
+			memmove(state->buf, state->buf + (keep - state->base),
+				used);
+			state->base = keep;
+		}
+		if ( used > state->buflen / 2 ) {
+			nlen = state->buflen * 2;
+			if ( nlen <= state->buflen )
+				return -2;
+			newbuf = realloc(state->buf, nlen);
+			if ( newbuf == NULL )
+				return -2;
+			state->buf = newbuf;
+			state->buflen = nlen;
+		}
 	}
 
-	if ( state->cur.i >= state->buflen ) {
-		abort_unless(state->cur.i == state->buflen);
-		newbuf = realloc(state->buf, state->buflen + 4096);
-		if ( newbuf == NULL ) 
+	if ( state->read != NULL ) {
+		c = (*state->read)(state->in, state->buf + used,
+				   state->buflen - used);
+		if ( c < 0 )
 			return -2;
-		state->buf = newbuf;
-		memset((uchar *)newbuf + state->buflen, '\0', 4096);
-		state->buflen += 4096;
+		abort_unless(c <= state->buflen - used);
+		state->readidx += c;
+		return c;
+	}
+
+	c = (*state->getc)(state->in);
+	if ( c == EOF )
+		return 0;
+	state->buf[used] = c;
+	++state->readidx;
+	return 1;
+}
+
+
+int cpg_getc(struct cpg_state *state)
+{
+	int rv;
+	int c;
+
+	if ( state->cur.i >= state->eof ) {
+		abort_unless(state->cur.i == state->eof);
+		return EOF;
 	}
 
 	if ( state->cur.i >= state->readidx ) {
 		abort_unless(state->cur.i == state->readidx);
-		c = (*state->getc)(state->in);
-		if ( c == EOF ) {
+		rv = cpg_fill(state);
+		if ( rv < 0 )
+			return rv;
+		if ( rv == 0 ) {
 			state->eof = state->cur.i;
 			return EOF;
 		}
-		state->buf[state->readidx++] = c;
 	}
 
-	if ( state->buf[state->cur.i - 1] == '\n' )
+	if ( state->cur.i > 0 && CHARI(state, &state->cur, -1) == '\n' )
 		state->cur.line++;
-	return state->buf[state->cur.i++];
+	c = CHAR(state, &state->cur);
+	state->cur.i++;
+	return c;
 }
 
 
@@ -83,6 +179,284 @@ static int cpg_match_literal(struct cpg_state *state, int lit, void *aux);
 static int cpg_match_class(struct cpg_state *state, int cls, void *aux);
 
 
+/* stop memoizing the rules being matched:  their logs are incomplete */
+static void cpg_memo_abandon(struct cpg_state *state)
+{
+	uint i;
+
+	for ( i = 0; i < state->memo_nopen; ++i )
+		state->memo_open[i] = CPG_NOPIN;
+}
+
+
+/* invalidate every memo entry and empty the action log */
+static void cpg_memo_flush(struct cpg_state *state)
+{
+	++state->memo_gen;
+	cpg_memo_abandon(state);
+	state->act_base = state->nacts;
+}
+
+
+static int cpg_memo_live(struct cpg_state *state, struct cpg_memo_ent *me)
+{
+	return me->def >= 0 && me->gen == state->memo_gen && me->nact > 0;
+}
+
+
+static void cpg_act_mark(struct cpg_state *state, uint *live, ulong act,
+			 uint nact)
+{
+	struct cpg_act_rec *ar;
+	ulong i;
+
+	for ( i = act - state->act_base; i < act - state->act_base + nact;
+	      ++i ) {
+		if ( live[i] )
+			continue;
+		live[i] = 1;
+		ar = &state->acts[i];
+		if ( ar->pri == CPG_ACT_REF )
+			cpg_act_mark(state, live, ar->off, ar->len);
+	}
+}
+
+
+/*
+ * Reclaim the log records that no live memo entry or rule being matched
+ * can replay.  The open rules' records stay at the same log positions
+ * and the live ones before them move down next to them.  Rules being
+ * matched that hold more than a quarter of the log are abandoned rather
+ * than kept.  Returns -1 if out of memory.
+ */
+static int cpg_act_compact(struct cpg_state *state)
+{
+	struct cpg_act_rec *ar;
+	struct cpg_memo_ent *me;
+	ulong tail = state->nacts;
+	ulong obase = state->act_base;
+	ulong olen, i, j;
+	uint *live;
+
+	for ( i = 0; i < state->memo_nopen; ++i ) {
+		j = state->memo_open[i];
+		if ( j == CPG_NOPIN )
+			continue;
+		if ( state->nacts - j <= state->max_acts / 4 ) {
+			tail = j;
+			break;
+		}
+		state->memo_open[i] = CPG_NOPIN;
+	}
+
+	olen = tail - obase;
+	live = calloc(olen + 1, sizeof(*live));
+	if ( live == NULL )
+		return -1;
+
+	/* an entry or replay is either wholly before 'tail' or after it */
+	for ( i = 0; i <= state->memo_mask; ++i ) {
+		me = &state->memo[i];
+		if ( cpg_memo_live(state, me) && me->act < tail )
+			cpg_act_mark(state, live, me->act, me->nact);
+	}
+	for ( i = olen; i < state->nacts - obase; ++i ) {
+		ar = &state->acts[i];
+		if ( ar->pri == CPG_ACT_REF && ar->off < tail )
+			cpg_act_mark(state, live, ar->off, ar->len);
+	}
+
+	/* 'live' becomes the new offset of each record that's kept */
+	for ( i = 0, j = 0; i < olen; ++i ) {
+		if ( live[i] ) {
+			state->acts[j] = state->acts[i];
+			live[i] = j++;
+		}
+	}
+	memmove(state->acts + j, state->acts + olen,
+		(state->nacts - tail) * sizeof(*state->acts));
+	state->act_base = tail - j;
+
+	for ( i = 0; i <= state->memo_mask; ++i ) {
+		me = &state->memo[i];
+		if ( cpg_memo_live(state, me) && me->act < tail )
+			me->act = state->act_base + live[me->act - obase];
+	}
+	for ( i = 0; i < state->nacts - state->act_base; ++i ) {
+		ar = &state->acts[i];
+		if ( ar->pri == CPG_ACT_REF && ar->off < tail )
+			ar->off = state->act_base + live[ar->off - obase];
+	}
+
+	free(live);
+	return 0;
+}
+
+
+/*
+ * Make room for one more record in the action log:  grow it, else
+ * compact it, else start the memo over.  Returns 0 if there's no room
+ * in which case the rules being matched are no longer memoized.
+ */
+static int cpg_act_room(struct cpg_state *state)
+{
+	struct cpg_act_rec *acts;
+	uint nlen;
+
+	if ( state->nacts - state->act_base < state->acts_len )
+		return 1;
+
+	nlen = state->acts_len * 2;
+	if ( nlen < ACT_INIT_LEN )
+		nlen = ACT_INIT_LEN;
+	if ( nlen > state->max_acts )
+		nlen = state->max_acts;
+	if ( nlen > state->acts_len ) {
+		acts = realloc(state->acts, nlen * sizeof(*acts));
+		if ( acts != NULL ) {
+			state->acts = acts;
+			state->acts_len = nlen;
+			return 1;
+		}
+	}
+
+	if ( state->acts_len == 0 ) {
+		cpg_memo_abandon(state);
+		return 0;
+	}
+	if ( cpg_act_compact(state) < 0 ||
+	     state->nacts - state->act_base > state->acts_len / 2 )
+		cpg_memo_flush(state);
+	return 1;
+}
+
+
+/* record an action or replay for the rules being matched to replay */
+static void cpg_log_action(struct cpg_state *state, int pri, ulong off,
+			   uint len)
+{
+	struct cpg_act_rec *ar;
+
+	ar = &state->acts[state->nacts - state->act_base];
+	ar->pri = pri;
+	ar->off = off;
+	ar->len = len;
+	++state->nacts;
+}
+
+
+static int cpg_call_action(struct cpg_state *state, int pri, ulong off,
+			   uint len, void *aux)
+{
+	struct peg_node *pn = NODE(state->peg, pri);
+	struct raw r;
+
+	abort_unless(off >= state->base);
+	r.data = state->buf + (off - state->base);
+	r.len = len;
+	return (*pn->pn_action_cb)(pri, &r, aux);
+}
+
+
+static int cpg_action(struct cpg_state *state, int pri, ulong off, uint len,
+		      void *aux)
+{
+	if ( state->memo_nopen > 0 && cpg_act_room(state) )
+		cpg_log_action(state, pri, off, len);
+	return cpg_call_action(state, pri, off, len, aux);
+}
+
+
+/* callbacks don't log anything so the log stays put while replaying */
+static int cpg_replay(struct cpg_state *state, ulong act, uint nact,
+		      void *aux)
+{
+	struct cpg_act_rec *ar;
+	ulong i;
+	int rv;
+
+	for ( i = act - state->act_base; i < act - state->act_base + nact;
+	      ++i ) {
+		ar = &state->acts[i];
+		if ( ar->pri == CPG_ACT_REF )
+			rv = cpg_replay(state, ar->off, ar->len, aux);
+		else
+			rv = cpg_call_action(state, ar->pri, ar->off, ar->len,
+					     aux);
+		if ( rv < 0 )
+			return rv;
+	}
+	return 0;
+}
+
+
+static int cpg_match_memo(struct cpg_state *state, int def, void *aux)
+{
+	struct peg_grammar *peg = state->peg;
+	struct cpg_memo_ent *me;
+	ulong pos = state->cur.i;
+	ulong *open;
+	ulong act;
+	uint n;
+	int rv;
+
+	me = &state->memo[MEMO_HASH(def, pos) & state->memo_mask];
+	if ( me->def == def && me->pos == pos && me->gen == state->memo_gen ) {
+		++state->memo_hits;
+		rv = cpg_replay(state, me->act, me->nact, aux);
+		if ( rv < 0 )
+			return rv;
+		/* making room may move or drop the entry's records */
+		if ( me->nact > 0 && state->memo_nopen > 0 &&
+		     cpg_act_room(state) && me->gen == state->memo_gen )
+			cpg_log_action(state, CPG_ACT_REF, me->act, me->nact);
+		if ( me->rv > 0 )
+			state->cur = me->end;
+		return me->rv;
+	}
+
+	++state->memo_misses;
+	n = state->memo_nopen;
+	if ( n == state->memo_open_len ) {
+		open = realloc(state->memo_open, (n + 16) * sizeof(*open));
+		if ( open == NULL )
+			return cpg_match_expression(state,
+						    NODE(peg, def)->pd_expr,
+						    aux);
+		state->memo_open = open;
+		state->memo_open_len = n + 16;
+	}
+	state->memo_open[n] = state->nacts;
+	state->memo_nopen = n + 1;
+	rv = cpg_match_expression(state, NODE(peg, def)->pd_expr, aux);
+	abort_unless(state->memo_nopen == n + 1);
+	state->memo_nopen = n;
+	/* a cut or a full log abandons the rules being matched */
+	act = state->memo_open[n];
+	if ( rv < 0 || act == CPG_NOPIN )
+		return rv;
+
+	me->def = def;
+	me->pos = pos;
+	me->gen = state->memo_gen;
+	me->rv = rv;
+	me->end = state->cur;
+	me->act = act;
+	me->nact = state->nacts - act;
+	return rv;
+}
+
+
+/* backtrack to 'oc':  an error if a cut committed the parse past it */
+static int cpg_rewind(struct cpg_state *state, struct cpg_cursor *oc)
+{
+	if ( oc->i < state->cut )
+		return -1;
+	state->cur = *oc;
+	return 0;
+}
+
+
 static int cpg_match_expression(struct cpg_state *state, int seq, void *aux)
 {
 	struct peg_grammar *peg = state->peg;
@@ -112,7 +486,8 @@ static int cpg_match_sequence(struct cpg_state *state, int seq, void *aux)
 	for ( pri = pn->ps_pri; pri >= 0; pri = NODE(peg, pri)->pn_next ) {
 		rv = cpg_match_primary(state, pri, aux);
 		if ( rv <= 0 ) {
-			state->cur = oc;
+			if ( cpg_rewind(state, &oc) < 0 )
+				return -1;
 			return rv;
 		}
 	}
@@ -125,11 +500,11 @@ static int cpg_match_primary(struct cpg_state *state, int pri, void *aux)
 	struct peg_grammar *peg = state->peg;
 	struct cpg_cursor oc = state->cur;
 	struct peg_node *pn;
+	ulong opin = state->pin;
 	uint nmatch = 0;
 	int repeat;
 	int mtype;
 	int rv = -1;
-	struct raw r;
 	int act_rv;
 
 	abort_unless(NODE_VALID(peg, pri, PEG_PRIMARY));
@@ -140,6 +515,10 @@ static int cpg_match_primary(struct cpg_state *state, int pri, void *aux)
 	abort_unless(NODE_VALID_IDX(peg, pn->pp_match));
 	mtype = NODE(peg, pn->pp_match)->pn_type;
 
+	/* keep the input this action will get even if there's a cut in it */
+	if ( pn->pp_action == PEG_ACT_CALLBACK && oc.i < state->pin )
+		state->pin = oc.i;
+
 	do {
 		switch ( mtype ) {
 		case PEG_SEQUENCE:
@@ -154,6 +533,10 @@ static int cpg_match_primary(struct cpg_state *state, int pri, void *aux)
 		case PEG_CLASS:
 			rv = cpg_match_class(state, pn->pp_match, aux);
 			break;
+		case PEG_CUT:
+			cpg_cut(state);
+			rv = 1;
+			break;
 		default:
 			abort_unless(0);
 		}
@@ -162,7 +545,7 @@ static int cpg_match_primary(struct cpg_state *state, int pri, void *aux)
 	} while ( rv > 0 && repeat );
 
 	if ( rv < 0 )
-		return rv;
+		goto out;
 
 	switch ( pn->pp_suffix ) {
 	case PEG_ATTR_NONE: rv = (nmatch == 1); break;
@@ -174,23 +557,29 @@ static int cpg_match_primary(struct cpg_state *state, int pri, void *aux)
 	}
 
 	if ( pn->pp_prefix != PEG_ATTR_NONE ) {
-		state->cur = oc;
+		if ( cpg_rewind(state, &oc) < 0 ) {
+			rv = -1;
+			goto out;
+		}
 		if ( pn->pp_prefix == PEG_ATTR_NOT )
 			rv = !rv;
 		else
 			abort_unless(pn->pp_prefix == PEG_ATTR_AND);
 	} else if ( rv <= 0 ) {
-		state->cur = oc;
+		if ( cpg_rewind(state, &oc) < 0 ) {
+			rv = -1;
+			goto out;
+		}
 	}
 
 	if ( rv > 0 && pn->pp_action == PEG_ACT_CALLBACK ) {
-		r.data = state->buf + oc.i;
-		r.len = state->cur.i - oc.i;
-		act_rv = (*pn->pn_action_cb)(pri, &r, aux);
+		act_rv = cpg_action(state, pri, oc.i, state->cur.i - oc.i, aux);
 		if ( act_rv < 0 )
-			return act_rv;
+			rv = act_rv;
 	}
 
+out:
+	state->pin = opin;
 	return rv;
 }
 
@@ -210,7 +599,7 @@ static int cpg_match_identifier(struct cpg_state *state, int id, void *aux)
 	struct peg_node *pn = NODE(state->peg, id);
 	if ( state->debug ) {
 		pad(state);
-		fprintf(stderr, ">:'%s' at <L:%d/P:%d>\n",
+		fprintf(stderr, ">:'%s' at <L:%d/P:%lu>\n",
 			pn->pn_str.data, state->cur.line, state->cur.i);
 	}
 	++state->depth;
@@ -218,22 +607,25 @@ static int cpg_match_identifier(struct cpg_state *state, int id, void *aux)
 		rv = cpg_match_token(state, id, aux);
 	} else {
 		abort_unless(NODE_VALID(peg, pn->pi_def, PEG_DEFINITION));
-		rv = cpg_match_expression(state, NODE(peg, pn->pi_def)->pd_expr,
-					  aux);
+		if ( state->memo != NULL && state->memo_rules[pn->pi_def] )
+			rv = cpg_match_memo(state, pn->pi_def, aux);
+		else
+			rv = cpg_match_expression(state,
+					NODE(peg, pn->pi_def)->pd_expr, aux);
 	}
 	--state->depth;
 	if ( state->debug ) {
 		if ( rv < 0 ) {
 			pad(state);
-			fprintf(stderr, "E:'%s' at <L:%d/P:%d>\n",
+			fprintf(stderr, "E:'%s' at <L:%d/P:%lu>\n",
 				pn->pn_str.data, state->cur.line, state->cur.i);
 		} else if ( rv == 0 ) {
 			pad(state);
-			fprintf(stderr, "F:'%s' at <L:%d/P:%d>\n",
+			fprintf(stderr, "F:'%s' at <L:%d/P:%lu>\n",
 				pn->pn_str.data, state->cur.line, state->cur.i);
 		} else {
 			pad(state);
-			fprintf(stderr, "S:'%s' at <L:%d/P:%d>\n",
+			fprintf(stderr, "S:'%s' at <L:%d/P:%lu>\n",
 				pn->pn_str.data, state->cur.line, state->cur.i);
 		}
 	}
@@ -252,7 +644,7 @@ static int cpg_match_token(struct cpg_state *state, int id, void *aux)
 
 	if ( state->debug ) {
 		pad(state);
-		fprintf(stderr, "T>:'%d' at <L:%d/P:%d>\n",
+		fprintf(stderr, "T>:'%d' at <L:%d/P:%lu>\n",
 			id, state->cur.line, state->cur.i);
 	}
 
@@ -260,7 +652,7 @@ static int cpg_match_token(struct cpg_state *state, int id, void *aux)
 	if ( c != EOF &&  c == PEG_TOKEN_ID(NODE(peg, id)->pi_def) ) {
 		if ( state->debug ) {
 			pad(state);
-			fprintf(stderr, "TS:'%d' at <L:%d/P:%d>\n",
+			fprintf(stderr, "TS:'%d' at <L:%d/P:%lu>\n",
 				id, state->cur.line, state->cur.i);
 		}
 		return 1;
@@ -268,7 +660,7 @@ static int cpg_match_token(struct cpg_state *state, int id, void *aux)
 		state->cur = oc;
 		if ( state->debug ) {
 			pad(state);
-			fprintf(stderr, "TF:'%d' at <L:%d/P:%d>\n",
+			fprintf(stderr, "TF:'%d' at <L:%d/P:%lu>\n",
 				id, state->cur.line, state->cur.i);
 		}
 		return 0;
@@ -286,7 +678,7 @@ static int cpg_match_literal(struct cpg_state *state, int lit, void *aux)
 
 	if ( state->debug ) {
 		pad(state);
-		fprintf(stderr, "L>:'%s' at <L:%d/P:%d>\n",
+		fprintf(stderr, "L>:'%s' at <L:%d/P:%lu>\n",
 			pn->pn_str.data, state->cur.line, state->cur.i);
 	}
 
@@ -298,7 +690,7 @@ static int cpg_match_literal(struct cpg_state *state, int lit, void *aux)
 
 	if ( state->debug ) {
 		pad(state);
-		fprintf(stderr, "LS:'%s' at <L:%d/P:%d>\n",
+		fprintf(stderr, "LS:'%s' at <L:%d/P:%lu>\n",
 			pn->pn_str.data, state->cur.line, state->cur.i);
 	}
 
@@ -307,7 +699,7 @@ static int cpg_match_literal(struct cpg_state *state, int lit, void *aux)
 fail:
 	if ( state->debug ) {
 		pad(state);
-		fprintf(stderr, "LF:'%s' at <L:%d/P:%d>\n",
+		fprintf(stderr, "LF:'%s' at <L:%d/P:%lu>\n",
 			pn->pn_str.data, state->cur.line, state->cur.i);
 	}
 	state->cur = oc;
@@ -326,7 +718,7 @@ static int cpg_match_class(struct cpg_state *state, int cls, void *aux)
 
 	if ( state->debug ) {
 		pad(state);
-		fprintf(stderr, "C>:'%d' at <L:%d/P:%d>\n",
+		fprintf(stderr, "C>:'%d' at <L:%d/P:%lu>\n",
 			cls, state->cur.line, state->cur.i);
 	}
 
@@ -334,7 +726,7 @@ static int cpg_match_class(struct cpg_state *state, int cls, void *aux)
 	if ( c != EOF && cset_contains(NODE(peg, cls)->pc_cset, c) ) {
 		if ( state->debug ) {
 			pad(state);
-			fprintf(stderr, "CS:'%d' at <L:%d/P:%d>\n",
+			fprintf(stderr, "CS:'%d' at <L:%d/P:%lu>\n",
 				cls, state->cur.line, state->cur.i);
 		}
 		return 1;
@@ -342,7 +734,7 @@ static int cpg_match_class(struct cpg_state *state, int cls, void *aux)
 		state->cur = oc;
 		if ( state->debug ) {
 			pad(state);
-			fprintf(stderr, "CF:'%d' at <L:%d/P:%d>\n",
+			fprintf(stderr, "CF:'%d' at <L:%d/P:%lu>\n",
 				cls, state->cur.line, state->cur.i);
 		}
 		return 0;
@@ -367,19 +759,194 @@ int cpg_parse(struct cpg_state *state, void *in, void *aux)
 }
 
 
+int cpg_parse_mem(struct cpg_state *state, const void *data, size_t len,
+		  void *aux)
+{
+	uchar *obuf;
+	int rv;
+
+	abort_unless(state != NULL);
+	abort_unless(data != NULL || len == 0);
+
+	cpg_reset(state);
+	obuf = state->buf;
+	state->buf = (uchar *)data;
+	state->readidx = len;
+	state->eof = len;
+
+	rv = cpg_parse(state, NULL, aux);
+
+	/*
+	 * Go on reading input at the cursor as if cut there:  the buffer
+	 * keeps the character before it for the line count.
+	 */
+	state->buf = obuf;
+	state->eof = (ulong)-1;
+	state->readidx = state->cur.i;
+	state->base = state->cur.i;
+	if ( state->cur.i > 0 ) {
+		state->buf[0] = ((const uchar *)data)[state->cur.i - 1];
+		state->base -= 1;
+	}
+	cpg_cut(state);
+	return rv;
+}
+
+
+#if CAT_HAS_POSIX
+
+int cpg_parse_file(struct cpg_state *state, const char *path, void *aux)
+{
+	struct stat sb;
+	void *p;
+	int fd;
+	int rv;
+
+	abort_unless(path != NULL);
+
+	if ( (fd = open(path, O_RDONLY)) < 0 )
+		return -1;
+	if ( fstat(fd, &sb) < 0 || (off_t)(size_t)sb.st_size != sb.st_size ) {
+		close(fd);
+		return -1;
+	}
+	if ( sb.st_size == 0 ) {
+		close(fd);
+		return cpg_parse_mem(state, "", 0, aux);
+	}
+	p = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if ( p == MAP_FAILED )
+		return -1;
+	rv = cpg_parse_mem(state, p, sb.st_size, aux);
+	munmap(p, sb.st_size);
+	return rv;
+}
+
+#endif /* CAT_HAS_POSIX */
+
+
+void cpg_cut(struct cpg_state *state)
+{
+	abort_unless(state->cur.i >= state->cut);
+	state->cut = state->cur.i;
+	/* nothing can look up memo entries before the cut:  reuse the log */
+	if ( state->memo != NULL )
+		cpg_memo_flush(state);
+}
+
+
 void cpg_reset(struct cpg_state *state)
 {
-	if ( state->buf != NULL )
-		memset(state->buf, '\0', state->buflen);
-	state->cur.i = 1;
+	uint i;
+
+	state->cur.i = 0;
 	state->cur.line = 1;
-	state->readidx = 1;
-	state->eof = (uint)-1;
+	state->base = 0;
+	state->readidx = 0;
+	state->eof = (ulong)-1;
+	state->cut = 0;
+	state->pin = CPG_NOPIN;
+	state->memo_gen = 0;
+	if ( state->memo != NULL )
+		for ( i = 0; i <= state->memo_mask; ++i )
+			state->memo[i].def = -1;
+	state->act_base = 0;
+	state->nacts = 0;
+	state->memo_nopen = 0;
+	state->memo_hits = 0;
+	state->memo_misses = 0;
+}
+
+
+static void cpg_memo_free(struct cpg_state *state)
+{
+	free(state->memo);
+	free(state->memo_rules);
+	free(state->acts);
+	free(state->memo_open);
+	state->memo = NULL;
+	state->memo_mask = 0;
+	state->memo_rules = NULL;
+	state->acts = NULL;
+	state->act_base = 0;
+	state->nacts = 0;
+	state->acts_len = 0;
+	state->max_acts = 0;
+	state->memo_open = NULL;
+	state->memo_nopen = 0;
+	state->memo_open_len = 0;
+}
+
+
+int cpg_memo_init(struct cpg_state *state, size_t budget)
+{
+	struct peg_grammar *peg;
+	size_t nents = MEMO_MIN_ENTS;
+	uint i;
+
+	abort_unless(state != NULL && state->peg != NULL);
+	peg = state->peg;
+
+	cpg_memo_free(state);
+	if ( budget == 0 )
+		return 0;
+
+	while ( nents * 2 * sizeof(struct cpg_memo_ent) <= budget / 2 &&
+		nents * 2 <= (uint)~0 / 2 + 1 )
+		nents *= 2;
+	state->memo = malloc(nents * sizeof(struct cpg_memo_ent));
+	state->memo_rules = malloc(peg->max_nodes);
+	if ( state->memo == NULL || state->memo_rules == NULL ) {
+		cpg_memo_free(state);
+		return -1;
+	}
+	state->memo_mask = nents - 1;
+	for ( i = 0; i < nents; ++i )
+		state->memo[i].def = -1;
+	for ( i = 0; i < peg->max_nodes; ++i )
+		state->memo_rules[i] = pn_is_type(peg, i, PEG_DEFINITION);
+
+	if ( budget < nents * sizeof(struct cpg_memo_ent) )
+		budget = 0;
+	else
+		budget -= nents * sizeof(struct cpg_memo_ent);
+	if ( budget / sizeof(struct cpg_act_rec) > (uint)~0 )
+		state->max_acts = (uint)~0;
+	else
+		state->max_acts = budget / sizeof(struct cpg_act_rec);
+	return 0;
+}
+
+
+int cpg_memo_rule(struct cpg_state *state, const char *rule, int enable)
+{
+	struct peg_grammar *peg;
+	struct peg_node *pn;
+	uint i;
+
+	abort_unless(state != NULL && state->peg != NULL);
+	abort_unless(rule != NULL);
+	peg = state->peg;
+	if ( state->memo_rules == NULL )
+		return 0;
+
+	for ( i = 0; i < peg->max_nodes; ++i ) {
+		if ( !pn_is_type(peg, i, PEG_DEFINITION) )
+			continue;
+		pn = NODE(peg, NODE(peg, i)->pd_id);
+		if ( strcmp(rule, pn->pi_name.data) == 0 ) {
+			state->memo_rules[i] = (enable != 0);
+			return 1;
+		}
+	}
+	return 0;
 }
 
 
 void cpg_fini(struct cpg_state *state)
 {
+	cpg_memo_free(state);
 	free(state->buf);
 	state->buf = NULL;
 	state->buflen = 0;
@@ -387,6 +954,7 @@ void cpg_fini(struct cpg_state *state)
 	state->readidx = 0;
 	state->peg = NULL;
 	state->getc = NULL;
+	state->read = NULL;
 	state->eof = 0;
 	state->debug = 0;
 }
@@ -8,6 +8,24 @@
  */
 
 #include <cat/crc.h>
+#include <string.h>
+
+/*
+ * On x86-64 with GCC, crc32t_le() can use the SSE4.2 crc32 instruction
+ * for CRC32C and PCLMULQDQ folding for any little-endian polynomial.
+ * The init functions check for the instructions with cpuid so the
+ * library still runs on CPUs without them.
+ */
+#ifndef CAT_CRC_HWACCEL
+#if defined(__GNUC__) && defined(__x86_64__) && !CAT_ANSI89
+#define CAT_CRC_HWACCEL	1
+#else
+#define CAT_CRC_HWACCEL	0
+#endif
+#endif /* CAT_CRC_HWACCEL */
+
+/* use folding instead of the crc32 instruction from this size up */
+#define CLMUL_MIN	256
 
 
 static byte_t rev8(byte_t x)
@@ -26,10 +44,162 @@ static ulong rev32(ulong x)
 	x = ((x >> 4) & 0x0F0F0F0F) | ((x << 4) & 0xF0F0F0F0);
 	x = ((x >> 2) & 0x33333333) | ((x << 2) & 0xCCCCCCCC);
 	x = ((x >> 1) & 0x55555555) | ((x << 1) & 0xAAAAAAAA);
-	return x;
+	return x & 0xFFFFFFFF;
+}
+
+
+/* multiply two polynomials mod 'poly' in big-endian bit order */
+static ulong mulmod_be(ulong a, ulong b, ulong poly)
+{
+	ulong p = 0;
+	int i;
+
+	for ( i = 0; i < 32; ++i ) {
+		if ( (a >> i) & 1 )
+			p ^= b;
+		b = ((b >> 31) & 1) ? ((b << 1) ^ poly) : (b << 1);
+		b &= 0xFFFFFFFF;
+	}
+	return p;
 }
 
 
+/* multiply two polynomials mod 'rpoly' in little-endian bit order */
+static ulong mulmod_le(ulong a, ulong b, ulong rpoly)
+{
+	ulong p = 0;
+	int i;
+
+	for ( i = 31; i >= 0; --i ) {
+		if ( (a >> i) & 1 )
+			p ^= b;
+		b = (b & 1) ? ((b >> 1) ^ rpoly) : (b >> 1);
+	}
+	return p;
+}
+
+
+/* x^(8 * len) mod poly in the bit order of 'mulmod' */
+static ulong xpow8(size_t len, ulong one, ulong x8,
+		   ulong (*mulmod)(ulong, ulong, ulong), ulong poly)
+{
+	ulong p = one, sq = x8;
+
+	for ( ; len > 0 ; len >>= 1 ) {
+		if ( len & 1 )
+			p = (*mulmod)(p, sq, poly);
+		sq = (*mulmod)(sq, sq, poly);
+	}
+	return p;
+}
+
+
+/* in little-endian bit order 1 is 0x80000000 and x^8 is 0x00800000 */
+static ulong xpow8_le(size_t len, ulong rpoly)
+{
+	return xpow8(len, 0x80000000, 0x00800000, mulmod_le, rpoly);
+}
+
+
+#if CAT_CRC_HWACCEL
+
+typedef long long crc_v2di __attribute__((vector_size(16)));
+
+static int crc_cpu_features(void)
+{
+	uint32_t eax = 1, ebx, ecx = 0, edx;
+	int hw = 0;
+
+	__asm__ __volatile__("cpuid"
+			     : "+a"(eax), "=b"(ebx), "+c"(ecx), "=d"(edx));
+	if ( (ecx >> 20) & 1 )
+		hw |= CRC32T_HW_CRC32C;
+	if ( (ecx >> 1) & 1 )
+		hw |= CRC32T_HW_CLMUL;
+	return hw;
+}
+
+
+__attribute__((target("sse4.2")))
+static ulong crc32c_hw(const byte_t *p, size_t size, ulong crc)
+{
+	ulong w;
+
+	for ( ; size > 0 && ((ulong)p & 7) != 0 ; --size, ++p )
+		crc = __builtin_ia32_crc32qi(crc, *p);
+	for ( ; size >= 8 ; size -= 8, p += 8 ) {
+		memcpy(&w, p, sizeof(w));
+		crc = __builtin_ia32_crc32di(crc, w);
+	}
+	for ( ; size > 0 ; --size, ++p )
+		crc = __builtin_ia32_crc32qi(crc, *p);
+	return crc;
+}
+
+
+/*
+ * Fold 64 bytes at a time in 4 independent 128-bit lanes, then fold the
+ * lanes and any remaining 16-byte blocks into one 128-bit remainder.
+ * The remainder has the same CRC (starting from 0) as all the bytes it
+ * replaces, so the table code finishes it and the tail.  Constants for
+ * folding across 'd' bits are x^(d+32) and x^(d-32) mod P, bit reversed
+ * and shifted left by one.  Requires size >= 64.
+ */
+__attribute__((target("pclmul,sse2")))
+static void crc32_clmul(const struct crc32tab *t, const byte_t *p,
+			size_t *size, ulong crc, byte_t *rem)
+{
+	crc_v2di x0, x1, x2, x3, d0, d1, d2, d3, k;
+	size_t n = *size;
+
+	memcpy(&x0, p, 16);
+	memcpy(&x1, p + 16, 16);
+	memcpy(&x2, p + 32, 16);
+	memcpy(&x3, p + 48, 16);
+	x0 ^= (crc_v2di){ (long long)crc, 0 };
+	p += 64;
+	n -= 64;
+
+	k = (crc_v2di){ (long long)t->fold[0], (long long)t->fold[1] };
+	while ( n >= 64 ) {
+		memcpy(&d0, p, 16);
+		memcpy(&d1, p + 16, 16);
+		memcpy(&d2, p + 32, 16);
+		memcpy(&d3, p + 48, 16);
+		x0 = __builtin_ia32_pclmulqdq128(x0, k, 0x00) ^
+		     __builtin_ia32_pclmulqdq128(x0, k, 0x11) ^ d0;
+		x1 = __builtin_ia32_pclmulqdq128(x1, k, 0x00) ^
+		     __builtin_ia32_pclmulqdq128(x1, k, 0x11) ^ d1;
+		x2 = __builtin_ia32_pclmulqdq128(x2, k, 0x00) ^
+		     __builtin_ia32_pclmulqdq128(x2, k, 0x11) ^ d2;
+		x3 = __builtin_ia32_pclmulqdq128(x3, k, 0x00) ^
+		     __builtin_ia32_pclmulqdq128(x3, k, 0x11) ^ d3;
+		p += 64;
+		n -= 64;
+	}
+
+	k = (crc_v2di){ (long long)t->fold[2], (long long)t->fold[3] };
+	x0 = __builtin_ia32_pclmulqdq128(x0, k, 0x00) ^
+	     __builtin_ia32_pclmulqdq128(x0, k, 0x11) ^ x1;
+	x0 = __builtin_ia32_pclmulqdq128(x0, k, 0x00) ^
+	     __builtin_ia32_pclmulqdq128(x0, k, 0x11) ^ x2;
+	x0 = __builtin_ia32_pclmulqdq128(x0, k, 0x00) ^
+	     __builtin_ia32_pclmulqdq128(x0, k, 0x11) ^ x3;
+	while ( n >= 16 ) {
+		memcpy(&d0, p, 16);
+		x0 = __builtin_ia32_pclmulqdq128(x0, k, 0x00) ^
+		     __builtin_ia32_pclmulqdq128(x0, k, 0x11) ^ d0;
+		p += 16;
+		n -= 16;
+	}
+
+	memcpy(rem, &x0, 16);
+	*size = n;
+}
+
+#endif /* CAT_CRC_HWACCEL */
+
+
 void crc32t_be_init(struct crc32tab *tab, ulong poly)
 {
 	int i, j;
@@ -42,18 +212,43 @@ void crc32t_be_init(struct crc32tab *tab, ulong poly)
 			else
 				r = (r << 1);
 		}
-		tab->resid[i] = r & 0xFFFFFFFF;
+		tab->resid[0][i] = r & 0xFFFFFFFF;
 	}
+	for ( i = 0; i < 256; ++i ) {
+		for ( j = 1; j < 8; ++j ) {
+			r = tab->resid[j - 1][i];
+			tab->resid[j][i] = (r << 8) ^ tab->resid[0][r >> 24];
+		}
+	}
+	tab->poly = poly & 0xFFFFFFFF;
+	tab->hwaccel = 0;
+	memset(tab->fold, 0, sizeof(tab->fold));
 }
 
 
 ulong crc32t_be(const struct crc32tab *tab, const void *voidp, size_t size,
 	        ulong crc)
 {
-	const byte_t *p;
-	for ( p = voidp ; size > 0 ; --size, ++p )
-		crc = tab->resid[(*p ^ (crc >> 24)) & 0xFF] ^ (crc << 8);
-	return crc & 0xFFFFFFFF;
+	const byte_t *p = voidp;
+	uint32_t c = crc, hi, lo;
+
+	for ( ; size >= 8 ; size -= 8, p += 8 ) {
+		hi = c ^ (((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+			  ((uint32_t)p[2] << 8) | p[3]);
+		lo = ((uint32_t)p[4] << 24) | ((uint32_t)p[5] << 16) |
+		     ((uint32_t)p[6] << 8) | p[7];
+		c = tab->resid[7][hi >> 24] ^
+		    tab->resid[6][(hi >> 16) & 0xFF] ^
+		    tab->resid[5][(hi >> 8) & 0xFF] ^
+		    tab->resid[4][hi & 0xFF] ^
+		    tab->resid[3][lo >> 24] ^
+		    tab->resid[2][(lo >> 16) & 0xFF] ^
+		    tab->resid[1][(lo >> 8) & 0xFF] ^
+		    tab->resid[0][lo & 0xFF];
+	}
+	for ( ; size > 0 ; --size, ++p )
+		c = tab->resid[0][(*p ^ (c >> 24)) & 0xFF] ^ (c << 8);
+	return c & 0xFFFFFFFF;
 }
 
 
@@ -61,6 +256,9 @@ void crc32t_le_init(struct crc32tab *tab, ulong poly)
 {
 	int i, j;
 	ulong r;
+#if CAT_CRC_HWACCEL
+	ulong rpoly;
+#endif /* CAT_CRC_HWACCEL */
 	for ( i = 0; i < 256; ++i ) {
 		r = rev8(i) << 24;
 		for ( j = 0; j < 8; ++j ) {
@@ -69,18 +267,92 @@ void crc32t_le_init(struct crc32tab *tab, ulong poly)
 			else
 				r = (r << 1);
 		}
-		tab->resid[i] = rev32(r & 0xFFFFFFFF);
+		tab->resid[0][i] = rev32(r & 0xFFFFFFFF);
+	}
+	for ( i = 0; i < 256; ++i ) {
+		for ( j = 1; j < 8; ++j ) {
+			r = tab->resid[j - 1][i];
+			tab->resid[j][i] = (r >> 8) ^ tab->resid[0][r & 0xFF];
+		}
+	}
+	tab->poly = poly & 0xFFFFFFFF;
+	tab->hwaccel = 0;
+	memset(tab->fold, 0, sizeof(tab->fold));
+
+#if CAT_CRC_HWACCEL
+	tab->hwaccel = crc_cpu_features();
+	if ( tab->poly != CAT_CRC32C_POLY )
+		tab->hwaccel &= ~CRC32T_HW_CRC32C;
+	/* x^544, x^480, x^160 and x^96:  see crc32_clmul() */
+	rpoly = rev32(tab->poly);
+	tab->fold[0] = xpow8_le(68, rpoly) << 1;
+	tab->fold[1] = xpow8_le(60, rpoly) << 1;
+	tab->fold[2] = xpow8_le(20, rpoly) << 1;
+	tab->fold[3] = xpow8_le(12, rpoly) << 1;
+#endif /* CAT_CRC_HWACCEL */
+}
+
+
+static uint32_t crc32t_le_sw(const struct crc32tab *tab, const byte_t *p,
+			     size_t size, uint32_t c)
+{
+	uint32_t lo, hi;
+
+	for ( ; size >= 8 ; size -= 8, p += 8 ) {
+		lo = c ^ (p[0] | ((uint32_t)p[1] << 8) |
+			  ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+		hi = p[4] | ((uint32_t)p[5] << 8) | ((uint32_t)p[6] << 16) |
+		     ((uint32_t)p[7] << 24);
+		c = tab->resid[7][lo & 0xFF] ^
+		    tab->resid[6][(lo >> 8) & 0xFF] ^
+		    tab->resid[5][(lo >> 16) & 0xFF] ^
+		    tab->resid[4][lo >> 24] ^
+		    tab->resid[3][hi & 0xFF] ^
+		    tab->resid[2][(hi >> 8) & 0xFF] ^
+		    tab->resid[1][(hi >> 16) & 0xFF] ^
+		    tab->resid[0][hi >> 24];
 	}
+	for ( ; size > 0 ; --size, ++p )
+		c = tab->resid[0][(*p ^ c) & 0xFF] ^ (c >> 8);
+	return c;
 }
 
 
 ulong crc32t_le(const struct crc32tab *tab, const void *voidp, size_t size,
 	        ulong crc)
 {
-	const byte_t *p;
-	for ( p = voidp ; size > 0 ; --size, ++p )
-		crc = tab->resid[(*p ^ crc) & 0xFF] ^ (crc >> 8);
-	return crc;
+	const byte_t *p = voidp;
+#if CAT_CRC_HWACCEL
+	byte_t rem[16];
+	size_t n;
+
+	if ( (tab->hwaccel & CRC32T_HW_CLMUL) && size >= CLMUL_MIN ) {
+		n = size;
+		crc32_clmul(tab, p, &n, crc, rem);
+		crc = crc32t_le_sw(tab, rem, sizeof(rem), 0);
+		p += size - n;
+		size = n;
+	}
+	if ( tab->hwaccel & CRC32T_HW_CRC32C )
+		return crc32c_hw(p, size, crc);
+#endif /* CAT_CRC_HWACCEL */
+	return crc32t_le_sw(tab, p, size, crc);
+}
+
+
+ulong crc32t_be_combine(const struct crc32tab *t, ulong crc1, ulong crc2,
+			size_t len2)
+{
+	return mulmod_be(crc1, xpow8(len2, 1, 0x100, mulmod_be, t->poly),
+			 t->poly) ^ crc2;
+}
+
+
+ulong crc32t_le_combine(const struct crc32tab *t, ulong crc1, ulong crc2,
+			size_t len2)
+{
+	ulong rpoly = rev32(t->poly);
+	return mulmod_le(crc1, xpow8_le(len2, rpoly), rpoly) ^ crc2;
 }
 
 
@@ -111,3 +383,10 @@ ulong crc32_finish(ulong crc)
 {
 	return crc ^ 0xFFFFFFFF;
 }
+
+ulong crc32_combine(ulong crc1, ulong crc2, size_t len2)
+{
+	if (!_crc32_table_initialized)
+		crc32_init();
+	return crc32t_le_combine(&_crc32_table, crc1, crc2, len2);
+}
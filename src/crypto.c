@@ -11,6 +11,24 @@
 
 #include <string.h>
 
+/*
+ * SHA-256.  On x86-64 with GCC the block function can use the SHA
+ * extensions and sha256_multi() can hash 8 messages at a time in AVX2
+ * lanes.  cpuid decides which paths are usable the first time they're
+ * needed and the result lands in sha256_hwaccel.
+ */
+#ifndef CAT_SHA_HWACCEL
+#if defined(__GNUC__) && defined(__x86_64__) && !CAT_ANSI89 && CAT_USE_STDLIB
+#define CAT_SHA_HWACCEL	1
+#else
+#define CAT_SHA_HWACCEL	0
+#endif
+#endif /* CAT_SHA_HWACCEL */
+
+#if CAT_SHA_HWACCEL
+#include <immintrin.h>
+#endif /* CAT_SHA_HWACCEL */
+
 void arc4_init(struct arc4ctx *arc4, const void *key, ulong len)
 {
 	int i, j;
@@ -85,8 +103,9 @@ void arc4_encrypt(struct arc4ctx *arc4, const void *in, void *out, ulong len)
 }
 
 
+int sha256_hwaccel = -1;
 
-static ulong sha256_k[64] = { 
+static const uint32_t sha256_k[64] = { 
 	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
 	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
 	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
@@ -105,72 +124,167 @@ static ulong sha256_k[64] = {
 	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
 };
 
-
-static ulong ror(ulong x, uint amt) {
-	return ((x >> amt) | (x << (32 - amt))) & 0xFFFFFFFF;
-}
+static const uint32_t sha256_h0[8] = {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+	0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
 
 
-static ulong Ch(ulong x, ulong y, ulong z) {
-	return (x & y) ^ (~x & z);
-}
+#define ROR32(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+#define CH(x, y, z)	(((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z)	(((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define SIGMA0(x)	(ROR32(x, 2) ^ ROR32(x, 13) ^ ROR32(x, 22))
+#define SIGMA1(x)	(ROR32(x, 6) ^ ROR32(x, 11) ^ ROR32(x, 25))
+#define SSIG0(x)	(ROR32(x, 7) ^ ROR32(x, 18) ^ ((x) >> 3))
+#define SSIG1(x)	(ROR32(x, 17) ^ ROR32(x, 19) ^ ((x) >> 10))
+#define BE32(p)		(((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) |\
+			 ((uint32_t)(p)[2] << 8) | (uint32_t)(p)[3])
 
 
-static ulong Maj(ulong x, ulong y, ulong z) {
-	return (x & y) ^ (x & z) ^ (y & z);
-}
+static void sha256_blocks_sw(uint32_t h[8], const byte_t *p, ulong nblocks)
+{
+	uint32_t w[64];
+	uint32_t a, b, c, d, e, f, g, hh, t1, t2;
+	int i;
 
+	for ( ; nblocks > 0 ; --nblocks, p += 64 ) {
+		for ( i = 0; i < 16; ++i )
+			w[i] = BE32(p + 4 * i);
+		for ( i = 16; i < 64; ++i )
+			w[i] = SSIG1(w[i-2]) + w[i-7] + SSIG0(w[i-15]) +
+			       w[i-16];
+
+		a = h[0];
+		b = h[1];
+		c = h[2];
+		d = h[3];
+		e = h[4];
+		f = h[5];
+		g = h[6];
+		hh = h[7];
+
+		for ( i = 0; i < 64; ++i ) {
+			t1 = hh + SIGMA1(e) + CH(e, f, g) + sha256_k[i] + w[i];
+			t2 = SIGMA0(a) + MAJ(a, b, c);
+			hh = g;
+			g = f;
+			f = e;
+			e = d + t1;
+			d = c;
+			c = b;
+			b = a;
+			a = t1 + t2;
+		}
 
-static ulong Sigma0(ulong x) {
-	return ror(x, 2) ^ ror(x, 13) ^ ror(x, 22);
+		h[0] += a;
+		h[1] += b;
+		h[2] += c;
+		h[3] += d;
+		h[4] += e;
+		h[5] += f;
+		h[6] += g;
+		h[7] += hh;
+	}
 }
 
 
-static ulong Sigma1(ulong x) {
-	return ror(x, 6) ^ ror(x, 11) ^ ror(x, 25);
-}
-
+#if CAT_SHA_HWACCEL
 
-static ulong sigma0(ulong x) {
-	return ror(x, 7) ^ ror(x, 18) ^ ((x >> 3) & 0xFFFFFFFF);
+static int sha256_probe(void)
+{
+	uint32_t eax, ebx, ecx, edx, xcr0;
+	int hw = 0;
+
+	eax = 1;
+	ecx = 0;
+	__asm__ __volatile__("cpuid"
+			     : "+a"(eax), "=b"(ebx), "+c"(ecx), "=d"(edx));
+	/* SSSE3 and SSE4.1 for the shuffles around the SHA instructions */
+	if ( ((ecx >> 9) & 1) == 0 || ((ecx >> 19) & 1) == 0 )
+		return 0;
+	/* AVX registers must be enabled by the OS (OSXSAVE + XCR0) */
+	if ( (ecx >> 27) & 1 ) {
+		__asm__ __volatile__("xgetbv" : "=a"(xcr0), "=d"(edx) : "c"(0));
+		if ( (xcr0 & 6) == 6 && ((ecx >> 28) & 1) )
+			hw |= SHA256_HW_AVX2;
+	}
+	eax = 7;
+	ecx = 0;
+	__asm__ __volatile__("cpuid"
+			     : "+a"(eax), "=b"(ebx), "+c"(ecx), "=d"(edx));
+	if ( ((ebx >> 5) & 1) == 0 )
+		hw &= ~SHA256_HW_AVX2;
+	if ( (ebx >> 29) & 1 )
+		hw |= SHA256_HW_SHANI;
+	return hw;
 }
 
 
-static ulong sigma1(ulong x) {
-	return ror(x, 17) ^ ror(x, 19) ^ ((x >> 10) & 0xFFFFFFFF);
-}
-
+#define SHANI_ROUNDS(_w, _g)						\
+	do {								\
+		msg = _mm_add_epi32((_w),				\
+			_mm_loadu_si128((const __m128i *)&sha256_k[4 * (_g)]));\
+		cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);		\
+		msg = _mm_shuffle_epi32(msg, 0x0E);			\
+		abef = _mm_sha256rnds2_epu32(abef, cdgh, msg);		\
+	} while (0)
 
-static int sha256_add_bytes(struct sha256ctx *s, byte_t **pp, ulong *len)
+__attribute__((target("sha,sse4.1,ssse3")))
+static void sha256_blocks_ni(uint32_t h[8], const byte_t *p, ulong nblocks)
 {
-	int idx = s->llo & 63;
-	int toadd = 64 - idx;
-	int i;
-	byte_t *p = *pp;
-	ulong olo;
-
-	if ( toadd > *len )
-		toadd = *len;
-
-	for ( i = 0; i < toadd; ++i ) {
-		switch ( idx & 3 ) {
-		case 0: s->w[idx / 4] = ((ulong)*p++ << 24);	break;
-		case 1: s->w[idx / 4] |= ((ulong)*p++ << 16);	break;
-		case 2: s->w[idx / 4] |= ((ulong)*p++ << 8);	break;
-		case 3: s->w[idx / 4] |= (ulong)*p++;	 	break;
+	__m128i abef, cdgh, abef0, cdgh0, tmp, msg, w[4];
+	const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+					     0x0405060700010203ULL);
+	int g;
+
+	/* the instructions want the state as ABEF and CDGH */
+	tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&h[0]), 0xB1);
+	cdgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&h[4]), 0x1B);
+	abef = _mm_alignr_epi8(tmp, cdgh, 8);
+	cdgh = _mm_blend_epi16(cdgh, tmp, 0xF0);
+
+	for ( ; nblocks > 0 ; --nblocks, p += 64 ) {
+		abef0 = abef;
+		cdgh0 = cdgh;
+		for ( g = 0; g < 4; ++g ) {
+			w[g] = _mm_shuffle_epi8(_mm_loadu_si128(
+					(const __m128i *)(p + 16 * g)), bswap);
+			SHANI_ROUNDS(w[g], g);
 		}
-		++idx;
+		/* w[g % 4] holds schedule words 4g-16 .. 4g-13 */
+		for ( g = 4; g < 16; ++g ) {
+			tmp = _mm_sha256msg1_epu32(w[g % 4], w[(g + 1) % 4]);
+			tmp = _mm_add_epi32(tmp, _mm_alignr_epi8(w[(g + 3) % 4],
+							w[(g + 2) % 4], 4));
+			w[g % 4] = _mm_sha256msg2_epu32(tmp, w[(g + 3) % 4]);
+			SHANI_ROUNDS(w[g % 4], g);
+		}
+		abef = _mm_add_epi32(abef, abef0);
+		cdgh = _mm_add_epi32(cdgh, cdgh0);
 	}
 
-	*pp = p;
-	*len -= toadd;
+	tmp = _mm_shuffle_epi32(abef, 0x1B);
+	cdgh = _mm_shuffle_epi32(cdgh, 0xB1);
+	_mm_storeu_si128((__m128i *)&h[0], _mm_blend_epi16(tmp, cdgh, 0xF0));
+	_mm_storeu_si128((__m128i *)&h[4], _mm_alignr_epi8(cdgh, tmp, 8));
+}
 
-	olo = s->llo;
-	s->llo = (olo + toadd) & 0xFFFFFFFF;
-	if ( s->llo < olo )
-		s->lhi++;
+#undef SHANI_ROUNDS
 
-	return (idx == 64);
+#endif /* CAT_SHA_HWACCEL */
+
+
+static void sha256_blocks(uint32_t h[8], const byte_t *p, ulong nblocks)
+{
+#if CAT_SHA_HWACCEL
+	if ( sha256_hwaccel < 0 )
+		sha256_hwaccel = sha256_probe();
+	if ( sha256_hwaccel & SHA256_HW_SHANI ) {
+		sha256_blocks_ni(h, p, nblocks);
+		return;
+	}
+#endif /* CAT_SHA_HWACCEL */
+	sha256_blocks_sw(h, p, nblocks);
 }
 
 
@@ -179,95 +293,59 @@ void sha256_init(struct sha256ctx *s)
 	memset(s, 0, sizeof(*s));
 	s->llo = 0;
 	s->lhi = 0;
-	s->h[0] = 0x6a09e667;
-	s->h[1] = 0xbb67ae85;
-	s->h[2] = 0x3c6ef372;
-	s->h[3] = 0xa54ff53a;
-	s->h[4] = 0x510e527f;
-	s->h[5] = 0x9b05688c;
-	s->h[6] = 0x1f83d9ab;
-	s->h[7] = 0x5be0cd19;
-}
-
-
-void sha256_hash_block(struct sha256ctx *s)
-{
-	int i;
-	ulong a, b, c, d, e, f, g, h, t1, t2;
-
-	/* compute the schedule */
-	for ( i = 16; i < 64; ++i )
-		s->w[i] = (sigma1(s->w[i-2]) + s->w[i-7] + 
-			   sigma0(s->w[i-15]) + s->w[i-16]) & 0xFFFFFFFF;
-
-	/* set the working variables */
-	a = s->h[0];
-	b = s->h[1];
-	c = s->h[2];
-	d = s->h[3];
-	e = s->h[4];
-	f = s->h[5];
-	g = s->h[6];
-	h = s->h[7];
-
-	/* hash rounds */
-	for ( i = 0; i < 64; ++i ) {
-		t1 = (h + Sigma1(e) + Ch(e, f, g) + sha256_k[i] + s->w[i]) & 
-		     0xFFFFFFFF;
-
-		t2 = (Sigma0(a) + Maj(a, b, c)) & 0xFFFFFFFF;
-
-		h = g;
-		g = f;
-		f = e;
-		e = (d + t1) & 0xFFFFFFFF;
-		d = c;
-		c = b;
-		b = a;
-		a = (t1 + t2) & 0xFFFFFFFF;
-	}
-
-	s->h[0] = (s->h[0] + a) & 0xFFFFFFFF;
-	s->h[1] = (s->h[1] + b) & 0xFFFFFFFF;
-	s->h[2] = (s->h[2] + c) & 0xFFFFFFFF;
-	s->h[3] = (s->h[3] + d) & 0xFFFFFFFF;
-	s->h[4] = (s->h[4] + e) & 0xFFFFFFFF;
-	s->h[5] = (s->h[5] + f) & 0xFFFFFFFF;
-	s->h[6] = (s->h[6] + g) & 0xFFFFFFFF;
-	s->h[7] = (s->h[7] + h) & 0xFFFFFFFF;
+	memcpy(s->h, sha256_h0, sizeof(s->h));
 }
 
 
 void sha256_add(struct sha256ctx *s, void *vp, ulong len)
 {
 	byte_t *p = vp;
-	while ( len > 0 )
-		if ( sha256_add_bytes(s, &p, &len) )
-			sha256_hash_block(s);
+	ulong idx = s->llo & 63;
+	ulong n, olo;
+
+	olo = s->llo;
+	s->llo = (olo + len) & 0xFFFFFFFF;
+	if ( s->llo < olo )
+		s->lhi++;
+	s->lhi += (len >> 16) >> 16;
+
+	/* top off a partial block, hash whole blocks in place, save the rest */
+	if ( idx > 0 ) {
+		n = 64 - idx;
+		if ( n > len )
+			n = len;
+		memcpy(s->block + idx, p, n);
+		p += n;
+		len -= n;
+		if ( idx + n < 64 )
+			return;
+		sha256_blocks(s->h, s->block, 1);
+	}
+	if ( len >= 64 ) {
+		sha256_blocks(s->h, p, len / 64);
+		p += len & ~(ulong)63;
+		len &= 63;
+	}
+	memcpy(s->block, p, len);
 }
 
 
-void sha256_fini(struct sha256ctx *s, byte_t hash[32])
+/* build the final one or two padded blocks for a message of 'llo' bytes */
+static int sha256_pad(byte_t pad[128], const byte_t *tail, ulong llo,
+		      ulong lhi)
 {
-	byte_t pad[72];
+	ulong n = llo & 63;
+	int nb = (n < 56) ? 1 : 2;
 	byte_t *p;
-	ulong plen;
-	ulong llo, lhi;
-	int i;
-
-	/* initialize the pad bytes to add */
-	memset(pad, 0, sizeof(pad));
-	pad[0] = 0x80;
-	plen = 64 - (s->llo % 63);
-	if ( plen < 9 )
-		plen += 64;
 
-	/* compute length into bits */
-	lhi = (s->lhi << 3) + (s->llo >> 29);
-	llo = (s->llo << 3) & 0xFFFFFFFF;
+	memcpy(pad, tail, n);
+	memset(pad + n, 0, 64 * nb - n);
+	pad[n] = 0x80;
 
-	/* encode as a big-endian bytes */
-	p = &pad[plen - 8];
+	/* length in bits as a big-endian 64-bit number */
+	lhi = (lhi << 3) + (llo >> 29);
+	llo = (llo << 3) & 0xFFFFFFFF;
+	p = &pad[64 * nb - 8];
 	*p++ = (lhi >> 24) & 0xFF;
 	*p++ = (lhi >> 16) & 0xFF;
 	*p++ = (lhi >>  8) & 0xFF;
@@ -277,17 +355,26 @@ void sha256_fini(struct sha256ctx *s, byte_t hash[32])
 	*p++ = (llo >>  8) & 0xFF;
 	*p++ = (llo >>  0) & 0xFF;
 
-	/* hash the last block(s) */
-	p = pad;
-	while ( plen > 0 ) {
-		sha256_add_bytes(s, &p, &plen);
-		sha256_hash_block(s);
-	}
+	return nb;
+}
+
 
-	/* extract the hash value into hash bytes */
+static void sha256_out(const uint32_t h[8], byte_t hash[32])
+{
+	int i;
 	for ( i = 0; i < 32; ++i )
-		hash[i] = (s->h[i / 4] >> ((3 - (i % 4)) * 8)) & 0xFF;
+		hash[i] = (h[i / 4] >> ((3 - (i % 4)) * 8)) & 0xFF;
+}
+
+
+void sha256_fini(struct sha256ctx *s, byte_t hash[32])
+{
+	byte_t pad[128];
+	int nb;
 
+	nb = sha256_pad(pad, s->block, s->llo, s->lhi);
+	sha256_blocks(s->h, pad, nb);
+	sha256_out(s->h, hash);
 	memset(s, 0, sizeof(*s));
 }
 
@@ -301,6 +388,139 @@ void sha256(void *in, ulong len, byte_t hash[32])
 }
 
 
+#if CAT_SHA_HWACCEL
+
+typedef uint32_t sha_v8 __attribute__((vector_size(32)));
+
+#define V8ROR(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+
+/*
+ * Run one block for each of 8 lanes:  st[i] holds state word i for every
+ * lane and blk[l] points at lane l's block.  The message words get
+ * transposed into lane order with scalar loads which keeps the code
+ * simple and costs little next to the 64 rounds.
+ */
+__attribute__((target("avx2")))
+static void sha256_x8(uint32_t st[8][8], const byte_t *blk[8])
+{
+	sha_v8 w[16], s[8], a, b, c, d, e, f, g, h, t1, t2, k;
+	uint32_t tw[8];
+	int i, l;
+
+	for ( i = 0; i < 16; ++i ) {
+		for ( l = 0; l < 8; ++l )
+			tw[l] = BE32(blk[l] + 4 * i);
+		memcpy(&w[i], tw, sizeof(tw));
+	}
+	for ( i = 0; i < 8; ++i )
+		memcpy(&s[i], st[i], sizeof(s[i]));
+
+	a = s[0]; b = s[1]; c = s[2]; d = s[3];
+	e = s[4]; f = s[5]; g = s[6]; h = s[7];
+	for ( i = 0; i < 64; ++i ) {
+		if ( i >= 16 ) {
+			t1 = w[(i - 15) & 15];
+			t2 = w[(i - 2) & 15];
+			w[i & 15] += (V8ROR(t1, 7) ^ V8ROR(t1, 18) ^ (t1 >> 3)) +
+				     w[(i - 7) & 15] +
+				     (V8ROR(t2, 17) ^ V8ROR(t2, 19) ^ (t2 >> 10));
+		}
+		k = (sha_v8){ 0 } + sha256_k[i];
+		t1 = h + (V8ROR(e, 6) ^ V8ROR(e, 11) ^ V8ROR(e, 25)) +
+		     ((e & f) ^ (~e & g)) + k + w[i & 15];
+		t2 = (V8ROR(a, 2) ^ V8ROR(a, 13) ^ V8ROR(a, 22)) +
+		     ((a & b) ^ (a & c) ^ (b & c));
+		h = g; g = f; f = e; e = d + t1;
+		d = c; c = b; b = a; a = t1 + t2;
+	}
+	s[0] += a; s[1] += b; s[2] += c; s[3] += d;
+	s[4] += e; s[5] += f; s[6] += g; s[7] += h;
+	for ( i = 0; i < 8; ++i )
+		memcpy(st[i], &s[i], sizeof(s[i]));
+}
+
+#undef V8ROR
+
+
+/* hash up to 8 messages at once:  finished lanes run on dummy blocks */
+static void sha256_multi8(const void *in[], const ulong len[],
+			  byte_t hash[][32], uint n)
+{
+	uint32_t st[8][8], prev[8][8], save[8];
+	byte_t pad[8][128];
+	const byte_t *blk[8];
+	ulong full[8], nb[8], maxnb = 0, b;
+	uint i, l;
+
+	for ( l = 0; l < 8; ++l ) {
+		for ( i = 0; i < 8; ++i )
+			st[i][l] = sha256_h0[i];
+		if ( l < n ) {
+			full[l] = len[l] / 64;
+			nb[l] = full[l] + sha256_pad(pad[l],
+					(const byte_t *)in[l] + full[l] * 64,
+					len[l] & 0xFFFFFFFF,
+					(len[l] >> 16) >> 16);
+		} else {
+			full[l] = nb[l] = 0;
+		}
+		if ( nb[l] > maxnb )
+			maxnb = nb[l];
+	}
+
+	for ( b = 0; b < maxnb; ++b ) {
+		for ( l = 0; l < 8; ++l ) {
+			if ( b < full[l] )
+				blk[l] = (const byte_t *)in[l] + b * 64;
+			else if ( b < nb[l] )
+				blk[l] = pad[l] + (b - full[l]) * 64;
+			else
+				blk[l] = pad[0];
+		}
+		if ( b < nb[0] && b < nb[1] && b < nb[2] && b < nb[3] &&
+		     b < nb[4] && b < nb[5] && b < nb[6] && b < nb[7] ) {
+			sha256_x8(st, blk);
+			continue;
+		}
+		/* some lanes are done:  put their final state back */
+		memcpy(prev, st, sizeof(st));
+		sha256_x8(st, blk);
+		for ( l = 0; l < 8; ++l )
+			if ( b >= nb[l] )
+				for ( i = 0; i < 8; ++i )
+					st[i][l] = prev[i][l];
+	}
+
+	for ( l = 0; l < n; ++l ) {
+		for ( i = 0; i < 8; ++i )
+			save[i] = st[i][l];
+		sha256_out(save, hash[l]);
+	}
+}
+
+#endif /* CAT_SHA_HWACCEL */
+
+
+void sha256_multi(const void *in[], const ulong len[], byte_t hash[][32],
+		  uint n)
+{
+	uint i = 0;
+
+#if CAT_SHA_HWACCEL
+	if ( sha256_hwaccel < 0 )
+		sha256_hwaccel = sha256_probe();
+	if ( (sha256_hwaccel & SHA256_HW_AVX2) &&
+	     !(sha256_hwaccel & SHA256_HW_SHANI) ) {
+		for ( ; i + 1 < n ; i += 8 )
+			sha256_multi8(in + i, len + i, hash + i,
+				      (n - i < 8) ? n - i : 8);
+	}
+#endif /* CAT_SHA_HWACCEL */
+	for ( ; i < n ; ++i )
+		sha256((void *)in[i], len[i], hash[i]);
+}
+
+
 #define U8TOU32LE(_p) \
 	((ulong)((_p)[0]) | ((ulong)((_p)[1]) << 8) | \
 	 ((ulong)((_p)[2]) << 16) | ((ulong)((_p)[3]) << 24))
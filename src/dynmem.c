@@ -823,3 +823,230 @@ void tlsf_each_block(struct tlsfpool *pool, apply_f f, void *ctx)
 	}
 }
 
+
+
+size_t tlsf_blklen(void *mem)
+{
+	ASSERT(mem);
+	return MBSIZE(ptr2mb(mem)) - UNITSIZE;
+}
+
+
+void tlsfmt_init(struct tlsfmt *tm)
+{
+	abort_unless(tm);
+	tlsf_init(&tm->tm_tlsf);
+	cat_lock_init(&tm->tm_lock);
+}
+
+
+void tlsfmt_add_pool(struct tlsfmt *tm, void *mem, size_t len)
+{
+	abort_unless(tm);
+	cat_lock(&tm->tm_lock);
+	tlsf_add_pool(&tm->tm_tlsf, mem, len);
+	cat_unlock(&tm->tm_lock);
+}
+
+
+static void *tlsfc_mm_alloc(struct memmgr *mm, size_t amt)
+{
+	return tlsfc_malloc(container(mm, struct tlsfcache, tc_mm), amt);
+}
+
+
+static void *tlsfc_mm_resize(struct memmgr *mm, void *omem, size_t newamt)
+{
+	return tlsfc_realloc(container(mm, struct tlsfcache, tc_mm), omem,
+			     newamt);
+}
+
+
+static void tlsfc_mm_free(struct memmgr *mm, void *mem)
+{
+	tlsfc_free(container(mm, struct tlsfcache, tc_mm), mem);
+}
+
+
+void tlsfc_init(struct tlsfcache *tc, struct tlsfmt *tm)
+{
+	int i;
+
+	abort_unless(tc);
+	abort_unless(tm);
+
+	tc->tc_mm.mm_alloc = tlsfc_mm_alloc;
+	tc->tc_mm.mm_resize = tlsfc_mm_resize;
+	tc->tc_mm.mm_free = tlsfc_mm_free;
+	tc->tc_mm.mm_ctx = tc;
+	tc->tc_heap = tm;
+	for ( i = 0; i < TLSFC_NCLASS; ++i ) {
+		tc->tc_mags[i] = NULL;
+		tc->tc_nmag[i] = 0;
+	}
+}
+
+
+/* cached blocks link through their first word */
+#define TC_NEXT(p)	(*(void **)(p))
+
+
+/* 
+ * Blocks from tlsf_malloc() can be larger than requested, so the class
+ * of a request rounds up while the class of a block rounds down.  Every
+ * block in class 'i' has at least (i + 1) * TLSFC_QUANTUM usable bytes.
+ */
+#define TC_REQCLASS(amt) \
+	((amt) == 0 ? 0 : (int)(((amt) - 1) / TLSFC_QUANTUM))
+#define TC_BLKCLASS(len) ((int)((len) / TLSFC_QUANTUM) - 1)
+
+
+/*
+ * Another thread holding the heap lock can flip the PREV_ALLOC_BIT in the
+ * header of an allocated block when it allocates or frees the block just
+ * before it.  The size bits never change while the block is allocated so
+ * reading them without the lock is safe as long as the load is not torn.
+ */
+static size_t tlsfc_blklen(void *mem)
+{
+	return (cat_ld_rlx(&ptr2mb(mem)->mb_len.sz) & ~CTLBMASK) - UNITSIZE;
+}
+
+
+static int tlsfc_refill(struct tlsfcache *tc, int cls)
+{
+	struct tlsfmt *tm = tc->tc_heap;
+	size_t amt = (size_t)(cls + 1) * TLSFC_QUANTUM;
+	void *mem;
+	int i;
+
+	cat_lock(&tm->tm_lock);
+	for ( i = 0; i < TLSFC_BATCH; ++i ) {
+		if ( (mem = tlsf_malloc(&tm->tm_tlsf, amt)) == NULL )
+			break;
+		TC_NEXT(mem) = tc->tc_mags[cls];
+		tc->tc_mags[cls] = mem;
+	}
+	cat_unlock(&tm->tm_lock);
+	tc->tc_nmag[cls] += i;
+
+	return i;
+}
+
+
+static void tlsfc_drain(struct tlsfcache *tc, int cls, uint n)
+{
+	struct tlsfmt *tm = tc->tc_heap;
+	void *mem;
+
+	ASSERT(n <= tc->tc_nmag[cls]);
+	tc->tc_nmag[cls] -= n;
+	cat_lock(&tm->tm_lock);
+	while ( n-- > 0 ) {
+		mem = tc->tc_mags[cls];
+		tc->tc_mags[cls] = TC_NEXT(mem);
+		tlsf_free(&tm->tm_tlsf, mem);
+	}
+	cat_unlock(&tm->tm_lock);
+}
+
+
+void *tlsfc_malloc(struct tlsfcache *tc, size_t amt)
+{
+	struct tlsfmt *tm;
+	void *mem;
+	int cls;
+
+	ASSERT(tc);
+
+	if ( amt > TLSFC_MAXSMALL ) {
+		tm = tc->tc_heap;
+		cat_lock(&tm->tm_lock);
+		mem = tlsf_malloc(&tm->tm_tlsf, amt);
+		cat_unlock(&tm->tm_lock);
+		return mem;
+	}
+
+	cls = TC_REQCLASS(amt);
+	if ( tc->tc_mags[cls] == NULL && tlsfc_refill(tc, cls) == 0 )
+		return NULL;
+	mem = tc->tc_mags[cls];
+	tc->tc_mags[cls] = TC_NEXT(mem);
+	tc->tc_nmag[cls] -= 1;
+
+	return mem;
+}
+
+
+void tlsfc_free(struct tlsfcache *tc, void *mem)
+{
+	struct tlsfmt *tm;
+	int cls;
+
+	ASSERT(tc);
+	if ( mem == NULL )
+		return;
+
+	cls = TC_BLKCLASS(tlsfc_blklen(mem));
+	if ( cls >= TLSFC_NCLASS ) {
+		tm = tc->tc_heap;
+		cat_lock(&tm->tm_lock);
+		tlsf_free(&tm->tm_tlsf, mem);
+		cat_unlock(&tm->tm_lock);
+		return;
+	}
+
+	if ( tc->tc_nmag[cls] >= TLSFC_MAGSIZE )
+		tlsfc_drain(tc, cls, TLSFC_BATCH);
+	TC_NEXT(mem) = tc->tc_mags[cls];
+	tc->tc_mags[cls] = mem;
+	tc->tc_nmag[cls] += 1;
+}
+
+
+void *tlsfc_realloc(struct tlsfcache *tc, void *omem, size_t newamt)
+{
+	struct tlsfmt *tm;
+	void *nmem;
+	size_t olen;
+
+	ASSERT(tc);
+	if ( newamt == 0 ) {
+		tlsfc_free(tc, omem);
+		return NULL;
+	}
+	if ( omem == NULL )
+		return tlsfc_malloc(tc, newamt);
+
+	olen = tlsfc_blklen(omem);
+	if ( olen > TLSFC_MAXSMALL && newamt > TLSFC_MAXSMALL ) {
+		tm = tc->tc_heap;
+		cat_lock(&tm->tm_lock);
+		nmem = tlsf_realloc(&tm->tm_tlsf, omem, newamt);
+		cat_unlock(&tm->tm_lock);
+		return nmem;
+	}
+
+	/* keep the block unless it would waste more than half of it */
+	if ( newamt <= olen && newamt > olen / 2 )
+		return omem;
+
+	nmem = tlsfc_malloc(tc, newamt);
+	if ( nmem != NULL ) {
+		memcpy(nmem, omem, (olen < newamt ? olen : newamt));
+		tlsfc_free(tc, omem);
+	}
+
+	return nmem;
+}
+
+
+void tlsfc_flush(struct tlsfcache *tc)
+{
+	int i;
+
+	ASSERT(tc);
+	for ( i = 0; i < TLSFC_NCLASS; ++i )
+		if ( tc->tc_nmag[i] > 0 )
+			tlsfc_drain(tc, i, tc->tc_nmag[i]);
+}
@@ -0,0 +1,274 @@
+/*
+ * fhash.c -- Fast non-cryptographic hash functions
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2003-2017 -- See accompanying license
+ *
+ */
+
+#include <cat/fhash.h>
+#include <string.h>
+
+#if CAT_64BIT
+
+/* 64-bit constants without relying on 'ull' suffixes for ANSI builds */
+#define FH_U64(_hi, _lo)	(((uint64_t)(_hi) << 32) | (uint64_t)(_lo))
+
+static const uint64_t wyp[4] = {
+	FH_U64(0xa0761d64, 0x78bd642f),
+	FH_U64(0xe7037ed1, 0xa0b428db),
+	FH_U64(0x8ebc6af0, 0x9c88c6e3),
+	FH_U64(0x589965cc, 0x75374cc3),
+};
+
+
+/* 64 x 64 -> 128-bit multiply:  *a gets the low half and *b the high */
+static void mum(uint64_t *a, uint64_t *b)
+{
+#if defined(__SIZEOF_INT128__) && !CAT_ANSI89
+	__extension__ unsigned __int128 r = *a;
+	r *= *b;
+	*a = (uint64_t)r;
+	*b = (uint64_t)(r >> 64);
+#else /* __SIZEOF_INT128__ && !CAT_ANSI89 */
+	uint64_t ha = *a >> 32, hb = *b >> 32;
+	uint64_t la = *a & 0xFFFFFFFF, lb = *b & 0xFFFFFFFF;
+	uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64_t t = rl + (rm0 << 32), c = t < rl, lo;
+	lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif /* __SIZEOF_INT128__ && !CAT_ANSI89 */
+}
+
+
+static uint64_t mix(uint64_t a, uint64_t b)
+{
+	mum(&a, &b);
+	return a ^ b;
+}
+
+
+static uint64_t rd8(const byte_t *p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+
+static uint64_t rd4(const byte_t *p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+
+uint64_t wyhash(const void *vp, size_t len, uint64_t seed)
+{
+	const byte_t *p = vp;
+	uint64_t a, b, see1, see2;
+	size_t i;
+
+	seed ^= mix(seed ^ wyp[0], wyp[1]);
+	if ( len <= 16 ) {
+		if ( len >= 4 ) {
+			a = (rd4(p) << 32) | rd4(p + ((len >> 3) << 2));
+			b = (rd4(p + len - 4) << 32) |
+			    rd4(p + len - 4 - ((len >> 3) << 2));
+		} else if ( len > 0 ) {
+			a = ((uint64_t)p[0] << 16) |
+			    ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		i = len;
+		if ( i > 48 ) {
+			see1 = see2 = seed;
+			do {
+				seed = mix(rd8(p) ^ wyp[1], rd8(p + 8) ^ seed);
+				see1 = mix(rd8(p + 16) ^ wyp[2],
+					   rd8(p + 24) ^ see1);
+				see2 = mix(rd8(p + 32) ^ wyp[3],
+					   rd8(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while ( i > 48 );
+			seed ^= see1 ^ see2;
+		}
+		while ( i > 16 ) {
+			seed = mix(rd8(p) ^ wyp[1], rd8(p + 8) ^ seed);
+			i -= 16;
+			p += 16;
+		}
+		a = rd8(p + i - 16);
+		b = rd8(p + i - 8);
+	}
+
+	a ^= wyp[1];
+	b ^= seed;
+	mum(&a, &b);
+	return mix(a ^ wyp[0] ^ len, b ^ wyp[1]);
+}
+
+
+uint64_t wyhash64(uint64_t x, uint64_t seed)
+{
+	return mix(mix(x ^ wyp[0], seed ^ wyp[1]), wyp[2]);
+}
+
+
+#define ROTL64(_x, _n)	(((_x) << (_n)) | ((_x) >> (64 - (_n))))
+
+#define SIPROUND(_v0, _v1, _v2, _v3)					\
+	do {								\
+		_v0 += _v1; _v1 = ROTL64(_v1, 13); _v1 ^= _v0;		\
+		_v0 = ROTL64(_v0, 32);					\
+		_v2 += _v3; _v3 = ROTL64(_v3, 16); _v3 ^= _v2;		\
+		_v0 += _v3; _v3 = ROTL64(_v3, 21); _v3 ^= _v0;		\
+		_v2 += _v1; _v1 = ROTL64(_v1, 17); _v1 ^= _v2;		\
+		_v2 = ROTL64(_v2, 32);					\
+	} while (0)
+
+
+/* little-endian load of the last 0-7 bytes */
+static uint64_t rdtail(const byte_t *p, size_t n)
+{
+	uint64_t v = 0;
+	while ( n > 0 ) {
+		--n;
+		v = (v << 8) | p[n];
+	}
+	return v;
+}
+
+
+static uint64_t rdle8(const byte_t *p)
+{
+	return rdtail(p, 8);
+}
+
+
+uint64_t siphash13(const byte_t key[16], const void *vp, size_t len)
+{
+	const byte_t *p = vp;
+	const byte_t *end = p + (len & ~(size_t)7);
+	uint64_t k0 = rdle8(key), k1 = rdle8(key + 8), m;
+	uint64_t v0 = k0 ^ FH_U64(0x736f6d65, 0x70736575);
+	uint64_t v1 = k1 ^ FH_U64(0x646f7261, 0x6e646f6d);
+	uint64_t v2 = k0 ^ FH_U64(0x6c796765, 0x6e657261);
+	uint64_t v3 = k1 ^ FH_U64(0x74656462, 0x79746573);
+
+	for ( ; p < end ; p += 8 ) {
+		m = rdle8(p);
+		v3 ^= m;
+		SIPROUND(v0, v1, v2, v3);
+		v0 ^= m;
+	}
+
+	m = rdtail(p, len & 7) | ((uint64_t)(len & 0xFF) << 56);
+	v3 ^= m;
+	SIPROUND(v0, v1, v2, v3);
+	v0 ^= m;
+
+	v2 ^= 0xFF;
+	SIPROUND(v0, v1, v2, v3);
+	SIPROUND(v0, v1, v2, v3);
+	SIPROUND(v0, v1, v2, v3);
+	return v0 ^ v1 ^ v2 ^ v3;
+}
+
+
+static const struct fhash_key zero_key;
+
+
+#define FOLD(_h)	((uint)((_h) ^ ((_h) >> 32)))
+#define KEY(_k)		((_k) == NULL ? &zero_key : (const struct fhash_key *)(_k))
+
+
+void fhash_key_init(struct fhash_key *k, const void *seed, size_t len)
+{
+	const byte_t *p = seed;
+	size_t i;
+
+	abort_unless(k != NULL);
+	abort_unless(p != NULL || len == 0);
+
+	memset(k, 0, sizeof(*k));
+	for ( i = 0; i < len; ++i ) {
+		k->seed ^= (uint64_t)p[i] << ((i % 8) * 8);
+		k->sipkey[i % 16] ^= p[i];
+	}
+}
+
+
+uint ht_wy_shash(const void *str, void *k)
+{
+	uint64_t h;
+	abort_unless(str != NULL);
+	h = wyhash(str, strlen(str), KEY(k)->seed);
+	return FOLD(h);
+}
+
+
+uint ht_wy_rhash(const void *raw, void *k)
+{
+	const struct raw *r = raw;
+	uint64_t h;
+	abort_unless(r != NULL);
+	abort_unless(r->data != NULL || r->len == 0);
+	h = wyhash(r->data, r->len, KEY(k)->seed);
+	return FOLD(h);
+}
+
+
+uint ht_wy_u32hash(const void *key, void *k)
+{
+	uint64_t h;
+	abort_unless(key != NULL);
+	h = wyhash64(*(const uint32_t *)key, KEY(k)->seed);
+	return FOLD(h);
+}
+
+
+uint ht_wy_u64hash(const void *key, void *k)
+{
+	uint64_t h;
+	abort_unless(key != NULL);
+	h = wyhash64(*(const uint64_t *)key, KEY(k)->seed);
+	return FOLD(h);
+}
+
+
+uint ht_wy_ihash(const void *key, void *k)
+{
+	uint64_t h = wyhash64((uint64_t)ptr2uint(key), KEY(k)->seed);
+	return FOLD(h);
+}
+
+
+uint ht_sh13_shash(const void *str, void *k)
+{
+	uint64_t h;
+	abort_unless(str != NULL);
+	h = siphash13(KEY(k)->sipkey, str, strlen(str));
+	return FOLD(h);
+}
+
+
+uint ht_sh13_rhash(const void *raw, void *k)
+{
+	const struct raw *r = raw;
+	uint64_t h;
+	abort_unless(r != NULL);
+	abort_unless(r->data != NULL || r->len == 0);
+	h = siphash13(KEY(k)->sipkey, r->data, r->len);
+	return FOLD(h);
+}
+
+#endif /* CAT_64BIT */
@@ -12,3 +12,158 @@
 #define CAT_USE_INLINE 0
 #define CAT_HASH_DO_DECL 1
 #include <cat/hash.h>
+
+
+static void rht_move(struct rhtab *t)
+{
+	int i;
+	struct hnode *node;
+
+	for ( i = 0 ; i < RHT_STEP && t->mvidx < t->old.nbkts ; ++i ) {
+		while ( (node = t->old.bkts[t->mvidx]) != NULL ) {
+			ht_rem(node);
+			ht_ins_h(&t->tab, node);
+		}
+		++t->mvidx;
+	}
+
+	if ( t->mvidx == t->old.nbkts ) {
+		mem_free(t->mm, t->old.bkts);
+		t->old.bkts = NULL;
+	}
+}
+
+
+static void rht_resize(struct rhtab *t, uint nbkts)
+{
+	struct hnode **bkts;
+
+	if ( rht_inmove(t) )
+		return;
+	if ( nbkts > ((uint)~0 >> 1) / sizeof(struct hnode *) )
+		return;
+	bkts = mem_get(t->mm, nbkts * sizeof(struct hnode *));
+	if ( bkts == NULL )
+		return;
+
+	t->old = t->tab;
+	t->mvidx = 0;
+	ht_init(&t->tab, bkts, nbkts, t->old.cmp, t->old.hash, t->old.hctx);
+}
+
+
+/* do a bounded amount of resizing work */
+static void rht_step(struct rhtab *t)
+{
+	if ( rht_inmove(t) )
+		rht_move(t);
+	else if ( t->fill / RHT_MAXLOAD > t->tab.nbkts )
+		rht_resize(t, t->tab.nbkts * 2);
+	else if ( t->tab.nbkts > t->minbkts &&
+		  t->fill * RHT_MINLOAD < t->tab.nbkts )
+		rht_resize(t, t->tab.nbkts / 2);
+}
+
+
+int rht_init(struct rhtab *t, struct memmgr *mm, uint nbkts, cmp_f cmpf,
+	     hash_f hashf, void *hctx)
+{
+	struct hnode **bkts;
+	uint n;
+
+	abort_unless(t != NULL);
+	abort_unless(mm != NULL);
+	abort_unless(nbkts <= ((uint)~0 >> 1) / sizeof(struct hnode *));
+
+	for ( n = 1 ; n < nbkts ; n <<= 1 )
+		;
+	bkts = mem_get(mm, n * sizeof(struct hnode *));
+	if ( bkts == NULL )
+		return -1;
+
+	ht_init(&t->tab, bkts, n, cmpf, hashf, hctx);
+	t->old = t->tab;
+	t->old.bkts = NULL;
+	t->mvidx = 0;
+	t->minbkts = n;
+	t->fill = 0;
+	t->mm = mm;
+
+	return 0;
+}
+
+
+void rht_fini(struct rhtab *t)
+{
+	abort_unless(t != NULL);
+
+	mem_free(t->mm, t->tab.bkts);
+	t->tab.bkts = NULL;
+	if ( rht_inmove(t) ) {
+		mem_free(t->mm, t->old.bkts);
+		t->old.bkts = NULL;
+	}
+}
+
+
+struct hnode *rht_lkup(struct rhtab *t, const void *key, uint *hp)
+{
+	struct hnode *node;
+	uint h;
+
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+
+	rht_step(t);
+
+	/* both bucket counts are powers of 2 */
+	h = (*t->tab.hash)(key, t->tab.hctx);
+	if ( hp != NULL )
+		*hp = h;
+	for ( node = t->tab.bkts[h & t->tab.po2mask] ; node ; node = node->next )
+		if ( !(*t->tab.cmp)(node->key, key) )
+			return node;
+
+	if ( rht_inmove(t) ) {
+		node = t->old.bkts[h & t->old.po2mask];
+		for ( ; node != NULL ; node = node->next )
+			if ( !(*t->old.cmp)(node->key, key) )
+				return node;
+	}
+
+	return NULL;
+}
+
+
+void rht_ins(struct rhtab *t, struct hnode *node, uint hash)
+{
+	abort_unless(t != NULL);
+	abort_unless(node != NULL);
+
+	ht_ins(&t->tab, node, hash);
+	++t->fill;
+	rht_step(t);
+}
+
+
+void rht_rem(struct rhtab *t, struct hnode *node)
+{
+	abort_unless(t != NULL);
+	abort_unless(node != NULL);
+	abort_unless(t->fill > 0);
+
+	ht_rem(node);
+	--t->fill;
+	rht_step(t);
+}
+
+
+void rht_apply(struct rhtab *t, apply_f func, void *ctx)
+{
+	abort_unless(t != NULL);
+	abort_unless(func != NULL);
+
+	if ( rht_inmove(t) )
+		ht_apply(&t->old, func, ctx);
+	ht_apply(&t->tab, func, ctx);
+}
@@ -25,6 +25,7 @@ struct lexer *lex_new(struct memmgr *mm)
 	lex->input.len = 0;
 	lex->next_char = NULL;
 	lex->mm = mm;
+	lex->use_rset = (rex_set_init(&lex->rset, mm, 0) == 0);
 	return lex;
 }
 
@@ -53,6 +54,8 @@ int lex_add_entry(struct lexer *lex, const char *pattern, int token)
 		mem_free(lex->mm, ent);
 		return -1;
 	}
+	if ( lex->use_rset && rex_set_add(&lex->rset, &ent->pattern, token) < 0 )
+		lex->use_rset = 0;
 	l_enq(&lex->entries, &ent->entry);
 	return 0;
 }
@@ -68,35 +71,49 @@ void lex_reset(struct lexer *lex, const char *string)
 
 int lex_next_token(struct lexer *lex, const char **string, int *len)
 {
-	int rv;
+	int rv, tok = LEX_NOMATCH;
 	struct list *node;
 	struct lexer_entry *ent;
 	struct raw r;
 	struct rex_match_loc match;
+	size_t mlen = 0;
 
 	if ( lex->next_char == (char *)lex->input.data + lex->input.len )
 		return LEX_END;
 
 	r.data = (byte_t*)lex->next_char;
-	r.len = lex->input.len - (lex->next_char - (char *)r.data);
-	l_for_each(node, &lex->entries) { 
-		ent = node_to_lexent(node);
-		rv = rex_match(&ent->pattern, &r, &match, 1);
+	r.len = lex->input.len - (lex->next_char - (char *)lex->input.data);
+	if ( lex->use_rset ) {
+		rv = rex_set_match(&lex->rset, &r, &tok, &mlen);
 		if ( rv == REX_ERROR )
 			return LEX_ERROR;
 		if ( rv != REX_MATCH )
-			continue;
-		abort_unless(match.valid);
-		abort_unless(match.start == 0);
-		if ( string != NULL )
-			*string = lex->next_char;
-		if ( len != NULL )
-			*len = match.len;
-		lex->next_char += match.len;
-		return ent->token;
+			return LEX_NOMATCH;
+	} else {
+		l_for_each(node, &lex->entries) { 
+			ent = node_to_lexent(node);
+			rv = rex_match(&ent->pattern, &r, &match, 1);
+			if ( rv == REX_ERROR )
+				return LEX_ERROR;
+			if ( rv != REX_MATCH )
+				continue;
+			abort_unless(match.valid);
+			abort_unless(match.start == 0);
+			if ( tok == LEX_NOMATCH || match.len > mlen ) {
+				tok = ent->token;
+				mlen = match.len;
+			}
+		}
+		if ( tok == LEX_NOMATCH )
+			return LEX_NOMATCH;
 	}
 
-	return LEX_NOMATCH;
+	if ( string != NULL )
+		*string = lex->next_char;
+	if ( len != NULL )
+		*len = mlen;
+	lex->next_char += mlen;
+	return tok;
 }
 
 
@@ -104,6 +121,7 @@ void lex_destroy(struct lexer *lex)
 {
 	struct list *node;
 	struct memmgr *mm = lex->mm;
+	rex_set_free(&lex->rset);
 	while ( (node = l_deq(&lex->entries)) != NULL ) {
 		struct lexer_entry *ent = node_to_lexent(node);
 		rex_free(&ent->pattern);
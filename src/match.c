@@ -8,10 +8,33 @@
  */
 #include <cat/cat.h>
 #include <cat/match.h>
+#include <cat/archops.h>
+#include <cat/tsort.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 
+#if CAT_HAS_POSIX
+#include <cat/io.h>
+#endif /* CAT_HAS_POSIX */
+
+/*
+ * On x86-64 with GCC, mem_match() filters candidate positions with SSE2
+ * or AVX2 compares.  cpuid decides whether AVX2 is usable the first time
+ * it's called and the result lands in mem_match_hwaccel.
+ */
+#ifndef CAT_MATCH_HWACCEL
+#if defined(__GNUC__) && defined(__x86_64__) && !CAT_ANSI89 && CAT_USE_STDLIB
+#define CAT_MATCH_HWACCEL	1
+#else
+#define CAT_MATCH_HWACCEL	0
+#endif
+#endif /* CAT_MATCH_HWACCEL */
+
+#if CAT_MATCH_HWACCEL
+#include <immintrin.h>
+#endif /* CAT_MATCH_HWACCEL */
+
 
 void kmp_pinit(struct kmppat *kmp, struct raw *pat, ulong *skips)
 {
@@ -176,6 +199,153 @@ int bm_match(struct raw *str, struct bmpat *pat, ulong *loc)
 }
 
 
+int mem_match_hwaccel = -1;
+
+
+/* check positions 'i' onward one at a time */
+static int mem_match_scalar(const uchar *sp, size_t slen, const uchar *pp,
+			    size_t plen, size_t i, size_t *loc)
+{
+	uchar first = pp[0], last = pp[plen - 1];
+
+	for ( ; i <= slen - plen ; ++i ) {
+		if ( sp[i] == first && sp[i + plen - 1] == last &&
+		     (plen <= 2 || memcmp(sp + i + 1, pp + 1, plen - 2) == 0) ) {
+			if ( loc )
+				*loc = i;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+
+#if CAT_MATCH_HWACCEL
+
+static int mem_match_probe(void)
+{
+	uint32_t eax, ebx, ecx, edx, xcr0;
+	int hw = MEM_MATCH_HW_SSE2;
+
+	eax = 1;
+	ecx = 0;
+	__asm__ __volatile__("cpuid"
+			     : "+a"(eax), "=b"(ebx), "+c"(ecx), "=d"(edx));
+	/* AVX registers must be enabled by the OS (OSXSAVE + XCR0) */
+	if ( ((ecx >> 27) & 1) == 0 || ((ecx >> 28) & 1) == 0 )
+		return hw;
+	__asm__ __volatile__("xgetbv" : "=a"(xcr0), "=d"(edx) : "c"(0));
+	if ( (xcr0 & 6) != 6 )
+		return hw;
+	eax = 7;
+	ecx = 0;
+	__asm__ __volatile__("cpuid"
+			     : "+a"(eax), "=b"(ebx), "+c"(ecx), "=d"(edx));
+	if ( (ebx >> 5) & 1 )
+		hw |= MEM_MATCH_HW_AVX2;
+	return hw;
+}
+
+
+/*
+ * Bit 'b' of 'mask' is set when position i + b starts with the first
+ * byte of the pattern and has the last byte at the right distance.
+ * Only those candidates get the full comparison.
+ */
+#define MEM_MATCH_CANDIDATES(_mask)					\
+	while ( (_mask) != 0 ) {					\
+		b = __builtin_ctz(_mask);				\
+		if ( plen <= 2 ||					\
+		     memcmp(sp + i + b + 1, pp + 1, plen - 2) == 0 ) {	\
+			if ( loc )					\
+				*loc = i + b;				\
+			return 1;					\
+		}							\
+		(_mask) &= (_mask) - 1;					\
+	}
+
+
+__attribute__((target("sse2")))
+static int mem_match_sse2(const uchar *sp, size_t slen, const uchar *pp,
+			  size_t plen, size_t *loc)
+{
+	const __m128i first = _mm_set1_epi8((char)pp[0]);
+	const __m128i last = _mm_set1_epi8((char)pp[plen - 1]);
+	__m128i bf, bl;
+	size_t i, npos = slen - plen + 1;
+	uint mask, b;
+
+	for ( i = 0 ; i + 16 <= npos ; i += 16 ) {
+		bf = _mm_loadu_si128((const __m128i *)(sp + i));
+		bl = _mm_loadu_si128((const __m128i *)(sp + i + plen - 1));
+		mask = _mm_movemask_epi8(_mm_and_si128(
+				_mm_cmpeq_epi8(bf, first),
+				_mm_cmpeq_epi8(bl, last)));
+		MEM_MATCH_CANDIDATES(mask);
+	}
+	return mem_match_scalar(sp, slen, pp, plen, i, loc);
+}
+
+
+__attribute__((target("avx2")))
+static int mem_match_avx2(const uchar *sp, size_t slen, const uchar *pp,
+			  size_t plen, size_t *loc)
+{
+	const __m256i first = _mm256_set1_epi8((char)pp[0]);
+	const __m256i last = _mm256_set1_epi8((char)pp[plen - 1]);
+	__m256i bf, bl;
+	size_t i, npos = slen - plen + 1;
+	uint mask, b;
+
+	for ( i = 0 ; i + 32 <= npos ; i += 32 ) {
+		bf = _mm256_loadu_si256((const __m256i *)(sp + i));
+		bl = _mm256_loadu_si256((const __m256i *)(sp + i + plen - 1));
+		mask = (uint)_mm256_movemask_epi8(_mm256_and_si256(
+				_mm256_cmpeq_epi8(bf, first),
+				_mm256_cmpeq_epi8(bl, last)));
+		MEM_MATCH_CANDIDATES(mask);
+	}
+	return mem_match_scalar(sp, slen, pp, plen, i, loc);
+}
+
+#endif /* CAT_MATCH_HWACCEL */
+
+
+int mem_match(const struct raw *str, const struct raw *pat, size_t *loc)
+{
+	const uchar *sp, *pp;
+	size_t slen, plen;
+
+	abort_unless(str && (str->data || str->len == 0));
+	abort_unless(pat && (pat->data || pat->len == 0));
+
+	sp = (const uchar *)str->data;
+	slen = str->len;
+	pp = (const uchar *)pat->data;
+	plen = pat->len;
+
+	if ( plen == 0 ) {
+		if ( loc )
+			*loc = 0;
+		return 1;
+	}
+	if ( plen > slen )
+		return 0;
+
+#if CAT_MATCH_HWACCEL
+	if ( mem_match_hwaccel < 0 )
+		mem_match_hwaccel = mem_match_probe();
+	if ( (mem_match_hwaccel & MEM_MATCH_HW_AVX2) &&
+	     slen - plen + 1 >= 32 )
+		return mem_match_avx2(sp, slen, pp, plen, loc);
+	if ( (mem_match_hwaccel & MEM_MATCH_HW_SSE2) )
+		return mem_match_sse2(sp, slen, pp, plen, loc);
+#endif /* CAT_MATCH_HWACCEL */
+
+	return mem_match_scalar(sp, slen, pp, plen, 0, loc);
+}
+
+
 #define isexplicit(suffix) ( (suffix)->end < (suffix)->start )
 
 
@@ -471,6 +641,719 @@ void sfx_clear(struct sfxtree *sfx)
 }
 
 
+/*
+ * SA-IS (Nong, Zhang and Chan):  sort the LMS substrings by induction,
+ * name them, recursively sort the string of names if they aren't unique
+ * and induce the order of all suffixes from the sorted LMS suffixes.  The
+ * top level sorts the bytes of the string as symbols 1-256 followed by a
+ * virtual 0 sentinel so it works on arbitrary binary data.  Later levels
+ * sort the names stored in the upper part of the suffix array.
+ */
+
+#define SFA_EMPTY	((uint32_t)~0)
+#define TGET(_t, _i)	(((_t)[(_i) >> 3] >> ((_i) & 7)) & 1)
+#define TSET(_t, _i)	((_t)[(_i) >> 3] |= 1 << ((_i) & 7))
+#define ISLMS(_t, _i)	((_i) > 0 && TGET(_t, _i) && !TGET(_t, (_i) - 1))
+
+struct sais_str {
+	const uchar *		b;	/* top level string */
+	const uint32_t *	w;	/* names of a reduced string or NULL */
+	uint32_t		n;	/* symbols including the sentinel */
+};
+
+
+static uint32_t sais_chr(const struct sais_str *s, uint32_t i)
+{
+	if ( s->w != NULL )
+		return s->w[i];
+	return (i + 1 < s->n) ? (uint32_t)s->b[i] + 1 : 0;
+}
+
+
+/* start ('end' == 0) or end of each symbol's bucket in the suffix array */
+static void sais_buckets(const struct sais_str *s, uint32_t *bkt, uint32_t k,
+			 int end)
+{
+	uint32_t i, c, sum = 0;
+
+	memset(bkt, 0, k * sizeof(uint32_t));
+	for ( i = 0; i < s->n; ++i )
+		++bkt[sais_chr(s, i)];
+	for ( i = 0; i < k; ++i ) {
+		c = bkt[i];
+		sum += c;
+		bkt[i] = end ? sum : sum - c;
+	}
+}
+
+
+static void sais_induce(const struct sais_str *s, const uchar *t,
+			uint32_t *sa, uint32_t *bkt, uint32_t k)
+{
+	uint32_t i, j;
+
+	/* L type suffixes from left to right at the start of their buckets */
+	sais_buckets(s, bkt, k, 0);
+	for ( i = 0; i < s->n; ++i ) {
+		j = sa[i];
+		if ( j != SFA_EMPTY && j > 0 && !TGET(t, j - 1) )
+			sa[bkt[sais_chr(s, j - 1)]++] = j - 1;
+	}
+
+	/* then S type suffixes from right to left at the ends */
+	sais_buckets(s, bkt, k, 1);
+	for ( i = s->n; i-- > 0; ) {
+		j = sa[i];
+		if ( j != SFA_EMPTY && j > 0 && TGET(t, j - 1) )
+			sa[--bkt[sais_chr(s, j - 1)]] = j - 1;
+	}
+}
+
+
+/* sort the suffixes of 's' whose symbols are all < 'k' into 'sa' */
+static int sais(struct memmgr *mm, const struct sais_str *s, uint32_t *sa,
+		uint32_t k)
+{
+	struct sais_str rs;
+	uchar *t;
+	uint32_t *bkt, *s1;
+	uint32_t n = s->n, n1, i, j, d, pos, prev, name;
+	int diff;
+
+	if ( n == 1 ) {
+		sa[0] = 0;
+		return 0;
+	}
+
+	/* suffix types:  1 for S (smaller than the next suffix), 0 for L */
+	if ( (t = mem_get(mm, n / 8 + 1)) == NULL )
+		return -1;
+	memset(t, 0, n / 8 + 1);
+	TSET(t, n - 1);
+	for ( i = n - 1; i-- > 0; )
+		if ( sais_chr(s, i) < sais_chr(s, i + 1) ||
+		     (sais_chr(s, i) == sais_chr(s, i + 1) && TGET(t, i + 1)) )
+			TSET(t, i);
+
+	if ( (bkt = mem_get(mm, k * sizeof(uint32_t))) == NULL )
+		goto err_t;
+	sais_buckets(s, bkt, k, 1);
+	for ( i = 0; i < n; ++i )
+		sa[i] = SFA_EMPTY;
+	for ( i = 1; i < n; ++i )
+		if ( ISLMS(t, i) )
+			sa[--bkt[sais_chr(s, i)]] = i;
+	sais_induce(s, t, sa, bkt, k);
+	mem_free(mm, bkt);
+
+	/* name the sorted LMS substrings:  equal substrings share a name */
+	for ( i = 0, n1 = 0; i < n; ++i )
+		if ( ISLMS(t, sa[i]) )
+			sa[n1++] = sa[i];
+	for ( i = n1; i < n; ++i )
+		sa[i] = SFA_EMPTY;
+	name = 0;
+	prev = SFA_EMPTY;
+	for ( i = 0; i < n1; ++i ) {
+		pos = sa[i];
+		diff = (prev == SFA_EMPTY);
+		/* the unique sentinel ends every comparison in bounds */
+		for ( d = 0; !diff; ++d ) {
+			if ( sais_chr(s, pos + d) != sais_chr(s, prev + d) ||
+			     TGET(t, pos + d) != TGET(t, prev + d) )
+				diff = 1;
+			else if ( d > 0 && (ISLMS(t, pos + d) ||
+					    ISLMS(t, prev + d)) )
+				break;
+		}
+		if ( diff ) {
+			++name;
+			prev = pos;
+		}
+		/* LMS positions are at least 2 apart so this doesn't collide */
+		sa[n1 + pos / 2] = name - 1;
+	}
+	for ( i = n, j = n; i-- > n1; )
+		if ( sa[i] != SFA_EMPTY )
+			sa[--j] = sa[i];
+
+	/* sort the LMS suffixes:  recursively unless the names are unique */
+	s1 = sa + n - n1;
+	if ( name < n1 ) {
+		rs.b = NULL;
+		rs.w = s1;
+		rs.n = n1;
+		if ( sais(mm, &rs, sa, name) < 0 )
+			goto err_t;
+	} else {
+		for ( i = 0; i < n1; ++i )
+			sa[s1[i]] = i;
+	}
+
+	/* put them at the ends of their buckets and induce the rest */
+	if ( (bkt = mem_get(mm, k * sizeof(uint32_t))) == NULL )
+		goto err_t;
+	for ( i = 1, j = 0; i < n; ++i )
+		if ( ISLMS(t, i) )
+			s1[j++] = i;
+	for ( i = 0; i < n1; ++i )
+		sa[i] = s1[sa[i]];
+	for ( i = n1; i < n; ++i )
+		sa[i] = SFA_EMPTY;
+	sais_buckets(s, bkt, k, 1);
+	for ( i = n1; i-- > 0; ) {
+		j = sa[i];
+		sa[i] = SFA_EMPTY;
+		sa[--bkt[sais_chr(s, j)]] = j;
+	}
+	sais_induce(s, t, sa, bkt, k);
+
+	mem_free(mm, bkt);
+	mem_free(mm, t);
+	return 0;
+
+err_t:
+	mem_free(mm, t);
+	return -1;
+}
+
+
+int sfa_init(struct sfxarr *sfa, struct raw *str, struct memmgr *mm)
+{
+	struct sais_str s;
+	uint32_t n;
+
+	abort_unless(sfa);
+	abort_unless(str && (str->data || str->len == 0));
+	abort_unless(mm);
+
+	sfa->mm = mm;
+	sfa->str = *str;
+	sfa->sa = NULL;
+	sfa->lcp = NULL;
+	/* a 32-bit size_t can't count the bytes of the largest arrays */
+	if ( str->len > SFA_MAXLEN ||
+	     str->len > (size_t)~0 / sizeof(uint32_t) - 1 )
+		return -1;
+	n = str->len;
+
+	/* sort with the sentinel and then drop it:  it always sorts first */
+	if ( (sfa->sa = mem_get(mm, (n + 1) * sizeof(uint32_t))) == NULL )
+		return -1;
+	s.b = (const uchar *)str->data;
+	s.w = NULL;
+	s.n = n + 1;
+	if ( sais(mm, &s, sfa->sa, 257) < 0 ) {
+		sfa_clear(sfa);
+		return -1;
+	}
+	abort_unless(sfa->sa[0] == n);
+	memmove(sfa->sa, sfa->sa + 1, n * sizeof(uint32_t));
+	return 0;
+}
+
+
+int sfa_lcp(struct sfxarr *sfa)
+{
+	const uchar *s;
+	uint32_t *rank, *lcp;
+	uint32_t n, i, j, h;
+
+	abort_unless(sfa && sfa->sa);
+
+	n = sfa->str.len;
+	s = (const uchar *)sfa->str.data;
+	if ( (lcp = mem_get(sfa->mm, (n + 1) * sizeof(uint32_t))) == NULL )
+		return -1;
+	if ( (rank = mem_get(sfa->mm, (n + 1) * sizeof(uint32_t))) == NULL ) {
+		mem_free(sfa->mm, lcp);
+		return -1;
+	}
+	for ( i = 0; i < n; ++i )
+		rank[sfa->sa[i]] = i;
+
+	/* the LCP drops by at most 1 from each suffix to the next one */
+	for ( i = 0, h = 0; i < n; ++i ) {
+		if ( rank[i] == 0 ) {
+			lcp[0] = 0;
+			h = 0;
+			continue;
+		}
+		j = sfa->sa[rank[i] - 1];
+		while ( i + h < n && j + h < n && s[i + h] == s[j + h] )
+			++h;
+		lcp[rank[i]] = h;
+		if ( h > 0 )
+			--h;
+	}
+
+	mem_free(sfa->mm, rank);
+	if ( sfa->lcp != NULL )
+		mem_free(sfa->mm, sfa->lcp);
+	sfa->lcp = lcp;
+	return 0;
+}
+
+
+/*
+ * Compare the suffix at 'off' to the 'm' bytes of 'p' knowing that the
+ * first '*lcp' bytes match.  Updates '*lcp'.
+ */
+static int sfa_cmp(const struct sfxarr *sfa, uint32_t off, const uchar *p,
+		   ulong m, ulong *lcp)
+{
+	const uchar *s = (const uchar *)sfa->str.data + off;
+	ulong slen = sfa->str.len - off;
+	ulong i = *lcp;
+
+	while ( i < m && i < slen && s[i] == p[i] )
+		++i;
+	*lcp = i;
+	if ( i == m )
+		return 0;
+	if ( i == slen || s[i] < p[i] )
+		return -1;
+	return 1;
+}
+
+
+/*
+ * The first suffix that is >= 'p' ('upper' == 0) or > 'p' ('upper' != 0)
+ * comparing 'm' bytes.  The suffixes between two others share at least
+ * as long a prefix with 'p' as the lesser of the two do so comparisons
+ * can skip that much.
+ */
+static ulong sfa_bound(const struct sfxarr *sfa, const uchar *p, ulong m,
+		       int upper)
+{
+	ulong lo = 0, hi = sfa->str.len, mid;
+	ulong llo = 0, lhi = 0, l;
+	int c;
+
+	while ( lo < hi ) {
+		mid = lo + (hi - lo) / 2;
+		l = (llo < lhi) ? llo : lhi;
+		c = sfa_cmp(sfa, sfa->sa[mid], p, m, &l);
+		if ( c < 0 || (upper && c == 0) ) {
+			lo = mid + 1;
+			llo = l;
+		} else {
+			hi = mid;
+			lhi = l;
+		}
+	}
+	return lo;
+}
+
+
+ulong sfa_range(struct sfxarr *sfa, struct raw *pat, ulong *first)
+{
+	const uchar *p;
+	ulong lo, hi;
+
+	abort_unless(sfa && sfa->sa);
+	abort_unless(pat && (pat->data || pat->len == 0));
+
+	p = (const uchar *)pat->data;
+	lo = sfa_bound(sfa, p, pat->len, 0);
+	hi = sfa_bound(sfa, p, pat->len, 1);
+	if ( first != NULL )
+		*first = lo;
+	return hi - lo;
+}
+
+
+int sfa_match(struct sfxarr *sfa, struct raw *pat, ulong *loc)
+{
+	ulong first;
+
+	abort_unless(sfa && sfa->sa);
+	abort_unless(pat && (pat->data || pat->len == 0));
+
+	if ( pat->len == 0 ) {
+		if ( loc != NULL )
+			*loc = 0;
+		return 1;
+	}
+	if ( sfa_range(sfa, pat, &first) == 0 )
+		return 0;
+	if ( loc != NULL )
+		*loc = sfa->sa[first];
+	return 1;
+}
+
+
+void sfa_clear(struct sfxarr *sfa)
+{
+	abort_unless(sfa);
+	if ( sfa->sa != NULL )
+		mem_free(sfa->mm, sfa->sa);
+	if ( sfa->lcp != NULL )
+		mem_free(sfa->mm, sfa->lcp);
+	sfa->sa = NULL;
+	sfa->lcp = NULL;
+}
+
+
+#if CAT_HAS_POSIX
+
+/* magic, then byte order mark, flags and length as 32 bit words */
+static const char sfa_magic[8] = "catsfa01";
+#define SFA_BOM		0x01020304
+#define SFA_F_LCP	0x1
+#define SFA_HDRLEN	3
+
+
+int sfa_save(struct sfxarr *sfa, int fd)
+{
+	uint32_t hdr[SFA_HDRLEN];
+	ssize_t alen;
+
+	abort_unless(sfa && sfa->sa);
+	abort_unless(fd >= 0);
+
+	hdr[0] = SFA_BOM;
+	hdr[1] = (sfa->lcp != NULL) ? SFA_F_LCP : 0;
+	hdr[2] = sfa->str.len;
+	alen = (ssize_t)sfa->str.len * sizeof(uint32_t);
+	if ( io_write(fd, (void *)sfa_magic, sizeof(sfa_magic)) !=
+	     sizeof(sfa_magic) ||
+	     io_write(fd, hdr, sizeof(hdr)) != sizeof(hdr) ||
+	     io_write(fd, sfa->sa, alen) != alen )
+		return -1;
+	if ( sfa->lcp != NULL && io_write(fd, sfa->lcp, alen) != alen )
+		return -1;
+	return 0;
+}
+
+
+int sfa_load(struct sfxarr *sfa, struct raw *str, int fd, struct memmgr *mm)
+{
+	char magic[sizeof(sfa_magic)];
+	uint32_t hdr[SFA_HDRLEN];
+	ssize_t alen;
+	uint32_t i;
+
+	abort_unless(sfa);
+	abort_unless(str && (str->data || str->len == 0));
+	abort_unless(fd >= 0);
+	abort_unless(mm);
+
+	sfa->mm = mm;
+	sfa->str = *str;
+	sfa->sa = NULL;
+	sfa->lcp = NULL;
+	if ( io_read(fd, magic, sizeof(magic)) != sizeof(magic) ||
+	     memcmp(magic, sfa_magic, sizeof(magic)) != 0 ||
+	     io_read(fd, hdr, sizeof(hdr)) != sizeof(hdr) ||
+	     hdr[0] != SFA_BOM || (hdr[1] & ~SFA_F_LCP) != 0 ||
+	     str->len > SFA_MAXLEN || hdr[2] != str->len )
+		return -1;
+
+	alen = (ssize_t)str->len * sizeof(uint32_t);
+	if ( (sfa->sa = mem_get(mm, alen + sizeof(uint32_t))) == NULL )
+		return -1;
+	if ( io_read(fd, sfa->sa, alen) != alen )
+		goto err;
+	/* matching trusts the offsets:  keep a bad file from reading past */
+	for ( i = 0; i < str->len; ++i )
+		if ( sfa->sa[i] >= str->len )
+			goto err;
+	if ( (hdr[1] & SFA_F_LCP) != 0 ) {
+		sfa->lcp = mem_get(mm, alen + sizeof(uint32_t));
+		if ( sfa->lcp == NULL || io_read(fd, sfa->lcp, alen) != alen )
+			goto err;
+	}
+	return 0;
+
+err:
+	sfa_clear(sfa);
+	return -1;
+}
+
+#endif /* CAT_HAS_POSIX */
+
+
+struct acbnode {
+	uint			child;
+	uint			sibling;
+	uint			pat;
+	uchar			byte;
+};
+
+
+void ac_init(struct acpat *ac, struct memmgr *mm)
+{
+	abort_unless(ac);
+	abort_unless(mm);
+	memset(ac, 0, sizeof(*ac));
+	ac->mm = mm;
+}
+
+
+/* make room for 'n' more trie nodes */
+static int ac_trie_reserve(struct acpat *ac, size_t n)
+{
+	struct acbnode *t;
+	uint talloc;
+
+	if ( n > ((uint)~0 >> 2) / sizeof(*t) - ac->ntrie )
+		return -1;
+	if ( ac->ntrie + n <= ac->talloc )
+		return 0;
+	talloc = (ac->talloc == 0) ? 64 : ac->talloc;
+	while ( talloc < ac->ntrie + n )
+		talloc *= 2;
+	if ( !(t = mem_resize(ac->mm, ac->trie, talloc * sizeof(*t))) )
+		return -1;
+	ac->trie = t;
+	ac->talloc = talloc;
+	return 0;
+}
+
+
+static uint ac_trie_node(struct acpat *ac, uchar byte)
+{
+	struct acbnode *t;
+
+	abort_unless(ac->ntrie < ac->talloc);
+	t = &ac->trie[ac->ntrie];
+	t->child = 0;
+	t->sibling = 0;
+	t->pat = AC_NONE;
+	t->byte = byte;
+	return ac->ntrie++;
+}
+
+
+int ac_add(struct acpat *ac, const struct raw *pat)
+{
+	const uchar *p;
+	uint *plen, *pnext, palloc;
+	uint n, nn, *np;
+	size_t i;
+
+	abort_unless(ac);
+	abort_unless(pat && (pat->data || pat->len == 0));
+
+	if ( pat->len == 0 || pat->len > (uint)~0 || ac->npat == AC_NONE - 1 )
+		return -1;
+
+	if ( ac->npat == ac->palloc ) {
+		palloc = (ac->palloc == 0) ? 16 : ac->palloc * 2;
+		plen = mem_resize(ac->mm, ac->plen, palloc * sizeof(uint));
+		if ( plen == NULL )
+			return -1;
+		ac->plen = plen;
+		pnext = mem_resize(ac->mm, ac->pnext, palloc * sizeof(uint));
+		if ( pnext == NULL )
+			return -1;
+		ac->pnext = pnext;
+		ac->palloc = palloc;
+	}
+	if ( ac_trie_reserve(ac, pat->len + 1) < 0 )
+		return -1;
+	if ( ac->ntrie == 0 )
+		ac_trie_node(ac, 0);
+
+	/* children lists stay sorted by byte for ac_compile() */
+	n = 0;
+	p = (const uchar *)pat->data;
+	for ( i = 0; i < pat->len; ++i ) {
+		np = &ac->trie[n].child;
+		while ( *np != 0 && ac->trie[*np].byte < p[i] )
+			np = &ac->trie[*np].sibling;
+		if ( *np == 0 || ac->trie[*np].byte != p[i] ) {
+			nn = ac_trie_node(ac, p[i]);
+			ac->trie[nn].sibling = *np;
+			*np = nn;
+		}
+		n = *np;
+	}
+
+	ac->plen[ac->npat] = pat->len;
+	ac->pnext[ac->npat] = ac->trie[n].pat;
+	ac->trie[n].pat = ac->npat;
+	return ac->npat++;
+}
+
+
+static uint ac_goto(const struct acstate *st, uint c)
+{
+	uint32_t w = st->edges[c >> 5];
+	uint32_t bit = (uint32_t)1 << (c & 31);
+	if ( !(w & bit) )
+		return 0;
+	return st->child + st->rank[c >> 5] + pop_32(w & (bit - 1));
+}
+
+
+int ac_compile(struct acpat *ac)
+{
+	struct acstate *st;
+	struct acbnode *t;
+	uint *order, *newidx;
+	uint head, tail, i, s, c, f, g, ch;
+
+	abort_unless(ac);
+	if ( ac->states != NULL ) {
+		mem_free(ac->mm, ac->states);
+		ac->states = NULL;
+		ac->nstates = 0;
+	}
+	if ( ac->ntrie == 0 ) {
+		if ( ac_trie_reserve(ac, 1) < 0 )
+			return -1;
+		ac_trie_node(ac, 0);
+	}
+
+	t = ac->trie;
+	order = mem_get(ac->mm, ac->ntrie * sizeof(uint));
+	newidx = mem_get(ac->mm, ac->ntrie * sizeof(uint));
+	st = mem_get(ac->mm, ac->ntrie * sizeof(*st));
+	if ( order == NULL || newidx == NULL || st == NULL ) {
+		if ( order != NULL )
+			mem_free(ac->mm, order);
+		if ( newidx != NULL )
+			mem_free(ac->mm, newidx);
+		if ( st != NULL )
+			mem_free(ac->mm, st);
+		return -1;
+	}
+
+	/* number the states breadth first so siblings are consecutive */
+	order[0] = 0;
+	newidx[0] = 0;
+	for ( head = 0, tail = 1; head < tail; ++head ) {
+		for ( ch = t[order[head]].child; ch != 0; ch = t[ch].sibling ) {
+			newidx[ch] = tail;
+			order[tail++] = ch;
+		}
+	}
+	abort_unless(tail == ac->ntrie);
+
+	for ( s = 0; s < ac->ntrie; ++s ) {
+		memset(st[s].edges, 0, sizeof(st[s].edges));
+		ch = t[order[s]].child;
+		st[s].child = (ch != 0) ? newidx[ch] : 0;
+		st[s].pat = t[order[s]].pat;
+		st[s].fail = 0;
+		st[s].dict = 0;
+		for ( ; ch != 0; ch = t[ch].sibling )
+			st[s].edges[t[ch].byte >> 5] |=
+				(uint32_t)1 << (t[ch].byte & 31);
+		for ( c = 0, i = 0; i < 8; ++i ) {
+			st[s].rank[i] = c;
+			c += pop_32(st[s].edges[i]);
+		}
+	}
+
+	/* breadth first order means fail states are done before they're used */
+	for ( s = 0; s < ac->ntrie; ++s ) {
+		for ( ch = t[order[s]].child; ch != 0; ch = t[ch].sibling ) {
+			c = newidx[ch];
+			f = 0;
+			if ( s != 0 ) {
+				f = st[s].fail;
+				while ( (g = ac_goto(&st[f], t[ch].byte)) == 0 &&
+					f != 0 )
+					f = st[f].fail;
+				f = g;
+			}
+			st[c].fail = f;
+			st[c].dict = (st[f].pat != AC_NONE) ? f : st[f].dict;
+		}
+	}
+
+	mem_free(ac->mm, order);
+	mem_free(ac->mm, newidx);
+	ac->states = st;
+	ac->nstates = ac->ntrie;
+	return 0;
+}
+
+
+void ac_scan_init(struct acscan *scan)
+{
+	abort_unless(scan);
+	scan->state = 0;
+	scan->off = 0;
+}
+
+
+int ac_scan(struct acpat *ac, struct acscan *scan, const struct raw *buf,
+	    ac_report_f report, void *ctx)
+{
+	const struct acstate *st;
+	const uchar *p, *end;
+	ulong off;
+	uint s, n, m, pat;
+	int rv;
+
+	abort_unless(ac && ac->states);
+	abort_unless(scan);
+	abort_unless(buf && (buf->data || buf->len == 0));
+	abort_unless(report);
+
+	st = ac->states;
+	s = scan->state;
+	off = scan->off;
+	p = (const uchar *)buf->data;
+	end = p + buf->len;
+	while ( p < end ) {
+		while ( (n = ac_goto(&st[s], *p)) == 0 && s != 0 )
+			s = st[s].fail;
+		s = n;
+		++p;
+		++off;
+		m = (st[s].pat != AC_NONE) ? s : st[s].dict;
+		for ( ; m != 0; m = st[m].dict ) {
+			for ( pat = st[m].pat; pat != AC_NONE; 
+			      pat = ac->pnext[pat] ) {
+				rv = (*report)(pat, off - ac->plen[pat], ctx);
+				if ( rv != 0 ) {
+					scan->state = s;
+					scan->off = off;
+					return rv;
+				}
+			}
+		}
+	}
+	scan->state = s;
+	scan->off = off;
+	return 0;
+}
+
+
+int ac_match(struct acpat *ac, const struct raw *str, ac_report_f report,
+	     void *ctx)
+{
+	struct acscan scan;
+	ac_scan_init(&scan);
+	return ac_scan(ac, &scan, str, report, ctx);
+}
+
+
+void ac_free(struct acpat *ac)
+{
+	abort_unless(ac);
+	if ( ac->states != NULL )
+		mem_free(ac->mm, ac->states);
+	if ( ac->trie != NULL )
+		mem_free(ac->mm, ac->trie);
+	if ( ac->plen != NULL )
+		mem_free(ac->mm, ac->plen);
+	if ( ac->pnext != NULL )
+		mem_free(ac->mm, ac->pnext);
+	ac->states = NULL;
+	ac->trie = NULL;
+	ac->plen = NULL;
+	ac->pnext = NULL;
+	ac->nstates = ac->ntrie = ac->talloc = 0;
+	ac->npat = ac->palloc = 0;
+}
+
+
 struct rex_parse_aux {
 	struct memmgr *mm;
 	struct rex_group *initial;
@@ -623,7 +1506,7 @@ static int rex_parse_str(struct rex_node **rxnn, uchar *p,
 				return rex_parse_error(rxnn, aux, p);
 			*s++ = *(p + 1);
 			p += 2;
-			--maxlen;
+			maxlen -= 2;
 			++len;
 		}
 	} while ( maxlen > 0 );
@@ -640,6 +1523,7 @@ static int rex_parse_str(struct rex_node **rxnn, uchar *p,
 				return rex_parse_error(rxnn, aux, NULL);
 			rs->len -= 1;
 			*rxnn = (struct rex_node *)rs2;
+			rs2->str[0] = rs->str[rs->len];
 			rs2->base.type = REX_T_STRING;
 			rs2->base.repmin = rs->base.repmin;
 			rs2->base.repmax = rs->base.repmax;
@@ -670,7 +1554,7 @@ static int rex_parse_class(struct rex_node **rxnn, uchar *p,
 	for ( ; end < aux->end && *end != ']'; ++end )
 		;
 	if ( end == start || end == aux->end )
-		rex_parse_error(rxnn, aux, p - 1);
+		return rex_parse_error(rxnn, aux, p);
 
 	if ( !(rxc = mem_get(aux->mm, sizeof(*rxc))) )
 		return rex_parse_error(rxnn, aux, NULL);
@@ -964,6 +1848,7 @@ int rex_init(struct rex_pat *rxp, struct raw *pat, struct memmgr *mm,
 	rxp->end.other = &rxp->start;
 
 	rxp->mm = mm;
+	rxp->dfa = NULL;
 	aux.mm = rxp->mm;
 	aux.initial = &rxp->start;
 	aux.final = &rxp->end;
@@ -1006,13 +1891,612 @@ static void rex_free_help(struct rex_node *node, struct rex_node *end,
 }
 
 
+static void rex_dfa_free(struct rex_dfa *d, struct memmgr *mm);
+
+
 void rex_free(struct rex_pat *rxp)
 {
 	abort_unless(rxp);
+	if ( rxp->dfa != NULL ) {
+		rex_dfa_free(rxp->dfa, rxp->mm);
+		rxp->dfa = NULL;
+	}
 	rex_free_help(&rxp->start.base, &rxp->end.base, rxp->mm);
 }
 
 
+/*
+ * The DFA matcher works on an NFA of the _reversed_ pattern.  Scanning
+ * the string from its end towards its start while adding the NFA's start
+ * state at every position finds every position where some match starts
+ * (the NFA reaches its MATCH state) in a single pass.  The leftmost of
+ * those is where the backtracking matcher would find its match.  A
+ * rex_set instead combines forward NFAs of several patterns, each ending
+ * in its own MATCH state, and scans forward from the start of the string.
+ * NFAs get built in continuation passing style:  each node compiles to a
+ * fragment that enters the state for the rest of the pattern when it
+ * finishes, so there are no dangling edges to patch up.
+ */
+
+#define REX_NS_BYTE	0	/* consume byte 'out1' then go to 'out' */
+#define REX_NS_SET	1	/* consume a byte in 'set' then go to 'out' */
+#define REX_NS_SPLIT	2	/* go to both 'out' and 'out1' */
+#define REX_NS_BOL	3	/* go to 'out' at the start of the string */
+#define REX_NS_EOL	4	/* go to 'out' at the end of the string */
+#define REX_NS_MATCH	5	/* pattern 'out1' matched w/ priority 'out' */
+
+#define REX_F_BOL	1
+#define REX_F_EOL	2
+
+struct rex_nstate {
+	int			type;
+	int			out;
+	int			out1;
+	const uchar *		set;
+};
+
+struct rex_dset {
+	uint			n;
+	int *			states;
+};
+
+struct rex_dstate {
+	struct hnode		hn;
+	struct rex_dset		set;
+	int			accept;
+	struct rex_dstate *	lnext;
+	struct rex_dstate *	next[256];
+};
+
+struct rex_dfa {
+	struct rex_nstate *	nfa;
+	uint			nn;
+	uint			nalloc;
+	int			start;
+	int			reverse;
+	uint			npat;
+	struct memmgr *		mm;
+	struct htab		tab;
+	struct rex_dstate *	states;
+	uint			ndstates;
+	uint			maxstates;
+	uint			nflush;
+	int *			set;
+	int *			stack;
+	uint *			mark;
+	uint			gen;
+	int			acc;
+	int			accpri;
+	struct rex_dstate *	init;
+	uint			initflush;
+};
+
+
+#define int_lt(a, b) ((a) < (b))
+CAT_SORT_DEFINE(rex_sort_states, int, int_lt)
+
+
+static int rex_nfa_add(struct rex_dfa *d, int type, int out, int out1,
+		       const uchar *set)
+{
+	struct rex_nstate *ns;
+	uint nalloc;
+
+	if ( out < 0 || out1 < 0 || d->nn >= REX_NFA_MAX )
+		return -1;
+	if ( d->nn == d->nalloc ) {
+		nalloc = (d->nalloc == 0) ? 64 : d->nalloc * 2;
+		ns = mem_resize(d->mm, d->nfa, nalloc * sizeof(*ns));
+		if ( ns == NULL )
+			return -1;
+		d->nfa = ns;
+		d->nalloc = nalloc;
+	}
+	ns = &d->nfa[d->nn];
+	ns->type = type;
+	ns->out = out;
+	ns->out1 = out1;
+	ns->set = set;
+	return d->nn++;
+}
+
+
+static int rex_nfa_list(struct rex_dfa *d, struct rex_node *rxn,
+			struct rex_node *end, int cont);
+
+
+/* compile a single repetition of 'rxn' */
+static int rex_nfa_unit(struct rex_dfa *d, struct rex_node *rxn, int cont)
+{
+	struct rex_node_str *rs;
+	struct rex_group *rg;
+	ulong i;
+
+	switch ( rxn->type ) {
+	case REX_T_STRING:
+		rs = (struct rex_node_str *)rxn;
+		for ( i = 0; i < rs->len; ++i )
+			cont = rex_nfa_add(d, REX_NS_BYTE, cont,
+					   rs->str[d->reverse ? i : rs->len-i-1],
+					   NULL);
+		return cont;
+	case REX_T_CLASS:
+		return rex_nfa_add(d, REX_NS_SET, cont, 0,
+				   ((struct rex_ascii_class *)rxn)->set);
+	case REX_T_BANCHOR:
+		return rex_nfa_add(d, REX_NS_BOL, cont, 0, NULL);
+	case REX_T_EANCHOR:
+		return rex_nfa_add(d, REX_NS_EOL, cont, 0, NULL);
+	case REX_T_GROUP_S:
+		rg = (struct rex_group *)rxn;
+		return rex_nfa_list(d, rxn->next, &rg->other->base, cont);
+	default:
+		return -1;
+	}
+}
+
+
+/* compile 'rxn' with its repetitions:  the order of copies doesn't matter */
+static int rex_nfa_rep(struct rex_dfa *d, struct rex_node *rxn, int cont)
+{
+	int i, s, body;
+
+	if ( rxn->repmax == REX_WILDCARD ) {
+		if ( (s = rex_nfa_add(d, REX_NS_SPLIT, 0, cont, NULL)) < 0 )
+			return -1;
+		if ( (body = rex_nfa_unit(d, rxn, s)) < 0 )
+			return -1;
+		d->nfa[s].out = body;
+		cont = s;
+	} else {
+		for ( i = rxn->repmin; i < rxn->repmax; ++i ) {
+			body = rex_nfa_unit(d, rxn, cont);
+			cont = rex_nfa_add(d, REX_NS_SPLIT, body, cont, NULL);
+		}
+	}
+	for ( i = 0; i < rxn->repmin; ++i )
+		cont = rex_nfa_unit(d, rxn, cont);
+	return cont;
+}
+
+
+static struct rex_node *rex_nfa_skip(struct rex_node *rxn)
+{
+	if ( rxn->type == REX_T_GROUP_S )
+		return ((struct rex_group *)rxn)->other->base.next;
+	return rxn->next;
+}
+
+
+/*
+ * Walking the list forward builds the reversed pattern, since each node
+ * continues into the nodes before it.  The forward pattern has to build
+ * the rest of the list first.
+ */
+static int rex_nfa_list(struct rex_dfa *d, struct rex_node *rxn,
+			struct rex_node *end, int cont)
+{
+	struct rex_choice *rc;
+	int o1, o2;
+
+	while ( rxn != NULL && rxn != end && cont >= 0 ) {
+		/* a choice spans the rest of the group */
+		if ( rxn->type == REX_T_CHOICE ) {
+			rc = (struct rex_choice *)rxn;
+			o1 = rex_nfa_list(d, rc->opt1, end, cont);
+			o2 = rex_nfa_list(d, rc->opt2, end, cont);
+			return rex_nfa_add(d, REX_NS_SPLIT, o1, o2, NULL);
+		}
+		if ( !d->reverse ) {
+			cont = rex_nfa_list(d, rex_nfa_skip(rxn), end, cont);
+			return (cont < 0) ? -1 : rex_nfa_rep(d, rxn, cont);
+		}
+		cont = rex_nfa_rep(d, rxn, cont);
+		rxn = rex_nfa_skip(rxn);
+	}
+	return cont;
+}
+
+
+static uint rex_dset_hash(const void *key, void *unused)
+{
+	const struct rex_dset *ds = key;
+	uint h = 0x811c9dc5;
+	uint i;
+	for ( i = 0; i < ds->n; ++i )
+		h = (h ^ (uint)ds->states[i]) * 0x01000193;
+	return h;
+}
+
+
+static int rex_dset_cmp(const void *k1, const void *k2)
+{
+	const struct rex_dset *a = k1, *b = k2;
+	if ( a->n != b->n )
+		return (a->n < b->n) ? -1 : 1;
+	return memcmp(a->states, b->states, a->n * sizeof(int));
+}
+
+
+static void rex_dfa_flush(struct rex_dfa *d)
+{
+	struct rex_dstate *ds;
+	while ( (ds = d->states) != NULL ) {
+		d->states = ds->lnext;
+		ht_rem(&ds->hn);
+		mem_free(d->mm, ds);
+	}
+	d->ndstates = 0;
+	++d->nflush;
+}
+
+
+static void rex_dfa_free(struct rex_dfa *d, struct memmgr *mm)
+{
+	rex_dfa_flush(d);
+	mem_free(mm, d->tab.bkts);
+	if ( d->nfa != NULL )
+		mem_free(mm, d->nfa);
+	if ( d->set != NULL )
+		mem_free(mm, d->set);
+	if ( d->stack != NULL )
+		mem_free(mm, d->stack);
+	if ( d->mark != NULL )
+		mem_free(mm, d->mark);
+	mem_free(mm, d);
+}
+
+
+static struct rex_dfa *rex_dfa_new(struct memmgr *mm, uint maxstates,
+				   int reverse)
+{
+	struct rex_dfa *d;
+	struct hnode **bkts;
+	uint nbkts;
+
+	if ( maxstates == 0 )
+		maxstates = REX_DFA_DEFSTATES;
+	for ( nbkts = 16; nbkts < maxstates && nbkts < 0x10000; nbkts <<= 1 )
+		;
+
+	if ( !(d = mem_get(mm, sizeof(*d))) )
+		return NULL;
+	memset(d, 0, sizeof(*d));
+	d->mm = mm;
+	d->maxstates = maxstates;
+	d->reverse = reverse;
+	d->start = -1;
+	if ( !(bkts = mem_get(mm, nbkts * sizeof(*bkts))) ) {
+		mem_free(mm, d);
+		return NULL;
+	}
+	ht_init(&d->tab, bkts, nbkts, rex_dset_cmp, rex_dset_hash, NULL);
+	return d;
+}
+
+
+/* size the scratch space to the NFA */
+static int rex_dfa_scratch(struct rex_dfa *d)
+{
+	int *set, *stack;
+	uint *mark;
+
+	/* every state can be pushed once per edge into it plus as a seed */
+	if ( !(set = mem_resize(d->mm, d->set, d->nn * sizeof(int))) )
+		return -1;
+	d->set = set;
+	stack = mem_resize(d->mm, d->stack, (3 * d->nn + 1) * sizeof(int));
+	if ( stack == NULL )
+		return -1;
+	d->stack = stack;
+	if ( !(mark = mem_resize(d->mm, d->mark, d->nn * sizeof(uint))) )
+		return -1;
+	d->mark = mark;
+	memset(d->mark, 0, d->nn * sizeof(uint));
+	d->gen = 0;
+	return 0;
+}
+
+
+int rex_compile(struct rex_pat *rxp, uint maxstates)
+{
+	struct rex_dfa *d;
+	int match;
+
+	abort_unless(rxp);
+	if ( rxp->dfa != NULL )
+		return 0;
+	if ( !(d = rex_dfa_new(rxp->mm, maxstates, 1)) )
+		return -1;
+
+	match = rex_nfa_add(d, REX_NS_MATCH, 0, 0, NULL);
+	d->start = rex_nfa_list(d, rxp->start.base.next, &rxp->end.base,
+				match);
+	if ( d->start < 0 || rex_dfa_scratch(d) < 0 ) {
+		rex_dfa_free(d, rxp->mm);
+		return -1;
+	}
+
+	rxp->dfa = d;
+	return 0;
+}
+
+
+/*
+ * Advance the NFA states in 'set' over 'c' (or start from scratch if 'c'
+ * < 0) and store the epsilon closure under 'flags' in d->set.  Reverse
+ * DFAs add the start state at every position.  Only byte consuming
+ * states and match states are kept since they alone determine future
+ * behavior.  d->acc gets the pattern with the highest priority MATCH
+ * state or -1.  Returns the number of states.
+ */
+static uint rex_dfa_step(struct rex_dfa *d, const int *set, uint n, int c,
+			 int flags)
+{
+	struct rex_nstate *ns;
+	uint i, sp = 0, nout = 0;
+	int s;
+
+	if ( ++d->gen == 0 ) {
+		memset(d->mark, 0, d->nn * sizeof(uint));
+		d->gen = 1;
+	}
+	d->acc = -1;
+
+	if ( c < 0 || d->reverse )
+		d->stack[sp++] = d->start;
+	for ( i = 0; c >= 0 && i < n; ++i ) {
+		ns = &d->nfa[set[i]];
+		if ( (ns->type == REX_NS_BYTE && ns->out1 == c) ||
+		     (ns->type == REX_NS_SET &&
+		      (ns->set[c >> 3] & (1 << (c & 0x7)))) )
+			d->stack[sp++] = ns->out;
+	}
+
+	while ( sp > 0 ) {
+		s = d->stack[--sp];
+		if ( d->mark[s] == d->gen )
+			continue;
+		d->mark[s] = d->gen;
+		ns = &d->nfa[s];
+		switch ( ns->type ) {
+		case REX_NS_SPLIT:
+			d->stack[sp++] = ns->out1;
+			d->stack[sp++] = ns->out;
+			break;
+		case REX_NS_BOL:
+			if ( (flags & REX_F_BOL) )
+				d->stack[sp++] = ns->out;
+			break;
+		case REX_NS_EOL:
+			if ( (flags & REX_F_EOL) )
+				d->stack[sp++] = ns->out;
+			break;
+		case REX_NS_MATCH:
+			if ( d->acc < 0 || ns->out < d->accpri ) {
+				d->acc = ns->out1;
+				d->accpri = ns->out;
+			}
+			/* fall through */
+		default:
+			d->set[nout++] = s;
+		}
+	}
+
+	rex_sort_states(d->set, nout);
+	return nout;
+}
+
+
+/* find or create the DFA state for the first 'n' states of d->set */
+static struct rex_dstate *rex_dfa_state(struct rex_dfa *d, uint n)
+{
+	struct rex_dset key;
+	struct rex_dstate *ds;
+	struct hnode *hn;
+	uint h;
+
+	key.n = n;
+	key.states = d->set;
+	if ( (hn = ht_lkup(&d->tab, &key, &h)) != NULL )
+		return container(hn, struct rex_dstate, hn);
+
+	if ( d->ndstates >= d->maxstates )
+		rex_dfa_flush(d);
+	if ( !(ds = mem_get(d->mm, sizeof(*ds) + n * sizeof(int))) )
+		return NULL;
+	memset(ds->next, 0, sizeof(ds->next));
+	ds->set.n = n;
+	ds->set.states = (int *)(ds + 1);
+	memcpy(ds->set.states, d->set, n * sizeof(int));
+	ds->accept = d->acc;
+	ht_ninit(&ds->hn, &ds->set);
+	ht_ins(&d->tab, &ds->hn, h);
+	ds->lnext = d->states;
+	d->states = ds;
+	++d->ndstates;
+	return ds;
+}
+
+
+/* build (and cache) the transition from 'cur' over 'c' mid-string */
+static struct rex_dstate *rex_dfa_miss(struct rex_dfa *d,
+				       struct rex_dstate *cur, int c)
+{
+	struct rex_dstate *nxt;
+	uint n, nflush;
+
+	n = rex_dfa_step(d, cur->set.states, cur->set.n, c, 0);
+	nflush = d->nflush;
+	if ( (nxt = rex_dfa_state(d, n)) != NULL && nflush == d->nflush )
+		cur->next[c] = nxt;
+	return nxt;
+}
+
+
+/*
+ * Scan 'str' backwards.  Sets '*from' to the leftmost position a match
+ * can start from or to any such position if 'first' is set.
+ */
+static int rex_dfa_scan(struct rex_dfa *d, struct raw *str, int first,
+			size_t *from)
+{
+	const uchar *p = (const uchar *)str->data;
+	struct rex_dstate *cur, *nxt;
+	size_t i = str->len;
+	int found = 0;
+
+	if ( i == 0 ) {
+		rex_dfa_step(d, NULL, 0, -1, REX_F_BOL|REX_F_EOL);
+		*from = 0;
+		return (d->acc >= 0) ? REX_MATCH : REX_NOMATCH;
+	}
+
+	if ( !(cur = rex_dfa_state(d, rex_dfa_step(d, NULL, 0, -1, REX_F_EOL))) )
+		return REX_ERROR;
+	if ( cur->accept >= 0 ) {
+		*from = i;
+		if ( first )
+			return REX_MATCH;
+		found = 1;
+	}
+
+	while ( --i > 0 ) {
+		if ( (nxt = cur->next[p[i]]) == NULL &&
+		     (nxt = rex_dfa_miss(d, cur, p[i])) == NULL )
+			return REX_ERROR;
+		cur = nxt;
+		if ( cur->accept >= 0 ) {
+			*from = i;
+			if ( first )
+				return REX_MATCH;
+			found = 1;
+		}
+	}
+
+	/* the start of the string needs the BOL assertions:  don't cache */
+	rex_dfa_step(d, cur->set.states, cur->set.n, p[0], REX_F_BOL);
+	if ( d->acc >= 0 ) {
+		*from = 0;
+		found = 1;
+	}
+
+	return found ? REX_MATCH : REX_NOMATCH;
+}
+
+
+int rex_set_init(struct rex_set *rs, struct memmgr *mm, uint maxstates)
+{
+	abort_unless(rs);
+	abort_unless(mm);
+	rs->dfa = rex_dfa_new(mm, maxstates, 0);
+	return (rs->dfa == NULL) ? -1 : 0;
+}
+
+
+int rex_set_add(struct rex_set *rs, struct rex_pat *rxp, int id)
+{
+	struct rex_dfa *d;
+	uint onn;
+	int match, start;
+
+	abort_unless(rs && rs->dfa);
+	abort_unless(rxp);
+	abort_unless(id >= 0);
+
+	d = rs->dfa;
+	onn = d->nn;
+	match = rex_nfa_add(d, REX_NS_MATCH, d->npat, id, NULL);
+	start = rex_nfa_list(d, rxp->start.base.next, &rxp->end.base, match);
+	if ( start >= 0 && d->start >= 0 )
+		start = rex_nfa_add(d, REX_NS_SPLIT, d->start, start, NULL);
+	if ( start < 0 || rex_dfa_scratch(d) < 0 ) {
+		d->nn = onn;
+		return -1;
+	}
+
+	/* cached DFA states don't know about the new pattern */
+	rex_dfa_flush(d);
+	d->start = start;
+	++d->npat;
+	return 0;
+}
+
+
+int rex_set_match(struct rex_set *rs, struct raw *str, int *id, size_t *len)
+{
+	struct rex_dfa *d;
+	struct rex_dstate *cur, *nxt;
+	const uchar *p;
+	size_t i;
+	uint n;
+	int flags;
+
+	abort_unless(rs && rs->dfa);
+	if ( str == NULL || str->data == NULL )
+		return REX_ERROR;
+
+	d = rs->dfa;
+	*id = -1;
+	if ( d->start < 0 )
+		return REX_NOMATCH;
+	p = (const uchar *)str->data;
+
+	/* the start state only depends on whether the string is empty */
+	if ( str->len > 0 && d->init != NULL && d->initflush == d->nflush ) {
+		cur = d->init;
+	} else {
+		flags = REX_F_BOL | ((str->len == 0) ? REX_F_EOL : 0);
+		n = rex_dfa_step(d, NULL, 0, -1, flags);
+		if ( !(cur = rex_dfa_state(d, n)) )
+			return REX_ERROR;
+		if ( str->len > 0 ) {
+			d->init = cur;
+			d->initflush = d->nflush;
+		}
+	}
+	if ( cur->accept >= 0 ) {
+		*id = cur->accept;
+		*len = 0;
+	}
+
+	/* longest match wins:  keep going until no pattern can match */
+	for ( i = 0; i < str->len && cur->set.n > 0; ++i ) {
+		if ( i == str->len - 1 ) {
+			/* the end of the string needs the EOL assertions */
+			rex_dfa_step(d, cur->set.states, cur->set.n, p[i],
+				     REX_F_EOL);
+			if ( d->acc >= 0 ) {
+				*id = d->acc;
+				*len = i + 1;
+				return REX_MATCH;
+			}
+			break;
+		}
+		if ( (nxt = cur->next[p[i]]) == NULL &&
+		     (nxt = rex_dfa_miss(d, cur, p[i])) == NULL )
+			return REX_ERROR;
+		cur = nxt;
+		if ( cur->accept >= 0 ) {
+			*id = cur->accept;
+			*len = i + 1;
+		}
+	}
+
+	return (*id >= 0) ? REX_MATCH : REX_NOMATCH;
+}
+
+
+void rex_set_free(struct rex_set *rs)
+{
+	abort_unless(rs);
+	if ( rs->dfa != NULL ) {
+		rex_dfa_free(rs->dfa, rs->dfa->mm);
+		rs->dfa = NULL;
+	}
+}
+
+
 struct rex_match_aux {
 	char *start;
 	char *end;
@@ -1047,14 +2531,19 @@ static int rex_match_string(struct rex_node *rxn, char *cur, unsigned rep,
 		            struct rex_match_aux *aux)
 {
 	struct rex_node_str *rs = (struct rex_node_str *)rxn;
+	int rv;
+
 	if ( ((aux->end - cur) >= rs->len) &&
 	     (memcmp(rs->str, cur, rs->len) == 0) ) {
-		return rex_next(rxn, cur + rs->len, rep + 1, aux);
-	} else if ( rxn->repmin == 0 && rep == 0 ) { 
-		return rex_match_rxn(rxn->next, cur, 0, aux);
-	} else { 
-		return REX_NOMATCH;
+		rv = rex_next(rxn, cur + rs->len, rep + 1, aux);
+		if ( rv != REX_NOMATCH )
+			return rv;
 	}
+
+	if ( rxn->repmin == 0 && rep == 0 )
+		return rex_match_rxn(rxn->next, cur, 0, aux);
+
+	return REX_NOMATCH;
 }
 
 
@@ -1062,14 +2551,17 @@ static int rex_match_class(struct rex_node *rxn, char *cur, unsigned rep,
 		           struct rex_match_aux *aux)
 {
 	struct rex_ascii_class *rac = (struct rex_ascii_class *)rxn;
-	int i, j;
+	int i, j, rv;
 
 	if ( aux->end - cur > 0 ) {
 		i = *(uchar *)cur;
 		j = i >> 3;
 		i &= 0x7;
-		if ( (rac->set[j] & (1 << i)) )
-			return rex_next(rxn, cur + 1, rep + 1, aux);
+		if ( (rac->set[j] & (1 << i)) ) {
+			rv = rex_next(rxn, cur + 1, rep + 1, aux);
+			if ( rv != REX_NOMATCH )
+				return rv;
+		}
 	}
 
 	if ( rxn->repmin == 0 && rep == 0 )
@@ -1111,16 +2603,14 @@ static int rex_match_group_s(struct rex_node *rxn, char *cur, unsigned rep,
 
 	rv = rex_match_rxn(rxn->next, cur, 0, new_aux);
 
-	if ( rv != REX_ERROR ) {
-		if ( rv == REX_NOMATCH && rxn->repmin == 0 && rep == 0 ) {
-			/* we are doing the job of the end group here */
-			if ( rg->num < aux->nmatch && 
-			     !aux->match[rg->num].valid ) {
-				aux->match[rg->num].valid = 1;
-				aux->match[rg->num].start = cur - aux->start;
-				aux->match[rg->num].len = 0;
-			}
-			rv = rex_match_rxn(rg->other->base.next, cur, 0, aux);
+	if ( rv == REX_NOMATCH && rxn->repmin == 0 && rep == 0 ) {
+		/* we are doing the job of the end group here */
+		rv = rex_match_rxn(rg->other->base.next, cur, 0, aux);
+		if ( rv == REX_MATCH && rg->num < aux->nmatch && 
+		     !aux->match[rg->num].valid ) {
+			aux->match[rg->num].valid = 1;
+			aux->match[rg->num].start = cur - aux->start;
+			aux->match[rg->num].len = 0;
 		}
 	}
 
@@ -1202,6 +2692,7 @@ int rex_match(struct rex_pat *rxp, struct raw *str, struct rex_match_loc *m,
 	      uint nm)
 {
 	struct rex_match_aux aux;
+	size_t from = 0;
 	char *cur;
 	int rv;
 
@@ -1217,16 +2708,27 @@ int rex_match(struct rex_pat *rxp, struct raw *str, struct rex_match_loc *m,
 	aux.end = str->data + str->len;
 	aux.match = m;
 	aux.nmatch = nm;
-	memset(m, 0, sizeof(*m) * nm);
+	if ( nm > 0 )
+		memset(m, 0, sizeof(*m) * nm);
+
+	/* the DFA finds where the leftmost match starts (if any) in linear */
+	/* time:  only backtrack from there to fill in the match locations */
+	if ( rxp->dfa != NULL ) {
+		rv = rex_dfa_scan(rxp->dfa, str, nm == 0, &from);
+		if ( rv == REX_NOMATCH || (rv == REX_MATCH && nm == 0) )
+			return rv;
+		if ( rv == REX_ERROR )
+			from = 0;
+	}
 
 	/* if all paths start with a start anchor don't search */
 	/* the entire string: stop and return here */
-	aux.gstart = aux.start;
+	aux.gstart = aux.start + from;
 	rv = rex_match_rxn(&rxp->start.base, aux.gstart, 0, &aux);
 	if ( rv != REX_NOMATCH || rxp->start_anchor || aux.gstart == aux.end )
 		return rv;
 
-	for ( cur = aux.start + 1; cur < aux.end; ++cur ) {
+	for ( cur = aux.gstart + 1; cur <= aux.end; ++cur ) {
 		aux.gstart = cur;
 		rv = rex_match_rxn(&rxp->start.base, cur, 0, &aux);
 		if ( rv != REX_NOMATCH )
@@ -10,6 +10,7 @@
 #include <cat/cat.h>
 #include <cat/mem.h>
 #include <stdlib.h>
+#include <string.h>
 
 
 void *mem_get(struct memmgr *mm, size_t len)
@@ -114,6 +115,192 @@ size_t amm_get_avail(struct arraymm *amm)
 }
 
 
+#define ARENA_HDRSZ	sizeof(union arena_chunk_u)
+
+
+static void arena_free_chunk(struct arena *a, union arena_chunk_u *c)
+{
+	if ( c->c.len == a->chunksz && a->spare == NULL )
+		a->spare = c;
+	else
+		mem_free(a->pmm, c);
+}
+
+
+static int arena_grow(struct arena *a, size_t alen)
+{
+	union arena_chunk_u *c;
+	size_t clen = a->chunksz;
+
+	if ( alen > clen - ARENA_HDRSZ ) {
+		if ( alen > (size_t)~0 - ARENA_HDRSZ )
+			return -1;
+		clen = alen + ARENA_HDRSZ;
+	}
+
+	if ( clen == a->chunksz && a->spare != NULL ) {
+		c = a->spare;
+		a->spare = NULL;
+	} else if ( (c = mem_get(a->pmm, clen)) == NULL ) {
+		return -1;
+	}
+
+	c->c.prev = a->chunks;
+	c->c.len = clen;
+	a->chunks = c;
+	a->next = (byte_t *)(c + 1);
+	a->end = (byte_t *)c + clen;
+	return 0;
+}
+
+
+void *arena_alloc(struct arena *a, size_t len)
+{
+	size_t alen;
+	byte_t *p;
+
+	abort_unless(a);
+
+	alen = CAT_ALIGN_SIZE(len > 0 ? len : 1);
+	if ( alen < len )
+		return NULL;
+	if ( alen > (size_t)(a->end - a->next) && arena_grow(a, alen) < 0 )
+		return NULL;
+	p = a->next;
+	a->next += alen;
+	a->last = p;
+	return p;
+}
+
+
+static void *arena_mm_alloc(struct memmgr *mm, size_t len)
+{
+	return arena_alloc(container(mm, struct arena, mm), len);
+}
+
+
+static void arena_mm_free(struct memmgr *mm, void *mem)
+{
+	struct arena *a = container(mm, struct arena, mm);
+
+	/* only the most recent allocation can be given back right away */
+	if ( mem != NULL && mem == a->last ) {
+		a->next = a->last;
+		a->last = NULL;
+	}
+}
+
+
+static void *arena_mm_resize(struct memmgr *mm, void *old, size_t len)
+{
+	struct arena *a = container(mm, struct arena, mm);
+	union arena_chunk_u *c;
+	size_t alen, olen;
+	void *mem;
+
+	if ( old == NULL )
+		return arena_alloc(a, len);
+	if ( len == 0 ) {
+		arena_mm_free(mm, old);
+		return NULL;
+	}
+
+	alen = CAT_ALIGN_SIZE(len);
+	if ( alen < len )
+		return NULL;
+
+	if ( old == a->last ) {
+		if ( alen <= (size_t)(a->end - a->last) ) {
+			a->next = a->last + alen;
+			return old;
+		}
+		olen = a->next - a->last;
+	} else {
+		/* size unknown:  may copy past the block, but stays in bounds */
+		for ( c = a->chunks ; c != NULL ; c = c->c.prev )
+			if ( (byte_t *)old > (byte_t *)c &&
+			     (byte_t *)old < (byte_t *)c + c->c.len )
+				break;
+		abort_unless(c != NULL);
+		olen = (byte_t *)c + c->c.len - (byte_t *)old;
+	}
+
+	if ( (mem = arena_alloc(a, len)) == NULL )
+		return NULL;
+	memmove(mem, old, olen < len ? olen : len);
+	return mem;
+}
+
+
+void arena_init(struct arena *a, struct memmgr *pmm, size_t chunksz)
+{
+	abort_unless(a && pmm);
+
+	if ( chunksz == 0 )
+		chunksz = ARENA_DEF_CHUNK;
+	chunksz = CAT_ALIGN_SIZE(chunksz);
+	abort_unless(chunksz > ARENA_HDRSZ);
+
+	a->mm.mm_alloc = arena_mm_alloc;
+	a->mm.mm_resize = arena_mm_resize;
+	a->mm.mm_free = arena_mm_free;
+	a->mm.mm_ctx = a;
+	a->pmm = pmm;
+	a->chunks = NULL;
+	a->spare = NULL;
+	a->next = NULL;
+	a->end = NULL;
+	a->last = NULL;
+	a->chunksz = chunksz;
+}
+
+
+void arena_mark(struct arena *a, struct arena_mark *m)
+{
+	abort_unless(a && m);
+	m->chunk = a->chunks;
+	m->next = a->next;
+}
+
+
+void arena_release(struct arena *a, struct arena_mark *m)
+{
+	union arena_chunk_u *c;
+
+	abort_unless(a && m);
+
+	while ( a->chunks != m->chunk ) {
+		/* if this fails, 'm' was already released */
+		abort_unless(a->chunks != NULL);
+		c = a->chunks;
+		a->chunks = c->c.prev;
+		arena_free_chunk(a, c);
+	}
+
+	if ( m->chunk != NULL ) {
+		a->next = m->next;
+		a->end = (byte_t *)m->chunk + m->chunk->c.len;
+	} else {
+		a->next = NULL;
+		a->end = NULL;
+	}
+	a->last = NULL;
+}
+
+
+void arena_fini(struct arena *a)
+{
+	struct arena_mark m = { NULL, NULL };
+
+	abort_unless(a);
+	arena_release(a, &m);
+	if ( a->spare != NULL ) {
+		mem_free(a->pmm, a->spare);
+		a->spare = NULL;
+	}
+}
+
+
 static void * std_alloc(struct memmgr *mm, size_t size) 
 {
 	abort_unless(mm && size > 0);
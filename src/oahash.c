@@ -0,0 +1,291 @@
+/*
+ * oahash.c -- Open addressing hash table implementation
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2003-2017 -- See accompanying license
+ *
+ */
+#include <cat/oahash.h>
+#include <cat/bitops.h>
+
+#ifndef CAT_OHT_SSE2
+#if defined(__SSE2__) && !CAT_ANSI89 && CAT_USE_STDLIB
+#define CAT_OHT_SSE2 1
+#else
+#define CAT_OHT_SSE2 0
+#endif
+#endif /* CAT_OHT_SSE2 */
+
+#if CAT_OHT_SSE2
+#include <emmintrin.h>
+#endif /* CAT_OHT_SSE2 */
+
+#define H1(_mh)		((_mh) >> 7)
+#define H2(_mh)		((_mh) & 0x7F)
+#define ISFULL(_c)	(((_c) & 0x80) == 0)
+
+
+/*
+ * Hash functions like ht_shash() put little entropy in the high bits and
+ * sequential keys get sequential hashes.  Linear chaining copes with that,
+ * but probing needs the bits spread out across the whole word.
+ */
+static uint mix(uint h)
+{
+	h = (uint)(((uint32_t)h * (uint32_t)0x9E3779B1) & 0xFFFFFFFF);
+	return h ^ (h >> 15);
+}
+
+
+/*
+ * Each of the group match functions returns a bitmask with bit 'i' set
+ * if control byte 'i' of the group matches.
+ */
+#if CAT_OHT_SSE2
+
+static uint grp_match(const byte_t *g, byte_t c)
+{
+	__m128i v = _mm_loadu_si128((const __m128i *)g);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8((char)c)));
+}
+
+
+static uint grp_empty(const byte_t *g)
+{
+	return grp_match(g, OHT_EMPTY);
+}
+
+
+/* empty or deleted */
+static uint grp_free(const byte_t *g)
+{
+	return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)g));
+}
+
+#else /* CAT_OHT_SSE2 */
+
+#define LSBS	((uint32_t)0x01010101)
+#define MSBS	((uint32_t)0x80808080)
+
+static uint32_t grp_word(const byte_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+	       ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+/* gather the most significant bits of each byte of 'w' into 4 bits */
+static uint grp_msbs(uint32_t w)
+{
+	return ((w >> 7) & 1) | ((w >> 14) & 2) | ((w >> 21) & 4) |
+	       ((w >> 28) & 8);
+}
+
+
+/* may report false matches after a true match:  callers check the hash */
+static uint grp_match(const byte_t *g, byte_t c)
+{
+	uint32_t x;
+	uint m = 0;
+	int i;
+
+	for ( i = 0 ; i < OHT_GSIZE ; i += 4 ) {
+		x = grp_word(g + i) ^ (LSBS * c);
+		m |= grp_msbs((x - LSBS) & ~x & MSBS) << i;
+	}
+	return m;
+}
+
+
+/* exact:  OHT_EMPTY is the only control byte with bit 7 set and bit 1 clear */
+static uint grp_empty(const byte_t *g)
+{
+	uint32_t w;
+	uint m = 0;
+	int i;
+
+	for ( i = 0 ; i < OHT_GSIZE ; i += 4 ) {
+		w = grp_word(g + i);
+		m |= grp_msbs(w & (~w << 6) & MSBS) << i;
+	}
+	return m;
+}
+
+
+static uint grp_free(const byte_t *g)
+{
+	uint m = 0;
+	int i;
+
+	for ( i = 0 ; i < OHT_GSIZE ; i += 4 )
+		m |= grp_msbs(grp_word(g + i) & MSBS) << i;
+	return m;
+}
+
+#endif /* CAT_OHT_SSE2 */
+
+
+void oht_init(struct ohtab *t, byte_t *ctrl, struct ohslot *slots,
+	      uint nslots, cmp_f cmp, hash_f hashf, void *hctx)
+{
+	uint i;
+
+	abort_unless(t != NULL);
+	abort_unless(ctrl != NULL);
+	abort_unless(slots != NULL);
+	abort_unless(nslots >= OHT_GSIZE);
+	abort_unless((nslots & (nslots - 1)) == 0);
+	abort_unless(cmp != NULL);
+	abort_unless(hashf != NULL);
+
+	t->ctrl = ctrl;
+	t->slots = slots;
+	t->nslots = nslots;
+	t->gmask = nslots / OHT_GSIZE - 1;
+	t->fill = 0;
+	t->ntomb = 0;
+	t->maxfill = nslots - nslots / 8;
+	t->cmp = cmp;
+	t->hash = hashf;
+	t->hctx = hctx;
+	for ( i = 0 ; i < nslots ; ++i )
+		ctrl[i] = OHT_EMPTY;
+}
+
+
+uint oht_hash(struct ohtab *t, const void *key)
+{
+	abort_unless(t != NULL);
+	return (*t->hash)(key, t->hctx);
+}
+
+
+struct ohslot *oht_lkup(struct ohtab *t, const void *key, uint *hashp)
+{
+	uint h, mh, g, i, m, n;
+	struct ohslot *s;
+	byte_t *ctrl;
+
+	abort_unless(t != NULL);
+
+	h = (*t->hash)(key, t->hctx);
+	if ( hashp != NULL )
+		*hashp = h;
+
+	/* triangular probing over a power of 2 visits every group once */
+	mh = mix(h);
+	g = H1(mh) & t->gmask;
+	for ( n = 1 ; n <= t->gmask + 1 ; ++n ) {
+		ctrl = t->ctrl + g * OHT_GSIZE;
+		for ( m = grp_match(ctrl, H2(mh)) ; m != 0 ; m &= m - 1 ) {
+			i = ntz_32(m);
+			s = &t->slots[g * OHT_GSIZE + i];
+			if ( ctrl[i] == H2(mh) && s->hash == h &&
+			     (*t->cmp)(s->key, key) == 0 )
+				return s;
+		}
+		if ( grp_empty(ctrl) != 0 )
+			break;
+		g = (g + n) & t->gmask;
+	}
+
+	return NULL;
+}
+
+
+struct ohslot *oht_ins(struct ohtab *t, void *key, void *data, uint h)
+{
+	uint mh, g, i, m, n;
+	struct ohslot *s;
+	byte_t *ctrl;
+
+	abort_unless(t != NULL);
+
+	mh = mix(h);
+	g = H1(mh) & t->gmask;
+	for ( n = 1 ; n <= t->gmask + 1 ; ++n ) {
+		ctrl = t->ctrl + g * OHT_GSIZE;
+		if ( (m = grp_free(ctrl)) != 0 ) {
+			i = ntz_32(m);
+			if ( ctrl[i] == OHT_DELETED ) {
+				--t->ntomb;
+			} else if ( oht_isfull(t) ) {
+				return NULL;
+			}
+			ctrl[i] = H2(mh);
+			s = &t->slots[g * OHT_GSIZE + i];
+			s->key = key;
+			s->data = data;
+			s->hash = h;
+			++t->fill;
+			return s;
+		}
+		g = (g + n) & t->gmask;
+	}
+
+	return NULL;
+}
+
+
+void oht_rem(struct ohtab *t, struct ohslot *s)
+{
+	uint i;
+	byte_t *ctrl;
+
+	abort_unless(t != NULL);
+	abort_unless(s >= t->slots && s < t->slots + t->nslots);
+
+	i = s - t->slots;
+	abort_unless(ISFULL(t->ctrl[i]));
+
+	/*
+	 * A group that has an empty slot has never been full, so no probe
+	 * sequence has ever gone past it and the slot can become empty again.
+	 */
+	ctrl = t->ctrl + (i & ~(OHT_GSIZE - 1));
+	if ( grp_empty(ctrl) != 0 ) {
+		t->ctrl[i] = OHT_EMPTY;
+	} else {
+		t->ctrl[i] = OHT_DELETED;
+		++t->ntomb;
+	}
+	--t->fill;
+	s->key = NULL;
+	s->data = NULL;
+}
+
+
+void oht_apply(struct ohtab *t, apply_f func, void *ctx)
+{
+	uint i;
+
+	abort_unless(t != NULL);
+	abort_unless(func != NULL);
+
+	for ( i = 0 ; i < t->nslots ; ++i )
+		if ( ISFULL(t->ctrl[i]) )
+			(*func)(&t->slots[i], ctx);
+}
+
+
+void oht_move(struct ohtab *dst, struct ohtab *src)
+{
+	uint i;
+	struct ohslot *s;
+
+	abort_unless(dst != NULL);
+	abort_unless(src != NULL);
+	abort_unless(dst->maxfill - dst->fill - dst->ntomb >= src->fill);
+
+	for ( i = 0 ; i < src->nslots ; ++i ) {
+		if ( ISFULL(src->ctrl[i]) ) {
+			s = &src->slots[i];
+			s = oht_ins(dst, s->key, s->data, s->hash);
+			abort_unless(s != NULL);
+		}
+		src->ctrl[i] = OHT_EMPTY;
+	}
+	src->fill = 0;
+	src->ntomb = 0;
+}
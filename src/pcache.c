@@ -7,6 +7,8 @@
  *
  */
 #include <cat/pcache.h>
+#include <cat/archops.h>
+#include <string.h>
 
 void pc_init(struct pcache *pc, size_t asiz, size_t pgsiz, uint hiwat, 
 	     uint maxpools, struct memmgr *mm)
@@ -45,6 +47,9 @@ void pc_freeall(struct pcache *pc)
 		mem_free(pc->mm, lp);
 	while ( (lp = l_pop(&pc->empty)) )
 		mem_free(pc->mm, lp);
+	while ( (lp = l_pop(&pc->full)) )
+		mem_free(pc->mm, lp);
+	pc->npools = 0;
 }
 
 
@@ -145,3 +150,176 @@ void pc_delpg(void *page)
 	pcp->cache->npools -= 1;
 	pcp->cache = NULL;
 }
+
+
+/* Large blocks carry a header that ends with a NULL pool pointer */
+struct slab_lhdr {
+	struct list		entry;
+	size_t			len;
+	cat_pcpad_t		pad;
+};
+
+static const size_t slab_sizes[SLAB_NCLASS] = {
+	16, 32, 48, 64, 96, 128, 192, 256,
+	384, 512, 768, 1024, 1536, 2048, 3072, 4096
+};
+
+
+static int slab_class(size_t len)
+{
+	int lg;
+
+	if ( len <= 64 )
+		return len == 0 ? 0 : (int)((len - 1) >> 4);
+	len -= 1;
+	lg = ilog2_32((uint32_t)len);
+	return 4 + ((lg - 6) << 1) + (int)((len >> (lg - 1)) & 1);
+}
+
+
+static void *slab_mm_alloc(struct memmgr *mm, size_t len)
+{
+	return slab_alloc(container(mm, struct slab, mm), len);
+}
+
+
+static void *slab_mm_resize(struct memmgr *mm, void *mem, size_t len)
+{
+	return slab_resize(container(mm, struct slab, mm), mem, len);
+}
+
+
+static void slab_mm_free(struct memmgr *mm, void *mem)
+{
+	slab_free(container(mm, struct slab, mm), mem);
+}
+
+
+void slab_init(struct slab *s, size_t pgsiz, uint hiwat, struct memmgr *mm)
+{
+	int i;
+
+	abort_unless(s);
+	abort_unless(mm);
+	if ( pgsiz == 0 )
+		pgsiz = PC_DEF_SIZE;
+	abort_unless(pgsiz >= sizeof(union pc_pool_u) + 
+			      pl_isiz(SLAB_MAXSIZE + sizeof(cat_pcpad_t), -1));
+
+	s->mm.mm_alloc = slab_mm_alloc;
+	s->mm.mm_resize = slab_mm_resize;
+	s->mm.mm_free = slab_mm_free;
+	s->mm.mm_ctx = s;
+	s->bmm = mm;
+	l_init(&s->large);
+	for ( i = 0; i < SLAB_NCLASS; ++i )
+		pc_init(&s->caches[i], slab_sizes[i], pgsiz, hiwat, 0, mm);
+}
+
+
+void *slab_alloc(struct slab *s, size_t len)
+{
+	struct slab_lhdr *lh;
+
+	abort_unless(s);
+
+	if ( len <= SLAB_MAXSIZE )
+		return pc_alloc(&s->caches[slab_class(len)]);
+
+	if ( len > (size_t)~0 - sizeof(*lh) )
+		return NULL;
+	lh = mem_get(s->bmm, len + sizeof(*lh));
+	if ( lh == NULL )
+		return NULL;
+	l_ins(&s->large, &lh->entry);
+	lh->len = len;
+	lh->pad.pool = NULL;
+	return lh + 1;
+}
+
+
+static struct slab_lhdr *slab_large(void *mem)
+{
+	struct slab_lhdr *lh = (struct slab_lhdr *)mem - 1;
+	return lh->pad.pool == NULL ? lh : NULL;
+}
+
+
+void slab_free(struct slab *s, void *mem)
+{
+	struct slab_lhdr *lh;
+
+	abort_unless(s);
+	if ( mem == NULL )
+		return;
+
+	if ( (lh = slab_large(mem)) != NULL ) {
+		l_rem(&lh->entry);
+		mem_free(s->bmm, lh);
+	} else {
+		pc_free(mem);
+	}
+}
+
+
+void *slab_resize(struct slab *s, void *mem, size_t len)
+{
+	struct slab_lhdr *lh;
+	struct pc_pool *pcp;
+	size_t olen;
+	void *nmem;
+
+	abort_unless(s);
+
+	if ( mem == NULL )
+		return slab_alloc(s, len);
+	if ( len == 0 ) {
+		slab_free(s, mem);
+		return NULL;
+	}
+
+	if ( (lh = slab_large(mem)) != NULL ) {
+		olen = lh->len;
+		if ( len > SLAB_MAXSIZE ) {
+			if ( len > (size_t)~0 - sizeof(*lh) )
+				return NULL;
+			l_rem(&lh->entry);
+			nmem = mem_resize(s->bmm, lh, len + sizeof(*lh));
+			if ( nmem == NULL ) {
+				l_ins(&s->large, &lh->entry);
+				return NULL;
+			}
+			lh = nmem;
+			l_ins(&s->large, &lh->entry);
+			lh->len = len;
+			return lh + 1;
+		}
+	} else {
+		pcp = ((cat_pcpad_t *)mem - 1)->pool;
+		olen = pcp->cache->asiz - sizeof(cat_pcpad_t);
+		if ( len <= SLAB_MAXSIZE &&
+		     pcp->cache == &s->caches[slab_class(len)] )
+			return mem;
+	}
+
+	if ( (nmem = slab_alloc(s, len)) == NULL )
+		return NULL;
+	memcpy(nmem, mem, olen < len ? olen : len);
+	slab_free(s, mem);
+
+	return nmem;
+}
+
+
+void slab_freeall(struct slab *s)
+{
+	struct list *lp;
+	int i;
+
+	abort_unless(s);
+
+	for ( i = 0; i < SLAB_NCLASS; ++i )
+		pc_freeall(&s->caches[i]);
+	while ( (lp = l_pop(&s->large)) )
+		mem_free(s->bmm, container(lp, struct slab_lhdr, entry));
+}
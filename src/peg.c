@@ -21,6 +21,7 @@
  * Primary <- Identifier !LEFTARROW
  *            / OPEN Expression CLOSE
  *            / Literal / Class / DOT
+ *    # XXX CUT added: see below XXX
  *
  * # XXX
  * # Added for parser generation: contains the C code to run on match
@@ -31,6 +32,11 @@
  *   # No spaces-^----------^------^
  *   # Added to embed in C comments
  * ActionLabel <- ':' Identifier
+ *
+ * # Commits the parse to everything matched so far:  it always matches,
+ * # consumes nothing and takes no prefix, suffix or action.
+ * Prefix <- CUT / (AND / NOT)? Suffix
+ * CUT <- '^' Spacing
  * # XXX
  *
  * # Lexical syntax
@@ -134,6 +140,8 @@ static void peg_node_free(struct peg_grammar *peg, int nn)
 	case PEG_CLASS:
 		free_str(&pn->pc_cset_raw);
 		break;
+	case PEG_CUT:
+		break;
 	default:
 		return;
 	}
@@ -760,7 +768,14 @@ static int parse_primary(struct peg_grammar_parser *pgp, struct peg_cursor *pc,
 	else if ( string_match(pgp, "!", &npc) )
 		prefix = PEG_ATTR_NOT;
 
-	if ( (rv = parse_id_and_not_arrow(pgp, &npc, &match)) != 0 ) {
+	if ( prefix == PEG_ATTR_NONE && string_match(pgp, "^", &npc) ) {
+		match = peg_node_new(peg, PEG_CUT, pc->line);
+		if ( match < 0 ) {
+			pgp->err = PEG_ERR_NOMEM;
+			return -1;
+		}
+		NODE(peg, match)->pn_str = r;
+	} else if ( (rv = parse_id_and_not_arrow(pgp, &npc, &match)) != 0 ) {
 		if ( rv < 0 )
 			goto err;
 	} else if ( (rv = parse_paren_expr(pgp, &npc, &match)) != 0 ) {
@@ -786,6 +801,9 @@ static int parse_primary(struct peg_grammar_parser *pgp, struct peg_cursor *pc,
 		goto err;
 	}
 
+	/* a cut takes no suffix or action */
+	if ( NODE(peg, match)->pn_type == PEG_CUT )
+		goto build;
 	if ( string_match(pgp, "?", &npc) )
 		suffix = PEG_ATTR_QUESTION;
 	else if ( string_match(pgp, "*", &npc) )
@@ -808,6 +826,7 @@ static int parse_primary(struct peg_grammar_parser *pgp, struct peg_cursor *pc,
 			action = PEG_ACT_LABEL;
 	}
 
+build:
 	pn = NODE(peg, pri);
 	pn->pn_next = -1;
 	pn->pp_match = match;
@@ -1271,6 +1290,10 @@ static void print_node(struct peg_grammar *peg, int i, int seq,
 	case PEG_CLASS:
 		print_class(out, pn);
 		break;
+
+	case PEG_CUT:
+		fprintf(out, "^");
+		break;
 	}
 }
 
@@ -0,0 +1,220 @@
+/*
+ * psort.c -- Parallel array sorting.
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2003-2017 -- See accompanying license
+ *
+ */
+#include <cat/sort.h>
+
+#if CAT_USE_STDLIB && CAT_HAS_POSIX
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/*
+ * The array gets split into one run per thread and each run is sorted
+ * with qsort_array().  The runs then get merged pairwise in rounds,
+ * ping-ponging between the array and a temporary buffer.  Each round
+ * divides the output evenly among the threads:  a thread finds where
+ * its slice of the output starts in each pair of runs by binary search
+ * ("co-ranking") so the merge work stays balanced no matter how the
+ * keys are distributed.  Merges favor the left run on ties so the merge
+ * phase is stable (though qsort_array() itself is not).
+ */
+
+#define PSORT_MAXTHR	64
+#define PSORT_MINRUN	4096
+
+struct psort {
+	byte_t *		src;
+	byte_t *		dst;
+	size_t			nelem;
+	size_t			esize;
+	cmp_f			cmp;
+	size_t			runlen;
+	uint			nthr;
+};
+
+struct psort_thr {
+	struct psort *		ps;
+	uint			idx;
+};
+
+
+static void *sort_run(void *arg)
+{
+	struct psort_thr *pt = arg;
+	struct psort *ps = pt->ps;
+	size_t lo = pt->idx * ps->runlen;
+	size_t n;
+
+	if ( lo < ps->nelem ) {
+		n = ps->nelem - lo;
+		if ( n > ps->runlen )
+			n = ps->runlen;
+		qsort_array(ps->src + lo * ps->esize, n, ps->esize, ps->cmp);
+	}
+	return NULL;
+}
+
+
+/*
+ * Return how many of the first 'k' merged elements of runs 'a' (of 'na'
+ * elements) and 'b' (of 'nb' elements) come from 'a'.
+ */
+static size_t corank(size_t k, byte_t *a, size_t na, byte_t *b, size_t nb,
+		     size_t esize, cmp_f cmp)
+{
+	size_t lo = (k > nb) ? k - nb : 0;
+	size_t hi = (k < na) ? k : na;
+	size_t i;
+
+	while ( lo < hi ) {
+		i = lo + (hi - lo) / 2;
+		/* a[i] precedes b[k-i-1] so more than i come from 'a' */
+		if ( (*cmp)(a + i * esize, b + (k - i - 1) * esize) <= 0 )
+			lo = i + 1;
+		else
+			hi = i;
+	}
+	return lo;
+}
+
+
+static void merge(byte_t *dst, byte_t *a, byte_t *ae, byte_t *b, byte_t *be,
+		  size_t esize, cmp_f cmp)
+{
+	while ( a < ae && b < be ) {
+		if ( (*cmp)(a, b) <= 0 ) {
+			memcpy(dst, a, esize);
+			a += esize;
+		} else {
+			memcpy(dst, b, esize);
+			b += esize;
+		}
+		dst += esize;
+	}
+	if ( a < ae ) {
+		memcpy(dst, a, ae - a);
+	} else if ( b < be ) {
+		memcpy(dst, b, be - b);
+	}
+}
+
+
+static void *merge_slice(void *arg)
+{
+	struct psort_thr *pt = arg;
+	struct psort *ps = pt->ps;
+	const size_t esize = ps->esize;
+	size_t olo = ps->nelem / ps->nthr * pt->idx;
+	size_t ohi = (pt->idx == ps->nthr - 1) ? ps->nelem :
+		     ps->nelem / ps->nthr * (pt->idx + 1);
+	size_t plo, na, nb, klo, khi, alo, ahi;
+	byte_t *a, *b;
+
+	/* walk each pair of runs that overlaps [olo, ohi) */
+	plo = olo - olo % (2 * ps->runlen);
+	for ( ; plo < ohi ; plo += 2 * ps->runlen ) {
+		a = ps->src + plo * esize;
+		na = ps->nelem - plo;
+		if ( na > ps->runlen )
+			na = ps->runlen;
+		b = a + na * esize;
+		nb = ps->nelem - plo - na;
+		if ( nb > ps->runlen )
+			nb = ps->runlen;
+
+		klo = (olo > plo) ? olo - plo : 0;
+		khi = (ohi < plo + na + nb) ? ohi - plo : na + nb;
+		alo = corank(klo, a, na, b, nb, esize, ps->cmp);
+		ahi = corank(khi, a, na, b, nb, esize, ps->cmp);
+		merge(ps->dst + (plo + klo) * esize,
+		      a + alo * esize, a + ahi * esize,
+		      b + (klo - alo) * esize, b + (khi - ahi) * esize,
+		      esize, ps->cmp);
+	}
+	return NULL;
+}
+
+
+/* run 'f' once for each thread index, in the caller if threads fail */
+static void run_phase(struct psort *ps, void *(*f)(void *))
+{
+	pthread_t tids[PSORT_MAXTHR];
+	struct psort_thr args[PSORT_MAXTHR];
+	int started[PSORT_MAXTHR];
+	uint i;
+
+	for ( i = 0 ; i < ps->nthr ; ++i ) {
+		args[i].ps = ps;
+		args[i].idx = i;
+		started[i] = (i > 0) &&
+			     (pthread_create(&tids[i], NULL, f, &args[i]) == 0);
+	}
+	for ( i = 0 ; i < ps->nthr ; ++i )
+		if ( !started[i] )
+			(*f)(&args[i]);
+	for ( i = 1 ; i < ps->nthr ; ++i )
+		if ( started[i] )
+			pthread_join(tids[i], NULL);
+}
+
+
+void psort_array(void *arr, const size_t nelem, const size_t esize, cmp_f cmp,
+		 uint nthreads)
+{
+	struct psort ps;
+	byte_t *tmp, *t;
+
+	abort_unless(arr != NULL || nelem == 0);
+	abort_unless(esize > 0);
+	abort_unless(cmp != NULL);
+
+	if ( nthreads > PSORT_MAXTHR )
+		nthreads = PSORT_MAXTHR;
+	if ( nthreads > nelem / PSORT_MINRUN )
+		nthreads = nelem / PSORT_MINRUN;
+	if ( nthreads <= 1 || nelem > (size_t)-1 / esize ||
+	     (tmp = malloc(nelem * esize)) == NULL ) {
+		qsort_array(arr, nelem, esize, cmp);
+		return;
+	}
+
+	ps.src = arr;
+	ps.dst = tmp;
+	ps.nelem = nelem;
+	ps.esize = esize;
+	ps.cmp = cmp;
+	ps.runlen = (nelem + nthreads - 1) / nthreads;
+	ps.nthr = nthreads;
+	run_phase(&ps, sort_run);
+
+	while ( ps.runlen < nelem ) {
+		run_phase(&ps, merge_slice);
+		t = ps.src;
+		ps.src = ps.dst;
+		ps.dst = t;
+		ps.runlen *= 2;
+	}
+
+	if ( ps.src != arr )
+		memcpy(arr, ps.src, nelem * esize);
+	free(tmp);
+}
+
+
+#else /* CAT_USE_STDLIB && CAT_HAS_POSIX */
+
+
+void psort_array(void *arr, const size_t nelem, const size_t esize, cmp_f cmp,
+		 uint nthreads)
+{
+	qsort_array(arr, nelem, esize, cmp);
+}
+
+
+#endif /* CAT_USE_STDLIB && CAT_HAS_POSIX */
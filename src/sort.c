@@ -7,6 +7,7 @@
  *
  */
 #include <cat/sort.h>
+#include <cat/mem.h>
 #include <string.h>
 
 
@@ -331,6 +332,255 @@ done_inner:
 }
 
 
+/*
+ * Radix sorts.  The key is an unsigned integer of 'klen' bytes or a
+ * struct raw (klen == 0) at offset 'koff' in each element.  Keys are
+ * always copied out with memcpy() since they need not be aligned.
+ */
+#define RSORT_THRESH	32
+#define RS_RAW		0
+
+
+static int rs_kcmp(const byte_t *a, const byte_t *b, uint klen, size_t depth)
+{
+	struct raw ra, rb;
+	size_t len;
+	uint32_t a32, b32;
+	int rv;
+#if CAT_64BIT
+	uint64_t a64, b64;
+#endif /* CAT_64BIT */
+
+	switch (klen) {
+	case sizeof(uint32_t):
+		memcpy(&a32, a, sizeof(a32));
+		memcpy(&b32, b, sizeof(b32));
+		return (a32 < b32) ? -1 : (a32 > b32);
+#if CAT_64BIT
+	case sizeof(uint64_t):
+		memcpy(&a64, a, sizeof(a64));
+		memcpy(&b64, b, sizeof(b64));
+		return (a64 < b64) ? -1 : (a64 > b64);
+#endif /* CAT_64BIT */
+	default:
+		/* the first 'depth' bytes of both keys are known to match */
+		memcpy(&ra, a, sizeof(ra));
+		memcpy(&rb, b, sizeof(rb));
+		len = (ra.len < rb.len) ? ra.len : rb.len;
+		if ( len > depth ) {
+			rv = memcmp(ra.data + depth, rb.data + depth,
+				    len - depth);
+			if ( rv != 0 )
+				return rv;
+		}
+		return (ra.len < rb.len) ? -1 : (ra.len > rb.len);
+	}
+}
+
+
+/* stable insertion sort on the keys for small arrays and buckets */
+static void rs_isort(byte_t *arr, const size_t nelem, const size_t esize,
+		     size_t koff, uint klen, size_t depth)
+{
+	byte_t *start = arr, *p1, *p2, *tmp;
+	const byte_t * const end = arr + nelem * esize;
+	int swaptype = SWAPTYPE(arr, esize);
+
+	for ( p1 = start + esize ; p1 < end ; p1 += esize ) {
+		for ( p2 = p1 ; p2 > start ; p2 -= esize ) {
+			tmp = p2 - esize;
+			if ( rs_kcmp(tmp + koff, p2 + koff, klen, depth) > 0 ) {
+				SWAP(tmp, p2, swaptype);
+			} else {
+				break;
+			}
+		}
+	}
+}
+
+
+static void rs_scatter(byte_t *dst, const byte_t *src, size_t nelem,
+		       size_t esize, size_t boff, size_t *pos)
+{
+	const byte_t *end = src + nelem * esize;
+
+	if ( esize == sizeof(uint32_t) ) {
+		for ( ; src < end ; src += sizeof(uint32_t) )
+			memcpy(dst + pos[src[boff]]++ * sizeof(uint32_t), src,
+			       sizeof(uint32_t));
+	} else if ( esize == 2 * sizeof(uint32_t) ) {
+		for ( ; src < end ; src += 2 * sizeof(uint32_t) )
+			memcpy(dst + pos[src[boff]]++ * 2 * sizeof(uint32_t),
+			       src, 2 * sizeof(uint32_t));
+	} else {
+		for ( ; src < end ; src += esize )
+			memcpy(dst + pos[src[boff]]++ * esize, src, esize);
+	}
+}
+
+
+/*
+ * LSD radix sort of integer keys, one byte per pass.  All the histograms
+ * are built in a single read of the array and passes where every key has
+ * the same digit are skipped.
+ */
+static int rsort_lsd(void *arr, size_t nelem, size_t esize, size_t koff,
+		     uint klen, struct memmgr *mm)
+{
+	static const union { uint32_t u; byte_t b[4]; } endian = { 1 };
+	size_t (*cnt)[256];
+	size_t pos[256];
+	size_t i, sum, boff;
+	byte_t *src = arr, *dst, *tmp, *p;
+	uint d, b;
+
+	abort_unless(arr != NULL || nelem == 0);
+	abort_unless(esize >= klen && koff <= esize - klen);
+	abort_unless(mm != NULL);
+
+	if ( nelem < RSORT_THRESH ) {
+		rs_isort(arr, nelem, esize, koff, klen, 0);
+		return 0;
+	}
+	if ( nelem > (size_t)-1 / esize )
+		return -1;
+	cnt = mem_get(mm, klen * sizeof(*cnt));
+	if ( cnt == NULL )
+		return -1;
+	tmp = mem_get(mm, nelem * esize);
+	if ( tmp == NULL ) {
+		mem_free(mm, cnt);
+		return -1;
+	}
+	dst = tmp;
+
+	/* byte 'd' of the key in order of significance */
+#define RS_BOFF(d) (koff + (endian.b[0] ? (d) : klen - 1 - (d)))
+	memset(cnt, 0, klen * sizeof(*cnt));
+	for ( i = 0, p = arr ; i < nelem ; ++i, p += esize )
+		for ( d = 0 ; d < klen ; ++d )
+			++cnt[d][p[RS_BOFF(d)]];
+
+	for ( d = 0 ; d < klen ; ++d ) {
+		boff = RS_BOFF(d);
+		if ( cnt[d][src[boff]] == nelem )
+			continue;
+		for ( b = 0, sum = 0 ; b < 256 ; ++b ) {
+			pos[b] = sum;
+			sum += cnt[d][b];
+		}
+		rs_scatter(dst, src, nelem, esize, boff, pos);
+		p = src;
+		src = dst;
+		dst = p;
+	}
+#undef RS_BOFF
+
+	if ( src != arr )
+		memcpy(arr, src, nelem * esize);
+	mem_free(mm, tmp);
+	mem_free(mm, cnt);
+	return 0;
+}
+
+
+int rsort_u32(void *arr, size_t nelem, size_t esize, size_t koff,
+	      struct memmgr *mm)
+{
+	return rsort_lsd(arr, nelem, esize, koff, sizeof(uint32_t), mm);
+}
+
+
+#if CAT_64BIT
+int rsort_u64(void *arr, size_t nelem, size_t esize, size_t koff,
+	      struct memmgr *mm)
+{
+	return rsort_lsd(arr, nelem, esize, koff, sizeof(uint64_t), mm);
+}
+#endif /* CAT_64BIT */
+
+
+/* bucket 0 holds keys that end at 'depth', bucket c + 1 byte c */
+static uint rs_digit(const byte_t *key, size_t depth)
+{
+	struct raw r;
+	memcpy(&r, key, sizeof(r));
+	return (r.len > depth) ? r.data[depth] + 1 : 0;
+}
+
+
+/*
+ * MSD radix sort of byte string keys.  Each level distributes the
+ * elements stably through 'tmp' and copies them back.  The largest
+ * bucket is handled by looping rather than recursion to keep the stack
+ * depth logarithmic in the number of elements.
+ */
+static void rsort_msd(byte_t *arr, byte_t *tmp, size_t nelem, size_t esize,
+		      size_t koff, size_t depth)
+{
+	size_t cnt[257], pos[257];
+	size_t i, sum, big;
+	byte_t *p;
+	uint b;
+
+	while ( nelem >= RSORT_THRESH ) {
+		memset(cnt, 0, sizeof(cnt));
+		for ( i = 0, p = arr ; i < nelem ; ++i, p += esize )
+			++cnt[rs_digit(p + koff, depth)];
+
+		if ( cnt[0] == nelem )
+			return;
+		for ( b = 0, sum = 0, big = 1 ; b < 257 ; ++b ) {
+			pos[b] = sum;
+			sum += cnt[b];
+			if ( b > 0 && cnt[b] > cnt[big] )
+				big = b;
+		}
+		if ( cnt[big] < nelem ) {
+			for ( i = 0, p = arr ; i < nelem ; ++i, p += esize )
+				memcpy(tmp + pos[rs_digit(p + koff, depth)]++ *
+				       esize, p, esize);
+			memcpy(arr, tmp, nelem * esize);
+			for ( b = 1 ; b < 257 ; ++b ) {
+				if ( b == big || cnt[b] < 2 )
+					continue;
+				p = arr + (pos[b] - cnt[b]) * esize;
+				rsort_msd(p, tmp, cnt[b], esize, koff,
+					  depth + 1);
+			}
+			arr += (pos[big] - cnt[big]) * esize;
+		}
+		nelem = cnt[big];
+		++depth;
+	}
+	rs_isort(arr, nelem, esize, koff, RS_RAW, depth);
+}
+
+
+int rsort_raw(void *arr, size_t nelem, size_t esize, size_t koff,
+	      struct memmgr *mm)
+{
+	byte_t *tmp;
+
+	abort_unless(arr != NULL || nelem == 0);
+	abort_unless(esize >= sizeof(struct raw) &&
+		     koff <= esize - sizeof(struct raw));
+	abort_unless(mm != NULL);
+
+	if ( nelem < RSORT_THRESH ) {
+		rs_isort(arr, nelem, esize, koff, RS_RAW, 0);
+		return 0;
+	}
+	if ( nelem > (size_t)-1 / esize )
+		return -1;
+	tmp = mem_get(mm, nelem * esize);
+	if ( tmp == NULL )
+		return -1;
+	rsort_msd(arr, tmp, nelem, esize, koff, 0);
+	mem_free(mm, tmp);
+	return 0;
+}
+
 
 void array_to_voidp(void **varr, void *arr, size_t nelem, size_t esize)
 {
@@ -436,16 +436,15 @@ struct apply_ctx {
 
 static struct chnode *cht_node_alloc_skey(struct chtab *t, void *key)
 {
-	char *kcpy;
 	struct chnode *chn;
-	kcpy = strdup(key);
-	if ( kcpy == NULL )
-		return NULL;
-	chn = malloc(sizeof(*chn));
-	if ( chn == NULL ) {
-		free(kcpy);
+	size_t len = strlen(key) + 1;
+	char *kcpy;
+
+	chn = mem_get(t->mm, CAT_ALIGN_SIZE(sizeof(*chn)) + len);
+	if ( chn == NULL )
 		return NULL;
-	}
+	kcpy = (char *)chn + CAT_ALIGN_SIZE(sizeof(*chn));
+	memcpy(kcpy, key, len);
 	ht_ninit(&chn->node, kcpy);
 	return chn;
 }
@@ -455,8 +454,7 @@ static void cht_node_free_skey(struct chtab *t, struct chnode *chn)
 {
 	abort_unless(chn != NULL);
 	abort_unless(chn->node.key != NULL);
-	free(chn->node.key);
-	free(chn);
+	mem_free(t->mm, chn);
 }
 
 
@@ -477,9 +475,9 @@ static struct chnode *cht_node_alloc_rkey(struct chtab *t, void *key)
 	struct raw *rnode;
 
 	abort_unless(rkey != NULL);
-	chn = malloc(CAT_ALIGN_SIZE(sizeof(*chn)) +
-		     CAT_ALIGN_SIZE(sizeof(*rnode)) +
-		     rkey->len);
+	chn = mem_get(t->mm, CAT_ALIGN_SIZE(sizeof(*chn)) +
+			       CAT_ALIGN_SIZE(sizeof(*rnode)) +
+			       rkey->len);
 	if ( chn == NULL )
 		return NULL;
 
@@ -498,7 +496,7 @@ static struct chnode *cht_node_alloc_rkey(struct chtab *t, void *key)
 
 static void cht_node_free_rkey(struct chtab *t, struct chnode *chn)
 {
-	free(chn);
+	mem_free(t->mm, chn);
 }
 
 
@@ -515,7 +513,7 @@ struct chtab_attr cht_std_attr_rkey = {
 static struct chnode *cht_node_alloc_pkey(struct chtab *t, void *key)
 {
 	struct chnode *chn;
-	chn = malloc(sizeof(*chn));
+	chn = mem_get(t->mm, sizeof(*chn));
 	if ( chn == NULL )
 		return NULL;
 	ht_ninit(&chn->node, key);
@@ -525,7 +523,7 @@ static struct chnode *cht_node_alloc_pkey(struct chtab *t, void *key)
 
 static void cht_node_free_pkey(struct chtab *t, struct chnode *chn)
 {
-	free(chn);
+	mem_free(t->mm, chn);
 }
 
 
@@ -557,7 +555,6 @@ struct chtab *cht_new(size_t nbkts, struct chtab_attr *attr, void *hctx,
 	size_t hctx_size;
 	struct chtab *t;
 	void *new_hctx;
-	struct hnode **buckets;
 
 	if ( attr == NULL )
 		attr = &cht_std_attr_skey;
@@ -566,14 +563,13 @@ struct chtab *cht_new(size_t nbkts, struct chtab_attr *attr, void *hctx,
 	abort_unless(attr->hash != NULL);
 	abort_unless(attr->node_alloc != NULL);
 	abort_unless(attr->node_free != NULL);
+	abort_unless(nbkts <= (uint)~0);
 
 	tsize = CAT_ALIGN_SIZE(sizeof(struct chtab));
 	hctx_size = CAT_ALIGN_SIZE(attr->hctx_size);
 	abort_unless(hctx_size >= attr->hctx_size);
 	abort_unless(SMAX - hctx_size >= tsize);
 	n = hctx_size + tsize;
-	abort_unless((SMAX - n) / sizeof(struct hnode *) >= nbkts);
-	n += sizeof(struct hnode *) * nbkts;
 
 	t = emalloc(n);
 	if ( t == NULL ) {
@@ -583,37 +579,44 @@ struct chtab *cht_new(size_t nbkts, struct chtab_attr *attr, void *hctx,
 	}
 
 	new_hctx = (byte_t *)t + tsize;
-	buckets = (struct hnode **)((byte_t *)new_hctx + hctx_size);
 
 	if (hctx_size != 0)
 		memmove(new_hctx, hctx, attr->hctx_size);
 	else
 		new_hctx = NULL;
 
-	ht_init(&t->table, buckets, nbkts, attr->kcmp, attr->hash, new_hctx);
+	if ( rht_init(&t->table, &stdmm, nbkts, attr->kcmp, attr->hash,
+		      new_hctx) < 0 ) {
+		free(t);
+		if ( abort_on_fail )
+			err("cht_new: unable to allocate table\n");
+		return NULL;
+	}
 	t->abort_on_fail = abort_on_fail;
 	t->node_alloc = attr->node_alloc;
 	t->node_free = attr->node_free;
 	t->ctx = attr->ctx;
+	t->mm = attr->mm != NULL ? attr->mm : &stdmm;
 
 	return t;
 }
 
 
-void cht_free(struct chtab *t)
+static void cht_free_node(void *p, void *ctx)
 {
-	unsigned i;
-	struct chnode *chn;
+	struct chtab *t = ctx;
+	struct chnode *chn = container(p, struct chnode, node);
+	ht_rem(&chn->node);
+	(*t->node_free)(t, chn);
+}
 
+
+void cht_free(struct chtab *t)
+{
 	abort_unless(t != NULL);
 
-	for ( i = 0; i < t->table.nbkts ; ++i ) {
-		while ( t->table.bkts[i] != NULL ) {
-			chn = container(t->table.bkts[i], struct chnode, node);
-			ht_rem(&chn->node);
-			(*t->node_free)(t, chn);
-		}
-	}
+	rht_apply(&t->table, &cht_free_node, t);
+	rht_fini(&t->table);
 	free(t);
 }
 
@@ -625,7 +628,7 @@ void *cht_get(struct chtab *t, void *key)
 	abort_unless(t != NULL);
 	abort_unless(key != NULL);
 
-	hn = ht_lkup(&t->table, key, NULL);
+	hn = rht_lkup(&t->table, key, NULL);
 	if ( hn != NULL )
 		return container(hn, struct chnode, node)->data;
 	return NULL;
@@ -642,7 +645,7 @@ int cht_put(struct chtab *t, void *key, void *data)
 	abort_unless(key != NULL);
 	abort_unless(data != NULL);
 
-	hn = ht_lkup(&t->table, key, &h);
+	hn = rht_lkup(&t->table, key, &h);
 	if ( hn != NULL ) {
 		chn = container(hn, struct chnode, node);
 		chn->data = data;
@@ -657,7 +660,7 @@ int cht_put(struct chtab *t, void *key, void *data)
 	}
 
 	chn->data = data;
-	ht_ins(&t->table, &chn->node, h);
+	rht_ins(&t->table, &chn->node, h);
 	return 0;
 }
 
@@ -671,9 +674,9 @@ void *cht_del(struct chtab *t, void *key)
 	abort_unless(t != NULL);
 	abort_unless(key != NULL);
 
-	hn = ht_lkup(&t->table, key, NULL);
+	hn = rht_lkup(&t->table, key, NULL);
 	if ( hn != NULL ) {
-		ht_rem(hn);
+		rht_rem(&t->table, hn);
 		chn = container(hn, struct chnode, node);
 		data = chn->data;
 		(*t->node_free)(t, chn);
@@ -695,7 +698,294 @@ void cht_apply(struct chtab *t, apply_f f, void *ctx)
 	struct apply_ctx ac;
 	ac.ctx = t->ctx;
 	ac.f = f;
-	ht_apply(&t->table, &cht_apply_wrap, &ac);
+	rht_apply(&t->table, &cht_apply_wrap, &ac);
+}
+
+
+
+
+/* Open Addressing Hash Tables */
+
+static void *coht_key_dup_skey(struct cohtab *t, void *key)
+{
+	return strdup(key);
+}
+
+
+static void coht_key_free_skey(struct cohtab *t, void *key)
+{
+	free(key);
+}
+
+
+struct cohtab_attr coht_std_attr_skey = {
+	&cmp_str,
+	&ht_shash,
+	0,
+	&coht_key_dup_skey,
+	&coht_key_free_skey,
+	NULL,
+};
+
+
+static void *coht_key_dup_rkey(struct cohtab *t, void *key)
+{
+	struct raw *rkey = key;
+	struct raw *rnew;
+
+	abort_unless(rkey != NULL);
+	rnew = malloc(CAT_ALIGN_SIZE(sizeof(*rnew)) + rkey->len);
+	if ( rnew == NULL )
+		return NULL;
+	rnew->len = rkey->len;
+	if ( rkey->len > 0 ) {
+		rnew->data = (byte_t *)rnew + CAT_ALIGN_SIZE(sizeof(*rnew));
+		memmove(rnew->data, rkey->data, rkey->len);
+	} else {
+		rnew->data = NULL;
+	}
+	return rnew;
+}
+
+
+static void coht_key_free_rkey(struct cohtab *t, void *key)
+{
+	free(key);
+}
+
+
+struct cohtab_attr coht_std_attr_rkey = {
+	&cmp_raw,
+	&ht_rhash,
+	0,
+	&coht_key_dup_rkey,
+	&coht_key_free_rkey,
+	NULL,
+};
+
+
+static void *coht_key_dup_pkey(struct cohtab *t, void *key)
+{
+	return key;
+}
+
+
+static void coht_key_free_pkey(struct cohtab *t, void *key)
+{
+}
+
+
+struct cohtab_attr coht_std_attr_pkey = {
+	&cmp_ptr,
+	&ht_phash,
+	0,
+	&coht_key_dup_pkey,
+	&coht_key_free_pkey,
+	NULL,
+};
+
+
+struct cohtab_attr coht_std_attr_bkey = {
+	NULL,		/* Must be supplied by user */
+	NULL,		/* Must be supplied by user */
+	0,		/* Must be supplied by user */
+	&coht_key_dup_pkey,
+	&coht_key_free_pkey,
+	NULL,
+};
+
+
+/* the control bytes follow the slots in a single allocation */
+static int coht_setsize(struct cohtab *t, size_t nslots)
+{
+	struct ohtab nt;
+	struct ohslot *slots;
+	size_t n;
+
+	abort_unless(nslots <= (uint)~0);
+	abort_unless((SMAX - nslots) / sizeof(struct ohslot) >= nslots);
+	n = sizeof(struct ohslot) * nslots + nslots;
+
+	slots = malloc(n);
+	if ( slots == NULL )
+		return -1;
+	oht_init(&nt, (byte_t *)(slots + nslots), slots, nslots,
+		 t->table.cmp, t->table.hash, t->table.hctx);
+	if ( t->table.slots != NULL ) {
+		oht_move(&nt, &t->table);
+		free(t->table.slots);
+	}
+	t->table = nt;
+	return 0;
+}
+
+
+struct cohtab *coht_new(size_t nslots, struct cohtab_attr *attr, void *hctx,
+			int abort_on_fail)
+{
+	size_t n;
+	size_t tsize;
+	size_t hctx_size;
+	struct cohtab *t;
+	void *new_hctx;
+
+	if ( attr == NULL )
+		attr = &coht_std_attr_skey;
+
+	abort_unless(attr->kcmp != NULL);
+	abort_unless(attr->hash != NULL);
+	abort_unless(attr->key_dup != NULL);
+	abort_unless(attr->key_free != NULL);
+
+	abort_unless(nslots <= ((size_t)(uint)~0 >> 1) + 1);
+	for ( n = OHT_GSIZE ; n < nslots ; n <<= 1 )
+		;
+	nslots = n;
+
+	tsize = CAT_ALIGN_SIZE(sizeof(struct cohtab));
+	hctx_size = CAT_ALIGN_SIZE(attr->hctx_size);
+	abort_unless(hctx_size >= attr->hctx_size);
+	abort_unless(SMAX - hctx_size >= tsize);
+	n = hctx_size + tsize;
+
+	t = emalloc(n);
+	if ( t == NULL ) {
+		if ( abort_on_fail )
+			err("coht_new: unable to allocate table\n");
+		return NULL;
+	}
+
+	new_hctx = (byte_t *)t + tsize;
+	if (hctx_size != 0)
+		memmove(new_hctx, hctx, attr->hctx_size);
+	else
+		new_hctx = NULL;
+
+	t->table.slots = NULL;
+	t->table.cmp = attr->kcmp;
+	t->table.hash = attr->hash;
+	t->table.hctx = new_hctx;
+	if ( coht_setsize(t, nslots) < 0 ) {
+		free(t);
+		if ( abort_on_fail )
+			err("coht_new: unable to allocate table\n");
+		return NULL;
+	}
+	t->abort_on_fail = abort_on_fail;
+	t->key_dup = attr->key_dup;
+	t->key_free = attr->key_free;
+	t->ctx = attr->ctx;
+
+	return t;
+}
+
+
+static void coht_free_key(void *p, void *ctx)
+{
+	struct cohtab *t = ctx;
+	struct ohslot *s = p;
+	(*t->key_free)(t, s->key);
+}
+
+
+void coht_free(struct cohtab *t)
+{
+	abort_unless(t != NULL);
+
+	oht_apply(&t->table, &coht_free_key, t);
+	free(t->table.slots);
+	free(t);
+}
+
+
+void *coht_get(struct cohtab *t, void *key)
+{
+	struct ohslot *s;
+
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+
+	s = oht_lkup(&t->table, key, NULL);
+	if ( s != NULL )
+		return s->data;
+	return NULL;
+}
+
+
+int coht_put(struct cohtab *t, void *key, void *data)
+{
+	struct ohslot *s;
+	size_t nslots;
+	void *kcpy;
+	uint h;
+
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+	abort_unless(data != NULL);
+
+	s = oht_lkup(&t->table, key, &h);
+	if ( s != NULL ) {
+		s->data = data;
+		return 1;
+	}
+
+	kcpy = (*t->key_dup)(t, key);
+	if ( kcpy == NULL )
+		goto nomem;
+
+	while ( (s = oht_ins(&t->table, kcpy, data, h)) == NULL ) {
+		/* grow if at least half full, else just clear the tombstones */
+		nslots = t->table.nslots;
+		if ( t->table.fill >= nslots / 2 ) {
+			abort_unless(nslots <= (uint)~0 / 2);
+			nslots *= 2;
+		}
+		if ( coht_setsize(t, nslots) < 0 ) {
+			(*t->key_free)(t, kcpy);
+			goto nomem;
+		}
+	}
+	return 0;
+
+nomem:
+	if ( t->abort_on_fail )
+		err("coht_put: unable to allocate memory\n");
+	return -1;
+}
+
+
+void *coht_del(struct cohtab *t, void *key)
+{
+	struct ohslot *s;
+	void *data = NULL;
+
+	abort_unless(t != NULL);
+	abort_unless(key != NULL);
+
+	s = oht_lkup(&t->table, key, NULL);
+	if ( s != NULL ) {
+		data = s->data;
+		(*t->key_free)(t, s->key);
+		oht_rem(&t->table, s);
+	}
+	return data;
+}
+
+
+static void coht_apply_wrap(void *p, void *ctx)
+{
+	struct ohslot *s = p;
+	struct apply_ctx *ac = ctx;
+	(*ac->f)(s->data, ac->ctx);
+}
+
+
+void coht_apply(struct cohtab *t, apply_f f, void *ctx)
+{
+	struct apply_ctx ac;
+	ac.ctx = ctx;
+	ac.f = f;
+	oht_apply(&t->table, &coht_apply_wrap, &ac);
 }
 
 
@@ -705,16 +995,15 @@ void cht_apply(struct chtab *t, apply_f f, void *ctx)
 
 static struct canode *cavl_node_alloc_skey(struct cavltree *t, void *key)
 {
-	char *kcpy;
 	struct canode *can;
-	kcpy = strdup(key);
-	if ( kcpy == NULL )
-		return NULL;
-	can = malloc(sizeof(*can));
-	if ( can == NULL ) {
-		free(kcpy);
+	size_t len = strlen(key) + 1;
+	char *kcpy;
+
+	can = mem_get(t->mm, CAT_ALIGN_SIZE(sizeof(*can)) + len);
+	if ( can == NULL )
 		return NULL;
-	}
+	kcpy = (char *)can + CAT_ALIGN_SIZE(sizeof(*can));
+	memcpy(kcpy, key, len);
 	avl_ninit(&can->node, kcpy);
 	return can;
 }
@@ -724,8 +1013,7 @@ static void cavl_node_free_skey(struct cavltree *t, struct canode *can)
 {
 	abort_unless(can != NULL);
 	abort_unless(can->node.key != NULL);
-	free(can->node.key);
-	free(can);
+	mem_free(t->mm, can);
 }
 
 
@@ -744,9 +1032,9 @@ static struct canode *cavl_node_alloc_rkey(struct cavltree *t, void *key)
 	struct raw *rnode;
 
 	abort_unless(rkey != NULL);
-	can = malloc(CAT_ALIGN_SIZE(sizeof(*can)) +
-		     CAT_ALIGN_SIZE(sizeof(*rnode)) +
-		     rkey->len);
+	can = mem_get(t->mm, CAT_ALIGN_SIZE(sizeof(*can)) +
+			       CAT_ALIGN_SIZE(sizeof(*rnode)) +
+			       rkey->len);
 	if ( can == NULL )
 		return NULL;
 
@@ -765,7 +1053,7 @@ static struct canode *cavl_node_alloc_rkey(struct cavltree *t, void *key)
 
 static void cavl_node_free_rkey(struct cavltree *t, struct canode *can)
 {
-	free(can);
+	mem_free(t->mm, can);
 }
 
 
@@ -780,7 +1068,7 @@ struct cavltree_attr cavl_std_attr_rkey = {
 static struct canode *cavl_node_alloc_pkey(struct cavltree *t, void *key)
 {
 	struct canode *can;
-	can = malloc(sizeof(*can));
+	can = mem_get(t->mm, sizeof(*can));
 	if ( can == NULL )
 		return NULL;
 	avl_ninit(&can->node, key);
@@ -790,7 +1078,7 @@ static struct canode *cavl_node_alloc_pkey(struct cavltree *t, void *key)
 
 static void cavl_node_free_pkey(struct cavltree *t, struct canode *can)
 {
-	free(can);
+	mem_free(t->mm, can);
 }
 
 
@@ -833,6 +1121,7 @@ struct cavltree *cavl_new(struct cavltree_attr *attr, int abort_on_fail)
 	t->node_alloc = attr->node_alloc;
 	t->node_free = attr->node_free;
 	t->ctx = attr->ctx;
+	t->mm = attr->mm != NULL ? attr->mm : &stdmm;
 
 	return t;
 }
@@ -941,16 +1230,15 @@ void cavl_apply(struct cavltree *t, apply_f f, void *ctx)
 
 static struct crbnode *crb_node_alloc_skey(struct crbtree *t, void *key)
 {
-	char *kcpy;
 	struct crbnode *crn;
-	kcpy = strdup(key);
-	if ( kcpy == NULL )
-		return NULL;
-	crn = malloc(sizeof(*crn));
-	if ( crn == NULL ) {
-		free(kcpy);
+	size_t len = strlen(key) + 1;
+	char *kcpy;
+
+	crn = mem_get(t->mm, CAT_ALIGN_SIZE(sizeof(*crn)) + len);
+	if ( crn == NULL )
 		return NULL;
-	}
+	kcpy = (char *)crn + CAT_ALIGN_SIZE(sizeof(*crn));
+	memcpy(kcpy, key, len);
 	rb_ninit(&crn->node, kcpy);
 	return crn;
 }
@@ -960,8 +1248,7 @@ static void crb_node_free_skey(struct crbtree *t, struct crbnode *crn)
 {
 	abort_unless(crn != NULL);
 	abort_unless(crn->node.key != NULL);
-	free(crn->node.key);
-	free(crn);
+	mem_free(t->mm, crn);
 }
 
 
@@ -980,9 +1267,9 @@ static struct crbnode *crb_node_alloc_rkey(struct crbtree *t, void *key)
 	struct raw *rnode;
 
 	abort_unless(rkey != NULL);
-	crn = malloc(CAT_ALIGN_SIZE(sizeof(*crn)) +
-		     CAT_ALIGN_SIZE(sizeof(struct raw)) +
-		     rkey->len);
+	crn = mem_get(t->mm, CAT_ALIGN_SIZE(sizeof(*crn)) +
+			       CAT_ALIGN_SIZE(sizeof(struct raw)) +
+			       rkey->len);
 	if ( crn == NULL )
 		return NULL;
 
@@ -1001,7 +1288,7 @@ static struct crbnode *crb_node_alloc_rkey(struct crbtree *t, void *key)
 
 static void crb_node_free_rkey(struct crbtree *t, struct crbnode *crn)
 {
-	free(crn);
+	mem_free(t->mm, crn);
 }
 
 
@@ -1016,7 +1303,7 @@ struct crbtree_attr crb_std_attr_rkey = {
 static struct crbnode *crb_node_alloc_pkey(struct crbtree *t, void *key)
 {
 	struct crbnode *crn;
-	crn = malloc(sizeof(*crn));
+	crn = mem_get(t->mm, sizeof(*crn));
 	if ( crn == NULL )
 		return NULL;
 	rb_ninit(&crn->node, key);
@@ -1026,7 +1313,7 @@ static struct crbnode *crb_node_alloc_pkey(struct crbtree *t, void *key)
 
 static void crb_node_free_pkey(struct crbtree *t, struct crbnode *crn)
 {
-	free(crn);
+	mem_free(t->mm, crn);
 }
 
 
@@ -1069,6 +1356,7 @@ struct crbtree *crb_new(struct crbtree_attr *attr, int abort_on_fail)
 	t->node_alloc = attr->node_alloc;
 	t->node_free = attr->node_free;
 	t->ctx = attr->ctx;
+	t->mm = attr->mm != NULL ? attr->mm : &stdmm;
 
 	return t;
 }
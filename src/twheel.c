@@ -0,0 +1,248 @@
+/*
+ * twheel.c -- Hashed hierarchical timing wheel.
+ *
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2003-2012 -- See accompanying license
+ *
+ */
+#include <cat/twheel.h>
+#include <cat/bitops.h>
+
+#define SHIFT(_lvl)	((_lvl) * TW_BITS)
+#define LVLIDX(_t, _lvl) (((_t) >> SHIFT(_lvl)) & TW_MASK)
+#define BMSET(_bm, _i)	((_bm)[(_i) >> 5] |= ((uint32_t)1 << ((_i) & 31)))
+#define BMCLR(_bm, _i)	((_bm)[(_i) >> 5] &= ~((uint32_t)1 << ((_i) & 31)))
+
+
+void tw_init(struct twheel *tw)
+{
+	int i, j;
+
+	abort_unless(tw);
+
+	tw->now = 0;
+	tw->count = 0;
+	for ( i = 0 ; i < TW_NLEVELS ; ++i ) {
+		for ( j = 0 ; j < TW_NSLOTS ; ++j )
+			l_init(&tw->slots[i][j]);
+		for ( j = 0 ; j < TW_BMLEN ; ++j )
+			tw->bmap[i][j] = 0;
+	}
+	l_init(&tw->overflow);
+}
+
+
+void tw_tmr_init(struct twtimer *t)
+{
+	abort_unless(t);
+	l_init(&t->entry);
+	t->expire = 0;
+}
+
+
+static void tw_place(struct twheel *tw, struct twtimer *t)
+{
+	ulong delta = t->expire - tw->now;
+	uint idx;
+	int lvl;
+
+	/* two shifts because SHIFT(TW_NLEVELS) may exceed the width of ulong */
+	for ( lvl = 0 ; lvl < TW_NLEVELS ; ++lvl )
+		if ( ((delta >> SHIFT(lvl)) >> TW_BITS) == 0 )
+			break;
+
+	if ( lvl == TW_NLEVELS ) {
+		l_enq(&tw->overflow, &t->entry);
+		return;
+	}
+
+	idx = LVLIDX(t->expire, lvl);
+	l_enq(&tw->slots[lvl][idx], &t->entry);
+	BMSET(tw->bmap[lvl], idx);
+}
+
+
+void tw_ins(struct twheel *tw, struct twtimer *t, ulong ticks)
+{
+	abort_unless(tw);
+	abort_unless(t);
+	abort_unless(!l_onlist(&t->entry));
+
+	if ( ticks == 0 )
+		ticks = 1;
+	t->expire = tw->now + ticks;
+	tw_place(tw, t);
+	++tw->count;
+}
+
+
+void tw_rem(struct twheel *tw, struct twtimer *t)
+{
+	abort_unless(tw);
+	abort_unless(t);
+
+	/* slot bitmaps are only hints:  they get cleared lazily */
+	if ( l_onlist(&t->entry) ) {
+		l_rem(&t->entry);
+		--tw->count;
+	}
+}
+
+
+/* returns the index of the first occupied slot >= 'from' or TW_NSLOTS */
+static uint tw_nextslot(struct twheel *tw, int lvl, uint from)
+{
+	uint32_t w;
+	uint i;
+
+	while ( from < TW_NSLOTS ) {
+		w = tw->bmap[lvl][from >> 5] & ((uint32_t)~0 << (from & 31));
+		if ( w == 0 ) {
+			from = (from & ~31) + 32;
+			continue;
+		}
+		i = (from & ~31) + ntz_32(w);
+		if ( i >= TW_NSLOTS )
+			break;
+		if ( !l_isempty(&tw->slots[lvl][i]) )
+			return i;
+		BMCLR(tw->bmap[lvl], i);
+		from = i + 1;
+	}
+
+	return TW_NSLOTS;
+}
+
+
+static void tw_cascade(struct twheel *tw, int lvl)
+{
+	struct list tmp, *node;
+	uint idx;
+
+	if ( lvl == TW_NLEVELS ) {
+		l_init(&tmp);
+		l_append(&tmp, &tw->overflow);
+	} else {
+		idx = LVLIDX(tw->now, lvl);
+		l_init(&tmp);
+		l_append(&tmp, &tw->slots[lvl][idx]);
+		BMCLR(tw->bmap[lvl], idx);
+		if ( idx == 0 )
+			tw_cascade(tw, lvl + 1);
+	}
+
+	while ( !l_isempty(&tmp) ) {
+		node = l_head(&tmp);
+		l_rem(node);
+		tw_place(tw, l_to_twt(node));
+	}
+}
+
+
+void tw_adv(struct twheel *tw, ulong ticks, struct list *out)
+{
+	struct list *slot;
+	uint idx, step;
+
+	abort_unless(tw);
+	abort_unless(out);
+
+	l_init(out);
+
+	while ( ticks > 0 ) {
+		if ( tw->count == 0 ) {
+			tw->now += ticks;
+			break;
+		}
+
+		/* skip to the next occupied slot in level 0 or the next wrap */
+		idx = tw->now & TW_MASK;
+		step = tw_nextslot(tw, 0, idx + 1) - idx;
+		if ( step > ticks )
+			step = ticks;
+		tw->now += step;
+		ticks -= step;
+
+		idx = tw->now & TW_MASK;
+		if ( idx == 0 )
+			tw_cascade(tw, 1);
+
+		slot = &tw->slots[0][idx];
+		if ( !l_isempty(slot) ) {
+			tw->count -= l_length(slot);
+			l_append(out, slot);
+		}
+		BMCLR(tw->bmap[0], idx);
+	}
+}
+
+
+int tw_next(struct twheel *tw, ulong *ticks)
+{
+	ulong low, d, best = 0;
+	uint cur, idx;
+	int lvl, found = 0;
+
+	abort_unless(tw);
+	abort_unless(ticks);
+
+	if ( tw->count == 0 )
+		return 0;
+
+	/*
+	 * The earliest event is either the expiration of a level 0 timer or
+	 * the cascade of the first occupied slot of some other level.  Slots
+	 * at or before the current index belong to the next rotation.
+	 * Modular arithmetic in ulong takes care of the wrap on short ulongs.
+	 */
+	for ( lvl = 0 ; lvl < TW_NLEVELS ; ++lvl ) {
+		cur = LVLIDX(tw->now, lvl);
+		low = tw->now & (((ulong)1 << SHIFT(lvl)) - 1);
+		if ( (idx = tw_nextslot(tw, lvl, cur + 1)) < TW_NSLOTS )
+			d = ((ulong)(idx - cur) << SHIFT(lvl)) - low;
+		else if ( (idx = tw_nextslot(tw, lvl, 0)) <= cur )
+			d = ((ulong)(TW_NSLOTS - cur + idx) << SHIFT(lvl)) - low;
+		else
+			continue;
+		if ( !found || d < best ) {
+			best = d;
+			found = 1;
+		}
+	}
+
+	if ( !l_isempty(&tw->overflow) ) {
+		lvl = TW_NLEVELS - 1;
+		cur = LVLIDX(tw->now, lvl);
+		low = tw->now & (((ulong)1 << SHIFT(lvl)) - 1);
+		d = ((ulong)(TW_NSLOTS - cur) << SHIFT(lvl)) - low;
+		if ( !found || d < best ) {
+			best = d;
+			found = 1;
+		}
+	}
+
+	/* can only fail if the count is out of sync with the wheel */
+	abort_unless(found);
+	*ticks = best;
+	return 1;
+}
+
+
+void tw_flush(struct twheel *tw, struct list *out)
+{
+	int i, j;
+
+	abort_unless(tw);
+	abort_unless(out);
+
+	l_init(out);
+	for ( i = 0 ; i < TW_NLEVELS ; ++i ) {
+		for ( j = 0 ; j < TW_NSLOTS ; ++j )
+			l_append(out, &tw->slots[i][j]);
+		for ( j = 0 ; j < TW_BMLEN ; ++j )
+			tw->bmap[i][j] = 0;
+	}
+	l_append(out, &tw->overflow);
+	tw->count = 0;
+}
@@ -18,6 +18,8 @@
 #include <stdlib.h>
 #include <signal.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 
 #include <cat/mem.h>
 #include <cat/aux.h>
@@ -25,11 +27,38 @@
 #include <cat/err.h>
 #include <cat/stduse.h>
 
+#if CAT_HAS_EPOLL
+#include <sys/epoll.h>
+#endif /* CAT_HAS_EPOLL */
+
+
+/* Per-descriptor state:  one for each fd with a registered I/O event */
+struct ue_fdent {
+	struct list		iolist;
+	struct list		fdfree;
+	int			fd;
+	int			events;
+};
+
+#define UE_EVB(_type)	(1 << (_type))
+
+
+/* I/O backend operations */
+struct ue_iobe {
+	int	(*init)(struct uemux *mux);
+	void	(*fini)(struct uemux *mux);
+	/* fe->events changed from 'omask':  update the monitored set */
+	int	(*mod)(struct uemux *mux, struct ue_fdent *fe, int omask);
+	int	(*wait)(struct uemux *mux, struct timeval *tvp);
+	void	(*dispatch)(struct uemux *mux);
+};
+
 static int  fdmax(struct cavltree *a);
 static void disable_signals(sigset_t *save);
 static void restore_signals(sigset_t *save);
 static void tdispatch(void *lp, void *muxp);
 static void iorun(void *ioep, void *param);
+static void fdrun(struct uemux *mux, struct ue_fdent *fe, int ready);
 static void run_sig_handlers(struct uemux *mux, sigset_t *ss, int maxsig);
 
 static sigset_t uemux_sset;
@@ -43,11 +72,11 @@ static int uemux_initialized = 0;
 static int fdmax(struct cavltree *a)
 {
 	struct anode *n = avl_getmax(&a->tree);
-	struct ue_ioevent *io;
+	struct ue_fdent *fe;
 	if ( !n ) 
 		return -1;
-	io = cavl_data(n);
-	return io->fd;
+	fe = cavl_data(n);
+	return fe->fd;
 }
 
 
@@ -69,26 +98,235 @@ static void restore_signals(sigset_t *save)
 }
 
 
-void ue_init(struct uemux *mux, struct memmgr *mm)
+static int sel_init(struct uemux *mux)
+{
+	FD_ZERO(&mux->rset);
+	FD_ZERO(&mux->wset);
+	FD_ZERO(&mux->eset);
+	return 0;
+}
+
+
+static void sel_fini(struct uemux *mux)
+{
+}
+
+
+static int sel_mod(struct uemux *mux, struct ue_fdent *fe, int omask)
+{
+	if ( fe->fd >= FD_SETSIZE )
+		return -1;
+
+	if ( fe->events & UE_EVB(UE_RD) )
+		FD_SET(fe->fd, &mux->rset);
+	else
+		FD_CLR(fe->fd, &mux->rset);
+	if ( fe->events & UE_EVB(UE_WR) )
+		FD_SET(fe->fd, &mux->wset);
+	else
+		FD_CLR(fe->fd, &mux->wset);
+	if ( fe->events & UE_EVB(UE_EX) )
+		FD_SET(fe->fd, &mux->eset);
+	else
+		FD_CLR(fe->fd, &mux->eset);
+
+	return 0;
+}
+
+
+static int sel_wait(struct uemux *mux, struct timeval *tvp)
+{
+	mux->rrdy = mux->rset;
+	mux->wrdy = mux->wset;
+	mux->erdy = mux->eset;
+	return select(mux->maxfd + 1, &mux->rrdy, &mux->wrdy, &mux->erdy, tvp);
+}
+
+
+static void sel_dispatch(struct uemux *mux)
+{
+	l_apply(&mux->iolist, iorun, mux);
+}
+
+
+static const struct ue_iobe ue_select_be = {
+	sel_init, sel_fini, sel_mod, sel_wait, sel_dispatch
+};
+
+
+#if CAT_HAS_EPOLL
+
+static int ep_init(struct uemux *mux)
+{
+	int fd;
+
+	if ( !mux->mm )
+		return -1;
+	mux->bevents = mem_get(mux->mm, 
+			       sizeof(struct epoll_event) * UE_EPOLL_NEVENTS);
+	if ( !mux->bevents )
+		return -1;
+	if ( (fd = epoll_create(UE_EPOLL_NEVENTS)) < 0 ) {
+		mem_free(mux->mm, mux->bevents);
+		mux->bevents = NULL;
+		return -1;
+	}
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	mux->befd = fd;
+	return 0;
+}
+
+
+static void ep_fini(struct uemux *mux)
+{
+	close(mux->befd);
+	mux->befd = -1;
+	mem_free(mux->mm, mux->bevents);
+	mux->bevents = NULL;
+}
+
+
+static int ep_mod(struct uemux *mux, struct ue_fdent *fe, int omask)
+{
+	struct epoll_event ev;
+	int op;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.data.ptr = fe;
+	if ( fe->events & UE_EVB(UE_RD) )
+		ev.events |= EPOLLIN;
+	if ( fe->events & UE_EVB(UE_WR) )
+		ev.events |= EPOLLOUT;
+	if ( fe->events & UE_EVB(UE_EX) )
+		ev.events |= EPOLLPRI;
+	if ( mux->betype == UE_BE_EPOLL_ET )
+		ev.events |= EPOLLET;
+
+	if ( omask == 0 ) {
+		op = EPOLL_CTL_ADD;
+	} else if ( fe->events == 0 ) {
+		/* the descriptor may already be closed:  ignore errors */
+		epoll_ctl(mux->befd, EPOLL_CTL_DEL, fe->fd, &ev);
+		return 0;
+	} else {
+		op = EPOLL_CTL_MOD;
+	}
+
+	if ( epoll_ctl(mux->befd, op, fe->fd, &ev) < 0 )
+		return -1;
+	return 0;
+}
+
+
+static int ep_wait(struct uemux *mux, struct timeval *tvp)
+{
+	int n, msec = -1;
+
+	if ( tvp ) {
+		/* round up so we don't spin on sub-millisecond timeouts */
+		if ( tvp->tv_sec >= INT_MAX / 1000 - 1 )
+			msec = INT_MAX;
+		else
+			msec = tvp->tv_sec * 1000 + (tvp->tv_usec + 999) / 1000;
+	}
+
+	n = epoll_wait(mux->befd, mux->bevents, UE_EPOLL_NEVENTS, msec);
+	mux->nready = (n < 0) ? 0 : n;
+	return n;
+}
+
+
+static void ep_dispatch(struct uemux *mux)
+{
+	struct epoll_event *ev = mux->bevents;
+	int i, ready;
+
+	for ( i = 0 ; i < mux->nready && !mux->done ; ++i ) {
+		ready = 0;
+		if ( ev[i].events & (EPOLLIN|EPOLLERR|EPOLLHUP) )
+			ready |= UE_EVB(UE_RD);
+		if ( ev[i].events & (EPOLLOUT|EPOLLERR|EPOLLHUP) )
+			ready |= UE_EVB(UE_WR);
+		if ( ev[i].events & EPOLLPRI )
+			ready |= UE_EVB(UE_EX);
+		fdrun(mux, ev[i].data.ptr, ready);
+	}
+	mux->nready = 0;
+}
+
+
+static const struct ue_iobe ue_epoll_be = {
+	ep_init, ep_fini, ep_mod, ep_wait, ep_dispatch
+};
+
+#endif /* CAT_HAS_EPOLL */
+
+
+int ue_init_be(struct uemux *mux, struct memmgr *mm, int betype)
 {
 	abort_unless(mux);
 
+	if ( betype == UE_BE_BEST )
+		betype = CAT_HAS_EPOLL ? UE_BE_EPOLL : UE_BE_SELECT;
+
+	switch(betype) {
+	case UE_BE_SELECT:
+		mux->iobe = &ue_select_be;
+		break;
+#if CAT_HAS_EPOLL
+	case UE_BE_EPOLL:
+	case UE_BE_EPOLL_ET:
+		mux->iobe = &ue_epoll_be;
+		break;
+#endif /* CAT_HAS_EPOLL */
+	default:
+		return -1;
+	}
+
+	mux->mm = mm;
+	mux->betype = betype;
+	mux->befd = -1;
+	mux->bevents = NULL;
+	mux->nready = 0;
+	mux->gen = 0;
+	mux->indisp = 0;
+	l_init(&mux->fdfree);
+	if ( (*mux->iobe->init)(mux) < 0 )
+		return -1;
+
 	if ( !uemux_initialized ) {
 		uemux_initialized = 1;
 		sigemptyset(&uemux_sset);
 		uemux_maxsig = -1;
 	}
 
-	mux->mm = mm;
 	mux->done = 0;
 	mux->maxfd = -1;
 	mux->fdtab = cavl_new(&cavl_std_attr_pkey, 0);
-	dl_init(&mux->timers, tm_zero);
+	tw_init(&mux->timers);
+	mux->tmlast = tm_uget();
 	l_init(&mux->iolist);
-	FD_ZERO(&mux->rset);
-	FD_ZERO(&mux->wset);
-	FD_ZERO(&mux->eset);
 	mux->sigtab = cavl_new(&cavl_std_attr_pkey, 0);
+
+	return 0;
+}
+
+
+void ue_init(struct uemux *mux, struct memmgr *mm)
+{
+	int rv = ue_init_be(mux, mm, UE_BE_SELECT);
+	abort_unless(rv == 0);
+}
+
+
+static void free_fdents(struct uemux *mux)
+{
+	struct list *l;
+	while ( !l_isempty(&mux->fdfree) ) {
+		l = l_head(&mux->fdfree);
+		l_rem(l);
+		mem_free(mux->mm, container(l, struct ue_fdent, fdfree));
+	}
 }
 
 
@@ -104,21 +342,42 @@ static void free_sigevent(void *sep, void *mmp)
 }
 
 
+static void free_fdtab(struct uemux *mux)
+{
+	struct anode *n;
+	struct ue_fdent *fe;
+
+	while ( (n = avl_getmax(&mux->fdtab->tree)) != NULL ) {
+		fe = cavl_data(n);
+		cavl_del(mux->fdtab, IKEY(fe->fd));
+		mem_free(mux->mm, fe);
+	}
+}
+
+
 void ue_fini(struct uemux *mux)
 {
 	struct ue_timer *t;
+	struct list l;
 
 	abort_unless(mux);
 
-	if ( mux->mm )
+	if ( mux->mm ) {
 		l_apply(&mux->iolist, free_io, NULL);
+		free_fdtab(mux);
+	}
 	cavl_free(mux->fdtab);
+	free_fdents(mux);
+	(*mux->iobe->fini)(mux);
 	if ( mux->mm )
 		cavl_apply(mux->sigtab, free_sigevent, NULL);
 	cavl_free(mux->sigtab);
 
-	while ( !dl_isempty(&mux->timers) ) {
-		t = container(dl_head(&mux->timers), struct ue_timer, entry);
+	tw_flush(&mux->timers, &l);
+	while ( !l_isempty(&l) ) {
+		t = container(l_to_twt(l_head(&l)), struct ue_timer, entry);
+		l_rem(&t->entry.entry);
+		t->flags &= ~UE_TREG;
 		ue_tm_del(t);
 	}
 }
@@ -130,37 +389,74 @@ void ue_stop(struct uemux *mux)
 }
 
 
+/* milliseconds since the timing wheel's last tick:  resyncs on clock steps */
+static ulong tm_lag(struct uemux *mux, cat_time_t now)
+{
+	cat_time_t d = tm_sub(now, mux->tmlast);
+	if ( tm_ltz(d) ) {
+		mux->tmlast = now;
+		return 0;
+	}
+	return tm_sec(d) * 1000 + tm_nsec(d) / 1000000;
+}
+
+
 static void tdispatch(void *lp, void *muxp)
 {
 	struct list *l = lp;
 	struct uemux *m = muxp;
 	struct ue_timer *t;
-	cat_time_t tout;
 
-	if ( m->done )
-		return;
+	t = container(l_to_twt(l), struct ue_timer, entry);
 	l_rem(l);
-	t = container(container(l, struct dlist, entry), struct ue_timer,entry);
+	if ( m->done ) {
+		/* put it back so it fires if the mux restarts */
+		tw_ins(&m->timers, &t->entry, 1);
+		t->flags |= UE_TREG;
+		return;
+	}
 	if ( t->flags & UE_PERIODIC ) {
-		tout = tm_lset(t->orig / 1000, (t->orig % 1000) * 1000000);
-		dl_init(&t->entry, tout);
-		dl_ins(&m->timers, &t->entry);
+		tw_ins(&m->timers, &t->entry, t->orig);
+		t->flags |= UE_TREG;
 	}
 	cb_call(&t->cb, NULL);
 }
 
 
+static void tm_advance(struct uemux *mux)
+{
+	struct list l, *trav;
+	cat_time_t now;
+	ulong ms;
+
+	now = tm_uget();
+	ms = tm_lag(mux, now);
+	mux->tmlast = tm_add(mux->tmlast, tm_lset(ms / 1000, 
+						  (ms % 1000) * 1000000));
+	tw_adv(&mux->timers, ms, &l);
+
+	/* 
+	 * Timers on 'l' are out of the wheel but a callback can still cancel
+	 * them before they get dispatched.  So, always take from the head.
+	 */
+	l_for_each(trav, &l)
+		container(l_to_twt(trav), struct ue_timer, entry)->flags &= 
+			~UE_TREG;
+	while ( !l_isempty(&l) )
+		tdispatch(l_head(&l), mux);
+}
+
+
 void ue_tm_init(struct ue_timer *t, int flags, ulong ttl, callback_f func, 
 		void *ctx)
 {
-	cat_time_t tout;
 	abort_unless(t);
 	abort_unless(func);
 	t->flags = flags;
 	t->orig  = ttl;
 	cb_init(&t->cb, func, ctx);
-	tout = tm_lset(t->orig / 1000, (t->orig % 1000) * 1000000);
-	dl_init(&t->entry, tout);
+	tw_tmr_init(&t->entry);
+	t->mux = NULL;
 	t->mm = NULL;
 }
 
@@ -169,8 +465,10 @@ int ue_tm_reg(struct uemux *mux, struct ue_timer *t)
 {
 	abort_unless(t);
 	abort_unless(mux);
-	dl_ins(&mux->timers, &t->entry);
+	/* the wheel only advances in ue_next():  account for time since */
+	tw_ins(&mux->timers, &t->entry, t->orig + tm_lag(mux, tm_uget()));
 	t->flags |= UE_TREG;
+	t->mux = mux;
 	return 0;
 }
 
@@ -179,9 +477,13 @@ int ue_tm_reg(struct uemux *mux, struct ue_timer *t)
 void ue_tm_cancel(struct ue_timer *t)
 {
 	abort_unless(t);
-	if ( !(t->flags & UE_TREG) )
+	if ( !(t->flags & UE_TREG) ) {
+		/* expired but still awaiting dispatch */
+		if ( tw_isreg(&t->entry) )
+			l_rem(&t->entry.entry);
 		return;
-	dl_rem(&t->entry);
+	}
+	tw_rem(&t->mux->timers, &t->entry);
 	t->flags &= ~UE_TREG;
 }
 
@@ -199,7 +501,8 @@ void ue_io_init(struct ue_ioevent *io, int type, int fd, callback_f f, void *a)
 
 int ue_io_reg(struct uemux *mux, struct ue_ioevent *io)
 {
-	struct list *list;
+	struct ue_fdent *fe;
+	int omask, isnew = 0;
 
 	abort_unless(mux);
 	abort_unless(io);
@@ -207,36 +510,43 @@ int ue_io_reg(struct uemux *mux, struct ue_ioevent *io)
 		     io->type == UE_EX);
 	abort_unless(io->fd >= 0);
 
-	if ( (list = cavl_get(mux->fdtab, IKEY(io->fd))) == NULL ) {
-		list = mem_get(mux->mm, sizeof(struct list));
-		if ( list == NULL )
+	if ( (fe = cavl_get(mux->fdtab, IKEY(io->fd))) == NULL ) {
+		fe = mem_get(mux->mm, sizeof(*fe));
+		if ( fe == NULL )
 			return -1;
-		l_init(list);
-		if ( cavl_put(mux->fdtab, IKEY(io->fd), list) < 0 ) {
-			mem_free(mux->mm, list);
+		l_init(&fe->iolist);
+		l_init(&fe->fdfree);
+		fe->fd = io->fd;
+		fe->events = 0;
+		if ( cavl_put(mux->fdtab, IKEY(io->fd), fe) < 0 ) {
+			mem_free(mux->mm, fe);
 			return -1;
 		}
+		isnew = 1;
 	}
-	l_ins(list, &io->fdlist);
 
-	cb_reg(&mux->iolist, &io->cb);
-	switch(io->type) {
-	case UE_RD:
-		FD_SET(io->fd, &mux->rset);
-		break;
-	case UE_WR:
-		FD_SET(io->fd, &mux->wset);
-		break;
-	case UE_EX:
-		FD_SET(io->fd, &mux->eset);
-		break;
+	omask = fe->events;
+	if ( !(omask & UE_EVB(io->type)) ) {
+		fe->events |= UE_EVB(io->type);
+		if ( (*mux->iobe->mod)(mux, fe, omask) < 0 ) {
+			fe->events = omask;
+			if ( isnew ) {
+				cavl_del(mux->fdtab, IKEY(io->fd));
+				mem_free(mux->mm, fe);
+			}
+			return -1;
+		}
 	}
+	l_ins(&fe->iolist, &io->fdlist);
+
+	cb_reg(&mux->iolist, &io->cb);
 
 	/* check if we have a new high fd */
 	if ( io->fd > mux->maxfd ) 
 		mux->maxfd = io->fd;
 
 	io->mux = mux;
+	io->gen = mux->gen;
 
 	return 0;
 }
@@ -245,8 +555,10 @@ int ue_io_reg(struct uemux *mux, struct ue_ioevent *io)
 void ue_io_cancel(struct ue_ioevent *io)
 {
 	struct uemux *mux;
-	struct list *list, *trav;
+	struct ue_fdent *fe;
+	struct list *trav;
 	struct ue_ioevent *io2;
+	int omask;
 
 	abort_unless(io);
 
@@ -256,26 +568,28 @@ void ue_io_cancel(struct ue_ioevent *io)
 	cb_unreg(&io->cb);
 
 	l_rem(&io->fdlist);
-	list = cavl_get(mux->fdtab, IKEY(io->fd));
-	abort_unless(list);
+	fe = cavl_get(mux->fdtab, IKEY(io->fd));
+	abort_unless(fe);
 
-	l_for_each(trav, list) {
+	l_for_each(trav, &fe->iolist) {
 		io2 = container(trav, struct ue_ioevent, fdlist);
 		if ( io2->type == io->type )
 			break;
 	}
-	if ( trav == l_end(list) ) {
-		switch(io->type) {
-		case UE_RD: FD_CLR(io->fd, &mux->rset); break;
-		case UE_WR: FD_CLR(io->fd, &mux->wset); break;
-		case UE_EX: FD_CLR(io->fd, &mux->eset); break;
-		}
+	if ( trav == l_end(&fe->iolist) ) {
+		omask = fe->events;
+		fe->events &= ~UE_EVB(io->type);
+		(*mux->iobe->mod)(mux, fe, omask);
 	}
-	if ( l_isempty(list) ) {
+	if ( l_isempty(&fe->iolist) ) {
 		cavl_del(mux->fdtab, IKEY(io->fd));
 		if ( io->fd == mux->maxfd )
 			mux->maxfd = fdmax(mux->fdtab);
-		mem_free(mux->mm, list);
+		/* the backend may still hold references during dispatch */
+		if ( mux->indisp )
+			l_ins(&mux->fdfree, &fe->fdfree);
+		else
+			mem_free(mux->mm, fe);
 	}
 }
 
@@ -404,29 +718,21 @@ static void run_sig_handlers(struct uemux *mux, sigset_t *ss, int maxsig)
 }
 
 
-struct ue_iorun_prm {
-	struct uemux *	mux;
-	fd_set *	rset;
-	fd_set *	wset;
-	fd_set *	eset;
-};
-
-
-static void iorun(void *ioep, void *param)
+static void iorun(void *ioep, void *muxp)
 {
 	struct ue_ioevent *io =
 		container(container(ioep, struct callback, entry), 
 			  struct ue_ioevent, cb);
-	struct ue_iorun_prm *iorp = param;
+	struct uemux *mux = muxp;
 	fd_set *set = NULL;
 
-	if ( iorp->mux->done )
+	if ( mux->done )
 		return;
 
 	switch(io->type) {
-		case UE_RD: set = iorp->rset; break;
-		case UE_WR: set = iorp->wset; break;
-		case UE_EX: set = iorp->eset; break;
+		case UE_RD: set = &mux->rrdy; break;
+		case UE_WR: set = &mux->wrdy; break;
+		case UE_EX: set = &mux->erdy; break;
 	}
 
 	if ( FD_ISSET(io->fd, set) )
@@ -434,14 +740,38 @@ static void iorun(void *ioep, void *param)
 }
 
 
+/*
+ * Run the I/O events on a descriptor that match the 'ready' mask.  Callbacks
+ * may cancel or register any event so rescan the list after each call.  The
+ * generation count ensures that each event runs at most once per ue_next().
+ */
+static void fdrun(struct uemux *mux, struct ue_fdent *fe, int ready)
+{
+	struct list *trav;
+	struct ue_ioevent *io;
+
+	do {
+		io = NULL;
+		l_for_each(trav, &fe->iolist) {
+			io = container(trav, struct ue_ioevent, fdlist);
+			if ( io->gen != mux->gen && 
+			     (ready & UE_EVB(io->type)) )
+				break;
+			io = NULL;
+		}
+		if ( io ) {
+			io->gen = mux->gen;
+			cb_call(&io->cb, int2ptr(io->fd));
+		}
+	} while ( io && !mux->done );
+}
+
+
 void ue_next(struct uemux *mux)
 {
 	int i, maxsig;
-	fd_set rset, wset, eset;
-	struct timeval cur, delta, tv, *tvp;
-	struct ue_iorun_prm iorp;
-	struct list l;
-	cat_time_t ct;
+	struct timeval delta, *tvp;
+	ulong ticks, lag;
 	sigset_t save, fired;
 
 	abort_unless(mux);
@@ -449,23 +779,23 @@ void ue_next(struct uemux *mux)
 		return;
 
 	tvp = NULL;
-	rset = mux->rset;
-	wset = mux->wset;
-	eset = mux->eset;
-
-	dl_first(&mux->timers, &ct);
-	if ( tm_gez(ct) ) {
-		delta.tv_sec  = tm_sec(ct);
-		delta.tv_usec = tm_nsec(ct) / 1000;
-		gettimeofday(&cur, NULL);
+	++mux->gen;
+
+	if ( tw_next(&mux->timers, &ticks) ) {
+		lag = tm_lag(mux, tm_uget());
+		ticks = (ticks > lag) ? ticks - lag : 0;
+		delta.tv_sec  = ticks / 1000;
+		delta.tv_usec = (ticks % 1000) * 1000;
 		tvp = &delta;
 	}
 
-	i = select(mux->maxfd + 1, &rset, &wset, &eset, tvp);
+	i = (*mux->iobe->wait)(mux, tvp);
 	if ( i < 0 && errno != EINTR ) {
-		errsys("ue_next (select): ");
+		errsys("ue_next (wait): ");
 	}
 
+	mux->indisp = 1;
+
 	disable_signals(&save);
 	maxsig = uemux_maxsig;
 	uemux_maxsig = -1;
@@ -480,34 +810,22 @@ void ue_next(struct uemux *mux)
 
 	/* possible if a signal fired */
 	if ( i < 0 )
-		return;
+		goto out;
 
-	if ( tvp ) { 
-		gettimeofday(&tv, NULL);
-		delta.tv_sec = tv.tv_sec - cur.tv_sec;
-		delta.tv_usec = tv.tv_usec - cur.tv_usec;
-		if (delta.tv_usec < 0) {
-			delta.tv_sec -= 1;
-			delta.tv_usec += 1000000;
-		}
-		ct = tm_lset(delta.tv_sec, delta.tv_usec * 1000);
-		l_init(&l);
-		dl_adv(&mux->timers, ct, &l);
-		l_apply(&l, tdispatch, mux);
-	}
+	tm_advance(mux);
 
-	iorp.mux  = mux;
-	iorp.rset = &rset;
-	iorp.wset = &wset;
-	iorp.eset = &eset;
-	l_apply(&mux->iolist, iorun, &iorp);
+	(*mux->iobe->dispatch)(mux);
+
+out:
+	mux->indisp = 0;
+	free_fdents(mux);
 }
 
 
 void ue_run(struct uemux *mux)
 {
 	abort_unless(mux);
-	while ( (!dl_isempty(&mux->timers) || (mux->maxfd >= 0)) && !mux->done )
+	while ( (!tw_isempty(&mux->timers) || (mux->maxfd >= 0)) && !mux->done )
 		ue_next(mux);
 }
 
@@ -532,6 +850,8 @@ void ue_runfor(struct uemux *mux, ulong msec)
 
 	while ( !timeout && !mux->done )
 		ue_next(mux);
+
+	ue_tm_cancel(&timer);
 }
 
 
@@ -0,0 +1,312 @@
+#include <cat/peg.h>
+#include <cat/emalloc.h>
+#include <cat/err.h>
+#include <cat/cpg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+
+struct input {
+	char *buf;
+	uint len;
+	uint pos;
+};
+
+
+struct actsum {
+	ulong n;
+	ulong sum;
+};
+
+
+char *readfile(const char *filename, uint *fs)
+{
+	FILE *fp;
+	long fsize;
+	char *buf;
+	long nread;
+
+	fp = fopen(filename, "r");
+	if ( fp == NULL )
+		errsys("opening file %s: ", filename);
+	fseek(fp, 0, SEEK_END);
+	fsize = ftell(fp);
+	rewind(fp);
+	buf = emalloc(fsize + 1);
+	nread = fread(buf, 1, fsize, fp);
+	if ( fsize != nread )
+		errsys("error reading file: ");
+	*fs = fsize;
+	return buf;
+}
+
+
+int mgetc(void *p)
+{
+	struct input *in = p;
+	if ( in->pos >= in->len )
+		return EOF;
+	return (uchar)in->buf[in->pos++];
+}
+
+
+int fgetc_in(void *fp)
+{
+	return fgetc(fp);
+}
+
+
+int fread_in(void *fp, void *buf, uint len)
+{
+	size_t n = fread(buf, 1, len, fp);
+	if ( n == 0 && ferror((FILE *)fp) )
+		return -1;
+	return n;
+}
+
+
+/* fold every action and the span it matched into a checksum */
+int record(int n, struct raw *r, void *aux)
+{
+	struct actsum *as = aux;
+
+	as->sum = as->sum * 31 + n;
+	as->sum = as->sum * 31 + r->len;
+	if ( r->len > 0 )
+		as->sum = as->sum * 31 + r->data[0];
+	++as->n;
+	return 0;
+}
+
+
+static void gen_term(struct input *in, uint max, int depth);
+
+static void gen_expr(struct input *in, uint max, int depth)
+{
+	gen_term(in, max, depth);
+	while ( in->len < max && rand() % 4 != 0 ) {
+		in->buf[in->len++] = ' ';
+		in->buf[in->len++] = "+-*/"[rand() % 4];
+		in->buf[in->len++] = ' ';
+		gen_term(in, max, depth);
+	}
+}
+
+
+static void gen_term(struct input *in, uint max, int depth)
+{
+	if ( depth > 0 && in->len < max && rand() % 3 == 0 ) {
+		in->buf[in->len++] = '(';
+		gen_expr(in, max, depth - 1);
+		in->buf[in->len++] = ')';
+	} else {
+		in->len += sprintf(in->buf + in->len, "%d", 1 + rand() % 999);
+	}
+}
+
+
+static double tv_usec(struct timeval *s, struct timeval *e)
+{
+	return (e->tv_sec - s->tv_sec) * 1e6 + (e->tv_usec - s->tv_usec);
+}
+
+
+static int run(struct cpg_state *cs, struct input *in, struct actsum *as,
+	       double *usec)
+{
+	struct timeval start, end;
+	int rv;
+
+	cpg_reset(cs);
+	in->pos = 0;
+	memset(as, 0, sizeof(*as));
+	gettimeofday(&start, NULL);
+	rv = cpg_parse(cs, in, as);
+	gettimeofday(&end, NULL);
+	*usec = tv_usec(&start, &end);
+	return rv;
+}
+
+
+/*
+ * Parse the input from a file with a getc function, with a block read
+ * function and mapped into memory.  All three must agree.
+ */
+static void input_bench(struct peg_grammar *peg, struct input *in)
+{
+	static const char *names[] = { "getc", "read", "mmap" };
+	char fname[] = "/tmp/peg-bench.XXXXXX";
+	struct cpg_state cs;
+	struct timeval start, end;
+	struct actsum as[3], more;
+	FILE *fp = NULL;
+	int fd, i, rv[3];
+	double usec;
+
+	if ( (fd = mkstemp(fname)) < 0 )
+		errsys("mkstemp: ");
+	if ( write(fd, in->buf, in->len) != in->len )
+		errsys("writing %s: ", fname);
+	close(fd);
+
+	for ( i = 0; i < 3; ++i ) {
+		if ( i < 2 && (fp = fopen(fname, "r")) == NULL )
+			errsys("opening %s: ", fname);
+		if ( i == 0 )
+			cpg_init(&cs, peg, fgetc_in);
+		else
+			cpg_init_read(&cs, peg, fread_in);
+		memset(&as[i], 0, sizeof(as[i]));
+		gettimeofday(&start, NULL);
+		if ( i < 2 )
+			rv[i] = cpg_parse(&cs, fp, &as[i]);
+		else
+			rv[i] = cpg_parse_file(&cs, fname, &as[i]);
+		gettimeofday(&end, NULL);
+		usec = tv_usec(&start, &end);
+		printf("%s:  rv = %d, %lu actions, %.0f usec, %.1f MB/s, "
+		       "%u byte buffer\n", names[i], rv[i], as[i].n, usec,
+		       in->len / (usec + 1), i < 2 ? cs.buflen : in->len);
+		/* the state reads on after mapped input without a reset */
+		if ( i == 2 && rv[i] > 0 ) {
+			if ( (fp = fopen(fname, "r")) == NULL )
+				errsys("opening %s: ", fname);
+			memset(&more, 0, sizeof(more));
+			if ( cpg_parse(&cs, fp, &more) != rv[i] ||
+			     more.n != as[i].n || more.sum != as[i].sum )
+				err("parsing on after mmap input differs\n");
+		}
+		cpg_fini(&cs);
+		if ( fp != NULL )
+			fclose(fp);
+		fp = NULL;
+	}
+	unlink(fname);
+
+	if ( rv[0] <= 0 )
+		err("grammar rejected %u bytes of input\n", in->len);
+	for ( i = 1; i < 3; ++i )
+		if ( rv[i] != rv[0] || as[i].n != as[0].n ||
+		     as[i].sum != as[0].sum )
+			err("%s input parsed differently than getc\n",
+			    names[i]);
+}
+
+
+void usage(const char *prog)
+{
+	err("usage: %s [-n size] [-d depth] [-m budget] [-1] [-a] [-x|-i] "
+	    "peg-file\n"
+	    "  -1 generates one long expression even if the grammar takes "
+	    "one per line\n"
+	    "  -a leaves the actions without callbacks\n"
+	    "  -x skips the unmemoized parse\n"
+	    "  -i compares input methods instead of memoization\n", prog);
+}
+
+
+int main(int argc, char *argv[])
+{
+	char *buf;
+	char estr[256];
+	struct peg_grammar_parser pgp;
+	struct peg_grammar peg;
+	struct cpg_state cs;
+	struct input in;
+	struct actsum plain, memo;
+	uint fsize, size = 4096;
+	ulong budget = 1024 * 1024;
+	int depth = 6, skip = 0, one = 0, noact = 0, inb = 0;
+	int i, rvp = 0, rvm;
+	double pu = 0, mu;
+
+	for ( i = 1; i < argc - 1; ++i ) {
+		if ( strcmp(argv[i], "-n") == 0 && i + 2 < argc )
+			size = strtoul(argv[++i], NULL, 0);
+		else if ( strcmp(argv[i], "-d") == 0 && i + 2 < argc )
+			depth = atoi(argv[++i]);
+		else if ( strcmp(argv[i], "-m") == 0 && i + 2 < argc )
+			budget = strtoul(argv[++i], NULL, 0);
+		else if ( strcmp(argv[i], "-a") == 0 )
+			noact = 1;
+		else if ( strcmp(argv[i], "-1") == 0 )
+			one = 1;
+		else if ( strcmp(argv[i], "-i") == 0 )
+			inb = 1;
+		else if ( strcmp(argv[i], "-x") == 0 )
+			skip = 1;
+		else
+			usage(argv[0]);
+	}
+	if ( i != argc - 1 )
+		usage(argv[0]);
+
+	buf = readfile(argv[i], &fsize);
+	if ( peg_parse(&pgp, &peg, buf, fsize, 0) < 0 )
+		err("%s\n", peg_err_string(&pgp, estr, sizeof(estr)));
+	for ( i = 0; i < peg.max_nodes && !noact; ++i ) {
+		if ( peg.nodes[i].pn_type == PEG_PRIMARY &&
+		     peg.nodes[i].pp_action == PEG_ACT_LABEL ) {
+			peg.nodes[i].pn_action_cb = &record;
+			peg.nodes[i].pp_action = PEG_ACT_CALLBACK;
+		}
+	}
+
+	/* grammars that don't take an expression per line get just one */
+	cpg_init(&cs, &peg, mgetc);
+	if ( !one && cpg_parse_mem(&cs, "1\n2\n", 4, &plain) <= 0 )
+		one = 1;
+	cpg_fini(&cs);
+
+	/* random expressions with nesting up to 'depth' */
+	srand(1);
+	in.buf = emalloc(size + 16 * depth + 64);
+	in.len = 0;
+	while ( in.len < size ) {
+		if ( one && in.len > 0 ) {
+			in.buf[in.len++] = ' ';
+			in.buf[in.len++] = '+';
+			in.buf[in.len++] = ' ';
+		}
+		gen_expr(&in, size, depth);
+		if ( !one )
+			in.buf[in.len++] = '\n';
+	}
+
+	if ( inb ) {
+		input_bench(&peg, &in);
+		goto done;
+	}
+
+	cpg_init(&cs, &peg, mgetc);
+	if ( !skip ) {
+		rvp = run(&cs, &in, &plain, &pu);
+		printf("plain:  rv = %d, %lu actions, %.0f usec, "
+		       "%u byte buffer\n", rvp, plain.n, pu, cs.buflen);
+		if ( rvp <= 0 )
+			err("grammar rejected %u bytes of input\n", in.len);
+	}
+
+	if ( cpg_memo_init(&cs, budget) < 0 )
+		err("cpg_memo_init() failed\n");
+	rvm = run(&cs, &in, &memo, &mu);
+	printf("memo:   rv = %d, %lu actions, %.0f usec, %lu hits, "
+	       "%lu misses, %u byte buffer\n", rvm, memo.n, mu,
+	       cs.memo_hits, cs.memo_misses, cs.buflen);
+	if ( rvm <= 0 )
+		err("grammar rejected %u bytes of input\n", in.len);
+
+	if ( !skip && (rvp != rvm || plain.n != memo.n ||
+		       plain.sum != memo.sum) )
+		err("memoized parse of %u bytes differs\n", in.len);
+
+	cpg_fini(&cs);
+done:
+	peg_free_nodes(&peg);
+	free(in.buf);
+	free(buf);
+	return 0;
+}
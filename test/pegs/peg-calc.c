@@ -69,6 +69,7 @@ int push_num(int n, struct raw *r, void *aux)
 int do_negate(int n, struct raw *r, void *aux)
 {
 	push(-pop());
+	return 0;
 }
 
 
@@ -76,12 +77,14 @@ int do_divide(int n, struct raw *r, void *aux)
 {
 	int b = pop();
 	push(pop() / b);
+	return 0;
 }
 
 
 int do_multiply(int n, struct raw *r, void *aux)
 {
 	push(pop() * pop());
+	return 0;
 }
 
 
@@ -89,12 +92,14 @@ int do_minus(int n, struct raw *r, void *aux)
 {
 	int b = pop();
 	push(pop() - b);
+	return 0;
 }
 
 
 int do_plus(int n, struct raw *r, void *aux)
 {
 	push(pop() + pop());
+	return 0;
 }
 
 
@@ -102,6 +107,7 @@ int output(int n, struct raw *r, void *aux)
 {
 	printf("result = %d\n", pop());
 	fflush(stdout);
+	return 0;
 }
 
 
@@ -0,0 +1,138 @@
+#include <cat/emalloc.h>
+#include <cat/err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "calct.h"
+#include "calcs.h"
+
+
+struct input {
+	char *buf;
+	uint len;
+	uint pos;
+};
+
+
+struct actsum {
+	ulong n;
+	ulong sum;
+};
+
+
+int mgetc(void *p)
+{
+	struct input *in = p;
+	if ( in->pos >= in->len )
+		return EOF;
+	return (uchar)in->buf[in->pos++];
+}
+
+
+/* called from the actions of both parsers */
+int bench_act(int n, struct raw *r, void *ctx)
+{
+	struct actsum *as = ctx;
+
+	as->sum = as->sum * 31 + n;
+	as->sum = as->sum * 31 + r->len;
+	if ( r->len > 0 )
+		as->sum = as->sum * 31 + r->data[0];
+	++as->n;
+	return 0;
+}
+
+
+static void gen_term(struct input *in, uint max, int depth);
+
+static void gen_expr(struct input *in, uint max, int depth)
+{
+	gen_term(in, max, depth);
+	while ( in->len < max && rand() % 4 != 0 ) {
+		in->buf[in->len++] = ' ';
+		in->buf[in->len++] = "+-*/"[rand() % 4];
+		in->buf[in->len++] = ' ';
+		gen_term(in, max, depth);
+	}
+}
+
+
+static void gen_term(struct input *in, uint max, int depth)
+{
+	if ( depth > 0 && in->len < max && rand() % 3 == 0 ) {
+		in->buf[in->len++] = '(';
+		gen_expr(in, max, depth - 1);
+		in->buf[in->len++] = ')';
+	} else {
+		in->len += sprintf(in->buf + in->len, "%d", 1 + rand() % 999);
+	}
+}
+
+
+static double tv_usec(struct timeval *s, struct timeval *e)
+{
+	return (e->tv_sec - s->tv_sec) * 1e6 + (e->tv_usec - s->tv_usec);
+}
+
+
+/*
+ * Parse the same input with the table driven parser (cpg_parse()) and
+ * the specialized one that pegcc -s generated from the same grammar.
+ */
+int main(int argc, char *argv[])
+{
+	struct calct_parser tp;
+	struct calcs_parser sp;
+	struct input in;
+	struct actsum ta, sa;
+	struct timeval start, end;
+	uint size = 4 * 1024 * 1024;
+	int depth = 6;
+	int trv, srv;
+	uint tbuf, sbuf;
+	double tu, su;
+
+	if ( argc > 1 )
+		size = strtoul(argv[1], NULL, 0);
+	if ( argc > 2 )
+		depth = atoi(argv[2]);
+
+	srand(1);
+	in.buf = emalloc(size + 16 * depth + 64);
+	in.len = 0;
+	while ( in.len < size ) {
+		gen_expr(&in, size, depth);
+		in.buf[in.len++] = '\n';
+	}
+
+	calct_init(&tp, mgetc);
+	in.pos = 0;
+	memset(&ta, 0, sizeof(ta));
+	gettimeofday(&start, NULL);
+	trv = calct_parse(&tp, &in, &ta);
+	gettimeofday(&end, NULL);
+	tu = tv_usec(&start, &end);
+	tbuf = tp.pstate.buflen;
+	calct_fini(&tp);
+
+	calcs_init(&sp, mgetc);
+	in.pos = 0;
+	memset(&sa, 0, sizeof(sa));
+	gettimeofday(&start, NULL);
+	srv = calcs_parse(&sp, &in, &sa);
+	gettimeofday(&end, NULL);
+	su = tv_usec(&start, &end);
+	sbuf = sp.pstate.buflen;
+	calcs_fini(&sp);
+
+	printf("cpg_parse():  rv = %d, %lu actions, %.0f usec, %.1f MB/s, "
+	       "%u byte buffer\n", trv, ta.n, tu, in.len / (tu + 1), tbuf);
+	printf("specialized:  rv = %d, %lu actions, %.0f usec, %.1f MB/s, "
+	       "%u byte buffer\n", srv, sa.n, su, in.len / (su + 1), sbuf);
+	if ( trv != srv || ta.n != sa.n || ta.sum != sa.sum )
+		err("specialized parser disagrees with cpg_parse()\n");
+
+	free(in.buf);
+	return 0;
+}
@@ -0,0 +1,169 @@
+/*
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2003-2017 -- See accompanying license
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <cat/cat.h>
+#include <cat/catlibc.h>
+#include <cat/err.h>
+
+#define BUFSZ		(1024 * 1024 + 64)
+#define NCHECK		100000
+#define MINBYTES	(64 * 1024 * 1024)
+
+byte_t *buf1, *buf2, *buf3;
+
+
+static int sign(int x)
+{
+  return x < 0 ? -1 : (x > 0 ? 1 : 0);
+}
+
+
+static void fill(byte_t *p, size_t len, uint *seed)
+{
+  size_t i;
+  for ( i = 0 ; i < len ; ++i )
+    p[i] = rand_r(seed);
+}
+
+
+/* compare each function against the platform libc at random offsets */
+static void check(void)
+{
+  uint seed = 1;
+  size_t len, o1, o2, i;
+  int n, c;
+  void *rv;
+  char *p;
+
+  for ( n = 0 ; n < NCHECK ; ++n ) {
+    len = rand_r(&seed) % (n % 16 == 0 ? 4096 : 100);
+    o1 = rand_r(&seed) % 32;
+    o2 = rand_r(&seed) % 32;
+    c = rand_r(&seed) % 256;
+
+    fill(buf1, len + 64, &seed);
+    memcpy(buf2, buf1, len + 64);
+    rv = cat_memcpy(buf2 + o1, buf1 + o2, len);
+    if ( rv != buf2 + o1 || memcmp(buf2 + o1, buf1 + o2, len) != 0 ||
+         memcmp(buf2, buf1, o1) != 0 ||
+         memcmp(buf2 + o1 + len, buf1 + o1 + len, 64 - o1) != 0 )
+      err("cat_memcpy() failed: len %u, offsets %u, %u\n", (uint)len,
+          (uint)o1, (uint)o2);
+
+    memcpy(buf2, buf1, len + 64);
+    memcpy(buf3, buf1, len + 64);
+    cat_memmove(buf2 + o1, buf2 + o2, len);
+    memmove(buf3 + o1, buf3 + o2, len);
+    if ( memcmp(buf2, buf3, len + 64) != 0 )
+      err("cat_memmove() failed: len %u, offsets %u, %u\n", (uint)len,
+          (uint)o1, (uint)o2);
+
+    memcpy(buf2, buf1, len + 64);
+    memcpy(buf3, buf1, len + 64);
+    cat_memset(buf2 + o1, c, len);
+    memset(buf3 + o1, c, len);
+    if ( memcmp(buf2, buf3, len + 64) != 0 )
+      err("cat_memset() failed: len %u, offset %u\n", (uint)len, (uint)o1);
+
+    memcpy(buf2 + o2, buf1 + o1, len);
+    if ( len > 0 && n % 2 == 0 )
+      buf2[o2 + rand_r(&seed) % len] ^= 1 << (rand_r(&seed) % 8);
+    if ( sign(cat_memcmp(buf1 + o1, buf2 + o2, len)) !=
+         sign(memcmp(buf1 + o1, buf2 + o2, len)) )
+      err("cat_memcmp() failed: len %u, offsets %u, %u\n", (uint)len,
+          (uint)o1, (uint)o2);
+
+    for ( i = 0 ; i < len ; ++i )
+      buf1[o1 + i] = buf1[o1 + i] % 255 + 1;
+    buf1[o1 + len] = '\0';
+    p = (char *)buf1 + o1;
+    if ( cat_strlen(p) != strlen(p) )
+      err("cat_strlen() failed: len %u, offset %u\n", (uint)len, (uint)o1);
+    if ( cat_strchr(p, c) != strchr(p, c) )
+      err("cat_strchr() failed: len %u, offset %u, char %d\n", (uint)len,
+          (uint)o1, c);
+  }
+  printf("catlibc functions agree with the platform libc\n\n");
+}
+
+
+static double now(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+enum { MEMCPY, MEMSET, MEMCMP, STRLEN };
+static const char *opnames[] = { "memcpy", "memset", "memcmp", "strlen" };
+
+
+/* return the throughput in MB/s */
+static double bench(int op, int cat, size_t len)
+{
+  ulong i, nrep = MINBYTES / len + 1;
+  volatile size_t sink = 0;
+  double start;
+
+  start = now();
+  for ( i = 0 ; i < nrep ; ++i ) {
+    switch ( op ) {
+    case MEMCPY:
+      if ( cat )
+        cat_memcpy(buf2, buf1 + 1, len);
+      else
+        memcpy(buf2, buf1 + 1, len);
+      break;
+    case MEMSET:
+      if ( cat )
+        cat_memset(buf2 + 1, (int)i, len);
+      else
+        memset(buf2 + 1, (int)i, len);
+      break;
+    case MEMCMP:
+      sink += cat ? cat_memcmp(buf1, buf3, len) : memcmp(buf1, buf3, len);
+      break;
+    case STRLEN:
+      sink += cat ? cat_strlen((char *)buf1) : strlen((char *)buf1);
+      break;
+    }
+  }
+  return (double)nrep * len / (now() - start) / (1024.0 * 1024.0);
+}
+
+
+int main(int argc, char *argv[])
+{
+  size_t len;
+  int op;
+
+  buf1 = malloc(BUFSZ);
+  buf2 = malloc(BUFSZ);
+  buf3 = malloc(BUFSZ);
+  if ( buf1 == NULL || buf2 == NULL || buf3 == NULL )
+    err("out of memory\n");
+
+  check();
+
+  printf("%-8s %10s %12s %12s\n", "op", "bytes", "catlibc MB/s",
+         "libc MB/s");
+  for ( op = MEMCPY ; op <= STRLEN ; ++op ) {
+    for ( len = 1 ; len <= 1024 * 1024 ; len *= 4 ) {
+      memset(buf1, 'a', BUFSZ);
+      memset(buf3, 'a', BUFSZ);
+      buf1[len] = '\0';
+      printf("%-8s %10u %12.1f %12.1f\n", opnames[op], (uint)len,
+             bench(op, 1, len), bench(op, 0, len));
+    }
+  }
+
+  return 0;
+}
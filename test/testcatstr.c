@@ -5,7 +5,13 @@
  *
  */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <cat/catstr.h>
+#include <cat/match.h>
+#include <cat/stduse.h>
+#include <cat/err.h>
+#include <sys/time.h>
 
 const char *foo()
 {
@@ -16,8 +22,153 @@ const char *foo()
 	return cs_to_cstr(&str1);
 }
 
+static int naive_find(const char *s, size_t slen, const char *p, size_t plen,
+		      size_t *loc)
+{
+	size_t i;
+	for ( i = 0 ; i + plen <= slen ; ++i ) {
+		if ( memcmp(s + i, p, plen) == 0 ) {
+			*loc = i;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+
+#define FINDTLEN	200
+#define FINDNTRY	20000
+
+void test_find(void)
+{
+	char text[FINDTLEN], pat[72];
+	struct raw r, pr;
+	size_t loc, nloc;
+	int hw[3], h, i, j, rv, nrv;
+	size_t slen, plen;
+	struct catstr *cs;
+
+	/* probe the CPU with a first search */
+	text[0] = pat[0] = 'a';
+	r.data = (byte_t *)text;
+	r.len = 1;
+	pr.data = (byte_t *)pat;
+	pr.len = 1;
+	mem_match(&r, &pr, &loc);
+	hw[0] = mem_match_hwaccel;
+	hw[1] = mem_match_hwaccel & MEM_MATCH_HW_SSE2;
+	hw[2] = 0;
+
+	srand(1);
+	for ( h = 0 ; h < 3 ; ++h ) {
+		mem_match_hwaccel = hw[h];
+		for ( i = 0 ; i < FINDNTRY ; ++i ) {
+			slen = rand() % FINDTLEN;
+			plen = rand() % sizeof(pat);
+			for ( j = 0 ; j < slen ; ++j )
+				text[j] = "abc"[rand() % 3];
+			for ( j = 0 ; j < plen ; ++j )
+				pat[j] = "abc"[rand() % 3];
+			/* plant the pattern most of the time */
+			if ( plen <= slen && (rand() % 4) != 0 )
+				memcpy(text + rand() % (slen - plen + 1), pat,
+				       plen);
+			r.len = slen;
+			pr.len = plen;
+			loc = nloc = (size_t)-1;
+			rv = mem_match(&r, &pr, &loc);
+			nrv = naive_find(text, slen, pat, plen, &nloc);
+			if ( rv != nrv || (rv && loc != nloc) )
+				err("mem_match(hw=%d) of %u bytes in %u: got "
+				    "%d@%lu, expected %d@%lu\n", hw[h],
+				    (uint)plen, (uint)slen, rv, (ulong)loc, nrv,
+				    (ulong)nloc);
+		}
+	}
+	mem_match_hwaccel = hw[0];
+	printf("mem_match() agreed with naive search %d times with "
+	       "hwaccel = %d, %d and %d\n", FINDNTRY, hw[0], hw[1], hw[2]);
+
+	cs = cs_copy_from_chars("the quick brown fox");
+	if ( cs_find_str(cs, "brown") != 10 || cs_find_str(cs, "") != 0 ||
+	     cs_find_str(cs, "fox") != 16 || cs_find_str(cs, "foxy") !=
+	     CS_NOTFOUND || cs_find_str(cs, "cat") != CS_NOTFOUND )
+		err("cs_find_str() returned the wrong offset\n");
+	cs_free(cs);
+	printf("cs_find_str() found and missed the right strings\n");
+}
+
+
+#define FINDBLEN	(1024 * 1024)
+#define FINDBREPS	20
+
+static double tv_usec(struct timeval *s, struct timeval *e)
+{
+	return (e->tv_sec - s->tv_sec) * 1e6 + (e->tv_usec - s->tv_usec);
+}
+
+
+void bench_find(void)
+{
+	static const int lens[] = { 1, 2, 3, 4, 6, 8, 12, 16, 24, 32, 48, 64 };
+	static char pat[65];
+	struct catstr *cs;
+	struct bmpat *bmp;
+	struct raw r, pr;
+	struct timeval start, end;
+	ulong loc, bloc;
+	size_t off;
+	double csu, bmu, mb;
+	int i, j, len;
+
+	cs = cs_alloc(FINDBLEN);
+	srand(2);
+	for ( i = 0 ; i < FINDBLEN ; ++i )
+		cs->cs_data[i] = 'a' + rand() % 26;
+	cs->cs_data[FINDBLEN] = '\0';
+	cs->cs_dlen = FINDBLEN;
+	r.data = (byte_t *)cs->cs_data;
+	r.len = FINDBLEN;
+
+	printf("needle   cs_find()      bm_match()     (MB/s to the match)\n");
+	for ( i = 0 ; i < sizeof(lens) / sizeof(lens[0]) ; ++i ) {
+		/* short needles occur early, long ones only near the end */
+		len = lens[i];
+		memcpy(pat, cs->cs_data + FINDBLEN - 100, len);
+		pat[len] = '\0';
+		pr.data = (byte_t *)pat;
+		pr.len = len;
+
+		gettimeofday(&start, NULL);
+		for ( j = 0 ; j < FINDBREPS ; ++j )
+			off = cs_find_str(cs, pat);
+		gettimeofday(&end, NULL);
+		csu = tv_usec(&start, &end);
+
+		bmp = bm_pnew(&estdmm, &pr);
+		gettimeofday(&start, NULL);
+		for ( j = 0 ; j < FINDBREPS ; ++j )
+			bm_match(&r, bmp, &bloc);
+		gettimeofday(&end, NULL);
+		bmu = tv_usec(&start, &end);
+		free(bmp);
+
+		if ( off != bloc )
+			err("cs_find_str() found %u byte needle at %lu, "
+			    "bm_match() at %lu\n", len, (ulong)off, bloc);
+		mb = (double)(off + len) * FINDBREPS;
+		printf("%6d %10.0f     %10.0f\n", len, mb / (csu + 1),
+		       mb / (bmu + 1));
+	}
+	cs_free(cs);
+}
+
+
 int main(int argc, char *argv[])
 {
 	puts(foo());
+	test_find();
+	if ( argc > 1 && strcmp(argv[1], "-b") == 0 )
+		bench_find();
 	return 0;
 }
@@ -0,0 +1,221 @@
+/*
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2003-2017 -- See accompanying license
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <cat/cmap.h>
+#include <cat/hash.h>
+#include <cat/err.h>
+
+#define NKEYS		16384
+#define NBKTS		16384
+#define NLOCKS		256
+#define NREADERS	4
+#define NWRITERS	2
+#define NOPS		(256 * 1024)
+
+struct tnode {
+  struct cmnode		cmn;
+  struct hnode		hn;
+  int			key;
+  int			inmap;
+  int			dead;
+};
+
+struct tnode nodes[NKEYS];
+struct cmnode *bkts[NBKTS];
+int locks[NLOCKS];
+struct cmap map;
+
+struct hnode *hbkts[NBKTS];
+struct htab htab;
+pthread_mutex_t hlock = PTHREAD_MUTEX_INITIALIZER;
+
+ulong nreleased;
+ulong nremoved;
+int use_mutex;
+
+
+static int cmp_int(const void *a, const void *b)
+{
+  return *(const int *)a - *(const int *)b;
+}
+
+
+static uint hash_int(const void *k, void *unused)
+{
+  uint x = *(const int *)k;
+  x = (x ^ (x >> 16)) * 0x45d9f3b;
+  return x ^ (x >> 16);
+}
+
+
+static void release(struct cmnode *cmn, void *ctx)
+{
+  struct tnode *tn = container(cmn, struct tnode, cmn);
+  tn->dead = 1;
+  __atomic_store_n(&tn->inmap, 0, __ATOMIC_RELEASE);
+  __atomic_add_fetch(&nreleased, 1, __ATOMIC_RELAXED);
+}
+
+
+static double elapsed(struct timeval *start, struct timeval *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1000000.0 +
+         (end->tv_usec - start->tv_usec);
+}
+
+
+/* Look up random keys and make sure no node gets released under us */
+static void *reader(void *arg)
+{
+  struct cmreader r;
+  struct cmnode *cmn;
+  struct tnode *tn;
+  uint seed = (uint)(ulong)arg;
+  ulong nfound = 0;
+  int i, k;
+
+  cm_rd_reg(&map, &r);
+  for ( i = 0 ; i < NOPS ; ++i ) {
+    k = rand_r(&seed) % NKEYS;
+    if ( use_mutex ) {
+      pthread_mutex_lock(&hlock);
+      nfound += ht_lkup(&htab, &k, NULL) != NULL;
+      pthread_mutex_unlock(&hlock);
+      continue;
+    }
+    cm_rd_enter(&map, &r);
+    if ( (cmn = cm_lkup(&map, &k, NULL)) != NULL ) {
+      tn = container(cmn, struct tnode, cmn);
+      if ( tn->key != k || tn->dead )
+        err("reader found a bad node for key %d\n", k);
+      ++nfound;
+    }
+    cm_rd_leave(&map, &r);
+  }
+  cm_rd_unreg(&map, &r);
+
+  return (void *)nfound;
+}
+
+
+/* Insert and remove the keys that belong to this writer */
+static void *writer(void *arg)
+{
+  struct tnode *tn;
+  int w = (int)(ulong)arg;
+  uint seed = w;
+  int i, k;
+
+  for ( i = 0 ; i < NOPS / 4 ; ++i ) {
+    k = rand_r(&seed) % (NKEYS / NWRITERS) * NWRITERS + w;
+    tn = &nodes[k];
+    if ( use_mutex ) {
+      pthread_mutex_lock(&hlock);
+      if ( tn->inmap )
+        ht_rem(&tn->hn);
+      else
+        ht_ins_h(&htab, &tn->hn);
+      tn->inmap = !tn->inmap;
+      pthread_mutex_unlock(&hlock);
+      continue;
+    }
+    /* 1 == in the map, 2 == removed but not released, 0 == released */
+    if ( __atomic_load_n(&tn->inmap, __ATOMIC_ACQUIRE) == 1 ) {
+      __atomic_store_n(&tn->inmap, 2, __ATOMIC_RELEASE);
+      if ( cm_rem_key(&map, &tn->key) != &tn->cmn )
+        err("writer %d unable to remove key %d\n", w, k);
+      __atomic_add_fetch(&nremoved, 1, __ATOMIC_RELAXED);
+    } else if ( __atomic_load_n(&tn->inmap, __ATOMIC_ACQUIRE) == 0 ) {
+      cm_ninit(&tn->cmn, &tn->key);
+      tn->dead = 0;
+      __atomic_store_n(&tn->inmap, 1, __ATOMIC_RELEASE);
+      if ( cm_ins(&map, &tn->cmn, cm_hash(&map, &tn->key)) != NULL )
+        err("writer %d found duplicate key %d\n", w, k);
+    }
+    if ( i % 1024 == 0 )
+      cm_reclaim(&map);
+  }
+
+  return NULL;
+}
+
+
+static void run(const char *name)
+{
+  pthread_t rthr[NREADERS], wthr[NWRITERS];
+  struct timeval start, end;
+  ulong nfound = 0;
+  void *rv;
+  int i;
+
+  gettimeofday(&start, NULL);
+  for ( i = 0 ; i < NWRITERS ; ++i )
+    if ( pthread_create(&wthr[i], NULL, writer, (void *)(ulong)i) != 0 )
+      err("unable to create writer thread\n");
+  for ( i = 0 ; i < NREADERS ; ++i )
+    if ( pthread_create(&rthr[i], NULL, reader, (void *)(ulong)(i+1)) != 0 )
+      err("unable to create reader thread\n");
+  for ( i = 0 ; i < NWRITERS ; ++i )
+    pthread_join(wthr[i], NULL);
+  for ( i = 0 ; i < NREADERS ; ++i ) {
+    pthread_join(rthr[i], &rv);
+    nfound += (ulong)rv;
+  }
+  gettimeofday(&end, NULL);
+
+  printf("%s: %d readers x %d lookups, %d writers x %d updates: "
+         "%.3f usec, %lu found\n", name, NREADERS, NOPS, NWRITERS, NOPS / 4,
+         elapsed(&start, &end), nfound);
+}
+
+
+int main(int argc, char *argv[])
+{
+  int i, n = 0;
+
+  if ( !CAT_HAS_ATOMICS ) {
+    printf("No atomic operations:  skipping the concurrent map test\n");
+    return 0;
+  }
+
+  cm_init(&map, bkts, NBKTS, locks, NLOCKS, cmp_int, hash_int, NULL,
+          release, NULL);
+  for ( i = 0 ; i < NKEYS ; ++i )
+    nodes[i].key = i;
+  run("cmap");
+
+  for ( i = 0 ; i < NKEYS ; ++i )
+    n += nodes[i].inmap == 1;
+  for ( i = 0 ; i < NKEYS ; ++i ) {
+    if ( nodes[i].inmap != 1 ) {
+      if ( cm_rem_key(&map, &nodes[i].key) != NULL )
+        err("key %d should not be in the map\n", i);
+    } else if ( cm_rem_key(&map, &nodes[i].key) == NULL ) {
+      err("key %d missing from the map\n", i);
+    } else {
+      ++nremoved;
+    }
+  }
+  cm_fini(&map);
+  if ( nreleased != nremoved )
+    err("released %lu nodes but removed %lu\n", nreleased, nremoved);
+  printf("cmap: %d keys left in the map, %lu nodes released\n", n, nreleased);
+
+  use_mutex = 1;
+  ht_init(&htab, hbkts, NBKTS, cmp_int, hash_int, NULL);
+  for ( i = 0 ; i < NKEYS ; ++i ) {
+    ht_ninit(&nodes[i].hn, &nodes[i].key);
+    nodes[i].inmap = 0;
+  }
+  run("mutex+htab");
+
+  return 0;
+}
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 #include <cat/crc.h>
 #include <cat/err.h>
 
@@ -128,8 +129,153 @@ static void check_crc32c(void)
 }
 
 
+#define NCHECK		2000
+#define BUFLEN		(1024 * 1024)
+#define MINBYTES	(256 * 1024 * 1024)
+byte_t buf[BUFLEN + 64];
+
+
+static ulong bytewise_le(const struct crc32tab *t, const byte_t *p,
+			 size_t size, ulong crc)
+{
+	for ( ; size > 0 ; --size, ++p )
+		crc = t->resid[0][(*p ^ crc) & 0xFF] ^ (crc >> 8);
+	return crc;
+}
+
+
+static ulong bytewise_be(const struct crc32tab *t, const byte_t *p,
+			 size_t size, ulong crc)
+{
+	for ( ; size > 0 ; --size, ++p )
+		crc = (t->resid[0][(*p ^ (crc >> 24)) & 0xFF] ^ (crc << 8)) &
+		      0xFFFFFFFF;
+	return crc;
+}
+
+
+/*
+ * Compare slice-by-8 and the hardware paths against the byte-at-a-time
+ * table at random lengths and alignments and check that combining the
+ * CRCs of two halves matches the CRC of the whole.  The SSE4.2 path is
+ * also checked on its own without PCLMULQDQ folding the long buffers.
+ */
+static void check_fast(const char *name, ulong poly, int le)
+{
+	struct crc32tab t, sw, nc;
+	size_t len, off, split;
+	ulong ref, c1, c2;
+	int i, hw, ok = 1;
+
+	if ( le ) {
+		crc32t_le_init(&t, poly);
+	} else {
+		crc32t_be_init(&t, poly);
+	}
+	sw = t;
+	sw.hwaccel = 0;
+	nc = t;
+	nc.hwaccel &= ~CRC32T_HW_CLMUL;
+	hw = t.hwaccel;
+
+	for ( i = 0 ; i < NCHECK && ok ; ++i ) {
+		len = rand() % (i % 10 == 0 ? 20000 : 600);
+		off = rand() % 16;
+		split = len ? rand() % len : 0;
+		c1 = rand();
+		if ( le ) {
+			ref = bytewise_le(&t, buf + off, len, c1);
+			ok = crc32t_le(&t, buf + off, len, c1) == ref &&
+			     crc32t_le(&sw, buf + off, len, c1) == ref &&
+			     crc32t_le(&nc, buf + off, len, c1) == ref;
+			c1 = crc32t_le(&t, buf + off, split, c1);
+			c2 = crc32t_le(&t, buf + off + split, len - split, 0);
+			ok = ok && crc32t_le_combine(&t, c1, c2, len - split)
+				   == ref;
+		} else {
+			ref = bytewise_be(&t, buf + off, len, c1);
+			ok = crc32t_be(&t, buf + off, len, c1) == ref;
+			c1 = crc32t_be(&t, buf + off, split, c1);
+			c2 = crc32t_be(&t, buf + off + split, len - split, 0);
+			ok = ok && crc32t_be_combine(&t, c1, c2, len - split)
+				   == ref;
+		}
+	}
+	fprintf(stderr, "Fast %s (hwaccel 0x%x) and combine match bytewise: %s\n",
+		name, hw, ok ? "PASSED" : "FAILED");
+}
+
+
+static void check_combine(void)
+{
+	ulong c1, c2, c;
+	size_t split = 3;
+
+	c1 = crc32(check_vec, split);
+	c2 = crc32(check_vec + split, strlen(check_vec) - split);
+	c = crc32_combine(c1, c2, strlen(check_vec) - split);
+	fprintf(stderr, "crc32_combine() of \"%s\" is 0x%08lx.  "
+		"Should be 0x%08lx\n", check_vec, c, CRC32_CHECK_VAL);
+	if ( c == CRC32_CHECK_VAL )
+		fprintf(stderr, "PASSED\n");
+	else
+		fprintf(stderr, "FAILED\n");
+}
+
+
+static double now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+/* return MB/s:  mode 0 is bytewise, 1 slice-by-8, 2 best available */
+static double bench(struct crc32tab *t, int mode, size_t len)
+{
+	struct crc32tab tt = *t;
+	ulong i, nrep = MINBYTES / len / (mode == 0 ? 8 : 1) + 1;
+	volatile ulong sink = 0;
+	double start;
+
+	if ( mode < 2 )
+		tt.hwaccel = 0;
+	start = now();
+	for ( i = 0 ; i < nrep ; ++i ) {
+		if ( mode == 0 )
+			sink += bytewise_le(&tt, buf, len, sink);
+		else
+			sink += crc32t_le(&tt, buf, len, sink);
+	}
+	return (double)nrep * len / (now() - start) / (1024.0 * 1024.0);
+}
+
+
+static void bench_all(void)
+{
+	struct crc32tab t32, t32c;
+	size_t len;
+
+	crc32t_le_init(&t32, CAT_CRC32_POLY);
+	crc32t_le_init(&t32c, CAT_CRC32C_POLY);
+	printf("%-7s %8s %13s %12s %12s\n", "crc", "bytes", "bytewise MB/s",
+	       "slice8 MB/s", "hw MB/s");
+	for ( len = 64 ; len <= BUFLEN ; len *= 16 ) {
+		printf("%-7s %8u %13.1f %12.1f %12.1f\n", "CRC32", (uint)len,
+		       bench(&t32, 0, len), bench(&t32, 1, len),
+		       bench(&t32, 2, len));
+		printf("%-7s %8u %13.1f %12.1f %12.1f\n", "CRC32C", (uint)len,
+		       bench(&t32c, 0, len), bench(&t32c, 1, len),
+		       bench(&t32c, 2, len));
+	}
+}
+
+
 int main(int argc, char *argv[])
 {
+	size_t i;
+
 	if ( argc == 2 && strcmp(argv[1], "-h") == 0 ) {
 		fprintf(stderr, "usage: %s [file]\n", argv[0]);
 		exit(1);
@@ -139,8 +285,17 @@ int main(int argc, char *argv[])
 	check_crc32_dumb();
 	check_crc32();
 	check_crc32c();
+	check_combine();
+
+	for ( i = 0 ; i < sizeof(buf) ; ++i )
+		buf[i] = rand();
+	check_fast("CRC32", CAT_CRC32_POLY, 1);
+	check_fast("CRC32C", CAT_CRC32C_POLY, 1);
+	check_fast("big-endian CRC32", CAT_CRC32_POLY, 0);
 
 	if ( argc > 1 ) 
 		crc32_file(argv[1]);
+	else
+		bench_all();
 	return 0;
 }
@@ -135,6 +135,158 @@ void perf_sha256()
   fflush(stdout);
 }
 
+/* SHA-256 of the first N bytes of 00 01 02 ... ff */
+struct { ulong len; byte_t hash[32]; } sha256_len_vectors[] = {
+  { 63, { 0x29, 0xaf, 0x26, 0x86, 0xfd, 0x53, 0x37, 0x4a, 0x36, 0xb0, 0x84,
+          0x66, 0x94, 0xcc, 0x34, 0x21, 0x77, 0xe4, 0x28, 0xd1, 0x64, 0x75,
+          0x15, 0xf0, 0x78, 0x78, 0x4d, 0x69, 0xcd, 0xb9, 0xe4, 0x88 } },
+  { 64, { 0xfd, 0xea, 0xb9, 0xac, 0xf3, 0x71, 0x03, 0x62, 0xbd, 0x26, 0x58,
+          0xcd, 0xc9, 0xa2, 0x9e, 0x8f, 0x9c, 0x75, 0x7f, 0xcf, 0x98, 0x11,
+          0x60, 0x3a, 0x8c, 0x44, 0x7c, 0xd1, 0xd9, 0x15, 0x11, 0x08 } },
+  { 119, { 0xda, 0x18, 0x79, 0x7e, 0xd7, 0xc3, 0xa7, 0x77, 0xf0, 0x84, 0x7f,
+           0x42, 0x97, 0x24, 0xa2, 0xd8, 0xcd, 0x51, 0x38, 0xe6, 0xed, 0x28,
+           0x95, 0xc3, 0xfa, 0x1a, 0x6d, 0x39, 0xd1, 0x8f, 0x7e, 0xc6 } },
+  { 120, { 0xf5, 0x2b, 0x23, 0xdb, 0x1f, 0xbb, 0x6d, 0xed, 0x89, 0xef, 0x42,
+           0xa2, 0x3c, 0xe0, 0xc8, 0x92, 0x2c, 0x45, 0xf2, 0x5c, 0x50, 0xb5,
+           0x68, 0xa9, 0x3b, 0xf1, 0xc0, 0x75, 0x42, 0x0b, 0xbb, 0x7c } },
+  { 256, { 0x40, 0xaf, 0xf2, 0xe9, 0xd2, 0xd8, 0x92, 0x2e, 0x47, 0xaf, 0xd4,
+           0x64, 0x8e, 0x69, 0x67, 0x49, 0x71, 0x58, 0x78, 0x5f, 0xbd, 0x1d,
+           0xa8, 0x70, 0xe7, 0x11, 0x02, 0x66, 0xbf, 0x94, 0x48, 0x80 } },
+};
+
+#define NMSG		4096
+#define MAXMSG		1024
+byte_t msgbuf[NMSG + MAXMSG];
+const void *msgs[NMSG];
+ulong msglens[NMSG];
+byte_t hashes[NMSG][32], hashes2[NMSG][32];
+
+
+/*
+ * Check every available path on lengths around the block and padding
+ * boundaries, incremental adds in odd sized pieces and sha256_multi()
+ * on messages of mixed lengths.
+ */
+void test_sha256_paths()
+{
+  struct sha256ctx s;
+  byte_t in[256], out[32], ref[32];
+  int hw, mode, i, j, fail = 0;
+  ulong len, n;
+
+  sha256(in, 0, out);
+  hw = sha256_hwaccel;
+  for ( i = 0; i < sizeof(in); ++i )
+    in[i] = i;
+
+  for ( mode = 0; mode < 2; ++mode ) {
+    sha256_hwaccel = mode ? hw : 0;
+    for ( i = 0; i < sizeof(sha256_len_vectors)/sizeof(sha256_len_vectors[0]);
+          ++i ) {
+      sha256(in, sha256_len_vectors[i].len, out);
+      if ( memcmp(out, sha256_len_vectors[i].hash, 32) ) {
+        printf("sha256 (hwaccel %d) wrong for %lu bytes\n", sha256_hwaccel,
+               sha256_len_vectors[i].len);
+        fail = 1;
+      }
+    }
+    for ( len = 0; len <= sizeof(in); ++len ) {
+      sha256(in, len, ref);
+      sha256_init(&s);
+      for ( j = 0, n = 1; j < len; j += n, n = n * 3 % 71 + 1 )
+        sha256_add(&s, in + j, (len - j < n) ? len - j : n);
+      sha256_fini(&s, out);
+      if ( memcmp(out, ref, 32) ) {
+        printf("incremental sha256 (hwaccel %d) differs for %lu bytes\n",
+               sha256_hwaccel, len);
+        fail = 1;
+      }
+    }
+  }
+
+  for ( i = 0; i < sizeof(msgbuf); ++i )
+    msgbuf[i] = i * 7 + (i >> 8);
+  for ( i = 0; i < NMSG; ++i ) {
+    msgs[i] = msgbuf + i;
+    msglens[i] = (i * 37) % (i % 64 == 0 ? MAXMSG : 200);
+  }
+  sha256_hwaccel = 0;
+  for ( i = 0; i < NMSG; ++i )
+    sha256((void *)msgs[i], msglens[i], hashes[i]);
+  for ( mode = 0; mode < 3; ++mode ) {
+    sha256_hwaccel = (mode == 0) ? 0 : (mode == 1) ? hw :
+                     (hw & ~SHA256_HW_SHANI);
+    /* odd group sizes leave lanes idle */
+    for ( i = 0; i < NMSG; i += n ) {
+      n = (i % 11) + 1;
+      if ( i + n > NMSG )
+        n = NMSG - i;
+      sha256_multi(msgs + i, msglens + i, hashes2 + i, n);
+    }
+    if ( memcmp(hashes, hashes2, sizeof(hashes)) ) {
+      printf("sha256_multi (hwaccel %d) differs from sha256\n",
+             sha256_hwaccel);
+      fail = 1;
+    }
+  }
+  sha256_hwaccel = hw;
+
+  printf("sha256 paths (hwaccel %d available) %s\n", hw,
+         fail ? "FAILURE!" : "SUCCESS");
+}
+
+
+static double sha256_mbps(int hwaccel, int multi, ulong msglen)
+{
+  cat_time_t start, diff;
+  ulong nbytes = 0;
+  int i, j;
+
+  for ( i = 0; i < NMSG; ++i )
+    msglens[i] = msglen;
+  sha256_hwaccel = hwaccel;
+  start = tm_uget();
+  for ( j = 0; nbytes < 64 * 1024 * 1024; ++j ) {
+    if ( multi ) {
+      sha256_multi(msgs, msglens, hashes, NMSG);
+    } else {
+      for ( i = 0; i < NMSG; ++i )
+        sha256((void *)msgs[i], msglen, hashes[i]);
+    }
+    nbytes += NMSG * msglen;
+  }
+  diff = tm_sub(tm_uget(), start);
+  return nbytes / tm_2dbl(diff) / (1024.0 * 1024.0);
+}
+
+
+void perf_sha256_paths()
+{
+  static const ulong lens[] = { 64, 256, 1024 };
+  int hw, i;
+
+  sha256_hwaccel = -1;
+  sha256(rand_data, 0, hashes[0]);
+  hw = sha256_hwaccel;
+  printf("%8s %12s %12s %12s %12s\n", "msglen", "scalar MB/s",
+         "SHA-NI MB/s", "AVX2x8 MB/s", "multi MB/s");
+  for ( i = 0; i < sizeof(lens) / sizeof(lens[0]); ++i ) {
+    printf("%8lu %12.1f ", lens[i], sha256_mbps(0, 0, lens[i]));
+    if ( hw & SHA256_HW_SHANI )
+      printf("%12.1f ", sha256_mbps(SHA256_HW_SHANI, 0, lens[i]));
+    else
+      printf("%12s ", "n/a");
+    if ( hw & SHA256_HW_AVX2 )
+      printf("%12.1f ", sha256_mbps(SHA256_HW_AVX2, 1, lens[i]));
+    else
+      printf("%12s ", "n/a");
+    printf("%12.1f\n", sha256_mbps(hw, 1, lens[i]));
+  }
+  sha256_hwaccel = hw;
+  fflush(stdout);
+}
+
+
 
 /*
  * SipHash-2-4 output with
@@ -277,6 +429,8 @@ int main(int argc, char *argv[])
   perf_arc4();
   test_sha256();
   perf_sha256();
+  test_sha256_paths();
+  perf_sha256_paths();
   test_siphash24();
   perf_siphash24();
   return 0;
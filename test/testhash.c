@@ -10,6 +10,8 @@
 #include <sys/time.h>
 #include <cat/hash.h>
 #include <cat/stduse.h>
+#include <cat/crypto.h>
+#include <cat/fhash.h>
 
 #define NUMSTR 4
 #define NOPS	65536
@@ -103,6 +105,313 @@ void timeit()
 }
 
 
+/* grow a table from 1 bucket to NOPS entries and back down again */
+void test_resize()
+{
+  struct rhtab rt;
+  struct htab ft;
+  struct hnode *fbkts[512];
+  static struct hnode nodes[NOPS], fnodes[NOPS];
+  uint h;
+  int i, j;
+  struct timeval start, end;
+  double usec;
+
+  if ( rht_init(&rt, &stdmm, 1, cmp_str, ht_shash, NULL) < 0 )
+    err("rht_init failed\n");
+  ht_init(&ft, fbkts, array_length(fbkts), cmp_str, ht_shash, NULL);
+
+  for (i = 0; i < NOPS; i++) {
+    ht_ninit(&nodes[i], str_fmt_a("node%d", i));
+    ht_ninit(&fnodes[i], nodes[i].key);
+  }
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NOPS; i++) {
+    if (rht_lkup(&rt, nodes[i].key, &h))
+      err("duplicate node for key %d found\n", i);
+    rht_ins(&rt, &nodes[i], h);
+  }
+  for (j = 0; j < 4; j++)
+    for (i = 0; i < NOPS; i++)
+      if (rht_lkup(&rt, nodes[i].key, NULL) != &nodes[i])
+        err("resizing table lost key %d\n", i);
+  gettimeofday(&end, NULL);
+  usec = (end.tv_sec - start.tv_sec) * 1000000 + end.tv_usec - start.tv_usec;
+  printf("Resizing table grew from 1 to %u buckets w/%lu elem: "
+         "%f usec for %d ins + %d lkup\n", rt.tab.nbkts, rht_fill(&rt), usec,
+         NOPS, 4 * NOPS);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < NOPS; i++) {
+    if (ht_lkup(&ft, fnodes[i].key, &h))
+      err("duplicate node for key %d found\n", i);
+    ht_ins(&ft, &fnodes[i], h);
+  }
+  for (j = 0; j < 4; j++)
+    for (i = 0; i < NOPS; i++)
+      if (ht_lkup(&ft, fnodes[i].key, NULL) != &fnodes[i])
+        err("fixed table lost key %d\n", i);
+  gettimeofday(&end, NULL);
+  usec = (end.tv_sec - start.tv_sec) * 1000000 + end.tv_usec - start.tv_usec;
+  printf("Fixed table with %u buckets w/%d elem: "
+         "%f usec for %d ins + %d lkup\n", ft.nbkts, NOPS, usec,
+         NOPS, 4 * NOPS);
+
+  for (i = 0; i < NOPS; i += 2)
+    rht_rem(&rt, &nodes[i]);
+  for (i = 0; i < NOPS; i++)
+    if ((rht_lkup(&rt, nodes[i].key, NULL) != NULL) != (i & 1))
+      err("key %d is wrong after removing half the nodes\n", i);
+  for (i = 1; i < NOPS; i += 2)
+    rht_rem(&rt, &nodes[i]);
+  for (i = 0; i < NOPS; i++)
+    rht_lkup(&rt, nodes[0].key, NULL);
+  if (rht_fill(&rt) != 0 || rht_inmove(&rt) || rt.tab.nbkts != 1)
+    err("table did not shrink back down: %lu elem, %u buckets\n",
+        rht_fill(&rt), rt.tab.nbkts);
+  printf("Resizing table shrank back to %u bucket when emptied\n",
+         rt.tab.nbkts);
+  rht_fini(&rt);
+
+  for (i = 0; i < NOPS; i++)
+    free(nodes[i].key);
+}
+
+
+/* random lookups in a table much larger than the cache */
+#define NBIG	(1024 * 1024)
+#define BURST	32
+struct hnode bignodes[NBIG];
+struct hnode *bigbkts[NBIG];
+const void *bigkeys[NBIG];
+
+void test_burst()
+{
+  struct htab bt;
+  struct hnode *out[BURST];
+  struct timeval start, end;
+  double usec;
+  ulong nfound, nlkup;
+  int i, j;
+
+  ht_init(&bt, bigbkts, NBIG, cmp_intptr, ht_ihash, NULL);
+  for (i = 0; i < NBIG; i++) {
+    ht_ninit(&bignodes[i], int2ptr(i + 1));
+    ht_ins_h(&bt, &bignodes[i]);
+  }
+  /* half hits, half misses */
+  for (i = 0; i < NBIG; i++)
+    bigkeys[i] = int2ptr(((ulong)rand() % (2 * NBIG)) + 1);
+
+  gettimeofday(&start, NULL);
+  for (nfound = 0, i = 0; i < NBIG; i++)
+    nfound += ht_lkup(&bt, bigkeys[i], NULL) != NULL;
+  gettimeofday(&end, NULL);
+  usec = (end.tv_sec - start.tv_sec) * 1000000 + end.tv_usec - start.tv_usec;
+  printf("Roughly %f nsec per ht_lkup() w/%d elem, %lu found\n",
+         usec * 1000 / NBIG, NBIG, nfound);
+  nlkup = nfound;
+
+  gettimeofday(&start, NULL);
+  for (nfound = 0, i = 0; i < NBIG; i += BURST) {
+    nfound += ht_lkup_burst(&bt, bigkeys + i, BURST, out, NULL);
+    for (j = 0; j < BURST; j++)
+      if (out[j] != NULL && out[j]->key != bigkeys[i + j])
+        err("ht_lkup_burst() returned the wrong node\n");
+  }
+  gettimeofday(&end, NULL);
+  usec = (end.tv_sec - start.tv_sec) * 1000000 + end.tv_usec - start.tv_usec;
+  printf("Roughly %f nsec per key for ht_lkup_burst() of %d w/%d elem, "
+         "%lu found\n", usec * 1000 / NBIG, BURST, NBIG, nfound);
+  if (nfound != nlkup)
+    err("ht_lkup_burst() found %lu keys, ht_lkup() found %lu\n", nfound,
+        nlkup);
+
+  /* every slot must hold exactly what ht_lkup() returns for its key */
+  for (i = 0; i < NBIG; i += BURST) {
+    ht_lkup_burst(&bt, bigkeys + i, BURST, out, NULL);
+    for (j = 0; j < BURST; j++)
+      if (out[j] != ht_lkup(&bt, bigkeys[i + j], NULL))
+        err("ht_lkup_burst() and ht_lkup() differ for key %d\n", i + j);
+  }
+}
+
+#if CAT_64BIT
+
+/* reference vectors from the wyhash and SipHash distributions */
+void test_fhash_vectors()
+{
+  static const char *wystr[] = {
+    "", "a", "abc", "message digest", "abcdefghijklmnopqrstuvwxyz",
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789",
+    "1234567890123456789012345678901234567890"
+    "1234567890123456789012345678901234567890"
+  };
+  static const ulong wyhi[] = {
+    0x0409638e, 0xa8412d09, 0x32dd92e4, 0x86191240, 0x7a43afb6, 0xff42329b,
+    0xc39cab13
+  };
+  static const ulong wylo[] = {
+    0xe2bde459, 0x1b5fe0a9, 0xb2915153, 0x89a3a16b, 0x1d7f5f40, 0x90e50d58,
+    0xb115aad3
+  };
+  static const struct { size_t len; ulong hi, lo; } sip[] = {
+    { 0, 0xabac0158, 0x050fc4dc }, { 1, 0xc9f49bf3, 0x7d57ca93 },
+    { 7, 0xd3927d98, 0x9bb11140 }, { 8, 0x36909511, 0x8d299a8e },
+    { 15, 0xd320d86d, 0x2a519956 }, { 63, 0x9d199062, 0xb7bbb3a8 },
+  };
+  byte_t key[16], msg[64];
+  struct fhash_key fk;
+  struct raw r;
+  uint64_t h;
+  uint32_t u32;
+  int i;
+
+  for (i = 0; i < array_length(wystr); i++) {
+    h = wyhash(wystr[i], strlen(wystr[i]), i);
+    if (h != (((uint64_t)wyhi[i] << 32) | wylo[i]))
+      err("wyhash(\"%s\", %d) = %08lx%08lx\n", wystr[i], i,
+          (ulong)(h >> 32), (ulong)(h & 0xFFFFFFFF));
+  }
+
+  for (i = 0; i < sizeof(key); i++)
+    key[i] = i;
+  for (i = 0; i < sizeof(msg); i++)
+    msg[i] = i;
+  for (i = 0; i < array_length(sip); i++) {
+    h = siphash13(key, msg, sip[i].len);
+    if (h != (((uint64_t)sip[i].hi << 32) | sip[i].lo))
+      err("siphash13() of %u bytes = %08lx%08lx\n", (uint)sip[i].len,
+          (ulong)(h >> 32), (ulong)(h & 0xFFFFFFFF));
+  }
+
+  /* the hash_f wrappers agree with each other and with the key */
+  fhash_key_init(&fk, key, sizeof(key));
+  r.data = (byte_t *)wystr[5];
+  r.len = strlen(wystr[5]);
+  if (ht_wy_shash(wystr[5], &fk) != ht_wy_rhash(&r, &fk) ||
+      ht_sh13_shash(wystr[5], &fk) != ht_sh13_rhash(&r, &fk))
+    err("string and raw hashes disagree\n");
+  if (ht_wy_shash(wystr[5], &fk) == ht_wy_shash(wystr[5], NULL) ||
+      ht_sh13_shash(wystr[5], &fk) == ht_sh13_shash(wystr[5], NULL))
+    err("hash key had no effect\n");
+  u32 = 12345;
+  h = 12345;
+  if (ht_wy_u32hash(&u32, NULL) != ht_wy_u64hash(&h, NULL) ||
+      ht_wy_u64hash(&h, NULL) != ht_wy_ihash(int2ptr(12345), NULL))
+    err("integer hashes disagree\n");
+  printf("wyhash and SipHash-1-3 vectors pass\n");
+}
+
+
+#define HBUFSZ	4096
+#define HBYTES	(64 * 1024 * 1024)
+
+void perf_fhash()
+{
+  static const size_t lens[] = { 4, 8, 16, 32, 64, 256, 1024, 4096 };
+  static const char *names[] = {
+    "ht_shash", "wyhash", "siphash13", "siphash24"
+  };
+  static char buf[HBUFSZ + 1];
+  struct ht_sh24_ctx s24;
+  struct fhash_key fk;
+  struct timeval start, end;
+  double usec;
+  ulong n, niter;
+  uint acc = 0;
+  int i, f;
+
+  for (i = 0; i < HBUFSZ; i++)
+    buf[i] = 'a' + i % 26;
+  fhash_key_init(&fk, "fhash test key", 14);
+  ht_sh24_init(&s24, "fhash test key", 14);
+
+  printf("%8s", "bytes");
+  for (f = 0; f < array_length(names); f++)
+    printf(" %11s", names[f]);
+  printf("    (nsec/key, MB/s)\n");
+  for (i = 0; i < array_length(lens); i++) {
+    buf[lens[i]] = '\0';
+    niter = HBYTES / lens[i];
+    if (niter > 8 * 1024 * 1024)
+      niter = 8 * 1024 * 1024;
+    printf("%8u", (uint)lens[i]);
+    for (f = 0; f < array_length(names); f++) {
+      gettimeofday(&start, NULL);
+      for (n = 0; n < niter; n++) {
+        buf[0] = 'a' + (n & 0xF);
+        switch (f) {
+        case 0: acc += ht_shash(buf, NULL); break;
+        case 1: acc += ht_wy_shash(buf, &fk); break;
+        case 2: acc += ht_sh13_shash(buf, &fk); break;
+        case 3: acc += ht_sh24_shash(buf, &s24); break;
+        }
+      }
+      gettimeofday(&end, NULL);
+      usec = (end.tv_sec - start.tv_sec) * 1000000 +
+             end.tv_usec - start.tv_usec;
+      printf(" %5.1f/%5.0f", usec * 1000 / niter,
+             (double)lens[i] * niter / usec);
+    }
+    printf("\n");
+    buf[lens[i]] = 'a' + lens[i] % 26;
+  }
+  printf("(checksum %u)\n", acc);
+}
+
+
+/*
+ * Chi-square of bucket counts for similar string keys and sequential
+ * integers.  For a uniform hash the statistic is close to the number of
+ * buckets;  values many times that mean the hash is clustering keys.
+ */
+#define DBKTS	1024
+#define DKEYS	(64 * DBKTS)
+
+static double chisq(uint *counts)
+{
+  double x = 0, e = (double)DKEYS / DBKTS;
+  int i;
+  for (i = 0; i < DBKTS; i++)
+    x += (counts[i] - e) * (counts[i] - e) / e;
+  return x;
+}
+
+
+void test_fhash_dist()
+{
+  static uint counts[4][DBKTS];
+  static const char *names[] = {
+    "ht_shash", "ht_wy_shash", "ht_sh13_shash", "ht_wy_u64hash"
+  };
+  char key[32];
+  uint64_t v;
+  int i, f;
+
+  memset(counts, 0, sizeof(counts));
+  for (i = 0; i < DKEYS; i++) {
+    sprintf(key, "node%d", i);
+    ++counts[0][ht_shash(key, NULL) % DBKTS];
+    ++counts[1][ht_wy_shash(key, NULL) % DBKTS];
+    ++counts[2][ht_sh13_shash(key, NULL) % DBKTS];
+    /* multiples of the bucket count defeat a plain modulus */
+    v = (uint64_t)i * DBKTS;
+    ++counts[3][ht_wy_u64hash(&v, NULL) % DBKTS];
+  }
+
+  for (f = 0; f < array_length(names); f++) {
+    printf("%-14s chi-square %.1f over %d buckets\n", names[f],
+           chisq(counts[f]), DBKTS);
+    if (f > 0 && chisq(counts[f]) > 2 * DBKTS)
+      err("%s distributes keys poorly\n", names[f]);
+  }
+}
+
+#endif /* CAT_64BIT */
+
+
 int main() 
 { 
   int i;
@@ -155,6 +464,13 @@ int main()
   cht_free(table); 
 
   timeit();
+  test_resize();
+  test_burst();
+#if CAT_64BIT
+  test_fhash_vectors();
+  test_fhash_dist();
+  perf_fhash();
+#endif /* CAT_64BIT */
 
   return 0;
 } 
@@ -8,7 +8,9 @@
 #include <cat/err.h>
 #include <cat/stduse.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 
 enum token_e { 
 	WHITESPACE, NEWLINE, NUMBER, PLUS, MINUS, TIMES, DIVIDE, LPAREN,
@@ -27,6 +29,87 @@ void Lex_add(struct lexer *lex, const char *pat, int tok)
 		err("Error adding token '%d' with pattern '%s'", tok, pat);
 }
 
+/* token rules for the benchmark:  the token is the index */
+const char *bench_rules[] = {
+	"[ \t]+", "[\n\r]+", "-?[0-9]+", "-?[0-9]+\\.[0-9]+", "\\+", "-",
+	"\\*", "/", "\\(", "\\)", "if", "else", "while", "for", "return",
+	"int", "char", "struct", "==", "!=", "<=", ">=", "<", ">", "=", ";", ",",
+	"\\{", "\\}", "\"[^\"]*\"", "[a-zA-Z_][a-zA-Z_0-9]*",
+};
+
+const char *bench_words[] = {
+	"if", "else", "while", "for", "return", "int", "char", "struct",
+	"ifx", "counter", "x", "_tmp9", "==", "!=", "<=", ">=", "<", ">", "=",
+	";", ",", "{", "}", "(", ")", "+", "-", "*", "/", "12345", "-7",
+	"3.14159", "\"a string\"", " ", "\t", "\n",
+};
+
+
+/* tokenize 'input' and return the number of tokens and a checksum */
+static ulong lex_all(struct lexer *lex, const char *input, ulong *csum)
+{
+	const char *tokp;
+	int tok, toklen;
+	ulong n = 0;
+
+	*csum = 0;
+	lex_reset(lex, input);
+	while ( (tok = lex_next_token(lex, &tokp, &toklen)) >= 0 ) {
+		*csum = *csum * 31 + tok * 1000 + toklen;
+		++n;
+	}
+	if ( tok != LEX_END )
+		err("lexing stopped with %d at offset %u\n", tok,
+		    (uint)(tokp - input));
+	return n;
+}
+
+
+int bench(void)
+{
+	struct lexer *lex;
+	struct timeval start, end;
+	char *input, *p;
+	const char *w;
+	size_t ilen = 1024 * 1024;
+	ulong ntok[2], csum[2];
+	double usec[2];
+	int i;
+
+	lex = lex_new(&estdmm);
+	for ( i = 0; i < array_length(bench_rules); ++i )
+		Lex_add(lex, bench_rules[i], i);
+
+	input = emalloc(ilen + 64);
+	srand(1);
+	for ( p = input; p < input + ilen; ) {
+		w = bench_words[rand() % array_length(bench_words)];
+		p += sprintf(p, "%s ", w);
+	}
+
+	for ( i = 0; i < 2; ++i ) {
+		lex->use_rset = !i;
+		gettimeofday(&start, NULL);
+		ntok[i] = lex_all(lex, input, &csum[i]);
+		gettimeofday(&end, NULL);
+		usec[i] = (end.tv_sec - start.tv_sec) * 1e6 +
+			  end.tv_usec - start.tv_usec;
+		printf("%s: %lu tokens from %u bytes in %.0f usec: %.1f MB/s\n",
+		       i ? "rex_match() per rule" : "combined DFA",
+		       ntok[i], (uint)(p - input), usec[i],
+		       (p - input) / usec[i]);
+	}
+	if ( ntok[0] != ntok[1] || csum[0] != csum[1] )
+		err("combined DFA and per-rule lexing disagree\n");
+	printf("%u rules:  combined DFA is %.1fx faster\n",
+	       (uint)array_length(bench_rules), usec[1] / usec[0]);
+
+	free(input);
+	lex_destroy(lex);
+	return 0;
+}
+
+
 int main(int argc, char *argv[]) 
 {
 	struct lexer *lex; 
@@ -35,6 +118,9 @@ int main(int argc, char *argv[])
 	const char *tokp;
 	int toklen;
 
+	if ( argc > 1 && strcmp(argv[1], "-b") == 0 )
+		return bench();
+
 	lex = lex_new(&estdmm);
 	Lex_add(lex, "[ \t]+", WHITESPACE);
 	Lex_add(lex, "[\n\r]+", NEWLINE);
@@ -13,10 +13,14 @@
 #include <cat/err.h>
 #include <cat/raw.h>
 #include <cat/stduse.h>
+#include <sys/time.h>
+#include <unistd.h>
 
 void usage(void)
 {
-	err("usage: testmatch (-k|-b|-s) <string> <pattern>\n");
+	err("usage: testmatch (-k|-b|-s|-f) <string> <pattern>\n"
+	    "       testmatch -a <string> <pattern> [<pattern>...]\n"
+	    "       testmatch -t\n");
 }
 
 
@@ -148,10 +152,402 @@ void dosuffix(struct raw *str, struct raw *pat)
 }
 
 
+static char **acpats;
+
+
+static int acprint(uint pat, ulong off, void *ctx)
+{
+	printf("Found %s at position %lu in %s\n", acpats[pat], off,
+	       (char *)ctx);
+	return 0;
+}
+
+
+void doac(struct raw *str, char **pats, int npats)
+{
+	struct acpat ac;
+	struct raw pat;
+	int i;
+
+	ac_init(&ac, &estdmm);
+	for ( i = 0; i < npats; ++i )
+		if ( ac_add(&ac, str_to_raw(&pat, pats[i], 0)) < 0 )
+			err("Error adding pattern %s\n", pats[i]);
+	if ( ac_compile(&ac) < 0 )
+		err("Error compiling Aho-Corasick automaton\n");
+	acpats = pats;
+	ac_match(&ac, str, acprint, str->data);
+	ac_free(&ac);
+}
+
+
+/* order independent digest of (pattern, offset) match pairs */
+struct acsum {
+	ulong			n;
+	ulong			sum;
+	ulong			stop;
+};
+
+
+static ulong acmix(ulong pat, ulong off)
+{
+	ulong x = (pat * 0x9E3779B1ul) ^ (off * 0x85EBCA6Bul);
+	return x ^ (x >> 13) ^ (x >> 7);
+}
+
+
+static int acsum(uint pat, ulong off, void *ctx)
+{
+	struct acsum *as = ctx;
+	as->sum += acmix(pat, off);
+	return (++as->n == as->stop);
+}
+
+
+#define ACTLEN		4096
+#define ACNPAT		300
+#define ACBLEN		(1024 * 1024)
+#define ACBPAT		1000
+
+
+static double tv_usec(struct timeval *s, struct timeval *e)
+{
+	return (e->tv_sec - s->tv_sec) * 1e6 + (e->tv_usec - s->tv_usec);
+}
+
+
+void actest(void)
+{
+	static char text[ACBLEN];
+	static char pats[ACBPAT][17];
+	struct acpat ac;
+	struct acscan scan;
+	struct acsum naive, one, chunked;
+	struct raw r, pr;
+	struct bmpat *bmp;
+	struct timeval start, end;
+	ulong loc;
+	size_t off, n;
+	int i, j, len;
+	double acu, bmu;
+
+	/* small alphabet for lots of overlapping and nested matches */
+	srand(3);
+	for ( i = 0; i < ACTLEN; ++i )
+		text[i] = "abcd"[rand() % 4];
+	ac_init(&ac, &estdmm);
+	memset(&naive, 0, sizeof(naive));
+	for ( i = 0; i < ACNPAT; ++i ) {
+		len = 1 + rand() % 6;
+		for ( j = 0; j < len; ++j )
+			pats[i][j] = "abcd"[rand() % 4];
+		pats[i][len] = '\0';
+		if ( ac_add(&ac, str_to_raw(&pr, pats[i], 0)) != i )
+			err("ac_add() failed\n");
+		for ( off = 0; off + len <= ACTLEN; ++off ) {
+			if ( memcmp(text + off, pats[i], len) == 0 ) {
+				naive.sum += acmix(i, off);
+				++naive.n;
+			}
+		}
+	}
+	if ( ac_compile(&ac) < 0 )
+		err("ac_compile() failed\n");
+
+	memset(&one, 0, sizeof(one));
+	r.data = (byte_t *)text;
+	r.len = ACTLEN;
+	ac_match(&ac, &r, acsum, &one);
+
+	memset(&chunked, 0, sizeof(chunked));
+	ac_scan_init(&scan);
+	for ( off = 0; off < ACTLEN; off += n ) {
+		n = 1 + rand() % 17;
+		if ( n > ACTLEN - off )
+			n = ACTLEN - off;
+		r.data = (byte_t *)text + off;
+		r.len = n;
+		ac_scan(&ac, &scan, &r, acsum, &chunked);
+	}
+
+	if ( one.n != naive.n || one.sum != naive.sum ||
+	     chunked.n != naive.n || chunked.sum != naive.sum )
+		err("Aho-Corasick found %lu/%lu matches, expected %lu\n",
+		    one.n, chunked.n, naive.n);
+
+	/* stopping early and resuming */
+	memset(&one, 0, sizeof(one));
+	one.stop = 10;
+	r.data = (byte_t *)text;
+	r.len = ACTLEN;
+	ac_scan_init(&scan);
+	if ( ac_scan(&ac, &scan, &r, acsum, &one) != 1 || one.n != 10 )
+		err("Aho-Corasick did not stop after 10 matches\n");
+	printf("Aho-Corasick found all %lu matches of %d patterns in %d "
+	       "bytes, whole or in chunks\n", naive.n, ACNPAT, ACTLEN);
+	ac_free(&ac);
+
+	/* signature scan:  all patterns at once vs Boyer-Moore per pattern */
+	for ( i = 0; i < ACBLEN; ++i )
+		text[i] = 'a' + rand() % 26;
+	ac_init(&ac, &estdmm);
+	for ( i = 0; i < ACBPAT; ++i ) {
+		len = 4 + rand() % 13;
+		off = rand() % (ACBLEN - len);
+		memcpy(pats[i], text + off, len);
+		pats[i][len] = '\0';
+		ac_add(&ac, str_to_raw(&pr, pats[i], 0));
+	}
+	ac_compile(&ac);
+
+	memset(&one, 0, sizeof(one));
+	r.data = (byte_t *)text;
+	r.len = ACBLEN;
+	gettimeofday(&start, NULL);
+	ac_match(&ac, &r, acsum, &one);
+	gettimeofday(&end, NULL);
+	acu = tv_usec(&start, &end);
+
+	memset(&naive, 0, sizeof(naive));
+	gettimeofday(&start, NULL);
+	for ( i = 0; i < ACBPAT; ++i ) {
+		bmp = bm_pnew(&estdmm, str_to_raw(&pr, pats[i], 0));
+		for ( off = 0; off < ACBLEN; off += loc + 1 ) {
+			r.data = (byte_t *)text + off;
+			r.len = ACBLEN - off;
+			if ( !bm_match(&r, bmp, &loc) )
+				break;
+			naive.sum += acmix(i, off + loc);
+			++naive.n;
+		}
+		free(bmp);
+	}
+	gettimeofday(&end, NULL);
+	bmu = tv_usec(&start, &end);
+
+	if ( one.n != naive.n || one.sum != naive.sum )
+		err("Aho-Corasick found %lu matches, Boyer-Moore %lu\n",
+		    one.n, naive.n);
+	printf("%d signatures in %d bytes: Aho-Corasick %.0f usec, "
+	       "Boyer-Moore per pattern %.0f usec (%lu matches)\n",
+	       ACBPAT, ACBLEN, acu, bmu, one.n);
+	ac_free(&ac);
+}
+
+
+void dosfa(struct raw *str, struct raw *pat)
+{
+	struct sfxarr sfa;
+	unsigned long loc;
+
+	if ( sfa_init(&sfa, str, &estdmm) < 0 )
+		err("sfa_init() failed\n");
+	if (sfa_match(&sfa, pat, &loc))
+		printf("Found %s at position %u in %s (%lu times)\n", pat->data,
+		       (uint)loc, str->data, sfa_range(&sfa, pat, NULL));
+	else
+		printf("%s not found in %s\n", pat->data, str->data);
+	sfa_clear(&sfa);
+}
+
+
+/* suffix order with shorter suffixes before longer ones they prefix */
+static int sfxcmp(const byte_t *s, ulong n, ulong a, ulong b, ulong *lcp)
+{
+	ulong i = 0;
+
+	while ( a + i < n && b + i < n && s[a + i] == s[b + i] )
+		++i;
+	*lcp = i;
+	if ( a + i == n )
+		return -1;
+	if ( b + i == n )
+		return 1;
+	return (s[a + i] < s[b + i]) ? -1 : 1;
+}
+
+
+static void sfacheck(byte_t *s, ulong n)
+{
+	struct sfxarr sfa, lsfa;
+	struct raw r, pat;
+	char fname[] = "/tmp/testmatch.XXXXXX";
+	byte_t seen[512];
+	ulong i, j, lcp, cnt, first, loc, plen;
+	int k, fd;
+
+	r.data = s;
+	r.len = n;
+	if ( sfa_init(&sfa, &r, &estdmm) < 0 || sfa_lcp(&sfa) < 0 )
+		err("building suffix array of %lu bytes failed\n", n);
+
+	memset(seen, 0, sizeof(seen));
+	for ( i = 0; i < n; ++i ) {
+		if ( sfa.sa[i] >= n || seen[sfa.sa[i]] )
+			err("suffix array is not a permutation\n");
+		seen[sfa.sa[i]] = 1;
+		if ( i == 0 ) {
+			if ( sfa.lcp[0] != 0 )
+				err("lcp[0] = %u\n", sfa.lcp[0]);
+			continue;
+		}
+		if ( sfxcmp(s, n, sfa.sa[i - 1], sfa.sa[i], &lcp) >= 0 )
+			err("suffixes %lu and %lu out of order\n", i - 1, i);
+		if ( sfa.lcp[i] != lcp )
+			err("lcp[%lu] = %u, expected %lu\n", i, sfa.lcp[i], lcp);
+	}
+
+	for ( k = 0; k < 50 && n > 0; ++k ) {
+		/* substrings, sometimes with the last byte changed */
+		plen = 1 + rand() % 6;
+		if ( plen > n )
+			plen = n;
+		j = (n > plen) ? rand() % (n - plen + 1) : 0;
+		pat.data = (byte_t *)s + j;
+		pat.len = plen;
+		if ( k % 3 == 0 ) {
+			memcpy(seen, s + j, plen);
+			seen[plen - 1] ^= 1 + rand() % 3;
+			pat.data = seen;
+		}
+		for ( cnt = 0, i = 0; i + plen <= n; ++i )
+			cnt += (memcmp(s + i, pat.data, plen) == 0);
+		if ( sfa_range(&sfa, &pat, &first) != cnt )
+			err("found %lu occurrences, expected %lu\n",
+			    sfa_range(&sfa, &pat, NULL), cnt);
+		for ( i = first; i < first + cnt; ++i )
+			if ( memcmp(s + sfa.sa[i], pat.data, plen) != 0 )
+				err("suffix %lu doesn't start with pattern\n",
+				    i);
+		if ( sfa_match(&sfa, &pat, &loc) != (cnt > 0) ||
+		     (cnt > 0 && memcmp(s + loc, pat.data, plen) != 0) )
+			err("sfa_match() disagrees with sfa_range()\n");
+	}
+
+	if ( (fd = mkstemp(fname)) < 0 )
+		errsys("mkstemp: ");
+	if ( sfa_save(&sfa, fd) < 0 )
+		errsys("sfa_save: ");
+	lseek(fd, 0, SEEK_SET);
+	if ( sfa_load(&lsfa, &r, fd, &estdmm) < 0 )
+		err("sfa_load() failed\n");
+	if ( memcmp(sfa.sa, lsfa.sa, n * sizeof(uint32_t)) != 0 ||
+	     lsfa.lcp == NULL ||
+	     memcmp(sfa.lcp, lsfa.lcp, n * sizeof(uint32_t)) != 0 )
+		err("loaded suffix array differs\n");
+	lseek(fd, 0, SEEK_SET);
+	r.len = n + 1;
+	if ( sfa_load(&lsfa, &r, fd, &estdmm) == 0 )
+		err("loaded suffix array for the wrong length string\n");
+	close(fd);
+	unlink(fname);
+
+	sfa_clear(&lsfa);
+	sfa_clear(&sfa);
+}
+
+
+#define SFABLEN		(1024 * 1024)
+#define SFABPAT		10000
+
+void sfatest(void)
+{
+	static byte_t text[SFABLEN];
+	static const char *alpha[] = { "a", "ab", "abcd", NULL };
+	struct sfxarr sfa;
+	struct sfxtree sfx;
+	struct raw r, pat;
+	struct timeval start, end;
+	ulong i, n, loc, nf;
+	double sau, stu, sam, stm;
+	int a, k;
+
+	/* repetitive, small alphabet and binary strings with NULs */
+	srand(5);
+	for ( a = 0; a < 4; ++a ) {
+		for ( k = 0; k < 40; ++k ) {
+			n = (k < 10) ? k : rand() % 300;
+			for ( i = 0; i < n; ++i ) {
+				if ( alpha[a] == NULL )
+					text[i] = rand() % 4 == 0 ? 0 : rand();
+				else
+					text[i] = alpha[a][rand() %
+							   strlen(alpha[a])];
+			}
+			sfacheck(text, n);
+		}
+	}
+	printf("Suffix arrays and LCP arrays of 160 strings checked\n");
+
+	/* text with long repeats:  copies of earlier pieces with edits */
+	for ( i = 0; i < SFABLEN; i += n ) {
+		n = 1 + rand() % 200;
+		if ( n > SFABLEN - i )
+			n = SFABLEN - i;
+		if ( i > 1000 && rand() % 2 == 0 ) {
+			memcpy(text + i, text + i - 1 - rand() % 1000, n);
+			text[i + rand() % n] = 'a' + rand() % 26;
+		} else {
+			for ( k = 0; k < n; ++k )
+				text[i + k] = 'a' + rand() % 26;
+		}
+	}
+	r.data = text;
+	r.len = SFABLEN;
+
+	gettimeofday(&start, NULL);
+	if ( sfa_init(&sfa, &r, &estdmm) < 0 || sfa_lcp(&sfa) < 0 )
+		err("sfa_init() failed\n");
+	gettimeofday(&end, NULL);
+	sau = tv_usec(&start, &end);
+	gettimeofday(&start, NULL);
+	if ( sfx_init(&sfx, &r, &estdmm) < 0 )
+		err("sfx_init() failed\n");
+	gettimeofday(&end, NULL);
+	stu = tv_usec(&start, &end);
+
+	srand(6);
+	nf = 0;
+	gettimeofday(&start, NULL);
+	for ( k = 0; k < SFABPAT; ++k ) {
+		pat.len = 4 + rand() % 13;
+		pat.data = text + rand() % (SFABLEN - pat.len);
+		nf += sfa_match(&sfa, &pat, &loc);
+	}
+	gettimeofday(&end, NULL);
+	sam = tv_usec(&start, &end);
+	srand(6);
+	gettimeofday(&start, NULL);
+	for ( k = 0; k < SFABPAT; ++k ) {
+		pat.len = 4 + rand() % 13;
+		pat.data = text + rand() % (SFABLEN - pat.len);
+		nf -= sfx_match(&sfx, &pat, &loc);
+	}
+	gettimeofday(&end, NULL);
+	stm = tv_usec(&start, &end);
+	if ( nf != 0 )
+		err("suffix array and suffix tree disagree\n");
+
+	printf("%d bytes: suffix array + LCP built in %.0f usec "
+	       "(%lu bytes), suffix tree in %.0f usec\n", SFABLEN, sau,
+	       (ulong)SFABLEN * 2 * sizeof(uint32_t), stu);
+	printf("%d lookups: suffix array %.0f usec, suffix tree %.0f usec\n",
+	       SFABPAT, sam, stm);
+	sfx_clear(&sfx);
+	sfa_clear(&sfa);
+}
+
+
 int main(int argc, char *argv[])
 {
 	struct raw str, pat;
 
+	if ( argc == 2 && strcmp(argv[1], "-t") == 0 ) {
+		actest();
+		sfatest();
+		return 0;
+	}
+
 	if (argc < 4 || argv[1][0] != '-' )
 		usage();
 
@@ -168,6 +564,12 @@ int main(int argc, char *argv[])
 	case 's':
 		dosuffix(&str, &pat);
 		break;
+	case 'f':
+		dosfa(&str, &pat);
+		break;
+	case 'a':
+		doac(&str, argv + 3, argc - 3);
+		break;
 	default:
 		usage();
 	}
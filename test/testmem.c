@@ -9,6 +9,8 @@
 #include <stdlib.h>
 #include <cat/mem.h>
 #include <cat/stduse.h>
+#include <cat/err.h>
+#include <string.h>
 
 #define NREPS 50000
 #define NMEM 100
@@ -32,6 +34,59 @@ unsigned nreps = NREPS;
 	}
 
 
+struct arena Arena;
+struct arena_mark Mark;
+
+
+static void test_arena(void)
+{
+	struct arena_mark outer, inner;
+	char *p, *q, *r;
+	int i;
+
+	arena_init(&Arena, &estdmm, 256);
+
+	arena_mark(&Arena, &outer);
+	p = mem_get(&Arena.mm, 10);
+	strcpy(p, "hello");
+	if ( (size_t)p % sizeof(cat_align_t) != 0 )
+		err("arena returned an unaligned block\n");
+
+	/* growing the last allocation stays in place */
+	q = mem_resize(&Arena.mm, p, 100);
+	if ( q != p || strcmp(q, "hello") != 0 )
+		err("arena did not grow the last block in place\n");
+
+	/* freeing the last allocation gives the space back */
+	r = mem_get(&Arena.mm, 32);
+	mem_free(&Arena.mm, r);
+	if ( mem_get(&Arena.mm, 32) != r )
+		err("arena did not reuse the last freed block\n");
+
+	/* nested scope spanning several chunks and a large block */
+	arena_mark(&Arena, &inner);
+	for ( i = 0 ; i < 100 ; ++i )
+		memset(mem_get(&Arena.mm, 64), 0xAA, 64);
+	memset(mem_get(&Arena.mm, 5000), 0xBB, 5000);
+	arena_release(&Arena, &inner);
+	if ( mem_get(&Arena.mm, 8) == NULL || strcmp(p, "hello") != 0 )
+		err("releasing the inner mark clobbered older data\n");
+
+	/* resizing an older block moves and copies it */
+	q = mem_resize(&Arena.mm, p, 1000);
+	if ( q == p || strcmp(q, "hello") != 0 )
+		err("arena did not move and copy an older block\n");
+
+	arena_release(&Arena, &outer);
+	if ( Arena.chunks != NULL || Arena.next != NULL )
+		err("releasing the outer mark did not free every chunk\n");
+	arena_fini(&Arena);
+	if ( Arena.spare != NULL )
+		err("arena_fini() did not free the spare chunk\n");
+	printf("arena tests passed\n\n");
+}
+
+
 #define HEAD printf("%-40s\tnanoseconds\n", "Op"); \
 	     printf("%-40s\t-----------\n", "--");
 
@@ -41,7 +96,11 @@ int main(int argc, char *argv[])
 	void *m;
 	void *arr[NMEM];
 	int k;
-	
+
+	test_arena();
+	arena_init(&Arena, &estdmm, 0);
+	arena_mark(&Arena, &Mark);
+
 	TEST(m=malloc(50); free(m));
 	TEST(m=mem_get(&estdmm,50); mem_free(&estdmm,m));
 
@@ -64,6 +123,13 @@ int main(int argc, char *argv[])
 	printf("\n");
 	TEST(for(k=0;k<NMEM;++k)arr[k]=malloc(256);while(k-->0)free(arr[k]););
 	TEST(for(k=0;k<NMEM;++k)arr[k]=mem_get(&estdmm,256);while(k-->0)mem_free(&estdmm,arr[k]););
+	TEST(for(k=0;k<NMEM;++k)arr[k]=mem_get(&Arena.mm,256);arena_release(&Arena,&Mark););
+
+	printf("\n");
+	TEST(for(k=0;k<NMEM;++k)arr[k]=malloc(24);while(k-->0)free(arr[k]););
+	TEST(for(k=0;k<NMEM;++k)arr[k]=mem_get(&Arena.mm,24);arena_release(&Arena,&Mark););
+
+	arena_fini(&Arena);
 
 	return 0;
 }
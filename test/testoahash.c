@@ -0,0 +1,206 @@
+/*
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2003-2017 -- See accompanying license
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <cat/hash.h>
+#include <cat/oahash.h>
+#include <cat/stduse.h>
+
+#define NKEYS	65536
+#define NOPS	(16 * NKEYS)
+#define NITER	16
+
+char *keys[NKEYS];
+char *misses[NKEYS];
+int present[NKEYS];
+int order[NKEYS];
+struct hnode nodes[NKEYS];
+struct hnode *buckets[NKEYS];
+byte_t ctrl[2 * NKEYS];
+struct ohslot slots[2 * NKEYS];
+
+
+static double elapsed(struct timeval *start, struct timeval *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1000000.0 +
+         (end->tv_usec - start->tv_usec);
+}
+
+
+/* random puts, gets and deletes checked against a flag array */
+void test_coht(void)
+{
+  struct cohtab *t;
+  int i, k, n = 0;
+  void *d;
+
+  t = coht_new(0, &coht_std_attr_skey, NULL, 1);
+  for ( i = 0 ; i < NOPS ; ++i ) {
+    k = rand() % NKEYS;
+    switch ( rand() % 3 ) {
+    case 0:
+      if ( coht_put(t, keys[k], keys[k]) != present[k] )
+        err("op %d: put of %s returned wrong status\n", i, keys[k]);
+      n += !present[k];
+      present[k] = 1;
+      break;
+    case 1:
+      d = coht_del(t, keys[k]);
+      if ( (d != NULL) != present[k] || (d != NULL && d != keys[k]) )
+        err("op %d: del of %s returned %p\n", i, keys[k], d);
+      n -= present[k];
+      present[k] = 0;
+      break;
+    default:
+      d = coht_get(t, keys[k]);
+      if ( (d != NULL) != present[k] || (d != NULL && d != keys[k]) )
+        err("op %d: get of %s returned %p\n", i, keys[k], d);
+    }
+    if ( oht_fill(&t->table) != n )
+      err("op %d: table has %u entries instead of %d\n", i,
+          oht_fill(&t->table), n);
+  }
+  for ( i = 0 ; i < NKEYS ; ++i )
+    if ( coht_get(t, misses[i]) != NULL )
+      err("found key %s that was never inserted\n", misses[i]);
+  printf("%d random operations on cohtab passed: %d keys in %u slots\n",
+         NOPS, n, t->table.nslots);
+  coht_free(t);
+}
+
+
+/* keep a small table at its maximum fill so groups fill up and tombstone */
+void test_full(void)
+{
+  struct ohtab t;
+  byte_t c[64];
+  struct ohslot s[64];
+  int in[NKEYS / 64], i, k, n;
+  uint h;
+
+  oht_init(&t, c, s, 64, cmp_str, ht_shash, NULL);
+  for ( i = 0 ; i < array_length(in) ; ++i )
+    in[i] = 0;
+  for ( n = 0 ; !oht_isfull(&t) ; ++n ) {
+    oht_ins(&t, keys[n], keys[n], oht_hash(&t, keys[n]));
+    in[n] = 1;
+  }
+  for ( i = 0 ; i < NOPS ; ++i ) {
+    k = rand() % array_length(in);
+    if ( in[k] ) {
+      oht_rem(&t, oht_lkup(&t, keys[k], NULL));
+      in[k] = 0;
+      --n;
+    } else if ( oht_lkup(&t, keys[k], &h) != NULL ) {
+      err("op %d: found deleted key %s\n", i, keys[k]);
+    } else if ( oht_ins(&t, keys[k], keys[k], h) != NULL ) {
+      in[k] = 1;
+      ++n;
+    } else if ( !oht_isfull(&t) ) {
+      err("op %d: insert failed with %u entries\n", i, t.fill);
+    }
+  }
+  for ( i = 0 ; i < array_length(in) ; ++i )
+    if ( (oht_lkup(&t, keys[i], NULL) != NULL) != in[i] )
+      err("key %s is %s the table\n", keys[i], in[i] ? "missing from" : "in");
+  if ( t.fill != n )
+    err("table has %u entries instead of %d\n", t.fill, n);
+  printf("%d operations on a full table passed: %d keys, %u tombstones\n",
+         NOPS, n, t.ntomb);
+}
+
+
+void bench(void)
+{
+  struct htab ht;
+  struct ohtab ot;
+  struct timeval start, end;
+  uint hashes[NKEYS], h;
+  int i, j;
+  ulong nfound;
+
+  ht_init(&ht, buckets, NKEYS, cmp_str, ht_shash, NULL);
+  oht_init(&ot, ctrl, slots, 2 * NKEYS, cmp_str, ht_shash, NULL);
+  for ( i = 0 ; i < NKEYS ; ++i ) {
+    ht_ninit(&nodes[i], keys[i]);
+    hashes[i] = ht_hash(&ht, keys[i]);
+    ht_ins(&ht, &nodes[i], hashes[i]);
+    if ( oht_ins(&ot, keys[i], keys[i], hashes[i]) == NULL )
+      err("unable to insert key %d into the open addressing table\n", i);
+  }
+
+  gettimeofday(&start, NULL);
+  for ( nfound = 0, j = 0 ; j < NITER ; ++j ) {
+    for ( i = 0 ; i < NKEYS ; ++i ) {
+      nfound += ht_lkup(&ht, keys[order[i]], &h) != NULL;
+      nfound += ht_lkup(&ht, misses[order[i]], &h) != NULL;
+    }
+  }
+  gettimeofday(&end, NULL);
+  if ( nfound != (ulong)NITER * NKEYS )
+    err("htab: found %lu keys\n", nfound);
+  printf("Roughly %f nsec per ht_lkup() w/%d elem, 50%% hits, random order\n",
+         elapsed(&start, &end) * 1000.0 / (2.0 * NITER * NKEYS), NKEYS);
+
+  gettimeofday(&start, NULL);
+  for ( nfound = 0, j = 0 ; j < NITER ; ++j ) {
+    for ( i = 0 ; i < NKEYS ; ++i ) {
+      nfound += oht_lkup(&ot, keys[order[i]], &h) != NULL;
+      nfound += oht_lkup(&ot, misses[order[i]], &h) != NULL;
+    }
+  }
+  gettimeofday(&end, NULL);
+  if ( nfound != (ulong)NITER * NKEYS )
+    err("ohtab: found %lu keys\n", nfound);
+  printf("Roughly %f nsec per oht_lkup() w/%d elem, 50%% hits, random order\n",
+         elapsed(&start, &end) * 1000.0 / (2.0 * NITER * NKEYS), NKEYS);
+
+  /* churn:  delete and reinsert to exercise the tombstones */
+  gettimeofday(&start, NULL);
+  for ( j = 0 ; j < NITER ; ++j ) {
+    for ( i = 0 ; i < NKEYS ; ++i ) {
+      oht_rem(&ot, oht_lkup(&ot, keys[i], &h));
+      if ( oht_ins(&ot, keys[i], keys[i], h) == NULL )
+        err("unable to reinsert key %d\n", i);
+    }
+  }
+  gettimeofday(&end, NULL);
+  printf("Roughly %f nsec per oht_lkup(),oht_rem(),oht_ins() w/%d elem, "
+         "%u tombstones\n", elapsed(&start, &end) * 1000.0 / (NITER * NKEYS),
+         NKEYS, ot.ntomb);
+  for ( i = 0 ; i < NKEYS ; ++i )
+    if ( oht_lkup(&ot, keys[i], NULL) == NULL )
+      err("lost key %d after churn\n", i);
+}
+
+
+int main(int argc, char *argv[])
+{
+  int i, j, tmp;
+
+  for ( i = 0 ; i < NKEYS ; ++i ) {
+    keys[i] = str_fmt_a("session%d", i);
+    misses[i] = str_fmt_a("nosession%d", i);
+    order[i] = i;
+  }
+
+  /* look keys up in random order as a session table would */
+  for ( i = NKEYS - 1 ; i > 0 ; --i ) {
+    j = rand() % (i + 1);
+    tmp = order[i];
+    order[i] = order[j];
+    order[j] = tmp;
+  }
+
+  test_coht();
+  test_full();
+  bench();
+
+  return 0;
+}
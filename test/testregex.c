@@ -5,13 +5,60 @@
  *
  */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 #include <cat/raw.h>
 #include <cat/stduse.h>
 #include <cat/match.h>
 #include <cat/mem.h>
 
 struct rex_match_loc locs[16];
+struct rex_match_loc dlocs[16];
+int nerrs = 0;
+
+
+/*
+ * Match with a compiled copy of the pattern and compare to 'rv' / 'locs'.
+ * A tiny 'maxstates' exercises flushing the DFA state cache.
+ */
+void dfa_check(char *pat, char *str, int rv, uint maxstates)
+{
+	struct rex_pat rp;
+	struct raw r;
+	int drv, i;
+
+	if ( rex_init(&rp, str_to_raw(&r, pat, 0), &estdmm, NULL) < 0 )
+		return;
+	if ( rex_compile(&rp, maxstates) < 0 ) {
+		printf("DFA: /%s/ left to the backtracking matcher\n", pat);
+		rex_free(&rp);
+		return;
+	}
+
+	drv = rex_match(&rp, str_to_raw(&r, str, 0), NULL, 0);
+	if ( drv != rv ) {
+		printf("DFA MISMATCH: /%s/ -- \"%s\": %d vs %d w/o locations\n",
+		       pat, str, drv, rv);
+		++nerrs;
+	}
+
+	memset(dlocs, 0, sizeof(dlocs));
+	drv = rex_match(&rp, &r, dlocs, 16);
+	if ( drv != rv || (rv == REX_MATCH &&
+			   memcmp(locs, dlocs, sizeof(locs)) != 0) ) {
+		printf("DFA MISMATCH: /%s/ -- \"%s\": %d vs %d", pat, str,
+		       drv, rv);
+		if ( drv == REX_MATCH && rv == REX_MATCH )
+			printf(" @%u:%u vs @%u:%u", (uint)dlocs[0].start,
+			       (uint)dlocs[0].len, (uint)locs[0].start,
+			       (uint)locs[0].len);
+		printf("\n");
+		++nerrs;
+	}
+
+	rex_free(&rp);
+}
 
 
 void tmatch(char *pat, char *str)
@@ -43,6 +90,7 @@ void tmatch(char *pat, char *str)
 	}
 
 	rex_free(&rp);
+	dfa_check(pat, str, rv, 0);
 }
 
 
@@ -60,8 +108,110 @@ void tfail(char *pat)
 }
 
 
+/*
+ * Random patterns over a two letter alphabet.  Groups only get bounded
+ * repetitions:  the backtracking matcher recurses forever on unbounded
+ * repetitions of groups that can match the empty string.
+ */
+static char *rpat(char *p, int depth)
+{
+	static const char *atoms[] = { "a", "b", "ab", "[ab]", "[^a]", "." };
+	static const char *reps[] = { "?", "*", "+", "{2}", "{1,3}", "{,2}" };
+	int i, n = 1 + rand() % 3;
+
+	for ( i = 0; i < n; ++i ) {
+		if ( depth > 0 && rand() % 4 == 0 ) {
+			*p++ = '(';
+			p = rpat(p, depth - 1);
+			if ( rand() % 2 ) {
+				*p++ = '|';
+				p = rpat(p, depth - 1);
+			}
+			*p++ = ')';
+			if ( rand() % 2 )
+				p += sprintf(p, "%s", reps[rand() % 2 ? 0 : 3]);
+		} else {
+			p += sprintf(p, "%s", atoms[rand() % 6]);
+			if ( rand() % 2 )
+				p += sprintf(p, "%s", reps[rand() % 6]);
+		}
+	}
+	*p = '\0';
+	return p;
+}
+
+
+void dfa_random(int n)
+{
+	struct rex_pat rp;
+	struct raw r;
+	char pat[256], str[16], *p;
+	int i, j, len, rv, onerrs = nerrs;
+
+	srand(12345);
+	for ( i = 0; i < n; ++i ) {
+		p = pat;
+		if ( rand() % 4 == 0 )
+			*p++ = '^';
+		p = rpat(p, 2);
+		if ( rand() % 4 == 0 )
+			strcpy(p, "$");
+		len = rand() % sizeof(str);
+		for ( j = 0; j < len; ++j )
+			str[j] = "abc"[rand() % 3];
+		str[len] = '\0';
+
+		if ( rex_init(&rp, str_to_raw(&r, pat, 0), &estdmm, NULL) < 0 )
+			continue;
+		memset(locs, 0, sizeof(locs));
+		rv = rex_match(&rp, str_to_raw(&r, str, 0), locs, 16);
+		rex_free(&rp);
+		dfa_check(pat, str, rv, (i % 2) ? 2 : 0);
+	}
+	printf("%d random patterns checked against the DFA: %d mismatches\n",
+	       n, nerrs - onerrs);
+}
+
+
+static double rtime(struct rex_pat *rp, struct raw *str, int iter)
+{
+	struct timeval start, end;
+	int i;
+
+	gettimeofday(&start, NULL);
+	for ( i = 0; i < iter; ++i )
+		rex_match(rp, str, NULL, 0);
+	gettimeofday(&end, NULL);
+	return ((end.tv_sec - start.tv_sec) * 1e6 +
+		(end.tv_usec - start.tv_usec)) / iter;
+}
+
+
+void dfa_bench(char *pat, char *str, int iter)
+{
+	struct rex_pat rp;
+	struct raw p, r;
+	double bt, dfa;
+
+	str_to_raw(&p, pat, 0);
+	str_to_raw(&r, str, 0);
+	rex_init(&rp, &p, &estdmm, NULL);
+	bt = rtime(&rp, &r, iter);
+	rex_free(&rp);
+	rex_init(&rp, &p, &estdmm, NULL);
+	rex_compile(&rp, 0);
+	dfa = rtime(&rp, &r, iter);
+	rex_free(&rp);
+	printf("/%s/ on %u bytes: backtracking %.2f usec, DFA %.2f usec\n",
+	       pat, (uint)r.len, bt, dfa);
+}
+
+
 int main(int argc, char *argv[])
 {
+	char line[4096];
+	int i;
+
 	tmatch("a", "bad");
 	tmatch("a", "good");
 	tmatch("z?", "bad");
@@ -135,6 +285,11 @@ int main(int argc, char *argv[])
 	tmatch("[a-zA-Z_0-9]{1,}", "bababcccaxx");
 	tmatch("[a-zA-Z_0-9]{,5}", "999");
 	tmatch("[a-zA-Z_0-9]{,5}", "999a");
+	tmatch("a?ab", "ab");
+	tmatch("[ab]*b", "aab");
+	tmatch("$", "abc");
+	tmatch("c?$", "abc");
+	tmatch("(x|y)?$", "abc");
 
 	tfail("(abc");
 	tfail("abc)");
@@ -158,5 +313,20 @@ int main(int argc, char *argv[])
 	tfail("a{1000,1000}");
 	tfail("a{,1000}");
 
+	dfa_random(20000);
+
+	for ( i = 0; i < sizeof(line) - 1; ++i )
+		line[i] = "abcdefghij klmnopqrstuvwxyz:"[i % 28];
+	line[i] = '\0';
+	dfa_bench("error|warn(ing)?|fatal", line, 200);
+	dfa_bench("[0-9]+\\.[0-9]+\\.[0-9]+", line, 200);
+	memset(line, 'a', 24);
+	line[24] = '\0';
+	dfa_bench("(a|aa)+b", line, 5);
+
+	if ( nerrs > 0 ) {
+		printf("%d DFA mismatches\n", nerrs);
+		return 1;
+	}
 	return 0;
 }
@@ -0,0 +1,203 @@
+/*
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2003-2017 -- See accompanying license
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <cat/err.h>
+#include <cat/pcache.h>
+#include <cat/stduse.h>
+
+#define NSLOTS		4096
+#define NOPS		(1024 * 1024)
+#define MAXSMALL	256
+#define NKEYS		100000
+
+struct slab Slab;
+ulong nbacking;
+
+
+/* backing memory manager that counts outstanding blocks */
+static void *cnt_alloc(struct memmgr *mm, size_t len)
+{
+  void *p = malloc(len);
+  if ( p != NULL )
+    ++nbacking;
+  return p;
+}
+
+
+static void *cnt_resize(struct memmgr *mm, void *old, size_t len)
+{
+  return realloc(old, len);
+}
+
+
+static void cnt_free(struct memmgr *mm, void *p)
+{
+  if ( p != NULL )
+    --nbacking;
+  free(p);
+}
+
+
+struct memmgr cntmm = { cnt_alloc, cnt_resize, cnt_free, &cntmm };
+
+
+struct slot {
+  byte_t *		data;
+  size_t		len;
+};
+
+
+static double elapsed(struct timeval *start, struct timeval *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1000000.0 +
+         (end->tv_usec - start->tv_usec);
+}
+
+
+static void check(struct slot *s, size_t n)
+{
+  size_t i;
+  for ( i = 0 ; i < n ; ++i )
+    if ( s->data[i] != (byte_t)s->len )
+      err("block %p of %u bytes corrupted at %u\n", s->data,
+          (uint)s->len, (uint)i);
+}
+
+
+/* random allocs, resizes and frees with a mix of small and large blocks */
+static void test_random(void)
+{
+  static struct slot slots[NSLOTS];
+  struct slot *s;
+  size_t len;
+  int i, r;
+
+  slab_init(&Slab, 0, 1, &cntmm);
+  for ( i = 0 ; i < NOPS ; ++i ) {
+    r = rand();
+    s = &slots[r % NSLOTS];
+    len = (r >> 12) % 16 == 0 ? (size_t)(r >> 16) % 16384 + 1 :
+          (size_t)(r >> 16) % 512 + 1;
+    if ( s->data == NULL ) {
+      s->data = mem_get(&Slab.mm, len);
+    } else {
+      check(s, s->len);
+      if ( (r >> 8) % 2 == 0 ) {
+        mem_free(&Slab.mm, s->data);
+        s->data = NULL;
+        continue;
+      }
+      s->data = mem_resize(&Slab.mm, s->data, len);
+      if ( s->data != NULL )
+        check(s, len < s->len ? len : s->len);
+    }
+    if ( s->data == NULL )
+      err("unable to allocate %u bytes\n", (uint)len);
+    s->len = len;
+    memset(s->data, (byte_t)len, len);
+  }
+
+  for ( i = 0 ; i < NSLOTS ; ++i ) {
+    if ( slots[i].data != NULL ) {
+      check(&slots[i], slots[i].len);
+      mem_free(&Slab.mm, slots[i].data);
+      slots[i].data = NULL;
+    }
+  }
+
+  /* with a high water mark of 1 each class keeps at most one free page */
+  if ( nbacking > SLAB_NCLASS )
+    err("%lu pages still held after freeing everything\n", nbacking);
+  slab_freeall(&Slab);
+  if ( nbacking != 0 )
+    err("%lu blocks not released by slab_freeall()\n", nbacking);
+  printf("random alloc/resize/free test passed\n");
+}
+
+
+static void bench(const char *name, struct memmgr *mm)
+{
+  static void *ptrs[NSLOTS];
+  struct timeval start, end;
+  int i, j;
+  uint seed = 1;
+
+  gettimeofday(&start, NULL);
+  for ( i = 0 ; i < NOPS / NSLOTS ; ++i ) {
+    for ( j = 0 ; j < NSLOTS ; ++j )
+      ptrs[j] = mem_get(mm, rand_r(&seed) % MAXSMALL + 1);
+    for ( j = 0 ; j < NSLOTS ; ++j )
+      mem_free(mm, ptrs[j]);
+  }
+  gettimeofday(&end, NULL);
+  printf("%s: %.1f nsec per alloc/free pair\n", name,
+         elapsed(&start, &end) * 1000.0 / NOPS);
+}
+
+
+static void test_tables(void)
+{
+  struct chtab_attr hattr = cht_std_attr_skey;
+  struct cavltree_attr aattr = cavl_std_attr_skey;
+  struct crbtree_attr rattr = crb_std_attr_skey;
+  struct chtab *ht;
+  struct cavltree *at;
+  struct crbtree *rt;
+  char key[32];
+  int i;
+
+  slab_init(&Slab, 0, 0, &cntmm);
+  hattr.mm = aattr.mm = rattr.mm = &Slab.mm;
+  ht = cht_new(128, &hattr, NULL, 1);
+  at = cavl_new(&aattr, 1);
+  rt = crb_new(&rattr, 1);
+
+  for ( i = 0 ; i < NKEYS ; ++i ) {
+    sprintf(key, "key%d", i);
+    cht_put(ht, key, (void *)(ulong)(i + 1));
+    cavl_put(at, key, (void *)(ulong)(i + 1));
+    crb_put(rt, key, (void *)(ulong)(i + 1));
+  }
+  for ( i = 0 ; i < NKEYS ; i += 2 ) {
+    sprintf(key, "key%d", i);
+    cht_del(ht, key);
+    cavl_del(at, key);
+    crb_del(rt, key);
+  }
+  for ( i = 0 ; i < NKEYS ; ++i ) {
+    sprintf(key, "key%d", i);
+    if ( (ulong)cht_get(ht, key) != (i % 2 ? (ulong)(i + 1) : 0) ||
+         (ulong)cavl_get(at, key) != (i % 2 ? (ulong)(i + 1) : 0) ||
+         (ulong)crb_get(rt, key) != (i % 2 ? (ulong)(i + 1) : 0) )
+      err("wrong value for key %s\n", key);
+  }
+
+  cht_free(ht);
+  cavl_free(at);
+  crb_free(rt);
+  slab_freeall(&Slab);
+  if ( nbacking != 0 )
+    err("%lu blocks leaked from the table test\n", nbacking);
+  printf("table node allocation through the slab passed\n");
+}
+
+
+int main(int argc, char *argv[])
+{
+  test_random();
+  test_tables();
+
+  slab_init(&Slab, 0, 0, &stdmm);
+  bench("slab", &Slab.mm);
+  bench("malloc", &stdmm);
+  slab_freeall(&Slab);
+
+  return 0;
+}
@@ -5,11 +5,16 @@
  *
  */
 #include <cat/sort.h>
+#include <cat/tsort.h>
 #include <cat/time.h>
 #include <cat/aux.h>
+#include <cat/raw.h>
+#include <cat/err.h>
+#include <cat/stduse.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 
 /* #define ASIZE	256 */
 #define ASIZE	10000
@@ -418,6 +423,279 @@ void test_speed3()
 }
 
 
+#define PSORTLEN	(4 * 1024 * 1024)
+#define PSORTMAXTHR	8
+int psort_arr1[PSORTLEN], psort_arr2[PSORTLEN], psort_ref[PSORTLEN];
+
+/* no comparison counter here:  the comparisons run in several threads */
+int psort_cmp(const void *i1, const void *i2)
+{
+	int a = *(const int *)i1, b = *(const int *)i2;
+	return (a < b) ? -1 : (a > b);
+}
+
+
+static double psort_time(uint nthreads, size_t len)
+{
+	struct timeval start, end;
+
+	memcpy(psort_arr2, psort_arr1, len * sizeof(int));
+	gettimeofday(&start, NULL);
+	psort_array(psort_arr2, len, sizeof(int), psort_cmp, nthreads);
+	gettimeofday(&end, NULL);
+	if ( memcmp(psort_arr2, psort_ref, len * sizeof(int)) != 0 ) {
+		printf("parallel sort with %u threads of %u elements failed\n",
+		       nthreads, (unsigned)len);
+		exit(1);
+	}
+	return (double)(end.tv_sec - start.tv_sec) + 
+	       (double)(end.tv_usec - start.tv_usec) / 1000000.0;
+}
+
+
+void test_psort()
+{
+	static const size_t lens[] = { 0, 1, 100, 4096 * 2 - 1, 4096 * 3 + 7,
+				       100000, 1000003 };
+	double base, t;
+	uint i, n;
+
+	/* odd sizes and run counts with lots of duplicate keys */
+	for ( i = 0 ; i < array_length(lens) ; ++i ) {
+		for ( n = 0 ; n < lens[i] ; ++n )
+			psort_arr1[n] = rand() % 1000;
+		memcpy(psort_ref, psort_arr1, lens[i] * sizeof(int));
+		qsort_array(psort_ref, lens[i], sizeof(int), psort_cmp);
+		for ( n = 1 ; n <= PSORTMAXTHR ; ++n )
+			psort_time(n, lens[i]);
+	}
+	printf("parallel sort succeeded on all sizes and thread counts\n");
+
+	for ( n = 0 ; n < PSORTLEN ; ++n )
+		psort_arr1[n] = rand();
+	memcpy(psort_ref, psort_arr1, sizeof(psort_ref));
+	qsort_array(psort_ref, PSORTLEN, sizeof(int), psort_cmp);
+
+	base = psort_time(1, PSORTLEN);
+	printf("Time taken to sort %u elements with 1 thread: %f\n",
+	       PSORTLEN, base);
+	for ( n = 2 ; n <= PSORTMAXTHR ; ++n ) {
+		t = psort_time(n, PSORTLEN);
+		printf("Time taken to sort %u elements with %u threads: %f "
+		       "(speedup %.2f)\n", PSORTLEN, n, t, base / t);
+	}
+}
+
+
+#define RSORTLEN	(1024 * 1024)
+struct rs_elem {
+	uint32_t		k32;
+	uint32_t		seq;
+	uint64_t		k64;
+	struct raw		kraw;
+};
+struct rs_elem rs_arr1[RSORTLEN], rs_arr2[RSORTLEN];
+uint64_t rs_keys[RSORTLEN], rs_keys2[RSORTLEN];
+char rs_strs[RSORTLEN][8];
+
+
+int rs_cmp64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return (x < y) ? -1 : (x > y);
+}
+
+
+static int rs_elem_cmp(struct rs_elem *a, struct rs_elem *b, int which)
+{
+	switch (which) {
+	case 0: return (a->k32 < b->k32) ? -1 : (a->k32 > b->k32);
+	case 1: return rs_cmp64(&a->k64, &b->k64);
+	default: return raw_cmp(&a->kraw, &b->kraw);
+	}
+}
+
+
+static void rs_check(size_t len, int which, const char *name)
+{
+	size_t i;
+	int rv;
+
+	for ( i = 1 ; i < len ; ++i ) {
+		rv = rs_elem_cmp(&rs_arr2[i-1], &rs_arr2[i], which);
+		if ( rv > 0 || (rv == 0 && rs_arr2[i-1].seq > rs_arr2[i].seq) ) {
+			printf("%s failed at position %u of %u\n", name,
+			       (unsigned)i, (unsigned)len);
+			exit(1);
+		}
+	}
+}
+
+
+void test_rsort()
+{
+	static const size_t lens[] = { 0, 1, 31, 32, 1000, RSORTLEN };
+	struct timeval start, end;
+	size_t i, j, n, len;
+	double t;
+
+	/* few distinct keys so stability gets tested */
+	for ( i = 0 ; i < RSORTLEN ; ++i ) {
+		rs_arr1[i].k32 = (uint32_t)rand() % 1000 * 0x10001;
+		rs_arr1[i].seq = i;
+		rs_arr1[i].k64 = ((uint64_t)(rand() % 1000) << 40) | 
+				 (rand() % 16);
+		/* strings of length 0-7 over a small alphabet */
+		n = urand(8);
+		for ( j = 0 ; j < n ; ++j )
+			rs_strs[i][j] = 'a' + urand(3);
+		rs_arr1[i].kraw.data = (byte_t *)rs_strs[i];
+		rs_arr1[i].kraw.len = n;
+	}
+
+	for ( i = 0 ; i < array_length(lens) ; ++i ) {
+		len = lens[i];
+		memcpy(rs_arr2, rs_arr1, len * sizeof(struct rs_elem));
+		if ( rsort_u32(rs_arr2, len, sizeof(struct rs_elem),
+			       offsetof(struct rs_elem, k32), &stdmm) < 0 )
+			err("rsort_u32() failed to allocate memory\n");
+		rs_check(len, 0, "rsort_u32()");
+		memcpy(rs_arr2, rs_arr1, len * sizeof(struct rs_elem));
+		if ( rsort_u64(rs_arr2, len, sizeof(struct rs_elem),
+			       offsetof(struct rs_elem, k64), &stdmm) < 0 )
+			err("rsort_u64() failed to allocate memory\n");
+		rs_check(len, 1, "rsort_u64()");
+		memcpy(rs_arr2, rs_arr1, len * sizeof(struct rs_elem));
+		if ( rsort_raw(rs_arr2, len, sizeof(struct rs_elem),
+			       offsetof(struct rs_elem, kraw), &stdmm) < 0 )
+			err("rsort_raw() failed to allocate memory\n");
+		rs_check(len, 2, "rsort_raw()");
+	}
+	printf("radix sorts succeeded and were stable\n");
+
+	for ( i = 0 ; i < RSORTLEN ; ++i )
+		rs_keys[i] = ((uint64_t)rand() << 32) ^ rand();
+
+	memcpy(rs_keys2, rs_keys, sizeof(rs_keys));
+	gettimeofday(&start, NULL);
+	rsort_u64(rs_keys2, RSORTLEN, sizeof(uint64_t), 0, &stdmm);
+	gettimeofday(&end, NULL);
+	t = (double)(end.tv_sec - start.tv_sec) + 
+	    (double)(end.tv_usec - start.tv_usec) / 1000000.0;
+	for ( i = 1 ; i < RSORTLEN ; ++i )
+		if ( rs_keys2[i-1] > rs_keys2[i] )
+			err("rsort_u64() of bare keys failed at %u\n",
+			    (unsigned)i);
+	printf("Time taken to sort %u 64-bit keys with rsort_u64: %f\n",
+	       RSORTLEN, t);
+
+	memcpy(rs_keys2, rs_keys, sizeof(rs_keys));
+	gettimeofday(&start, NULL);
+	qsort_array(rs_keys2, RSORTLEN, sizeof(uint64_t), rs_cmp64);
+	gettimeofday(&end, NULL);
+	printf("Time taken to sort %u 64-bit keys with qsort_array: %f\n",
+	       RSORTLEN, 
+	       (double)(end.tv_sec - start.tv_sec) + 
+	       (double)(end.tv_usec - start.tv_usec) / 1000000.0);
+}
+
+
+#define TSORTLEN	(1024 * 1024)
+struct ts_elem {
+	int			key;
+	short			a;
+	short			b;
+};
+
+#define ts_int_lt(x, y)		((x) < (y))
+#define ts_dbl_lt(x, y)		((x) < (y))
+#define ts_elem_lt(x, y)	((x).key < (y).key)
+CAT_SORT_DEFINE(ts_sort_int, int, ts_int_lt)
+CAT_SORT_DEFINE(ts_sort_dbl, double, ts_dbl_lt)
+CAT_SORT_DEFINE(ts_sort_elem, struct ts_elem, ts_elem_lt)
+
+int ts_iarr[TSORTLEN], ts_iarr2[TSORTLEN];
+double ts_darr[TSORTLEN], ts_darr2[TSORTLEN];
+struct ts_elem ts_earr[TSORTLEN], ts_earr2[TSORTLEN];
+
+
+int ts_dblcmp(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x < y) ? -1 : (x > y);
+}
+
+
+int ts_elemcmp(const void *a, const void *b)
+{
+	return psort_cmp(&((const struct ts_elem *)a)->key,
+			 &((const struct ts_elem *)b)->key);
+}
+
+
+static double ts_secs(struct timeval *start, struct timeval *end)
+{
+	return (double)(end->tv_sec - start->tv_sec) + 
+	       (double)(end->tv_usec - start->tv_usec) / 1000000.0;
+}
+
+
+#define TS_BENCH(_name, _arr, _arr2, _tsort, _cmp)			\
+	do {								\
+		struct timeval _s, _e;					\
+		double _t1, _t2;					\
+		int _i;							\
+		memcpy(_arr2, _arr, sizeof(_arr));			\
+		gettimeofday(&_s, NULL);				\
+		_tsort(_arr2, TSORTLEN);				\
+		gettimeofday(&_e, NULL);				\
+		_t1 = ts_secs(&_s, &_e);				\
+		for ( _i = 1 ; _i < TSORTLEN ; ++_i )			\
+			if ( (*_cmp)(&_arr2[_i-1], &_arr2[_i]) > 0 )	\
+				err("typed sort of %s failed at %d\n",	\
+				    _name, _i);				\
+		memcpy(_arr2, _arr, sizeof(_arr));			\
+		gettimeofday(&_s, NULL);				\
+		qsort_array(_arr2, TSORTLEN, sizeof(_arr[0]), _cmp);	\
+		gettimeofday(&_e, NULL);				\
+		_t2 = ts_secs(&_s, &_e);				\
+		printf("Sorting %u %s: typed sort %f, qsort_array %f "	\
+		       "(%.2fx)\n", TSORTLEN, _name, _t1, _t2, _t2 / _t1);\
+	} while (0)
+
+
+void test_tsort()
+{
+	int i;
+
+	for ( i = 0 ; i < TSORTLEN ; ++i ) {
+		ts_iarr[i] = rand();
+		ts_darr[i] = (double)rand() / RAND_MAX;
+		ts_earr[i].key = rand() % 1000;
+		ts_earr[i].a = i;
+		ts_earr[i].b = -i;
+	}
+	TS_BENCH("ints", ts_iarr, ts_iarr2, ts_sort_int, psort_cmp);
+	TS_BENCH("doubles", ts_darr, ts_darr2, ts_sort_dbl, ts_dblcmp);
+	TS_BENCH("8 byte structs", ts_earr, ts_earr2, ts_sort_elem,
+		 ts_elemcmp);
+
+	/* degenerate inputs:  sorted, reversed and all equal */
+	for ( i = 0 ; i < TSORTLEN ; ++i )
+		ts_iarr[i] = i;
+	ts_sort_int(ts_iarr, TSORTLEN);
+	for ( i = 0 ; i < TSORTLEN ; ++i )
+		ts_iarr2[i] = TSORTLEN - i;
+	ts_sort_int(ts_iarr2, TSORTLEN);
+	for ( i = 0 ; i < TSORTLEN ; ++i )
+		if ( ts_iarr[i] != i || ts_iarr2[i] != i + 1 )
+			err("typed sort of sorted/reversed input failed\n");
+	memset(ts_iarr, 0, sizeof(ts_iarr));
+	ts_sort_int(ts_iarr, TSORTLEN);
+	printf("typed sort handled sorted, reversed and equal input\n");
+}
+
+
 int main(int argc, char *argv[])
 {
 	size_t i;
@@ -444,5 +722,14 @@ int main(int argc, char *argv[])
 	       (unsigned)sizeof(struct speed2_elem));
 	test_speed3();
 
+	printf("\n\nparallel sort test\n");
+	test_psort();
+
+	printf("\n\nradix sort test\n");
+	test_rsort();
+
+	printf("\n\ntyped sort test\n");
+	test_tsort();
+
 	return 0;
 }
@@ -0,0 +1,245 @@
+/*
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2003-2017 -- See accompanying license
+ *
+ */
+#include <cat/cat.h>
+#include <cat/dynmem.h>
+#include <cat/err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#define NWORDS		(1024 * 1024 * 8)
+#define NTHREADS	4
+#define NSLOTS		1024
+#define NOPS		(1024 * 1024)
+#define MAXLARGE	4096
+
+unsigned long Memory[NWORDS];
+struct tlsfmt Heap;
+int use_cache;
+
+
+struct slot {
+  byte_t *		data;
+  size_t		len;
+};
+
+
+static double elapsed(struct timeval *start, struct timeval *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1000000.0 +
+         (end->tv_usec - start->tv_usec);
+}
+
+
+static void check(struct slot *s, int t)
+{
+  size_t i;
+  for ( i = 0 ; i < s->len ; ++i )
+    if ( s->data[i] != (byte_t)(t + s->len) )
+      err("thread %d: block %p of %u bytes corrupted at %u\n", t,
+          s->data, (uint)s->len, (uint)i);
+}
+
+
+static void *locked_alloc(size_t len)
+{
+  void *mem;
+  cat_lock(&Heap.tm_lock);
+  mem = tlsf_malloc(&Heap.tm_tlsf, len);
+  cat_unlock(&Heap.tm_lock);
+  return mem;
+}
+
+
+static void locked_free(void *mem)
+{
+  cat_lock(&Heap.tm_lock);
+  tlsf_free(&Heap.tm_tlsf, mem);
+  cat_unlock(&Heap.tm_lock);
+}
+
+
+/*
+ * Randomly allocate and free mostly small blocks.  The blocks left at
+ * the end get freed from the main thread to exercise cross-thread frees.
+ */
+static struct slot slots[NTHREADS][NSLOTS];
+
+static void *worker(void *arg)
+{
+  int t = (int)(ulong)arg;
+  uint seed = t + 1;
+  struct tlsfcache tc;
+  struct slot *s;
+  size_t len;
+  int i, r;
+
+  tlsfc_init(&tc, &Heap);
+  for ( i = 0 ; i < NOPS ; ++i ) {
+    r = rand_r(&seed);
+    s = &slots[t][r % NSLOTS];
+    if ( s->data != NULL ) {
+      check(s, t);
+      if ( use_cache )
+        tlsfc_free(&tc, s->data);
+      else
+        locked_free(s->data);
+      s->data = NULL;
+      continue;
+    }
+    if ( (r >> 12) % 16 == 0 )
+      len = (r >> 16) % MAXLARGE + 1;
+    else
+      len = (r >> 16) % TLSFC_MAXSMALL + 1;
+    if ( use_cache )
+      s->data = tlsfc_malloc(&tc, len);
+    else
+      s->data = locked_alloc(len);
+    if ( s->data == NULL )
+      err("thread %d: out of memory allocating %u bytes\n", t, (uint)len);
+    s->len = len;
+    memset(s->data, t + len, len);
+  }
+
+  tlsfc_flush(&tc);
+
+  return NULL;
+}
+
+
+static void run(const char *name)
+{
+  pthread_t thr[NTHREADS];
+  struct timeval start, end;
+  struct tlsfcache tc;
+  struct slot *s;
+  int i, j;
+
+  gettimeofday(&start, NULL);
+  for ( i = 0 ; i < NTHREADS ; ++i )
+    if ( pthread_create(&thr[i], NULL, worker, (void *)(ulong)i) != 0 )
+      err("unable to create thread\n");
+  for ( i = 0 ; i < NTHREADS ; ++i )
+    pthread_join(thr[i], NULL);
+  gettimeofday(&end, NULL);
+
+  tlsfc_init(&tc, &Heap);
+  for ( i = 0 ; i < NTHREADS ; ++i ) {
+    for ( j = 0 ; j < NSLOTS ; ++j ) {
+      s = &slots[i][j];
+      if ( s->data == NULL )
+        continue;
+      check(s, i);
+      if ( use_cache )
+        tlsfc_free(&tc, s->data);
+      else
+        locked_free(s->data);
+      s->data = NULL;
+    }
+  }
+  tlsfc_flush(&tc);
+
+  printf("%s: %d threads x %d ops: %.3f usec, %.1f nsec per op\n", name,
+         NTHREADS, NOPS, elapsed(&start, &end),
+         elapsed(&start, &end) * 1000.0 / (NTHREADS * (double)NOPS));
+}
+
+
+static void count_free(void *obj, void *ctx)
+{
+  struct tlsf_block_fake *blk = obj;
+  if ( !blk->allocated )
+    *(size_t *)ctx += blk->size;
+}
+
+
+static void count_pool(void *obj, void *ctx)
+{
+  tlsf_each_block(obj, count_free, ctx);
+}
+
+
+static size_t heap_free(void)
+{
+  size_t n = 0;
+  tlsf_each_pool(&Heap.tm_tlsf, count_pool, &n);
+  return n;
+}
+
+
+/* single threaded checks of the cache's memory manager interface */
+static void test_mm(void)
+{
+  struct tlsfcache tc;
+  struct memmgr *mm = &tc.tc_mm;
+  byte_t *p, *q;
+  size_t before;
+  int i;
+
+  before = heap_free();
+  tlsfc_init(&tc, &Heap);
+
+  p = mem_get(mm, 10);
+  if ( p == NULL || tlsf_blklen(p) < 10 )
+    err("mem_get() returned a bad block\n");
+  memset(p, 0x55, 10);
+  q = mem_resize(mm, p, 300);
+  if ( q == NULL || tlsf_blklen(q) < 300 )
+    err("mem_resize() to a larger class failed\n");
+  for ( i = 0 ; i < 10 ; ++i )
+    if ( q[i] != 0x55 )
+      err("mem_resize() lost data at %d\n", i);
+  memset(q, 0xAA, 300);
+  p = mem_resize(mm, q, 3000);
+  if ( p == NULL )
+    err("mem_resize() to a large block failed\n");
+  for ( i = 0 ; i < 300 ; ++i )
+    if ( p[i] != 0xAA )
+      err("mem_resize() lost data at %d\n", i);
+  q = mem_resize(mm, p, 20);
+  if ( q == NULL || q[19] != 0xAA )
+    err("mem_resize() to a small block failed\n");
+  if ( mem_resize(mm, q, 0) != NULL )
+    err("mem_resize() to 0 should return NULL\n");
+
+  tlsfc_flush(&tc);
+  if ( heap_free() != before )
+    err("flush did not return all memory: %u free, expected %u\n",
+        (uint)heap_free(), (uint)before);
+  printf("memmgr interface OK\n");
+}
+
+
+int main(int argc, char *argv[])
+{
+  size_t before;
+
+  tlsfmt_init(&Heap);
+  tlsfmt_add_pool(&Heap, Memory, sizeof(Memory));
+
+  test_mm();
+
+  if ( !CAT_HAS_ATOMICS ) {
+    printf("No atomic operations:  skipping the multithreaded test\n");
+    return 0;
+  }
+
+  before = heap_free();
+  run("locked tlsf");
+  if ( heap_free() != before )
+    err("locked tlsf leaked memory\n");
+
+  use_cache = 1;
+  run("thread caching tlsf");
+  if ( heap_free() != before )
+    err("thread caching tlsf leaked memory: %u free, expected %u\n",
+        (uint)heap_free(), (uint)before);
+
+  return 0;
+}
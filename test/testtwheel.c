@@ -0,0 +1,183 @@
+/*
+ * by Christopher Adam Telfer
+ *
+ * Copyright 2003-2015 -- See accompanying license
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <cat/twheel.h>
+#include <cat/dlist.h>
+#include <cat/err.h>
+#include <cat/stduse.h>
+
+#define NTIMERS		4096
+#define NRESETS		(4 * NTIMERS)
+#define MAXTTL		60000
+
+struct ttimer {
+  struct twtimer	twe;
+  struct dlist		dle;
+  ulong			ttl;
+  int			fired;
+};
+
+struct ttimer timers[NTIMERS];
+
+
+static double elapsed(struct timeval *start, struct timeval *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1000000.0 +
+         (end->tv_usec - start->tv_usec);
+}
+
+
+/* Drive the wheel by tw_next() and check that every timer fires on time */
+void test_correct(void)
+{
+  struct twheel tw;
+  struct list out;
+  struct ttimer *t;
+  ulong ticks, nfired = 0, ncancel = 0;
+  int i;
+
+  tw_init(&tw);
+  for ( i = 0 ; i < NTIMERS ; ++i ) {
+    tw_tmr_init(&timers[i].twe);
+    timers[i].fired = 0;
+    /* spread over all the levels and sometimes into the overflow list */
+    timers[i].ttl = ((ulong)rand() >> (rand() % 31)) + 1;
+    if ( sizeof(ulong) > 4 && i % 1024 == 0 )
+      timers[i].ttl = ((ulong)1 << (TW_BITS * TW_NLEVELS)) + rand();
+    tw_ins(&tw, &timers[i].twe, timers[i].ttl);
+  }
+
+  for ( i = 0 ; i < NTIMERS ; i += 7 ) {
+    tw_rem(&tw, &timers[i].twe);
+    timers[i].fired = -1;
+    ++ncancel;
+  }
+
+  while ( tw_next(&tw, &ticks) ) {
+    if ( ticks == 0 )
+      err("tw_next() returned 0 ticks with timers pending\n");
+    tw_adv(&tw, ticks, &out);
+    while ( !l_isempty(&out) ) {
+      t = container(l_to_twt(l_head(&out)), struct ttimer, twe);
+      l_rem(&t->twe.entry);
+      if ( t->fired )
+        err("timer %d fired twice or after cancel\n", (int)(t - timers));
+      if ( t->twe.expire != tw.now || t->ttl != tw.now )
+        err("timer %d with ttl %lu fired at %lu\n", (int)(t - timers),
+            t->ttl, tw.now);
+      t->fired = 1;
+      ++nfired;
+    }
+  }
+
+  if ( nfired + ncancel != NTIMERS )
+    err("%lu timers fired and %lu canceled out of %u\n", nfired, ncancel,
+        NTIMERS);
+  printf("All %lu timers fired on time (%lu canceled)\n", nfired, ncancel);
+}
+
+
+/*
+ * One timer per connection: insert them all, then repeatedly reset random
+ * timers as a keepalive would and finally run everything to expiration.
+ */
+void bench_twheel(void)
+{
+  struct twheel tw;
+  struct list out;
+  struct timeval start, end;
+  ulong ticks, nfired = 0;
+  int i, j;
+
+  gettimeofday(&start, NULL);
+  tw_init(&tw);
+  for ( i = 0 ; i < NTIMERS ; ++i ) {
+    tw_tmr_init(&timers[i].twe);
+    tw_ins(&tw, &timers[i].twe, timers[i].ttl);
+  }
+  for ( i = 0 ; i < NRESETS ; ++i ) {
+    j = rand() % NTIMERS;
+    tw_rem(&tw, &timers[j].twe);
+    tw_ins(&tw, &timers[j].twe, timers[j].ttl);
+    if ( i % 16 == 0 ) {
+      tw_adv(&tw, 1, &out);
+      nfired += l_length(&out);
+      while ( !l_isempty(&out) )
+        l_rem(l_head(&out));
+    }
+  }
+  while ( tw_next(&tw, &ticks) ) {
+    tw_adv(&tw, ticks, &out);
+    nfired += l_length(&out);
+    while ( !l_isempty(&out) )
+      l_rem(l_head(&out));
+  }
+  gettimeofday(&end, NULL);
+
+  printf("timing wheel: %lu timers fired, %.3f usec\n", nfired,
+         elapsed(&start, &end));
+}
+
+
+void bench_dlist(void)
+{
+  struct dlist dl;
+  struct list out;
+  struct timeval start, end;
+  cat_time_t ct;
+  ulong nfired = 0;
+  int i, j;
+
+  gettimeofday(&start, NULL);
+  dl_init(&dl, tm_zero);
+  for ( i = 0 ; i < NTIMERS ; ++i ) {
+    dl_init(&timers[i].dle, tm_lset(timers[i].ttl / 1000,
+                                       (timers[i].ttl % 1000) * 1000000));
+    dl_ins(&dl, &timers[i].dle);
+  }
+  for ( i = 0 ; i < NRESETS ; ++i ) {
+    j = rand() % NTIMERS;
+    dl_update(&dl, &timers[j].dle, tm_lset(timers[j].ttl / 1000,
+              (timers[j].ttl % 1000) * 1000000));
+    if ( i % 16 == 0 ) {
+      dl_adv(&dl, tm_lset(0, 1000000), &out);
+      nfired += l_length(&out);
+      while ( !l_isempty(&out) )
+        l_rem(l_head(&out));
+    }
+  }
+  for ( dl_first(&dl, &ct) ; !tm_ltz(ct) ; dl_first(&dl, &ct) ) {
+    dl_adv(&dl, ct, &out);
+    nfired += l_length(&out);
+    while ( !l_isempty(&out) )
+      l_rem(l_head(&out));
+  }
+  gettimeofday(&end, NULL);
+
+  printf("delta list:   %lu timers fired, %.3f usec\n", nfired,
+         elapsed(&start, &end));
+}
+
+
+int main(int argc, char *argv[])
+{
+  int i;
+
+  test_correct();
+
+  for ( i = 0 ; i < NTIMERS ; ++i )
+    timers[i].ttl = rand() % MAXTTL + 1;
+  printf("Benchmarking %d timers with %d resets\n", NTIMERS, NRESETS);
+  srand(1);
+  bench_twheel();
+  srand(1);
+  bench_dlist();
+
+  return 0;
+}
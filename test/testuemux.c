@@ -8,6 +8,7 @@
 #include <cat/io.h>
 #include <cat/uevent.h>
 #include <cat/stduse.h>
+#include <cat/err.h>
 #include <string.h>
 #include <stdio.h>
 #include <unistd.h>
@@ -114,7 +115,12 @@ int main(int argc, char *argv[])
 	unsigned long n;
 	struct ioctx x;
 
-	ue_init(&m, &estdmm);
+	if ( argc > 1 && strcmp(argv[1], "-e") == 0 ) {
+		if ( ue_init_be(&m, &estdmm, UE_BE_EPOLL) < 0 )
+			err("epoll backend not available\n");
+	} else {
+		ue_init(&m, &estdmm);
+	}
 	ue_tm_new(&m, UE_PERIODIC, 2000, percb, NULL);
 	ue_tm_new(&m, UE_TIMEOUT, 7000, attimecb, NULL);
 	ue_sig_new(&m, SIGALRM, alarmcb, NULL);
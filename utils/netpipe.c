@@ -172,7 +172,8 @@ int main(int argc, char *argv[])
 	if ( io_setnblk(cfd) < 0 )
 		errsys("Couldn't set client to non-blocking mode");
 
-	ue_init(&mux, &estdmm);
+	if ( ue_init_be(&mux, &estdmm, UE_BE_BEST) < 0 )
+		errsys("Couldn't initialize event multiplexer");
 	c2sbuf = emalloc(bsiz);
 	s2cbuf = emalloc(bsiz);
 	ring_init(&c2s, c2sbuf, bsiz);
@@ -31,6 +31,8 @@ struct clopt options[] = {
 		      "Automatically generate tokens for uresolved IDs"),
 	CLOPT_I_STRING('T', NULL, "tokpfx",
 		       "Token prefix (defaults to 'CPEGTOK_')"),
+	CLOPT_I_NOARG('s', NULL,
+		      "Generate specialized parsing code instead of tables"),
 };
 struct clopt_parser oparse =
 CLOPTPARSER_INIT(options, array_length(options));
@@ -51,6 +53,8 @@ FILE *outfile_c;
 FILE *outfile_h;
 uint hlines;
 int parse_flags = 0;
+int specialize = 0;
+int hascut = 0;		/* specialized code checks for backtracking past cuts */
 
 
 void usage(const char *estr)
@@ -152,6 +156,9 @@ void parse_args(int argc, char *argv[])
 		case 'T':
 			tokpfx = opt->val.str_val;
 			break;
+		case 's':
+			specialize = 1;
+			break;
 		}
 	}
 	if ( rv != argc - 1 )
@@ -329,6 +336,10 @@ void emit_prolog(struct peg_grammar *peg)
 		if ( HASCALLBACK(NODE(peg, i)) )
 			emit_action(peg, i);
 
+	/* specialized parsers don't need the nodes at runtime */
+	if ( specialize )
+		return;
+
 	/* generate static parsing array */
 	fprintf(outfile_c, "struct peg_node __%s_peg_nodes[%d] = {\n",
 		prefix, peg->num_nodes);
@@ -386,14 +397,411 @@ int find_token(struct peg_grammar *peg, int idx)
 }
 
 
-void emit_parse_functions(struct peg_grammar *peg)
+/*
+ * Specialized parsers:  each expression, primary, literal, class and
+ * token becomes its own C function that matches exactly the way cpg
+ * would walk the same nodes, including when actions fire.  Functions are
+ * named by node number so actions still receive the same node ids.
+ */
+
+void emit_sp_next(void)
+{
+	fprintf(outfile_c,
+		"static int __%s_next(struct cpg_state *s)\n"
+		"{\n"
+		"\tconst uchar *p = s->buf + (s->cur.i - s->base);\n"
+		"\tif ( s->cur.i < s->readidx ) {\n"
+		"\t\tif ( s->cur.i > 0 && p[-1] == '\\n' )\n"
+		"\t\t\ts->cur.line++;\n"
+		"\t\ts->cur.i++;\n"
+		"\t\treturn *p;\n"
+		"\t}\n"
+		"\treturn cpg_getc(s);\n"
+		"}\n\n", prefix);
+}
+
+
+void emit_sp_literal(struct peg_grammar *peg, int nn)
 {
+	struct peg_node *pn = NODE(peg, nn);
 	int i;
-	int id;
 
-	if ( !create_header )
-		emit_forward_defs(outfile_c, peg);
+	fprintf(outfile_c, "static int __%s_l%d(struct cpg_state *s)\n{\n",
+		prefix, nn);
+	if ( pn->pl_value.len == 0 ) {
+		fprintf(outfile_c, "\treturn 1;\n}\n\n");
+		return;
+	}
+	fprintf(outfile_c, "\tstruct cpg_cursor oc = s->cur;\n\tif ( ");
+	for ( i = 0; i < pn->pl_value.len; ++i )
+		fprintf(outfile_c, "%s__%s_next(s) != %u",
+			i == 0 ? "" : " ||\n\t     ", prefix,
+			(uchar)pn->pl_value.data[i]);
+	fprintf(outfile_c, " ) {\n"
+			   "\t\ts->cur = oc;\n"
+			   "\t\treturn 0;\n"
+			   "\t}\n"
+			   "\treturn 1;\n"
+			   "}\n\n");
+}
+
+
+#define SP_MAX_RANGES	4
+
+void emit_sp_class(struct peg_grammar *peg, int nn)
+{
+	struct peg_node *pn = NODE(peg, nn);
+	int lo[SP_MAX_RANGES + 1], hi[SP_MAX_RANGES + 1];
+	int nr = 0;
+	int c;
 
+	/* test a few ranges directly, otherwise look the character up */
+	for ( c = 0; c < 256 && nr <= SP_MAX_RANGES; ++c ) {
+		if ( !cset_contains(pn->pc_cset, c) )
+			continue;
+		if ( nr > 0 && hi[nr - 1] == c - 1 ) {
+			hi[nr - 1] = c;
+		} else {
+			lo[nr] = hi[nr] = c;
+			++nr;
+		}
+	}
+
+	/* an empty class never matches:  there's no need to read */
+	if ( nr == 0 ) {
+		fprintf(outfile_c, "static int __%s_c%d(struct cpg_state *s)\n"
+				   "{\n"
+				   "\t(void)s;\n"
+				   "\treturn 0;\n"
+				   "}\n\n", prefix, nn);
+		return;
+	}
+
+	if ( nr > SP_MAX_RANGES ) {
+		fprintf(outfile_c, "static const uchar __%s_cs%d[32] = {",
+			prefix, nn);
+		for ( c = 0; c < 32; ++c )
+			fprintf(outfile_c, "%s0x%02x", c % 8 ? ", " :
+				(c ? ",\n\t" : "\n\t"),
+				(cset_contains(pn->pc_cset, c * 8) << 0) |
+				(cset_contains(pn->pc_cset, c * 8 + 1) << 1) |
+				(cset_contains(pn->pc_cset, c * 8 + 2) << 2) |
+				(cset_contains(pn->pc_cset, c * 8 + 3) << 3) |
+				(cset_contains(pn->pc_cset, c * 8 + 4) << 4) |
+				(cset_contains(pn->pc_cset, c * 8 + 5) << 5) |
+				(cset_contains(pn->pc_cset, c * 8 + 6) << 6) |
+				(cset_contains(pn->pc_cset, c * 8 + 7) << 7));
+		fprintf(outfile_c, "\n};\n\n");
+	}
+
+	fprintf(outfile_c, "static int __%s_c%d(struct cpg_state *s)\n"
+			   "{\n"
+			   "\tstruct cpg_cursor oc = s->cur;\n"
+			   "\tint c = __%s_next(s);\n"
+			   "\tif ( ", prefix, nn, prefix);
+	if ( nr > SP_MAX_RANGES ) {
+		fprintf(outfile_c, "c >= 0 && ((__%s_cs%d[c >> 3] >> (c & 7)) "
+			"& 1)", prefix, nn);
+	} else {
+		for ( c = 0; c < nr; ++c ) {
+			if ( c > 0 )
+				fprintf(outfile_c, " ||\n\t     ");
+			if ( lo[c] == hi[c] )
+				fprintf(outfile_c, "c == %d", lo[c]);
+			else
+				fprintf(outfile_c, "(c >= %d && c <= %d)",
+					lo[c], hi[c]);
+		}
+	}
+	fprintf(outfile_c, " )\n"
+			   "\t\treturn 1;\n"
+			   "\ts->cur = oc;\n"
+			   "\treturn 0;\n"
+			   "}\n\n");
+}
+
+
+void emit_sp_token(struct peg_grammar *peg, int nn)
+{
+	fprintf(outfile_c, "static int __%s_t%d(struct cpg_state *s)\n"
+			   "{\n"
+			   "\tstruct cpg_cursor oc = s->cur;\n"
+			   "\tif ( __%s_next(s) == %d )\n"
+			   "\t\treturn 1;\n"
+			   "\ts->cur = oc;\n"
+			   "\treturn 0;\n"
+			   "}\n\n", prefix, nn, prefix,
+		PEG_TOKEN_ID(NODE(peg, nn)->pi_def));
+}
+
+
+void emit_sp_primary(struct peg_grammar *peg, int nn)
+{
+	struct peg_node *pn = NODE(peg, nn);
+	struct peg_node *mn = NODE(peg, pn->pp_match);
+	char call[256];
+	const char *ret;
+	int n;
+
+	/* every exit restores the pin after an action that may cut */
+	ret = (HASCALLBACK(pn) && hascut) ? "goto out" : "return rv";
+
+	switch ( mn->pn_type ) {
+	case PEG_SEQUENCE:
+		n = snprintf(call, sizeof(call), "__%s_x%d(s, aux)", prefix,
+			     pn->pp_match);
+		break;
+	case PEG_IDENTIFIER:
+		if ( PEG_IDX_IS_TOKEN(peg, mn->pi_def) )
+			n = snprintf(call, sizeof(call), "__%s_t%d(s)", prefix,
+				     pn->pp_match);
+		else
+			n = snprintf(call, sizeof(call), "__%s_x%d(s, aux)",
+				     prefix, NODE(peg, mn->pi_def)->pd_expr);
+		break;
+	case PEG_LITERAL:
+		n = snprintf(call, sizeof(call), "__%s_l%d(s)", prefix,
+			     pn->pp_match);
+		break;
+	case PEG_CLASS:
+		n = snprintf(call, sizeof(call), "__%s_c%d(s)", prefix,
+			     pn->pp_match);
+		break;
+	case PEG_CUT:
+		n = snprintf(call, sizeof(call), "(cpg_cut(s), 1)");
+		break;
+	default:
+		abort_unless(0);
+	}
+	if ( n >= sizeof(call) )
+		err("Parser prefix too long\n");
+
+	fprintf(outfile_c, "static int __%s_p%d(struct cpg_state *s, "
+			   "void *aux)\n"
+			   "{\n"
+			   "\tstruct cpg_cursor oc = s->cur;\n", prefix, nn);
+	if ( pn->pp_suffix == PEG_ATTR_PLUS )
+		fprintf(outfile_c, "\tuint n = 0;\n");
+	if ( HASCALLBACK(pn) && hascut )
+		fprintf(outfile_c, "\tulong opin = s->pin;\n");
+	fprintf(outfile_c, "\tint rv;\n\n");
+	if ( HASCALLBACK(pn) && hascut )
+		fprintf(outfile_c, "\tif ( oc.i < s->pin )\n"
+				   "\t\ts->pin = oc.i;\n");
+
+	switch ( pn->pp_suffix ) {
+	case PEG_ATTR_NONE:
+		fprintf(outfile_c, "\tif ( (rv = %s) < 0 )\n"
+				   "\t\t%s;\n", call, ret);
+		break;
+	case PEG_ATTR_QUESTION:
+		fprintf(outfile_c, "\tif ( (rv = %s) < 0 )\n"
+				   "\t\t%s;\n"
+				   "\trv = 1;\n", call, ret);
+		break;
+	case PEG_ATTR_STAR:
+		fprintf(outfile_c, "\twhile ( (rv = %s) > 0 )\n"
+				   "\t\t;\n"
+				   "\tif ( rv < 0 )\n"
+				   "\t\t%s;\n"
+				   "\trv = 1;\n", call, ret);
+		break;
+	case PEG_ATTR_PLUS:
+		fprintf(outfile_c, "\twhile ( (rv = %s) > 0 )\n"
+				   "\t\t++n;\n"
+				   "\tif ( rv < 0 )\n"
+				   "\t\t%s;\n"
+				   "\trv = (n >= 1);\n", call, ret);
+		break;
+	default:
+		abort_unless(0);
+	}
+
+	if ( pn->pp_prefix != PEG_ATTR_NONE ) {
+		if ( hascut )
+			fprintf(outfile_c, "\tif ( oc.i < s->cut ) {\n"
+					   "\t\trv = -1;\n"
+					   "\t\t%s;\n"
+					   "\t}\n", ret);
+		fprintf(outfile_c, "\ts->cur = oc;\n");
+		if ( pn->pp_prefix == PEG_ATTR_NOT )
+			fprintf(outfile_c, "\trv = !rv;\n");
+	} else if ( hascut ) {
+		fprintf(outfile_c, "\tif ( rv <= 0 ) {\n"
+				   "\t\tif ( oc.i < s->cut ) {\n"
+				   "\t\t\trv = -1;\n"
+				   "\t\t\t%s;\n"
+				   "\t\t}\n"
+				   "\t\ts->cur = oc;\n"
+				   "\t}\n", ret);
+	} else {
+		fprintf(outfile_c, "\tif ( rv <= 0 )\n\t\ts->cur = oc;\n");
+	}
+
+	if ( HASCALLBACK(pn) ) {
+		fprintf(outfile_c, "\tif ( rv > 0 ) {\n"
+				   "\t\tstruct raw r;\n"
+				   "\t\tint arv;\n"
+				   "\t\tr.data = s->buf + (oc.i - s->base);\n"
+				   "\t\tr.len = s->cur.i - oc.i;\n");
+		if ( pn->pp_action == PEG_ACT_CODE )
+			fprintf(outfile_c, "\t\tarv = __%s_peg_action%d(%d, "
+				"&r, aux);\n", prefix, nn, nn);
+		else
+			fprintf(outfile_c, "\t\tarv = %s(%d, &r, aux);\n",
+				pn->pp_label.data, nn);
+		fprintf(outfile_c, "\t\tif ( arv < 0 )\n"
+				   "\t\t\trv = arv;\n"
+				   "\t}\n");
+		if ( hascut )
+			fprintf(outfile_c, "out:\n"
+					   "\ts->pin = opin;\n");
+	}
+	fprintf(outfile_c, "\treturn rv;\n}\n\n");
+}
+
+
+/* ordered choice of the sequences starting at node 'head' */
+void emit_sp_expr(struct peg_grammar *peg, int head)
+{
+	int seq, pri, alt;
+
+	fprintf(outfile_c, "static int __%s_x%d(struct cpg_state *s, "
+			   "void *aux)\n"
+			   "{\n"
+			   "\tstruct cpg_cursor oc = s->cur;\n"
+			   "\tint rv = 0;\n\n", prefix, head);
+	for ( seq = head, alt = 0; seq >= 0;
+	      seq = NODE(peg, seq)->pn_next, ++alt ) {
+		pri = NODE(peg, seq)->ps_pri;
+		if ( pri < 0 ) {
+			fprintf(outfile_c, "\treturn 1;\n}\n\n");
+			return;
+		}
+		for ( ; pri >= 0; pri = NODE(peg, pri)->pn_next )
+			fprintf(outfile_c, "\tif ( (rv = __%s_p%d(s, aux)) "
+				"<= 0 )\n\t\tgoto alt%d;\n", prefix, pri, alt);
+		fprintf(outfile_c, "\treturn 1;\n"
+				   "alt%d:\n", alt);
+		if ( hascut )
+			fprintf(outfile_c, "\tif ( oc.i < s->cut )\n"
+					   "\t\treturn -1;\n");
+		fprintf(outfile_c, "\ts->cur = oc;\n"
+				   "\tif ( rv < 0 )\n"
+				   "\t\treturn rv;\n");
+	}
+	fprintf(outfile_c, "\t(void)oc;\n\treturn 0;\n}\n\n");
+}
+
+
+/* mark the functions that parsing from expression 'head' can reach */
+void sp_mark(struct peg_grammar *peg, int head, uchar *used)
+{
+	int seq, pri, mn;
+	struct peg_node *pn;
+
+	if ( used[head] )
+		return;
+	used[head] = 1;
+	for ( seq = head; seq >= 0; seq = NODE(peg, seq)->pn_next ) {
+		for ( pri = NODE(peg, seq)->ps_pri; pri >= 0;
+		      pri = NODE(peg, pri)->pn_next ) {
+			used[pri] = 1;
+			mn = NODE(peg, pri)->pp_match;
+			pn = NODE(peg, mn);
+			if ( pn->pn_type == PEG_SEQUENCE )
+				sp_mark(peg, mn, used);
+			else if ( pn->pn_type != PEG_IDENTIFIER ||
+				  PEG_IDX_IS_TOKEN(peg, pn->pi_def) )
+				used[mn] = 1;
+			else
+				sp_mark(peg, NODE(peg, pn->pi_def)->pd_expr,
+					used);
+		}
+	}
+}
+
+
+void emit_specialized(struct peg_grammar *peg, int start)
+{
+	struct peg_node *pn;
+	uchar *used;
+	int i;
+
+	used = ecalloc(peg->num_nodes, 1);
+	sp_mark(peg, start, used);
+	for ( i = 0; i < peg->num_nodes; ++i )
+		if ( used[i] && NODE_TYPE(peg, i) == PEG_CUT )
+			hascut = 1;
+
+	for ( i = 0; i < peg->num_nodes; ++i ) {
+		if ( !used[i] )
+			continue;
+		if ( NODE_TYPE(peg, i) == PEG_PRIMARY )
+			fprintf(outfile_c, "static int __%s_p%d(struct "
+				"cpg_state *s, void *aux);\n", prefix, i);
+		else if ( NODE_TYPE(peg, i) == PEG_SEQUENCE )
+			fprintf(outfile_c, "static int __%s_x%d(struct "
+				"cpg_state *s, void *aux);\n", prefix, i);
+	}
+	fprintf(outfile_c, "\n");
+
+	emit_sp_next();
+	for ( i = 0; i < peg->num_nodes; ++i ) {
+		if ( !used[i] )
+			continue;
+		pn = NODE(peg, i);
+		if ( pn->pn_type == PEG_LITERAL )
+			emit_sp_literal(peg, i);
+		else if ( pn->pn_type == PEG_CLASS )
+			emit_sp_class(peg, i);
+		else if ( pn->pn_type == PEG_IDENTIFIER )
+			emit_sp_token(peg, i);
+	}
+	for ( i = 0; i < peg->num_nodes; ++i ) {
+		if ( !used[i] )
+			continue;
+		if ( NODE_TYPE(peg, i) == PEG_PRIMARY )
+			emit_sp_primary(peg, i);
+		else if ( NODE_TYPE(peg, i) == PEG_SEQUENCE )
+			emit_sp_expr(peg, i);
+	}
+
+	free(used);
+}
+
+
+void emit_sp_entry(struct peg_grammar *peg)
+{
+	int def;
+
+	abort_unless(NODE_TYPE(peg, peg->start_node) == PEG_IDENTIFIER);
+	def = NODE(peg, peg->start_node)->pi_def;
+	abort_unless(NODE_TYPE(peg, def) == PEG_DEFINITION);
+	emit_specialized(peg, NODE(peg, def)->pd_expr);
+
+	fprintf(outfile_c,
+		"static int __%s_getc(void *fp) { return fgetc(fp); }\n\n"
+		"int %s_init(struct %s_parser *p, int (*getc)(void *)) {\n"
+		"  if (getc == NULL) getc = &__%s_getc;\n"
+		"  return cpg_init(&p->pstate, NULL, getc);\n"
+		"}\n\n", prefix, prefix, prefix, prefix);
+
+	fprintf(outfile_c,
+		"int %s_parse(struct %s_parser *p, void *in, void *aux) {\n"
+		"  struct cpg_state *s = &p->pstate;\n"
+		"  int rv;\n"
+		"  s->in = in;\n"
+		"  rv = __%s_x%d(s, aux);\n"
+		"  if ( rv >= 0 && s->cur.i < s->eof )\n"
+		"    rv = -1;\n"
+		"  return rv;\n"
+		"}\n\n", prefix, prefix, prefix, NODE(peg, def)->pd_expr);
+}
+
+
+void emit_cpg_entry(struct peg_grammar *peg)
+{
 	fprintf(outfile_c,
 		"static int __%s_getc(void *fp) { return fgetc(fp); }\n\n"
 		"int %s_init(struct %s_parser *p, int (*getc)(void *)) {\n"
@@ -405,6 +813,21 @@ void emit_parse_functions(struct peg_grammar *peg)
 		"int %s_parse(struct %s_parser *p, void *in, void *aux) {\n"
 		"  return cpg_parse(&p->pstate, in, aux);\n"
 		"}\n\n", prefix, prefix);
+}
+
+
+void emit_parse_functions(struct peg_grammar *peg)
+{
+	int i;
+	int id;
+
+	if ( !create_header )
+		emit_forward_defs(outfile_c, peg);
+
+	if ( specialize )
+		emit_sp_entry(peg);
+	else
+		emit_cpg_entry(peg);
 
 	fprintf(outfile_c,
 		"void %s_reset(struct %s_parser *p) {\n"